@@ -0,0 +1,342 @@
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <vector>
+
+#include <Poco/Exception.h>
+#include <Poco/JSON/Object.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/Timestamp.h>
+#include <Poco/Util/Application.h>
+#include <Poco/Util/HelpFormatter.h>
+#include <Poco/Util/Option.h>
+#include <Poco/Util/OptionSet.h>
+
+#include "bench/LatencyExporter.h"
+#include "bench/LoadGenerator.h"
+#include "core/BasicDistributor.h"
+#include "core/CommandDispatcher.h"
+#include "loop/LoopRunner.h"
+#include "model/DevicePrefix.h"
+#include "zmq/ZMQBroker.h"
+#include "zmq/ZMQClient.h"
+
+/*
+ * Maximal time to wait for registration of all clients (us).
+ */
+#define REGISTRATION_TIMEOUT (10 * Poco::Timespan::SECONDS)
+
+using namespace std;
+using namespace Poco;
+using namespace Poco::JSON;
+using namespace Poco::Util;
+using namespace BeeeOn;
+
+/*
+ * End-to-end benchmark of the gateway data path. It runs the ZMQBroker
+ * with a BasicDistributor and the given number of synthetic device
+ * managers (LoadGenerator) in a single process. Every device manager
+ * registers via hello_request and floods the broker with measured
+ * values at the given rate. After a warm-up, the throughput at the
+ * Exporter, the end-to-end latency percentiles and the CPU time per
+ * message are measured. The CPU time is of the whole process, thus
+ * it includes generating of the load.
+ *
+ * The results are printed either for humans or as a single JSON
+ * object (--format=json) suitable for tracking of regressions.
+ */
+class GatewayBench : public Application {
+public:
+	GatewayBench():
+		m_help(false)
+	{
+		setUnixOptions(true);
+	}
+
+protected:
+	void defineOptions(OptionSet &options) override
+	{
+		Application::defineOptions(options);
+
+		options.addOption(Option("help", "h", "print this help")
+			.required(false)
+			.repeatable(false)
+			.callback(OptionCallback<GatewayBench>(
+				this, &GatewayBench::handleHelp)));
+		options.addOption(Option("clients", "c",
+				"number of device managers (8)")
+			.argument("K")
+			.binding("bench.clients"));
+		options.addOption(Option("rate", "r",
+				"SensorData per second of each device manager, 0 is unlimited (1000)")
+			.argument("N")
+			.binding("bench.rate"));
+		options.addOption(Option("values", "v",
+				"number of values in a single SensorData (4)")
+			.argument("N")
+			.binding("bench.values"));
+		options.addOption(Option("duration", "d",
+				"duration of the measurement in seconds (10)")
+			.argument("S")
+			.binding("bench.duration"));
+		options.addOption(Option("warmup", "w",
+				"duration of the warm-up in seconds (2)")
+			.argument("S")
+			.binding("bench.warmup"));
+		options.addOption(Option("workers", "W",
+				"number of broker workers (0)")
+			.argument("N")
+			.binding("bench.workers"));
+		options.addOption(Option("polling", "p",
+				"use the polling loop of the broker instead of the reactor")
+			.binding("bench.polling"));
+		options.addOption(Option("encoding", "e",
+				"encoding of measured values: json or binary (json)")
+			.argument("ENC")
+			.binding("bench.encoding"));
+		options.addOption(Option("batch", "b",
+				"batch size of device managers, < 2 disables batching (0)")
+			.argument("N")
+			.binding("bench.batch"));
+		options.addOption(Option("credits", "C",
+				"credit window of the broker, 0 disables the flow control (0)")
+			.argument("N")
+			.binding("bench.credits"));
+		options.addOption(Option("port", "P",
+				"hello port of the broker, the data port follows (17001)")
+			.argument("PORT")
+			.binding("bench.port"));
+		options.addOption(Option("format", "f",
+				"output format: text or json (text)")
+			.argument("FMT")
+			.binding("bench.format"));
+	}
+
+	void handleHelp(const string &, const string &)
+	{
+		HelpFormatter formatter(options());
+		formatter.setCommand(commandName());
+		formatter.setUsage("[OPTIONS]");
+		formatter.setHeader("End-to-end benchmark of the gateway data path.");
+		formatter.format(cout);
+
+		m_help = true;
+		stopOptionsProcessing();
+	}
+
+	int main(const vector<string> &) override
+	{
+		if (m_help)
+			return EXIT_OK;
+
+		const unsigned int clients = config().getUInt("bench.clients", 8);
+		const unsigned int rate = config().getUInt("bench.rate", 1000);
+		const unsigned int values = config().getUInt("bench.values", 4);
+		const unsigned int duration = config().getUInt("bench.duration", 10);
+		const unsigned int warmup = config().getUInt("bench.warmup", 2);
+		const unsigned int workers = config().getUInt("bench.workers", 0);
+		const bool polling = config().has("bench.polling");
+		const string encoding = config().getString("bench.encoding", "json");
+		const unsigned int batch = config().getUInt("bench.batch", 0);
+		const unsigned int credits = config().getUInt("bench.credits", 0);
+		const unsigned int port = config().getUInt("bench.port", 17001);
+		const string format = config().getString("bench.format", "text");
+
+		if (clients == 0 || duration == 0) {
+			cerr << "clients and duration must be positive" << endl;
+			return EXIT_USAGE;
+		}
+
+		SharedPtr<LatencyExporter> exporter(new LatencyExporter);
+		SharedPtr<BasicDistributor> distributor(new BasicDistributor);
+		distributor->registerExporter(exporter);
+
+		SharedPtr<ZMQBroker> broker(new ZMQBroker);
+		broker->setHelloServerHost("127.0.0.1");
+		broker->setHelloServerPort(port);
+		broker->setDataServerHost("127.0.0.1");
+		broker->setDataServerPort(port + 1);
+		broker->setDistributor(distributor);
+		broker->setCommandDispatcher(new CommandDispatcher);
+		broker->setReactor(!polling);
+		broker->setWorkers(workers);
+		broker->setEncoding(encoding);
+		broker->setCreditWindow(credits);
+
+		LoopRunner runner;
+		runner.addRunnable(broker);
+
+		vector<SharedPtr<ZMQClient>> zmqClients;
+		vector<SharedPtr<LoadGenerator>> generators;
+		const DevicePrefix prefix = DevicePrefix::parse("Z-Wave");
+
+		for (unsigned int i = 0; i < clients; ++i) {
+			SharedPtr<ZMQClient> client(new ZMQClient);
+
+			client->setHelloServerHost("127.0.0.1");
+			client->setHelloServerPort(port);
+			client->setDataServerHost("127.0.0.1");
+			client->setDataServerPort(port + 1);
+			client->setDeviceManagerPrefix(prefix);
+			client->setEncoding(ZMQMessageEncoding::parse(encoding));
+			client->setBatchSize(batch);
+			client->setCreditWait(Timespan::SECONDS);
+
+			SharedPtr<LoadGenerator> generator(
+				new LoadGenerator(client, DeviceID(prefix, i + 1), values, rate));
+
+			runner.addRunnable(client);
+			runner.addRunnable(generator);
+			zmqClients.push_back(client);
+			generators.push_back(generator);
+		}
+
+		runner.start();
+
+		if (!waitReady(generators)) {
+			runner.stop();
+			cerr << "device managers have not been registered in time" << endl;
+			return EXIT_UNAVAILABLE;
+		}
+
+		sleep(warmup);
+		exporter->reset();
+
+		const unsigned long sentBefore = sent(generators);
+		const Timespan cpuBefore = cpuTime();
+		const Timestamp start;
+
+		sleep(duration);
+
+		const Timestamp::TimeDiff elapsed = start.elapsed();
+		const Timespan cpu = cpuTime() - cpuBefore;
+		const unsigned long sentCount = sent(generators) - sentBefore;
+		const unsigned long items = exporter->items();
+		const unsigned long valueCount = exporter->values();
+		const LatencyHistogram latencies = exporter->latencies();
+
+		runner.stop();
+
+		unsigned long clientDropped = 0;
+		for (auto &client : zmqClients)
+			clientDropped += client->dropped();
+
+		Object::Ptr result = new Object(true);
+		result->set("clients", clients);
+		result->set("rate", rate);
+		result->set("values", values);
+		result->set("workers", workers);
+		result->set("reactor", !polling);
+		result->set("encoding", encoding);
+		result->set("batch", batch);
+		result->set("credits", credits);
+		result->set("duration_us", elapsed);
+		result->set("sent", sentCount);
+		result->set("exported", items);
+		result->set("exported_values", valueCount);
+		result->set("client_dropped", clientDropped);
+		result->set("broker_dropped", broker->framesDropped());
+		result->set("throughput", perSecond(items, elapsed));
+		result->set("values_throughput", perSecond(valueCount, elapsed));
+		result->set("latency_min_us", latencies.min());
+		result->set("latency_mean_us", latencies.mean());
+		result->set("latency_p50_us", latencies.percentile(50));
+		result->set("latency_p90_us", latencies.percentile(90));
+		result->set("latency_p99_us", latencies.percentile(99));
+		result->set("latency_p999_us", latencies.percentile(99.9));
+		result->set("latency_max_us", latencies.max());
+		result->set("cpu_us", cpu.totalMicroseconds());
+		result->set("cpu_us_per_msg", items == 0 ? 0.0 :
+			double(cpu.totalMicroseconds()) / items);
+
+		if (format == "json") {
+			result->stringify(cout);
+			cout << endl;
+		}
+		else {
+			printText(result);
+		}
+
+		return items > 0 ? EXIT_OK : EXIT_SOFTWARE;
+	}
+
+	bool waitReady(const vector<SharedPtr<LoadGenerator>> &generators)
+	{
+		const Timestamp start;
+
+		for (auto &generator : generators) {
+			while (!generator->ready()) {
+				if (start.isElapsed(REGISTRATION_TIMEOUT))
+					return false;
+
+				usleep(10000);
+			}
+		}
+
+		return true;
+	}
+
+	unsigned long sent(const vector<SharedPtr<LoadGenerator>> &generators) const
+	{
+		unsigned long count = 0;
+
+		for (auto &generator : generators)
+			count += generator->sent();
+
+		return count;
+	}
+
+	/*
+	 * User and system CPU time consumed by the whole process.
+	 */
+	Timespan cpuTime() const
+	{
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+
+		return Timespan(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec,
+			usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+	}
+
+	double perSecond(unsigned long count, Timestamp::TimeDiff elapsed) const
+	{
+		return elapsed <= 0 ? 0.0 : double(count) * Timespan::SECONDS / elapsed;
+	}
+
+	void printText(Object::Ptr result) const
+	{
+		cout << "clients: " << result->getValue<unsigned int>("clients")
+			<< ", rate: " << result->getValue<unsigned int>("rate") << "/s"
+			<< ", values: " << result->getValue<unsigned int>("values")
+			<< ", workers: " << result->getValue<unsigned int>("workers")
+			<< ", encoding: " << result->getValue<string>("encoding")
+			<< ", batch: " << result->getValue<unsigned int>("batch")
+			<< ", credits: " << result->getValue<unsigned int>("credits")
+			<< endl;
+		cout << "sent: " << result->getValue<unsigned long>("sent")
+			<< ", exported: " << result->getValue<unsigned long>("exported")
+			<< ", dropped: " << result->getValue<unsigned long>("client_dropped")
+			<< " (client), " << result->getValue<unsigned long>("broker_dropped")
+			<< " (broker)" << endl;
+		cout << "throughput: " << result->getValue<double>("throughput")
+			<< " msg/s, " << result->getValue<double>("values_throughput")
+			<< " values/s" << endl;
+		cout << "latency (us): min " << result->getValue<uint64_t>("latency_min_us")
+			<< ", mean " << result->getValue<double>("latency_mean_us")
+			<< ", p50 " << result->getValue<uint64_t>("latency_p50_us")
+			<< ", p90 " << result->getValue<uint64_t>("latency_p90_us")
+			<< ", p99 " << result->getValue<uint64_t>("latency_p99_us")
+			<< ", p99.9 " << result->getValue<uint64_t>("latency_p999_us")
+			<< ", max " << result->getValue<uint64_t>("latency_max_us")
+			<< endl;
+		cout << "cpu: " << result->getValue<double>("cpu_us_per_msg")
+			<< " us/msg (" << result->getValue<Timespan::TimeDiff>("cpu_us")
+			<< " us in total, including the load generators)" << endl;
+	}
+
+private:
+	bool m_help;
+};
+
+POCO_APP_MAIN(GatewayBench)
@@ -0,0 +1,78 @@
+#include <Poco/Timestamp.h>
+
+#include "bench/LatencyExporter.h"
+#include "model/SensorData.h"
+
+using namespace BeeeOn;
+using namespace Poco;
+using namespace std;
+
+LatencyExporter::LatencyExporter():
+	m_items(0),
+	m_values(0)
+{
+}
+
+bool LatencyExporter::ship(const SensorData &data)
+{
+	const uint64_t now = Timestamp().epochMicroseconds();
+
+	FastMutex::ScopedLock guard(m_lock);
+	record(data, now);
+
+	return true;
+}
+
+bool LatencyExporter::shipBatch(const vector<SensorData> &batch)
+{
+	const uint64_t now = Timestamp().epochMicroseconds();
+
+	FastMutex::ScopedLock guard(m_lock);
+
+	for (auto &data : batch)
+		record(data, now);
+
+	return true;
+}
+
+void LatencyExporter::record(const SensorData &data, uint64_t now)
+{
+	m_items += 1;
+
+	for (auto &value : data) {
+		m_values += 1;
+
+		if (value.moduleID() != ModuleID(0) || !value.isValid())
+			continue;
+
+		const uint64_t sent = value.value();
+		m_latencies.record(now > sent ? now - sent : 0);
+	}
+}
+
+void LatencyExporter::reset()
+{
+	FastMutex::ScopedLock guard(m_lock);
+
+	m_latencies.reset();
+	m_items = 0;
+	m_values = 0;
+}
+
+LatencyHistogram LatencyExporter::latencies()
+{
+	FastMutex::ScopedLock guard(m_lock);
+	return m_latencies;
+}
+
+unsigned long LatencyExporter::items()
+{
+	FastMutex::ScopedLock guard(m_lock);
+	return m_items;
+}
+
+unsigned long LatencyExporter::values()
+{
+	FastMutex::ScopedLock guard(m_lock);
+	return m_values;
+}
@@ -0,0 +1,53 @@
+#ifndef BEEEON_LATENCY_EXPORTER_H
+#define BEEEON_LATENCY_EXPORTER_H
+
+#include <vector>
+
+#include <Poco/Mutex.h>
+
+#include "core/Exporter.h"
+#include "model/ModuleID.h"
+#include "util/LatencyHistogram.h"
+
+namespace BeeeOn {
+
+/*
+ * Exporter measuring the end-to-end latency of SensorData generated
+ * by the LoadGenerator. The generator stores the time of sending
+ * (microseconds since epoch) as the value of the module 0, the latency
+ * is the difference to the time of shipping. SensorData without such
+ * a value are only counted.
+ */
+class LatencyExporter : public Exporter {
+public:
+	LatencyExporter();
+
+	bool ship(const SensorData &data) override;
+	bool shipBatch(const std::vector<SensorData> &batch) override;
+
+	/*
+	 * Forget everything recorded so far, e.g. after a warm-up.
+	 */
+	void reset();
+
+	/*
+	 * Copy of the latencies (in microseconds) recorded so far.
+	 */
+	LatencyHistogram latencies();
+
+	unsigned long items();
+	unsigned long values();
+
+private:
+	void record(const SensorData &data, uint64_t now);
+
+private:
+	Poco::FastMutex m_lock;
+	LatencyHistogram m_latencies;
+	unsigned long m_items;
+	unsigned long m_values;
+};
+
+}
+
+#endif
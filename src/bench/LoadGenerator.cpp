@@ -0,0 +1,80 @@
+#include <unistd.h>
+
+#include <Poco/Timespan.h>
+#include <Poco/Timestamp.h>
+
+#include "bench/LoadGenerator.h"
+#include "model/SensorData.h"
+
+/*
+ * How often the registration of the client is checked (us).
+ */
+#define REGISTRATION_WAIT 10000
+
+using namespace BeeeOn;
+using namespace Poco;
+
+LoadGenerator::LoadGenerator(SharedPtr<ZMQClient> client,
+		const DeviceID &deviceID, unsigned int values, unsigned int rate):
+	m_client(client),
+	m_deviceID(deviceID),
+	m_values(values < 1 ? 1 : values),
+	m_rate(rate),
+	m_stop(false),
+	m_ready(false)
+{
+}
+
+void LoadGenerator::run()
+{
+	while (!m_stop && m_client->deviceManagerID().isNull())
+		usleep(REGISTRATION_WAIT);
+
+	if (m_stop)
+		return;
+
+	m_ready = true;
+
+	const Timestamp::TimeDiff period = m_rate > 0 ?
+		Timespan::SECONDS / m_rate : 0;
+	Timestamp::TimeDiff next = Timestamp().epochMicroseconds();
+
+	while (!m_stop) {
+		Timestamp::TimeDiff now = Timestamp().epochMicroseconds();
+
+		if (period > 0) {
+			if (now < next)
+				usleep(next - now);
+			else if (now - next > Timespan::SECONDS)
+				next = now;
+
+			next += period;
+			now = Timestamp().epochMicroseconds();
+		}
+
+		SensorData data;
+		data.setDeviceID(m_deviceID);
+		data.insertValue(SensorValue(ModuleID(0), now));
+
+		for (unsigned int i = 1; i < m_values; ++i)
+			data.insertValue(SensorValue(ModuleID(i), 20.5 + i));
+
+		m_client->send(data);
+		m_sent++;
+	}
+}
+
+void LoadGenerator::stop()
+{
+	m_stop = true;
+}
+
+unsigned long LoadGenerator::sent() const
+{
+	return m_sent;
+}
+
+bool LoadGenerator::ready() const
+{
+	return m_ready;
+}
@@ -0,0 +1,55 @@
+#ifndef BEEEON_LOAD_GENERATOR_H
+#define BEEEON_LOAD_GENERATOR_H
+
+#include <Poco/AtomicCounter.h>
+#include <Poco/SharedPtr.h>
+
+#include "loop/StoppableRunnable.h"
+#include "model/DeviceID.h"
+#include "util/Loggable.h"
+#include "zmq/ZMQClient.h"
+
+namespace BeeeOn {
+
+/*
+ * Synthetic device manager flooding the gateway with measured values.
+ * It waits until its ZMQClient is registered by the broker and then
+ * sends SensorData of the given number of values at the given rate
+ * (SensorData per second, 0 means as fast as possible). The module 0
+ * of every SensorData carries the time of sending in microseconds
+ * for the LatencyExporter.
+ *
+ * When the generator cannot keep up with the rate for more than
+ * a second, the missed SensorData are not sent in a burst later.
+ */
+class LoadGenerator : public StoppableRunnable, public Loggable {
+public:
+	LoadGenerator(Poco::SharedPtr<ZMQClient> client,
+		const DeviceID &deviceID, unsigned int values, unsigned int rate);
+
+	void run() override;
+	void stop() override;
+
+	/*
+	 * Number of SensorData sent so far.
+	 */
+	unsigned long sent() const;
+
+	/*
+	 * Whether the client has been registered by the broker.
+	 */
+	bool ready() const;
+
+private:
+	Poco::SharedPtr<ZMQClient> m_client;
+	DeviceID m_deviceID;
+	unsigned int m_values;
+	unsigned int m_rate;
+	Poco::AtomicCounter m_stop;
+	Poco::AtomicCounter m_ready;
+	Poco::AtomicCounter m_sent;
+};
+
+}
+
+#endif
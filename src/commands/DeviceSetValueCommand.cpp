@@ -32,6 +32,11 @@ Poco::Timespan DeviceSetValueCommand::timeout() const
 	return m_timeout;
 }
 
+bool DeviceSetValueCommand::hasDeviceID() const
+{
+	return true;
+}
+
 DeviceID DeviceSetValueCommand::deviceID() const
 {
 	return m_deviceID;
@@ -32,7 +32,8 @@ public:
 	ModuleID moduleID() const;
 	double value() const;
 	Poco::Timespan timeout() const;
-	DeviceID deviceID() const;
+	bool hasDeviceID() const override;
+	DeviceID deviceID() const override;
 
 protected:
 	~DeviceSetValueCommand();
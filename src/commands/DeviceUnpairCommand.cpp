@@ -12,6 +12,11 @@ DeviceUnpairCommand::~DeviceUnpairCommand()
 {
 }
 
+bool DeviceUnpairCommand::hasDeviceID() const
+{
+	return true;
+}
+
 DeviceID DeviceUnpairCommand::deviceID() const
 {
 	return m_deviceID;
@@ -20,7 +20,8 @@ public:
 
 	DeviceUnpairCommand(const DeviceID &deviceID);
 
-	DeviceID deviceID() const;
+	bool hasDeviceID() const override;
+	DeviceID deviceID() const override;
 
 protected:
 	~DeviceUnpairCommand();
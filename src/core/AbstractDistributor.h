@@ -23,6 +23,10 @@ public:
 	 * Export data to all registered exporters.
 	 */
 	virtual void exportData(const SensorData &sensorData) = 0;
+	/*
+	 * Export multiple data to all registered exporters.
+	 */
+	virtual void exportBatch(const std::vector<SensorData> &batch) = 0;
 
 protected:
 	std::vector<Poco::SharedPtr<Exporter>> m_exporters;
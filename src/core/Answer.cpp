@@ -1,7 +1,5 @@
 #include <vector>
 
-#include <Poco/Observer.h>
-
 #include "core/Answer.h"
 #include "core/AnswerQueue.h"
 #include "core/CommandRunner.h"
@@ -12,10 +10,10 @@ using namespace Poco;
 Answer::Answer(AnswerQueue &answerQueue):
 	m_answerQueue(answerQueue),
 	m_dirty(0),
-	m_taskManager(Poco::ThreadPool::defaultPool())
+	m_nextDirty(NULL),
+	m_queued(false)
 {
 	answerQueue.add(this);
-	installObservers();
 }
 
 void Answer::setDirty(bool dirty)
@@ -28,6 +26,9 @@ void Answer::setDirtyUnlocked(bool dirty)
 {
 	assureLocked();
 	m_dirty = dirty;
+
+	if (dirty)
+		m_answerQueue.pushDirty(this);
 }
 
 bool Answer::isDirty() const
@@ -76,39 +77,16 @@ bool Answer::isPendingUnlocked() const
 	return false;
 }
 
-void Answer::runCommands()
+void Answer::runCommands(CommandExecutor &executor)
 {
 	assureLocked();
 
-	for (auto item : m_commandList) {
-		m_taskManager.start(item);
-	}
+	for (auto &item : m_commandList)
+		executor.execute(item);
 
 	m_commandList.clear();
 }
 
-void Answer::installObservers()
-{
-	m_taskManager.addObserver(
-		Observer<CommandProgressHandler, Poco::TaskFinishedNotification>
-			(m_commandProgressHandler, &CommandProgressHandler::onFinished)
-	);
-
-	m_taskManager.addObserver(
-		Observer<CommandProgressHandler, Poco::TaskFailedNotification>
-			(m_commandProgressHandler, &CommandProgressHandler::onFailed)
-	);
-	m_taskManager.addObserver(
-		Observer<CommandProgressHandler, Poco::TaskStartedNotification>
-			(m_commandProgressHandler, &CommandProgressHandler::onStarted)
-	);
-
-	m_taskManager.addObserver(
-		Observer<CommandProgressHandler, Poco::TaskCancelledNotification>
-			(m_commandProgressHandler, &CommandProgressHandler::onCancel)
-	);
-}
-
 bool Answer::isEmpty() const
 {
 	return m_commands == 0;
@@ -153,7 +131,7 @@ void Answer::notifyUpdated()
 {
 	assureLocked();
 	setDirtyUnlocked(true);
-	event().set();
+	m_answerQueue.notify();
 }
 
 Result::Ptr Answer::at(size_t position)
@@ -1,15 +1,15 @@
 #ifndef BEEEON_ANSWER_H
 #define BEEEON_ANSWER_H
 
+#include <atomic>
+
 #include <Poco/AutoPtr.h>
 #include <Poco/Event.h>
 #include <Poco/Mutex.h>
 #include <Poco/RefCountedObject.h>
-#include <Poco/Task.h>
-#include <Poco/TaskManager.h>
 
 #include "Command.h"
-#include "core/CommandProgressHandler.h"
+#include "core/CommandExecutor.h"
 #include "core/Result.h"
 
 namespace BeeeOn {
@@ -29,6 +29,7 @@ class Result;
  * change the status in the Answer and in the Result MUST be locked.
  */
 class Answer : public Poco::RefCountedObject {
+	friend AnswerQueue;
 	friend CommandDispatcher;
 public:
 	typedef Poco::AutoPtr<Answer> Ptr;
@@ -43,6 +44,8 @@ public:
 
 	/*
 	 * The status that informs about the change of a Result.
+	 * Setting the dirty status enqueues the Answer into the dirty
+	 * queue of its AnswerQueue.
 	 */
 	void setDirty(bool dirty);
 	void setDirtyUnlocked(bool dirty);
@@ -88,9 +91,9 @@ protected:
 	void assureLocked() const;
 
 	/*
-	 * Run all commands from the Answer.
+	 * Run all commands from the Answer by the given executor.
 	 */
-	void runCommands();
+	void runCommands(CommandExecutor &executor);
 
 	/*
 	 * Adds the command for running and also creates the result
@@ -99,20 +102,19 @@ protected:
 	void addCommand(Poco::SharedPtr<CommandHandler> handler,
 		Command::Ptr cmd, Answer::Ptr answer);
 
-	/*
-	 * Registers an observer with the NotificationCenter.
-	 */
-	void installObservers();
-
 private:
 	AnswerQueue &m_answerQueue;
 	Poco::AtomicCounter m_dirty;
 	mutable Poco::FastMutex m_lock;
 	std::vector<Result::Ptr> m_resultList;
-	std::vector<Poco::Task *> m_commandList;
-	Poco::TaskManager m_taskManager;
-	CommandProgressHandler m_commandProgressHandler;
+	std::vector<CommandExecutor::Job> m_commandList;
 	Poco::AtomicCounter m_commands;
+
+	/*
+	 * Intrusive link of the AnswerQueue dirty queue.
+	 */
+	Answer *m_nextDirty;
+	std::atomic<bool> m_queued;
 };
 
 }
@@ -4,10 +4,18 @@ using namespace BeeeOn;
 using namespace Poco;
 using namespace std;
 
-AnswerQueue::AnswerQueue()
+AnswerQueue::AnswerQueue():
+	m_dirtyHead(NULL),
+	m_fdEvent(NULL)
 {
 }
 
+AnswerQueue::~AnswerQueue()
+{
+	list<Answer::Ptr> answers;
+	popDirty(answers);
+}
+
 bool AnswerQueue::wait(const Timespan &timeout, list<Answer::Ptr> &dirtyList)
 {
 	do {
@@ -16,7 +24,7 @@ bool AnswerQueue::wait(const Timespan &timeout, list<Answer::Ptr> &dirtyList)
 		listDirty(tmpList);
 
 		if (!tmpList.empty()) {
-			dirtyList = tmpList;
+			dirtyList.swap(tmpList);
 			return true;
 		}
 	} while (block(timeout));
@@ -26,9 +34,18 @@ bool AnswerQueue::wait(const Timespan &timeout, list<Answer::Ptr> &dirtyList)
 
 void AnswerQueue::listDirty(list<Answer::Ptr> &dirtyList) const
 {
-	FastMutex::ScopedLock lock(m_mutex);
+	list<Answer::Ptr> answers;
+	popDirty(answers);
+
+	for (auto &answer : answers) {
+		{
+			FastMutex::ScopedLock lock(m_mutex);
+
+			// removed from the queue meanwhile
+			if (m_answerList.find(answer.get()) == m_answerList.end())
+				continue;
+		}
 
-	for (auto answer : m_answerList) {
 		FastMutex::ScopedLock guard(answer->lock());
 		if (answer->isDirtyUnlocked()) {
 			dirtyList.push_back(answer);
@@ -37,11 +54,42 @@ void AnswerQueue::listDirty(list<Answer::Ptr> &dirtyList) const
 	}
 }
 
+void AnswerQueue::pushDirty(Answer *answer)
+{
+	if (answer->m_queued.exchange(true))
+		return;
+
+	answer->duplicate();
+
+	Answer *head = m_dirtyHead.load(memory_order_relaxed);
+	do {
+		answer->m_nextDirty = head;
+	} while (!m_dirtyHead.compare_exchange_weak(head, answer,
+			memory_order_release, memory_order_relaxed));
+}
+
+void AnswerQueue::popDirty(list<Answer::Ptr> &answers) const
+{
+	Answer *answer = m_dirtyHead.exchange(NULL, memory_order_acquire);
+
+	// the queue is a stack, reverse it to get the order of enqueueing
+	while (answer != NULL) {
+		Answer *next = answer->m_nextDirty;
+
+		answer->m_nextDirty = NULL;
+		// an update from now on enqueues the Answer again
+		answer->m_queued = false;
+		answers.push_front(Answer::Ptr(answer, false));
+
+		answer = next;
+	}
+}
+
 void AnswerQueue::add(Answer *answer)
 {
 	FastMutex::ScopedLock lock(m_mutex);
 
-	m_answerList.push_back(AutoPtr<Answer>(answer, true));
+	m_answerList.emplace(answer, AutoPtr<Answer>(answer, true));
 }
 
 bool AnswerQueue::block(const Timespan &timeout)
@@ -61,9 +109,7 @@ void AnswerQueue::remove(const Answer::Ptr answer)
 {
 	FastMutex::ScopedLock lock(m_mutex);
 
-	auto it = find(m_answerList.begin(), m_answerList.end(), answer);
-	if (it != m_answerList.end())
-		m_answerList.erase(it);
+	m_answerList.erase(answer.get());
 }
 
 Event &AnswerQueue::event()
@@ -71,6 +117,19 @@ Event &AnswerQueue::event()
 	return m_event;
 }
 
+void AnswerQueue::setFdEvent(FdEvent *fdEvent)
+{
+	m_fdEvent = fdEvent;
+}
+
+void AnswerQueue::notify()
+{
+	m_event.set();
+
+	if (m_fdEvent != NULL)
+		m_fdEvent->set();
+}
+
 unsigned long AnswerQueue::size() const
 {
 	FastMutex::ScopedLock lock(m_mutex);
@@ -1,12 +1,15 @@
 #ifndef BEEEON_ANSWER_QUEUE_H
 #define BEEEON_ANSWER_QUEUE_H
 
+#include <atomic>
 #include <list>
+#include <unordered_map>
 
 #include <Poco/Event.h>
 #include <Poco/Timespan.h>
 
 #include "core/Answer.h"
+#include "util/FdEvent.h"
 
 namespace BeeeOn {
 
@@ -18,11 +21,22 @@ namespace BeeeOn {
  * It is possible to wait for Answer from queue for a given time using
  * wait(Timespan, dirtyList). After a given time Answers with the set dirty
  * (the status Response was set to the Answers) are stored to the dirtyList.
+ *
+ * An event loop that multiplexes several sources (e.g. zmq_poll) cannot
+ * block in wait(). It can register an FdEvent via setFdEvent() instead.
+ * The FdEvent is signalled on every change together with event() and
+ * the loop can then collect the dirty Answers by wait(0, dirtyList).
+ *
+ * The Answers being set dirty are pushed into a lock-free intrusive
+ * queue (multiple producers, the Answers are linked via their
+ * m_nextDirty). The wait() visits only those Answers instead of
+ * checking all the Answers in the queue.
  */
 class AnswerQueue {
 	friend Answer;
 public:
 	AnswerQueue();
+	~AnswerQueue();
 
 	/*
 	 * Blocking waiting for the list of the Answers in which
@@ -36,11 +50,35 @@ public:
 
 	Poco::Event &event();
 
+	/*
+	 * Set an FdEvent that is signalled whenever any Answer
+	 * in the queue is updated. It must be set before
+	 * the queue is used concurrently.
+	 */
+	void setFdEvent(FdEvent *fdEvent);
+
 	unsigned long size() const;
 
 protected:
 	void add(Answer *answer);
 
+	/*
+	 * Enqueue the Answer into the dirty queue unless it is already
+	 * there. It is lock-free and called with the Answer locked.
+	 */
+	void pushDirty(Answer *answer);
+
+	/*
+	 * Take all the Answers from the dirty queue in order
+	 * of their enqueueing.
+	 */
+	void popDirty(std::list<Answer::Ptr> &answers) const;
+
+	/*
+	 * Wake up all waiting threads and the registered FdEvent.
+	 */
+	void notify();
+
 	bool block(const Poco::Timespan &timeout);
 
 	/*
@@ -49,8 +87,10 @@ protected:
 	void listDirty(std::list<Answer::Ptr> &dirtyList) const;
 
 protected:
-	std::list<Answer::Ptr> m_answerList;
+	std::unordered_map<const Answer *, Answer::Ptr> m_answerList;
+	mutable std::atomic<Answer *> m_dirtyHead;
 	Poco::Event m_event;
+	FdEvent *m_fdEvent;
 	mutable Poco::FastMutex m_mutex;
 };
 
@@ -39,3 +39,29 @@ void BasicDistributor::exportData(const SensorData &sensorData)
 		}
 	}
 }
+
+void BasicDistributor::exportBatch(const std::vector<SensorData> &batch)
+{
+	if (batch.empty())
+		return;
+
+	Poco::FastMutex::ScopedLock lock(m_exportMutex);
+
+	for (Poco::SharedPtr<Exporter> exporter : m_exporters) {
+		try {
+			exporter->shipBatch(batch);
+			poco_debug(logger(), "Batch of "
+				+ std::to_string(batch.size()) + " shipped successfully");
+
+		} catch (Poco::Exception &ex) {
+			poco_error(logger(), "Batch failed to ship: " + ex.displayText());
+
+		} catch (std::exception &ex) {
+			poco_critical(logger(), "Batch failed to ship: " + std::string(ex.what()));
+
+		} catch (...) {
+			poco_critical(logger(), "Unknown error occured when shipping batch");
+
+		}
+	}
+}
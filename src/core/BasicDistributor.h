@@ -14,6 +14,11 @@ public:
 	 * Export data to all registered exporters.
 	 */
 	void exportData(const SensorData &sensorData);
+	/*
+	 * Export the whole batch to all registered exporters
+	 * while holding the lock only once.
+	 */
+	void exportBatch(const std::vector<SensorData> &batch);
 private:
 	Poco::FastMutex m_exportMutex;
 };
@@ -1,3 +1,5 @@
+#include <Poco/Exception.h>
+
 #include "core/Command.h"
 
 using namespace BeeeOn;
@@ -13,6 +15,17 @@ string Command::name() const
 	return m_commandName;
 }
 
+bool Command::hasDeviceID() const
+{
+	return false;
+}
+
+DeviceID Command::deviceID() const
+{
+	throw Poco::NotImplementedException(
+		"command " + m_commandName + " does not target any device");
+}
+
 Command::~Command()
 {
 }
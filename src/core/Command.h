@@ -6,6 +6,7 @@
 #include <Poco/AutoPtr.h>
 #include <Poco/RefCountedObject.h>
 
+#include "model/DeviceID.h"
 #include "util/Castable.h"
 
 namespace BeeeOn {
@@ -24,6 +25,19 @@ public:
 
 	std::string name() const;
 
+	/*
+	 * Returns true when the command targets a particular device.
+	 * The prefix of such device is used to route the command
+	 * to the appropriate CommandHandlers.
+	 */
+	virtual bool hasDeviceID() const;
+
+	/*
+	 * The target device of the command. It throws
+	 * Poco::NotImplementedException unless hasDeviceID().
+	 */
+	virtual DeviceID deviceID() const;
+
 protected:
 	virtual ~Command();
 
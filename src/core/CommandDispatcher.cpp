@@ -7,31 +7,143 @@
 BEEEON_OBJECT_BEGIN(BeeeOn, CommandDispatcher)
 BEEEON_OBJECT_CASTABLE(CommandDispatcher)
 BEEEON_OBJECT_REF("registerHandler", &CommandDispatcher::registerHandler)
+BEEEON_OBJECT_REF("executor", &CommandDispatcher::setExecutor)
 BEEEON_OBJECT_END(BeeeOn, CommandDispatcher)
 
+using namespace std;
 using namespace BeeeOn;
 
+const int CommandDispatcher::ANY_PREFIX;
+
+CommandDispatcher::CommandDispatcher():
+	m_table(new RoutingTable),
+	m_executor(new CommandExecutor)
+{
+}
+
+void CommandDispatcher::setExecutor(CommandExecutor::Ptr executor)
+{
+	m_executor = executor;
+}
+
+size_t CommandDispatcher::RouteKeyHash::operator() (const RouteKey &key) const
+{
+	return hash<type_index>()(key.first) * 31 + hash<int>()(key.second);
+}
+
+/*
+ * Append the target unless it is already the last one (multiple
+ * routes of a single handler). The lists are sorted by the order
+ * of registration as the new handler is always the last one.
+ */
+void CommandDispatcher::RoutingTable::append(
+		TargetList &list, const Target &target)
+{
+	if (!list.empty() && list.back().handler.get() == target.handler.get()) {
+		list.back().confirm = list.back().confirm && target.confirm;
+		return;
+	}
+
+	list.push_back(target);
+}
+
+void CommandDispatcher::RoutingTable::add(
+		const CommandHandler::Route &route, const Target &target)
+{
+	if (route.anyPrefix()) {
+		append(routes[RouteKey(route.type(), ANY_PREFIX)], target);
+
+		// entries of particular prefixes contain also the generic targets
+		for (auto &entry : routes) {
+			if (entry.first.first == route.type() && entry.first.second != ANY_PREFIX)
+				append(entry.second, target);
+		}
+
+		return;
+	}
+
+	const RouteKey key(route.type(), route.prefix().raw());
+	auto it = routes.find(key);
+
+	if (it == routes.end()) {
+		auto generic = routes.find(RouteKey(route.type(), ANY_PREFIX));
+
+		it = routes.emplace(key, generic == routes.end()?
+				TargetList() : generic->second).first;
+	}
+
+	append(it->second, target);
+}
+
+const CommandDispatcher::TargetList *CommandDispatcher::RoutingTable::find(
+		const Command::Ptr cmd) const
+{
+	const type_index type(typeid(*cmd));
+
+	if (cmd->hasDeviceID()) {
+		auto it = routes.find(RouteKey(type, cmd->deviceID().prefix().raw()));
+		if (it != routes.end())
+			return &it->second;
+	}
+
+	auto it = routes.find(RouteKey(type, ANY_PREFIX));
+	if (it != routes.end())
+		return &it->second;
+
+	return NULL;
+}
+
 void CommandDispatcher::registerHandler(Poco::SharedPtr<CommandHandler> handler)
 {
-	for (auto &item : m_commandHandlers) {
+	Poco::FastMutex::ScopedLock guard(m_mutex);
+
+	for (auto &item : m_table->handlers) {
 		if (item.get() == handler.get()) {
 			throw Poco::ExistsException("handler " + handler->name()
 				+ " has been registered");
 		}
 	}
 
-	m_commandHandlers.push_back(handler);
+	shared_ptr<RoutingTable> table(new RoutingTable(*m_table));
+	const Target target = {table->handlers.size(), handler, true};
+	const vector<CommandHandler::Route> routes = handler->routes();
+
+	table->handlers.push_back(handler);
+
+	if (routes.empty())
+		table->dynamic.push_back(target);
+
+	for (auto &route : routes) {
+		Target routed = target;
+		routed.confirm = route.confirm();
+
+		table->add(route, routed);
+	}
+
+	atomic_store(&m_table, shared_ptr<const RoutingTable>(table));
 }
 
 void CommandDispatcher::dispatch(Command::Ptr cmd, Answer::Ptr answer)
 {
-	Poco::FastMutex::ScopedLock guard(m_mutex);
+	const shared_ptr<const RoutingTable> table = atomic_load(&m_table);
+	const TargetList none;
+	const TargetList *found = table->find(cmd);
+	const TargetList &routed = found == NULL? none : *found;
+	const TargetList &dynamic = table->dynamic;
+
+	auto r = routed.begin();
+	auto d = dynamic.begin();
+
+	// merge both lists to keep the order of registration
+	while (r != routed.end() || d != dynamic.end()) {
+		const bool takeRouted = d == dynamic.end()
+			|| (r != routed.end() && r->order < d->order);
+		const Target &target = takeRouted? *r++ : *d++;
 
-	for (auto item : m_commandHandlers) {
-		if (!item->accept(cmd))
+		if (target.confirm && !target.handler->accept(cmd))
 			continue;
 
-		answer->addCommand(item, cmd, answer);
+		answer->addCommand(target.handler, cmd, answer);
 	}
 
 	Poco::FastMutex::ScopedLock lock(answer->lock());
@@ -40,5 +152,5 @@ void CommandDispatcher::dispatch(Command::Ptr cmd, Answer::Ptr answer)
 		return;
 	}
 
-	answer->runCommands();
+	answer->runCommands(*m_executor);
 }
@@ -1,11 +1,16 @@
 #ifndef BEEEON_COMMAND_DISPATCHER_H
 #define BEEEON_COMMAND_DISPATCHER_H
 
-#include <list>
+#include <memory>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <Poco/Mutex.h>
 #include <Poco/SharedPtr.h>
 
+#include "core/CommandExecutor.h"
 #include "core/CommandHandler.h"
 #include "core/Command.h"
 
@@ -16,10 +21,27 @@ class Command;
 
 /*
  * The CommandDispatcher the given command to the target handler and
- * contain registered command handlers.
+ * contain registered command handlers. The handlers are executed
+ * by the CommandExecutor.
+ *
+ * The targets are resolved via a routing table built from routes
+ * declared by the handlers (CommandHandler::routes()). The table is
+ * indexed by the command type and the DevicePrefix of its target
+ * device. It is immutable, registerHandler() replaces it by a new
+ * copy, so the dispatching does not need any lock. Handlers without
+ * routes are asked via accept() for every command.
  */
 class CommandDispatcher {
 public:
+	CommandDispatcher();
+
+	/*
+	 * Set the executor of commands. The executor can be shared
+	 * among multiple dispatchers. When not set, the dispatcher
+	 * creates its own executor with default settings.
+	 */
+	void setExecutor(CommandExecutor::Ptr executor);
+
 	/*
 	 * Register a command handler for command dispatching.
 	 */
@@ -34,7 +56,40 @@ public:
 	void dispatch(Command::Ptr cmd, Answer::Ptr answer);
 
 private:
-	std::list<Poco::SharedPtr<CommandHandler>> m_commandHandlers;
+	struct Target {
+		/*
+		 * Order of registration of the handler.
+		 */
+		size_t order;
+		Poco::SharedPtr<CommandHandler> handler;
+		bool confirm;
+	};
+
+	typedef std::vector<Target> TargetList;
+
+	/*
+	 * Command type and the raw DevicePrefix or ANY_PREFIX.
+	 */
+	typedef std::pair<std::type_index, int> RouteKey;
+
+	struct RouteKeyHash {
+		size_t operator() (const RouteKey &key) const;
+	};
+
+	struct RoutingTable {
+		std::vector<Poco::SharedPtr<CommandHandler>> handlers;
+		std::unordered_map<RouteKey, TargetList, RouteKeyHash> routes;
+		TargetList dynamic;
+
+		const TargetList *find(const Command::Ptr cmd) const;
+		void add(const CommandHandler::Route &route, const Target &target);
+		static void append(TargetList &list, const Target &target);
+	};
+
+	static const int ANY_PREFIX = -1;
+
+	std::shared_ptr<const RoutingTable> m_table;
+	CommandExecutor::Ptr m_executor;
 	Poco::FastMutex m_mutex;
 };
 
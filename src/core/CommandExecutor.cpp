@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <deque>
+#include <exception>
+
+#include <Poco/Environment.h>
+#include <Poco/Exception.h>
+#include <Poco/Logger.h>
+#include <Poco/Thread.h>
+
+#include "core/CommandExecutor.h"
+#include "di/Injectable.h"
+
+BEEEON_OBJECT_BEGIN(BeeeOn, CommandExecutor)
+BEEEON_OBJECT_CASTABLE(CommandExecutor)
+BEEEON_OBJECT_NUMBER("threadsCount", &CommandExecutor::setThreadsCount)
+BEEEON_OBJECT_END(BeeeOn, CommandExecutor)
+
+using namespace BeeeOn;
+using namespace Poco;
+using namespace std;
+
+static const unsigned int MIN_DEFAULT_THREADS = 4;
+static const long WORKER_IDLE_WAIT_MS = 100;
+
+/*
+ * Executor and index of the worker owning the current thread.
+ */
+static thread_local const CommandExecutor *currentExecutor = NULL;
+static thread_local size_t currentWorker = 0;
+
+class CommandExecutor::Worker : public Runnable {
+public:
+	Worker(CommandExecutor &executor, size_t index):
+		m_executor(executor),
+		m_index(index)
+	{
+	}
+
+	void start()
+	{
+		m_thread.setName("command-" + to_string(m_index));
+		m_thread.start(*this);
+	}
+
+	void join()
+	{
+		if (m_thread.isRunning())
+			m_thread.join();
+	}
+
+	void run() override
+	{
+		currentExecutor = &m_executor;
+		currentWorker = m_index;
+
+		m_executor.work(m_index);
+	}
+
+	void push(Job job)
+	{
+		FastMutex::ScopedLock guard(m_lock);
+		m_queue.push_back(job);
+	}
+
+	/*
+	 * The owner takes the oldest job.
+	 */
+	bool pop(Job &job)
+	{
+		FastMutex::ScopedLock guard(m_lock);
+
+		if (m_queue.empty())
+			return false;
+
+		job = m_queue.front();
+		m_queue.pop_front();
+		return true;
+	}
+
+	/*
+	 * Others steal the newest job to not compete with the owner.
+	 */
+	bool steal(Job &job)
+	{
+		FastMutex::ScopedLock guard(m_lock);
+
+		if (m_queue.empty())
+			return false;
+
+		job = m_queue.back();
+		m_queue.pop_back();
+		return true;
+	}
+
+private:
+	CommandExecutor &m_executor;
+	size_t m_index;
+	Thread m_thread;
+	FastMutex m_lock;
+	deque<Job> m_queue;
+};
+
+CommandExecutor::CommandExecutor():
+	m_threadsCount(max(Environment::processorCount(), MIN_DEFAULT_THREADS)),
+	m_started(false),
+	m_stop(false),
+	m_pending(0),
+	m_sleeping(0),
+	m_next(0)
+{
+}
+
+CommandExecutor::~CommandExecutor()
+{
+	stop();
+}
+
+void CommandExecutor::setThreadsCount(int count)
+{
+	if (count <= 0)
+		throw InvalidArgumentException("threadsCount must be positive");
+
+	FastMutex::ScopedLock guard(m_lock);
+
+	if (m_started)
+		throw IllegalStateException("executor is already running");
+
+	m_threadsCount = count;
+}
+
+unsigned int CommandExecutor::threadsCount() const
+{
+	return m_threadsCount;
+}
+
+void CommandExecutor::start()
+{
+	for (size_t i = 0; i < m_threadsCount; ++i)
+		m_workers.push_back(new Worker(*this, i));
+
+	for (auto &worker : m_workers)
+		worker->start();
+
+	m_started = true;
+}
+
+void CommandExecutor::execute(Job job)
+{
+	FastMutex::ScopedLock guard(m_lock);
+
+	// checked under the lock, so stop() never misses the job
+	if (m_stop)
+		throw IllegalStateException("executor has been stopped");
+
+	if (!m_started)
+		start();
+
+	size_t index;
+
+	if (currentExecutor == this)
+		index = currentWorker;
+	else
+		index = m_next++ % m_workers.size();
+
+	++m_pending;
+	m_workers[index]->push(job);
+
+	if (m_sleeping > 0)
+		m_wakeup.set();
+}
+
+size_t CommandExecutor::pending() const
+{
+	return m_pending;
+}
+
+void CommandExecutor::stop()
+{
+	{
+		FastMutex::ScopedLock guard(m_lock);
+		m_stop = true;
+	}
+
+	// the workers are not modified after stop, a job being
+	// executed can call execute() (and fail) without a deadlock
+	for (auto &worker : m_workers) {
+		m_wakeup.set();
+		worker->join();
+	}
+}
+
+bool CommandExecutor::take(size_t index, Job &job)
+{
+	if (m_workers[index]->pop(job))
+		return true;
+
+	for (size_t i = 1; i < m_workers.size(); ++i) {
+		if (m_workers[(index + i) % m_workers.size()]->steal(job))
+			return true;
+	}
+
+	return false;
+}
+
+void CommandExecutor::work(size_t index)
+{
+	while (true) {
+		Job job;
+
+		if (take(index, job)) {
+			--m_pending;
+
+			// more work is available, pass the wakeup on
+			if (m_pending > 0 && m_sleeping > 0)
+				m_wakeup.set();
+
+			run(job);
+			continue;
+		}
+
+		if (m_stop && m_pending == 0)
+			break;
+
+		++m_sleeping;
+
+		if (m_pending == 0 && !m_stop)
+			m_wakeup.tryWait(WORKER_IDLE_WAIT_MS);
+
+		--m_sleeping;
+	}
+
+	// let the other workers to notice the stop
+	m_wakeup.set();
+}
+
+void CommandExecutor::run(Job &job)
+{
+	try {
+		job->run();
+	}
+	catch (const Exception &e) {
+		logger().log(e, __FILE__, __LINE__);
+	}
+	catch (const exception &e) {
+		logger().critical(e.what(), __FILE__, __LINE__);
+	}
+	catch (...) {
+		logger().critical("unknown error in command execution",
+			__FILE__, __LINE__);
+	}
+}
@@ -0,0 +1,93 @@
+#ifndef BEEEON_COMMAND_EXECUTOR_H
+#define BEEEON_COMMAND_EXECUTOR_H
+
+#include <atomic>
+#include <vector>
+
+#include <Poco/Event.h>
+#include <Poco/Mutex.h>
+#include <Poco/Runnable.h>
+#include <Poco/SharedPtr.h>
+
+#include "util/Loggable.h"
+
+namespace BeeeOn {
+
+/*
+ * Gateway-wide pool of threads executing the commands (CommandRunner)
+ * dispatched by the CommandDispatcher. Every worker thread has its own
+ * queue of jobs. The jobs are distributed among the queues round-robin,
+ * a job created by a worker thread is queued to the queue of the worker.
+ * An idle worker steals jobs from queues of other workers. Thus, a worker
+ * blocked by a long running job does not delay jobs queued after it.
+ *
+ * The threads are started when the first job is executed. The count
+ * of threads must be set before.
+ */
+class CommandExecutor : public Loggable {
+public:
+	typedef Poco::SharedPtr<CommandExecutor> Ptr;
+	typedef Poco::SharedPtr<Poco::Runnable> Job;
+
+	CommandExecutor();
+	~CommandExecutor();
+
+	/*
+	 * Count of worker threads, the default is the count
+	 * of processors but at least 4 as the commands might block.
+	 */
+	void setThreadsCount(int count);
+	unsigned int threadsCount() const;
+
+	/*
+	 * Queue the job to be executed by a worker thread.
+	 * @throw IllegalStateException, when the executor has been stopped
+	 */
+	void execute(Job job);
+
+	/*
+	 * Count of jobs queued and not yet started.
+	 */
+	size_t pending() const;
+
+	/*
+	 * Stop all workers. The already queued jobs are executed first.
+	 */
+	void stop();
+
+private:
+	class Worker;
+
+	/*
+	 * Start the workers. The m_lock must be locked.
+	 */
+	void start();
+
+	/*
+	 * Take a job from the queue of the given worker or steal
+	 * a job from queues of other workers.
+	 */
+	bool take(size_t index, Job &job);
+
+	/*
+	 * Main loop of the worker with the given index.
+	 */
+	void work(size_t index);
+
+	void run(Job &job);
+
+private:
+	unsigned int m_threadsCount;
+	std::vector<Poco::SharedPtr<Worker>> m_workers;
+	Poco::FastMutex m_lock;
+	std::atomic<bool> m_started;
+	std::atomic<bool> m_stop;
+	std::atomic<size_t> m_pending;
+	std::atomic<unsigned int> m_sleeping;
+	std::atomic<unsigned int> m_next;
+	Poco::Event m_wakeup;
+};
+
+}
+
+#endif
@@ -12,3 +12,45 @@ string CommandHandler::name() const
 {
 	return m_name;
 }
+
+vector<CommandHandler::Route> CommandHandler::routes() const
+{
+	return {};
+}
+
+CommandHandler::Route::Route(const type_info &type, bool confirm):
+	m_type(type),
+	m_anyPrefix(true),
+	m_prefix(DevicePrefix::fromRaw(DevicePrefix::PREFIX_INVALID)),
+	m_confirm(confirm)
+{
+}
+
+CommandHandler::Route::Route(const type_info &type,
+		const DevicePrefix &prefix, bool confirm):
+	m_type(type),
+	m_anyPrefix(false),
+	m_prefix(prefix),
+	m_confirm(confirm)
+{
+}
+
+type_index CommandHandler::Route::type() const
+{
+	return m_type;
+}
+
+bool CommandHandler::Route::anyPrefix() const
+{
+	return m_anyPrefix;
+}
+
+DevicePrefix CommandHandler::Route::prefix() const
+{
+	return m_prefix;
+}
+
+bool CommandHandler::Route::confirm() const
+{
+	return m_confirm;
+}
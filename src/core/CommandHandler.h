@@ -2,10 +2,14 @@
 #define BEEEON_COMMAND_HANDLER_H
 
 #include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <vector>
 
 #include "core/Command.h"
 #include "core/Result.h"
 #include "core/Answer.h"
+#include "model/DevicePrefix.h"
 
 namespace BeeeOn {
 
@@ -18,6 +22,46 @@ class Answer;
  */
 class CommandHandler {
 public:
+	/*
+	 * Static declaration of commands served by a handler. The route
+	 * matches commands of the given type. When a prefix is given,
+	 * only commands targeting a device with the prefix are matched
+	 * (see Command::hasDeviceID()).
+	 *
+	 * Matching commands are passed to the handler without calling
+	 * accept() unless the route is created as confirmed. Such route
+	 * only narrows the set of commands accept() is called for.
+	 */
+	class Route {
+	public:
+		Route(const std::type_info &type, bool confirm = false);
+		Route(const std::type_info &type,
+			const DevicePrefix &prefix, bool confirm = false);
+
+		template <typename C>
+		static Route of(bool confirm = false)
+		{
+			return Route(typeid(C), confirm);
+		}
+
+		template <typename C>
+		static Route of(const DevicePrefix &prefix, bool confirm = false)
+		{
+			return Route(typeid(C), prefix, confirm);
+		}
+
+		std::type_index type() const;
+		bool anyPrefix() const;
+		DevicePrefix prefix() const;
+		bool confirm() const;
+
+	private:
+		std::type_index m_type;
+		bool m_anyPrefix;
+		DevicePrefix m_prefix;
+		bool m_confirm;
+	};
+
 	/*
 	 * CommandHandler with specific name of handler.
 	 * The name is intended for debugging purposes only.
@@ -29,8 +73,17 @@ public:
 	 */
 	std::string name() const;
 
+	/*
+	 * Commands served by this handler. The routes are read once
+	 * when the handler is registered into a CommandDispatcher.
+	 * A handler without any routes is dynamic, its accept() is
+	 * called for every dispatched command.
+	 */
+	virtual std::vector<Route> routes() const;
+
 	/*
 	 * Returns true if the given command can be handled by this handler.
+	 * It is not called for commands matching an unconfirmed route.
 	 */
 	virtual bool accept(const Command::Ptr cmd) = 0;
 
@@ -1,18 +1,42 @@
+#include <exception>
+
+#include <Poco/Exception.h>
+#include <Poco/Logger.h>
+
 #include "core/CommandRunner.h"
 
 using namespace BeeeOn;
+using namespace Poco;
 using namespace std;
 
 CommandRunner::CommandRunner(Command::Ptr cmd, Answer::Ptr answer,
 		Poco::SharedPtr<CommandHandler> handler):
-	Task(cmd->name()),
 	m_cmd(cmd),
 	m_handler(handler),
 	m_answer(answer)
 {
 }
 
-void CommandRunner::runTask()
+void CommandRunner::run()
 {
-	m_handler->handle(m_cmd, m_answer);
+	if (logger().debug())
+		logger().debug(m_cmd->name() + " has started");
+
+	try {
+		m_handler->handle(m_cmd, m_answer);
+	}
+	catch (const Exception &e) {
+		logger().error(m_cmd->name() + " has failed",
+			__FILE__, __LINE__);
+		logger().log(e, __FILE__, __LINE__);
+		return;
+	}
+	catch (const exception &e) {
+		logger().error(m_cmd->name() + " has failed: " + e.what(),
+			__FILE__, __LINE__);
+		return;
+	}
+
+	if (logger().debug())
+		logger().debug(m_cmd->name() + " has finished");
 }
@@ -3,11 +3,12 @@
 
 #include <string>
 
+#include <Poco/Runnable.h>
 #include <Poco/SharedPtr.h>
-#include <Poco/Task.h>
 
 #include "core/CommandHandler.h"
 #include "core/Answer.h"
+#include "util/Loggable.h"
 
 namespace BeeeOn {
 
@@ -17,18 +18,19 @@ class CommandHandler;
 
 /*
  * Execute the CommandHandler::handle() method in a separate thread
- * via the Poco::Task class. Thus, the command handling is
+ * of the CommandExecutor. Thus, the command handling is
  * always non-blocking.
  */
-class CommandRunner : public Poco::Task {
+class CommandRunner : public Poco::Runnable, public Loggable {
 public:
 	CommandRunner(Command::Ptr cmd, Answer::Ptr answer,
 		Poco::SharedPtr<CommandHandler> handler);
 
 	/*
 	 * Executes method CommandHandler::handle in a separate thread.
+	 * A failure of the handler is logged.
 	 */
-	void runTask();
+	void run() override;
 
 private:
 	Command::Ptr m_cmd;
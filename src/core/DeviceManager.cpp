@@ -1,12 +1,23 @@
+#include <vector>
+
+#include <Poco/Exception.h>
+
 #include "core/DeviceManager.h"
 #include "util/ZMQUtil.h"
+#include "zmq/ZMQMessage.h"
+
+#define REQUEST_TTL      (60 * Poco::Timespan::SECONDS)
+#define REQUEST_CAPACITY 1024
 
 using namespace BeeeOn;
+using namespace std;
 
 DeviceManager::DeviceManager():
 	m_stop(false),
 	m_prefix(DevicePrefix::fromRaw(DevicePrefix::PREFIX_INVALID)),
-	m_zmqClient(new ZMQClient())
+	m_zmqClient(new ZMQClient()),
+	m_requests(REQUEST_TTL, REQUEST_CAPACITY),
+	m_answers(REQUEST_TTL, REQUEST_CAPACITY)
 {
 	m_runner.addRunnable(m_zmqClient);
 }
@@ -23,6 +34,43 @@ void DeviceManager::setPrefixName(const std::string &name)
 	m_zmqClient->setDeviceManagerPrefix(m_prefix);
 }
 
+void DeviceManager::setEncoding(const std::string &encoding)
+{
+	m_zmqClient->setEncoding(ZMQMessageEncoding::parse(encoding));
+}
+
+void DeviceManager::setBatchSize(const int size)
+{
+	if (size < 1)
+		throw Poco::InvalidArgumentException("batch size must be positive");
+
+	m_zmqClient->setBatchSize(size);
+}
+
+void DeviceManager::setBatchDelay(const int delay)
+{
+	if (delay < 0)
+		throw Poco::InvalidArgumentException("batch delay must not be negative");
+
+	m_zmqClient->setBatchDelay(delay * Poco::Timespan::MILLISECONDS);
+}
+
+void DeviceManager::setCreditBuffer(const int size)
+{
+	if (size < 1)
+		throw Poco::InvalidArgumentException("credit buffer must be positive");
+
+	m_zmqClient->setCreditBuffer(size);
+}
+
+void DeviceManager::setCreditWait(const int wait)
+{
+	if (wait < 0)
+		throw Poco::InvalidArgumentException("credit wait must not be negative");
+
+	m_zmqClient->setCreditWait(wait * Poco::Timespan::MILLISECONDS);
+}
+
 void DeviceManager::setDataServerHost(const std::string &host)
 {
 	m_zmqClient->setDataServerHost(host);
@@ -47,3 +95,66 @@ void DeviceManager::runClient()
 {
 	m_runner.start();
 }
+
+void DeviceManager::sendRequest(Answer::Ptr answer, Command::Ptr cmd)
+{
+	ZMQMessage msg = ZMQMessage::fromCommand(cmd);
+	msg.setID(GlobalID::random());
+
+	{
+		Poco::FastMutex::ScopedLock guard(m_requestLock);
+		vector<ResultData> evicted;
+
+		expireRequests();
+
+		m_requests.insert(msg.id(), answer);
+		m_answers.insert(answer.get(), ResultData{answer, cmd}, evicted);
+
+		for (auto &data : evicted)
+			m_queue.remove(data.answer);
+	}
+
+	m_zmqClient->send(msg.toString());
+}
+
+Answer::Ptr DeviceManager::findAnswer(const GlobalID &id)
+{
+	Poco::FastMutex::ScopedLock guard(m_requestLock);
+	Answer::Ptr answer;
+
+	m_requests.take(id, answer);
+	return answer;
+}
+
+Command::Ptr DeviceManager::answeredCommand(Answer::Ptr answer)
+{
+	Poco::FastMutex::ScopedLock guard(m_requestLock);
+
+	const ResultData *data = m_answers.find(answer.get());
+	if (data == NULL)
+		return Command::Ptr();
+
+	Command::Ptr cmd = data->cmd;
+
+	if (!answer->isPending()) {
+		m_answers.remove(answer.get());
+		m_queue.remove(answer);
+	}
+
+	return cmd;
+}
+
+void DeviceManager::expireRequests()
+{
+	const Poco::Timestamp now;
+	vector<Answer::Ptr> requests;
+	vector<ResultData> answers;
+
+	m_requests.expire(now, requests);
+	m_answers.expire(now, answers);
+
+	for (auto &data : answers) {
+		logger().warning("request " + data.cmd->name() + " has not been answered");
+		m_queue.remove(data.answer);
+	}
+}
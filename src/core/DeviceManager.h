@@ -2,14 +2,17 @@
 #define BEEEON_DEVICE_MANAGER_H
 
 #include <Poco/AtomicCounter.h>
+#include <Poco/Mutex.h>
 #include <Poco/SharedPtr.h>
 
 #include "core/Answer.h"
+#include "core/AnswerQueue.h"
 #include "core/Command.h"
 #include "loop/StoppableRunnable.h"
 #include "loop/LoopRunner.h"
 #include "model/DeviceID.h"
 #include "model/GlobalID.h"
+#include "util/CorrelationRegistry.h"
 #include "util/Loggable.h"
 #include "zmq/ZMQClient.h"
 
@@ -27,14 +30,34 @@ public:
 	void setHelloServerPort(const int port);
 	void setPrefixName(const std::string &prefixName);
 
+	/*
+	 * Preferred encoding ("json" or "binary") of the messages
+	 * sent to the server.
+	 */
+	void setEncoding(const std::string &encoding);
+
+	/*
+	 * Measured values are sent in batches of at most the given
+	 * size, delayed at most by batchDelay milliseconds.
+	 */
+	void setBatchSize(const int size);
+	void setBatchDelay(const int delay);
+
+	/*
+	 * Measured values are buffered (at most creditBuffer SensorData)
+	 * while the server does not grant credits. When the buffer is full,
+	 * sending blocks at most creditWait milliseconds.
+	 */
+	void setCreditBuffer(const int size);
+	void setCreditWait(const int wait);
+
 protected:
 	/*
-	 * Struktura reprezentujuca potrebne udaje ktore sa ulozia do mapy
-	 * m_table spolu s answer a su potrebne pre prijatie spravne
-	 * priradenie prijatej spravy.
+	 * Struktura reprezentujuca potrebne udaje ktore sa ulozia do
+	 * registra m_answers a su potrebne pre spracovanie odpovede.
 	 */
 	struct ResultData {
-		GlobalID id;
+		Answer::Ptr answer;
 		Command::Ptr cmd;
 	};
 
@@ -45,12 +68,45 @@ protected:
 
 	void runClient();
 
+	/*
+	 * Send the command to the server with a new id. The response
+	 * is matched by findAnswer() and processed via the Answer
+	 * created in m_queue.
+	 */
+	void sendRequest(Answer::Ptr answer, Command::Ptr cmd);
+
+	/*
+	 * Answer waiting for the response of the given id or NULL
+	 * when the id is unknown or expired. There is only one response
+	 * for each request, so the id is forgotten.
+	 */
+	Answer::Ptr findAnswer(const GlobalID &id);
+
+	/*
+	 * Command of the request answered via the given Answer or NULL
+	 * when it is unknown or expired. The request is forgotten when
+	 * the Answer is finished.
+	 */
+	Command::Ptr answeredCommand(Answer::Ptr answer);
+
 protected:
 	Poco::AtomicCounter m_stop;
 	DevicePrefix m_prefix;
 	LoopRunner m_runner;
-	std::map<Answer::Ptr, ResultData> m_table;
+	AnswerQueue m_queue;
 	Poco::SharedPtr<ZMQClient> m_zmqClient;
+
+private:
+	void expireRequests();
+
+	/*
+	 * Requests sent to the server are matched by their id to
+	 * the Answers and the Answers are matched to the Commands.
+	 * Entries that are not answered expire after REQUEST_TTL.
+	 */
+	CorrelationRegistry<GlobalID, Answer::Ptr, GlobalIDHash> m_requests;
+	CorrelationRegistry<const Answer *, ResultData> m_answers;
+	Poco::FastMutex m_requestLock;
 };
 
 }
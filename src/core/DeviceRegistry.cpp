@@ -0,0 +1,366 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <Poco/ByteOrder.h>
+#include <Poco/Exception.h>
+#include <Poco/Logger.h>
+
+#include "commands/DeviceUnpairCommand.h"
+#include "commands/ServerDeviceListCommand.h"
+#include "commands/ServerDeviceListResult.h"
+#include "core/DeviceRegistry.h"
+#include "di/Injectable.h"
+#include "model/SensorData.h"
+
+#define REGISTRY_MAGIC 0x47524442 // BDRG
+#define REGISTRY_VERSION 2
+#define HEADER_SIZE 8
+#define RECORD_SIZE 8
+#define REMOVED_MARKER 0xffffffffffffffffULL
+
+BEEEON_OBJECT_BEGIN(BeeeOn, DeviceRegistry)
+BEEEON_OBJECT_CASTABLE(Exporter)
+BEEEON_OBJECT_CASTABLE(CommandHandler)
+BEEEON_OBJECT_TEXT("file", &DeviceRegistry::setFile)
+BEEEON_OBJECT_END(BeeeOn, DeviceRegistry)
+
+using namespace BeeeOn;
+using namespace Poco;
+using namespace std;
+
+static void throwErrno(const string &message)
+{
+	throw IOException(message + ": " + strerror(errno));
+}
+
+DeviceRegistry::DeviceRegistry():
+	CommandHandler("DeviceRegistry"),
+	m_open(false),
+	m_fd(-1),
+	m_size(0)
+{
+}
+
+DeviceRegistry::~DeviceRegistry()
+{
+	if (m_fd >= 0)
+		::close(m_fd);
+}
+
+void DeviceRegistry::setFile(const string &path)
+{
+	m_file = path;
+}
+
+DeviceRegistry::Partition &DeviceRegistry::partitionOf(const DeviceID &deviceID)
+{
+	return m_partitions[static_cast<uint64_t>(deviceID) >> 56];
+}
+
+void DeviceRegistry::ensureOpen()
+{
+	if (m_open)
+		return;
+
+	FastMutex::ScopedLock guard(m_fileLock);
+
+	if (m_open)
+		return;
+
+	try {
+		if (!m_file.empty())
+			load();
+	}
+	catch (const IOException &e) {
+		// the registry is still useful without the persistence
+		logger().log(e, __FILE__, __LINE__);
+		logger().warning("paired devices are kept in memory only",
+			__FILE__, __LINE__);
+
+		if (m_fd >= 0)
+			::close(m_fd);
+
+		m_fd = -1;
+	}
+
+	m_open = true;
+}
+
+void DeviceRegistry::load()
+{
+	m_fd = ::open(m_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+		S_IRUSR | S_IWUSR);
+	if (m_fd < 0)
+		throwErrno("failed to open " + m_file);
+
+	struct stat st;
+	if (fstat(m_fd, &st) < 0)
+		throwErrno("failed to stat " + m_file);
+
+	string content(st.st_size, '\0');
+	size_t offset = 0;
+
+	while (offset < content.size()) {
+		const ssize_t ret = pread(m_fd, &content[offset],
+			content.size() - offset, offset);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			throwErrno("failed to read " + m_file);
+		if (ret == 0)
+			break;
+
+		offset += ret;
+	}
+
+	content.resize(offset);
+
+	UInt32 header[2];
+	UInt32 version = 0;
+
+	if (content.size() >= HEADER_SIZE) {
+		memcpy(header, content.data(), HEADER_SIZE);
+		version = ByteOrder::fromLittleEndian(header[1]);
+	}
+
+	if (content.size() < HEADER_SIZE
+			|| ByteOrder::fromLittleEndian(header[0]) != REGISTRY_MAGIC
+			|| version < 1 || version > REGISTRY_VERSION) {
+		if (!content.empty()) {
+			logger().warning("unrecognized content of " + m_file
+				+ ", starting empty",
+				__FILE__, __LINE__);
+		}
+
+		header[0] = ByteOrder::toLittleEndian(static_cast<UInt32>(REGISTRY_MAGIC));
+		header[1] = ByteOrder::toLittleEndian(static_cast<UInt32>(REGISTRY_VERSION));
+
+		if (ftruncate(m_fd, 0) < 0
+				|| pwrite(m_fd, header, HEADER_SIZE, 0) != HEADER_SIZE)
+			throwErrno("failed to initialize " + m_file);
+
+		content.clear();
+	}
+	else if (version != REGISTRY_VERSION) {
+		// version 1 differs only by not having the removed devices
+		header[1] = ByteOrder::toLittleEndian(static_cast<UInt32>(REGISTRY_VERSION));
+
+		if (pwrite(m_fd, header, HEADER_SIZE, 0) != HEADER_SIZE)
+			throwErrno("failed to upgrade " + m_file);
+	}
+
+	size_t loaded = 0;
+
+	for (offset = HEADER_SIZE; offset + RECORD_SIZE <= content.size();
+			offset += RECORD_SIZE) {
+		UInt64 raw;
+		memcpy(&raw, content.data() + offset, RECORD_SIZE);
+
+		if (raw != REMOVED_MARKER) {
+			if (insert(DeviceID(ByteOrder::fromLittleEndian(raw))))
+				loaded += 1;
+
+			continue;
+		}
+
+		// the marker without the DeviceID is an incomplete record
+		if (offset + 2 * RECORD_SIZE > content.size())
+			break;
+
+		offset += RECORD_SIZE;
+		memcpy(&raw, content.data() + offset, RECORD_SIZE);
+
+		if (erase(DeviceID(ByteOrder::fromLittleEndian(raw))))
+			loaded -= 1;
+	}
+
+	if (!content.empty() && offset != content.size()) {
+		logger().warning("truncating incomplete record of " + m_file,
+			__FILE__, __LINE__);
+
+		if (ftruncate(m_fd, offset) < 0)
+			throwErrno("failed to truncate " + m_file);
+	}
+
+	m_size = offset;
+
+	if (loaded > 0) {
+		logger().information("loaded " + to_string(loaded)
+			+ " paired devices from " + m_file,
+			__FILE__, __LINE__);
+	}
+}
+
+void DeviceRegistry::append(const DeviceID &deviceID, bool removed)
+{
+	if (m_fd < 0)
+		return;
+
+	UInt64 records[2];
+	size_t length = 0;
+
+	if (removed)
+		records[length++] = REMOVED_MARKER;
+
+	records[length++] = ByteOrder::toLittleEndian(
+		static_cast<UInt64>(deviceID));
+	length *= RECORD_SIZE;
+
+	ssize_t ret;
+
+	do {
+		ret = pwrite(m_fd, records, length, m_size);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret == static_cast<ssize_t>(length)) {
+		m_size += length;
+		return;
+	}
+
+	logger().error("failed to persist " + deviceID.toString()
+		+ " into " + m_file + ": "
+		+ (ret < 0? strerror(errno) : "short write"),
+		__FILE__, __LINE__);
+
+	// the next records must not follow an incomplete one
+	if (ret > 0 && ftruncate(m_fd, m_size) < 0) {
+		logger().error("failed to truncate " + m_file + ": " + strerror(errno),
+			__FILE__, __LINE__);
+		logger().warning("paired devices are kept in memory only",
+			__FILE__, __LINE__);
+
+		::close(m_fd);
+		m_fd = -1;
+	}
+}
+
+bool DeviceRegistry::insert(const DeviceID &deviceID)
+{
+	Partition &partition = partitionOf(deviceID);
+	FastMutex::ScopedLock guard(partition.lock);
+
+	if (!partition.index.insert(deviceID).second)
+		return false;
+
+	partition.devices.push_back(deviceID);
+	return true;
+}
+
+bool DeviceRegistry::erase(const DeviceID &deviceID)
+{
+	Partition &partition = partitionOf(deviceID);
+	FastMutex::ScopedLock guard(partition.lock);
+
+	if (partition.index.erase(static_cast<uint64_t>(deviceID)) == 0)
+		return false;
+
+	partition.devices.erase(find(partition.devices.begin(),
+		partition.devices.end(), deviceID));
+	return true;
+}
+
+bool DeviceRegistry::add(const DeviceID &deviceID)
+{
+	if (contains(deviceID))
+		return false;
+
+	// the records are written in the same order as the index is updated
+	FastMutex::ScopedLock guard(m_fileLock);
+
+	if (!insert(deviceID))
+		return false;
+
+	append(deviceID, false);
+	return true;
+}
+
+bool DeviceRegistry::remove(const DeviceID &deviceID)
+{
+	ensureOpen();
+
+	FastMutex::ScopedLock guard(m_fileLock);
+
+	if (!erase(deviceID))
+		return false;
+
+	append(deviceID, true);
+	return true;
+}
+
+bool DeviceRegistry::contains(const DeviceID &deviceID)
+{
+	ensureOpen();
+
+	Partition &partition = partitionOf(deviceID);
+	FastMutex::ScopedLock guard(partition.lock);
+
+	return partition.index.find(deviceID) != partition.index.end();
+}
+
+vector<DeviceID> DeviceRegistry::devices(const DevicePrefix &prefix)
+{
+	ensureOpen();
+
+	Partition &partition = partitionOf(DeviceID(prefix, 0));
+	FastMutex::ScopedLock guard(partition.lock);
+
+	return partition.devices;
+}
+
+size_t DeviceRegistry::size()
+{
+	ensureOpen();
+
+	size_t count = 0;
+
+	for (auto &partition : m_partitions) {
+		FastMutex::ScopedLock guard(partition.lock);
+		count += partition.devices.size();
+	}
+
+	return count;
+}
+
+bool DeviceRegistry::ship(const SensorData &data)
+{
+	add(data.deviceID());
+	return true;
+}
+
+vector<CommandHandler::Route> DeviceRegistry::routes() const
+{
+	return {
+		Route::of<ServerDeviceListCommand>(),
+		Route::of<DeviceUnpairCommand>(true),
+	};
+}
+
+/*
+ * The DeviceUnpairCommand is only observed to remove the device,
+ * the device managers answer it.
+ */
+bool DeviceRegistry::accept(const Command::Ptr cmd)
+{
+	if (cmd->is<DeviceUnpairCommand>()) {
+		remove(cmd.cast<DeviceUnpairCommand>()->deviceID());
+		return false;
+	}
+
+	return cmd->is<ServerDeviceListCommand>();
+}
+
+void DeviceRegistry::handle(Command::Ptr cmd, Answer::Ptr answer)
+{
+	ServerDeviceListResult::Ptr result = new ServerDeviceListResult(answer);
+	const vector<DeviceID> list =
+		devices(cmd.cast<ServerDeviceListCommand>()->devicePrefix());
+
+	FastMutex::ScopedLock guard(result->lock());
+	result->setDeviceListUnlocked(list);
+	result->setStatusUnlocked(Result::SUCCESS);
+}
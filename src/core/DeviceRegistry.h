@@ -0,0 +1,119 @@
+#ifndef BEEEON_DEVICE_REGISTRY_H
+#define BEEEON_DEVICE_REGISTRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <Poco/Mutex.h>
+
+#include "core/CommandHandler.h"
+#include "core/Exporter.h"
+#include "model/DeviceID.h"
+#include "model/DevicePrefix.h"
+#include "util/Loggable.h"
+
+namespace BeeeOn {
+
+/*
+ * Registry of the paired devices. A device is registered when
+ * the first SensorData of it is shipped (the registry is an Exporter
+ * fed by a Distributor). The registry answers ServerDeviceListCommand
+ * with the devices of the requested prefix.
+ *
+ * The index is partitioned by the prefix of DeviceID (its most
+ * significant byte), every partition has its own lock and a hash
+ * set for the lookup of the shipped devices.
+ *
+ * A device is removed when a DeviceUnpairCommand of it is dispatched.
+ * The command is only observed, it is answered by the device managers.
+ * When the device ships data again, it is registered again.
+ *
+ * Optionally, the registered devices are appended to a file that
+ * is read at once when the registry is used for the first time.
+ * The file starts with a header (magic and version) followed by
+ * DeviceIDs of 8 bytes (little endian). A removed device is recorded
+ * as a marker of all ones followed by its DeviceID. An incomplete
+ * record at the end of the file (a torn write) is truncated, a failed
+ * write is truncated back to the last complete record.
+ */
+class DeviceRegistry :
+	public Exporter,
+	public CommandHandler,
+	public Loggable {
+public:
+	DeviceRegistry();
+	~DeviceRegistry();
+
+	/*
+	 * File to persist the registry into, empty means no persistence.
+	 */
+	void setFile(const std::string &path);
+
+	bool ship(const SensorData &data) override;
+
+	std::vector<Route> routes() const override;
+	bool accept(const Command::Ptr cmd) override;
+	void handle(Command::Ptr cmd, Answer::Ptr answer) override;
+
+	/*
+	 * Register the device, returns false when it has been
+	 * registered already.
+	 */
+	bool add(const DeviceID &deviceID);
+
+	/*
+	 * Unregister the device, returns false when it has not
+	 * been registered.
+	 */
+	bool remove(const DeviceID &deviceID);
+
+	bool contains(const DeviceID &deviceID);
+
+	/*
+	 * Devices of the given prefix in order of their registration.
+	 */
+	std::vector<DeviceID> devices(const DevicePrefix &prefix);
+
+	size_t size();
+
+private:
+	struct Partition {
+		Poco::FastMutex lock;
+		std::unordered_set<uint64_t> index;
+		std::vector<DeviceID> devices;
+	};
+
+	void ensureOpen();
+	void load();
+
+	/*
+	 * Write the record of the registered or unregistered device
+	 * at the end of the file. The m_fileLock must be locked.
+	 */
+	void append(const DeviceID &deviceID, bool removed);
+
+	/*
+	 * Insert the device into its partition or erase it from there
+	 * without persisting it.
+	 */
+	bool insert(const DeviceID &deviceID);
+	bool erase(const DeviceID &deviceID);
+
+	Partition &partitionOf(const DeviceID &deviceID);
+
+private:
+	std::string m_file;
+	Partition m_partitions[256];
+
+	Poco::FastMutex m_fileLock;
+	std::atomic<bool> m_open;
+	int m_fd;
+	uint64_t m_size;
+};
+
+}
+
+#endif
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 namespace BeeeOn {
 
 class SensorData;
@@ -13,6 +15,12 @@ public:
 	 * Export data to all registered exporters.
 	 */
 	virtual void exportData(const SensorData &sensorData) = 0;
+
+	/*
+	 * Export multiple data received together to all registered
+	 * exporters. Every exporter receives the whole batch at once.
+	 */
+	virtual void exportBatch(const std::vector<SensorData> &batch) = 0;
 };
 
 }
@@ -1,4 +1,5 @@
 #include "Exporter.h"
+#include "model/SensorData.h"
 
 using namespace BeeeOn;
 
@@ -9,3 +10,13 @@ Exporter::Exporter()
 Exporter::~Exporter()
 {
 }
+
+bool Exporter::shipBatch(const std::vector<SensorData> &batch)
+{
+	bool shipped = true;
+
+	for (const auto &data : batch)
+		shipped = ship(data) && shipped;
+
+	return shipped;
+}
@@ -1,6 +1,8 @@
 #ifndef BEEEON_EXPORTER_H
 #define BEEEON_EXPORTER_H
 
+#include <vector>
+
 namespace BeeeOn {
 
 class SensorData;
@@ -22,6 +24,15 @@ public:
 	 */
 	virtual bool ship(const SensorData &data) = 0;
 
+	/**
+	 * Ensures export of multiple data received together. The default
+	 * implementation ships each item separately. Exporters that can
+	 * benefit from processing the whole batch at once should override it.
+	 * @return true when all the data were successfully shipped.
+	 * @throws Poco::IOException when a serious issue caused the Exporter to deny its service.
+	 */
+	virtual bool shipBatch(const std::vector<SensorData> &batch);
+
 };
 
 }
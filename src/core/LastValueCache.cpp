@@ -0,0 +1,388 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <Poco/Exception.h>
+#include <Poco/Logger.h>
+#include <Poco/Timestamp.h>
+
+#include "commands/ServerLastValueCommand.h"
+#include "commands/ServerLastValueResult.h"
+#include "core/LastValueCache.h"
+#include "di/Injectable.h"
+#include "model/SensorData.h"
+
+#define SHARDS 16
+#define MIN_SHARD_SIZE 4
+#define DEFAULT_CAPACITY 4096
+#define CACHE_MAGIC 0x43564c42 // BLVC
+#define CACHE_VERSION 1
+
+BEEEON_OBJECT_BEGIN(BeeeOn, LastValueCache)
+BEEEON_OBJECT_CASTABLE(Exporter)
+BEEEON_OBJECT_CASTABLE(CommandHandler)
+BEEEON_OBJECT_NUMBER("capacity", &LastValueCache::setCapacity)
+BEEEON_OBJECT_TEXT("file", &LastValueCache::setFile)
+BEEEON_OBJECT_END(BeeeOn, LastValueCache)
+
+using namespace BeeeOn;
+using namespace Poco;
+using namespace std;
+
+LastValueCache::LastValueCache():
+	CommandHandler("LastValueCache"),
+	m_capacity(DEFAULT_CAPACITY),
+	m_open(false),
+	m_fd(-1),
+	m_data(NULL),
+	m_size(0),
+	m_shardSize(0),
+	m_dropped(0)
+{
+}
+
+LastValueCache::~LastValueCache()
+{
+	try {
+		sync();
+	}
+	catch (const Exception &e) {
+		logger().log(e, __FILE__, __LINE__);
+	}
+
+	close();
+}
+
+void LastValueCache::setCapacity(int capacity)
+{
+	if (capacity <= 0)
+		throw InvalidArgumentException("capacity must be positive");
+
+	m_capacity = capacity;
+}
+
+void LastValueCache::setFile(const string &path)
+{
+	m_file = path;
+}
+
+void LastValueCache::ensureOpen()
+{
+	if (m_open)
+		return;
+
+	FastMutex::ScopedLock guard(m_openLock);
+
+	if (m_open)
+		return;
+
+	try {
+		open();
+	}
+	catch (const IOException &e) {
+		// the cache is still useful without the persistence
+		logger().log(e, __FILE__, __LINE__);
+		logger().warning("last values are kept in memory only",
+			__FILE__, __LINE__);
+
+		close();
+		m_file.clear();
+		open();
+	}
+
+	m_open = true;
+}
+
+void LastValueCache::open()
+{
+	// keep the load factor at most 3/4 for the requested capacity
+	const size_t wanted = (m_capacity * 4 / 3 + SHARDS - 1) / SHARDS;
+
+	m_shardSize = MIN_SHARD_SIZE;
+	while (m_shardSize < wanted)
+		m_shardSize <<= 1;
+
+	const size_t size = sizeof(Header) + SHARDS * m_shardSize * sizeof(Slot);
+	const bool reuse = map(size);
+
+	Header *header = reinterpret_cast<Header *>(m_data);
+
+	if (!reuse || header->magic != CACHE_MAGIC
+			|| header->version != CACHE_VERSION
+			|| header->shards != SHARDS
+			|| header->shardSize != m_shardSize) {
+		memset(m_data, 0, size);
+
+		header->magic = CACHE_MAGIC;
+		header->version = CACHE_VERSION;
+		header->shards = SHARDS;
+		header->shardSize = m_shardSize;
+	}
+
+	Slot *slots = reinterpret_cast<Slot *>(m_data + sizeof(Header));
+	size_t restored = 0;
+
+	m_shards.reset(new Shard[SHARDS]);
+
+	for (size_t i = 0; i < SHARDS; ++i) {
+		Shard &shard = m_shards[i];
+
+		shard.slots = slots + i * m_shardSize;
+		shard.used = 0;
+
+		for (size_t j = 0; j < m_shardSize; ++j) {
+			if (shard.slots[j].used)
+				shard.used += 1;
+		}
+
+		restored += shard.used;
+	}
+
+	if (restored > 0) {
+		logger().information("restored " + to_string(restored)
+			+ " last values from " + m_file,
+			__FILE__, __LINE__);
+	}
+}
+
+bool LastValueCache::map(size_t size)
+{
+	if (m_file.empty()) {
+		void *data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (data == MAP_FAILED)
+			throw IOException("failed to allocate last values: "
+				+ string(strerror(errno)));
+
+		m_data = static_cast<char *>(data);
+		m_size = size;
+		return false;
+	}
+
+	const int fd = ::open(m_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+		S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		throw IOException("failed to open " + m_file + ": "
+			+ strerror(errno));
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		::close(fd);
+		throw IOException("failed to stat " + m_file + ": "
+			+ strerror(errno));
+	}
+
+	const bool reuse = (size_t) st.st_size == size;
+
+	if (!reuse && (ftruncate(fd, 0) < 0 || ftruncate(fd, size) < 0)) {
+		::close(fd);
+		throw IOException("failed to resize " + m_file + ": "
+			+ strerror(errno));
+	}
+
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		::close(fd);
+		throw IOException("failed to map " + m_file + ": "
+			+ strerror(errno));
+	}
+
+	m_fd = fd;
+	m_data = static_cast<char *>(data);
+	m_size = size;
+	return reuse;
+}
+
+void LastValueCache::close()
+{
+	if (m_data != NULL)
+		munmap(m_data, m_size);
+
+	if (m_fd >= 0)
+		::close(m_fd);
+
+	m_data = NULL;
+	m_fd = -1;
+	m_open = false;
+}
+
+void LastValueCache::sync()
+{
+	if (!m_open || m_fd < 0)
+		return;
+
+	if (msync(m_data, m_size, MS_SYNC) < 0)
+		throw IOException("failed to sync " + m_file + ": "
+			+ strerror(errno));
+}
+
+uint64_t LastValueCache::hash(const DeviceID &deviceID, const ModuleID &moduleID)
+{
+	uint64_t h = static_cast<uint64_t>(deviceID)
+		^ (moduleID.value() * 0x9e3779b97f4a7c15ULL);
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+LastValueCache::Shard &LastValueCache::shardOf(uint64_t hash)
+{
+	return m_shards[hash % SHARDS];
+}
+
+LastValueCache::Slot *LastValueCache::find(Shard &shard, uint64_t hash,
+		const DeviceID &deviceID, const ModuleID &moduleID)
+{
+	const size_t mask = m_shardSize - 1;
+	size_t pos = (hash / SHARDS) & mask;
+
+	for (size_t i = 0; i < m_shardSize; ++i, pos = (pos + 1) & mask) {
+		Slot &slot = shard.slots[pos];
+
+		if (!slot.used)
+			return &slot;
+
+		if (slot.deviceID == static_cast<uint64_t>(deviceID)
+				&& slot.moduleID == moduleID.value())
+			return &slot;
+	}
+
+	return NULL;
+}
+
+bool LastValueCache::update(const DeviceID &deviceID, const ModuleID &moduleID,
+		double value, int64_t timestamp)
+{
+	ensureOpen();
+
+	const uint64_t h = hash(deviceID, moduleID);
+	Shard &shard = shardOf(h);
+
+	FastMutex::ScopedLock guard(shard.lock);
+
+	Slot *slot = find(shard, h, deviceID, moduleID);
+
+	if (slot != NULL && slot->used) {
+		if (timestamp < slot->timestamp)
+			return true;
+
+		slot->value = value;
+		slot->timestamp = timestamp;
+		return true;
+	}
+
+	if (slot == NULL || (shard.used + 1) * 4 > m_shardSize * 3) {
+		if (m_dropped++ == 0) {
+			logger().warning("last value cache is full, values of "
+				+ deviceID.toString() + " are not cached",
+				__FILE__, __LINE__);
+		}
+
+		return false;
+	}
+
+	slot->deviceID = deviceID;
+	slot->moduleID = moduleID.value();
+	slot->value = value;
+	slot->timestamp = timestamp;
+	slot->used = 1;
+	shard.used += 1;
+
+	return true;
+}
+
+bool LastValueCache::lookup(const DeviceID &deviceID, const ModuleID &moduleID,
+		double &value)
+{
+	ensureOpen();
+
+	const uint64_t h = hash(deviceID, moduleID);
+	Shard &shard = shardOf(h);
+
+	FastMutex::ScopedLock guard(shard.lock);
+
+	const Slot *slot = find(shard, h, deviceID, moduleID);
+	if (slot == NULL || !slot->used)
+		return false;
+
+	value = slot->value;
+	return true;
+}
+
+size_t LastValueCache::size()
+{
+	ensureOpen();
+
+	size_t count = 0;
+
+	for (size_t i = 0; i < SHARDS; ++i) {
+		FastMutex::ScopedLock guard(m_shards[i].lock);
+		count += m_shards[i].used;
+	}
+
+	return count;
+}
+
+unsigned long LastValueCache::dropped() const
+{
+	return m_dropped;
+}
+
+bool LastValueCache::ship(const SensorData &data)
+{
+	const IncompleteTimestamp timestamp = data.timestamp();
+
+	// incomplete timestamps are not comparable, use the time of arrival
+	const int64_t time = timestamp.isComplete() ?
+		timestamp.value().epochMicroseconds() : Timestamp().epochMicroseconds();
+
+	for (const auto &item : data) {
+		if (item.isValid())
+			update(data.deviceID(), item.moduleID(), item.value(), time);
+	}
+
+	return true;
+}
+
+vector<CommandHandler::Route> LastValueCache::routes() const
+{
+	return {
+		Route::of<ServerLastValueCommand>(true),
+	};
+}
+
+bool LastValueCache::accept(const Command::Ptr cmd)
+{
+	if (!cmd->is<ServerLastValueCommand>())
+		return false;
+
+	const ServerLastValueCommand &request = cmd->cast<ServerLastValueCommand>();
+	double value;
+
+	return lookup(request.deviceID(), request.moduleID(), value);
+}
+
+void LastValueCache::handle(Command::Ptr cmd, Answer::Ptr answer)
+{
+	const ServerLastValueCommand &request = cmd->cast<ServerLastValueCommand>();
+	ServerLastValueResult::Ptr result = new ServerLastValueResult(answer);
+	double value;
+
+	const bool found = lookup(request.deviceID(), request.moduleID(), value);
+
+	FastMutex::ScopedLock guard(result->lock());
+
+	if (found) {
+		result->setValueUnlocked(value);
+		result->setStatusUnlocked(Result::SUCCESS);
+	}
+	else {
+		result->setStatusUnlocked(Result::FAILED);
+	}
+}
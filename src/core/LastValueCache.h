@@ -0,0 +1,146 @@
+#ifndef BEEEON_LAST_VALUE_CACHE_H
+#define BEEEON_LAST_VALUE_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Poco/Mutex.h>
+
+#include "core/CommandHandler.h"
+#include "core/Exporter.h"
+#include "model/DeviceID.h"
+#include "model/ModuleID.h"
+#include "util/Loggable.h"
+
+namespace BeeeOn {
+
+/*
+ * Cache of the last valid value of every module of every device.
+ * It is fed by a Distributor as an Exporter and it answers
+ * ServerLastValueCommand as a CommandHandler, so the last values
+ * are served by the gateway itself without reaching the server.
+ * The route is confirmed, thus commands for values not cached
+ * are left to the other handlers.
+ *
+ * The cache is a hash table of a fixed capacity split into shards,
+ * each guarded by its own lock. Every shard is an open addressing
+ * table with linear probing, entries are never removed. When a shard
+ * is filled up to 3/4, values of new modules are dropped.
+ *
+ * Optionally, the table is a file mapped into memory (MAP_SHARED),
+ * thus the values survive a restart of the gateway without any
+ * syscall per update. The file is in the native byte order, it is
+ * reinitialized when its layout does not match. The values are
+ * written back by the kernel, an explicit sync() is done only when
+ * the cache is destroyed.
+ *
+ * Values older than the cached ones (e.g. replayed from a spool)
+ * do not replace them.
+ */
+class LastValueCache :
+	public Exporter,
+	public CommandHandler,
+	public Loggable {
+public:
+	LastValueCache();
+	~LastValueCache();
+
+	/*
+	 * Number of cached values, it is rounded up for the shards
+	 * to have a power of 2 slots.
+	 */
+	void setCapacity(int capacity);
+
+	/*
+	 * File to map the cache into, empty means no persistence.
+	 */
+	void setFile(const std::string &path);
+
+	bool ship(const SensorData &data) override;
+
+	std::vector<Route> routes() const override;
+	bool accept(const Command::Ptr cmd) override;
+	void handle(Command::Ptr cmd, Answer::Ptr answer) override;
+
+	/*
+	 * Store the value unless there is a newer one.
+	 * Returns false when the cache is full.
+	 */
+	bool update(const DeviceID &deviceID, const ModuleID &moduleID,
+		double value, int64_t timestamp);
+
+	bool lookup(const DeviceID &deviceID, const ModuleID &moduleID,
+		double &value);
+
+	size_t size();
+	unsigned long dropped() const;
+
+	/*
+	 * Write the mapped file to the storage.
+	 */
+	void sync();
+
+private:
+	struct Slot {
+		uint64_t deviceID;
+		uint16_t moduleID;
+		uint16_t used;
+		uint32_t reserved;
+		int64_t timestamp;
+		double value;
+	};
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t shards;
+		uint32_t shardSize;
+	};
+
+	struct Shard {
+		Poco::FastMutex lock;
+		Slot *slots;
+		size_t used;
+	};
+
+	void ensureOpen();
+	void open();
+	void close();
+
+	/*
+	 * Map the file (or an anonymous memory) of the given size,
+	 * returns true when the existing content is to be used.
+	 */
+	bool map(size_t size);
+
+	static uint64_t hash(const DeviceID &deviceID, const ModuleID &moduleID);
+
+	/*
+	 * Slot of the key or an empty slot where the key belongs,
+	 * NULL when the shard is full. The shard must be locked.
+	 */
+	Slot *find(Shard &shard, uint64_t hash,
+		const DeviceID &deviceID, const ModuleID &moduleID);
+
+	Shard &shardOf(uint64_t hash);
+
+private:
+	size_t m_capacity;
+	std::string m_file;
+
+	Poco::FastMutex m_openLock;
+	std::atomic<bool> m_open;
+	int m_fd;
+	char *m_data;
+	size_t m_size;
+	size_t m_shardSize;
+	std::unique_ptr<Shard[]> m_shards;
+	std::atomic<unsigned long> m_dropped;
+};
+
+}
+
+#endif
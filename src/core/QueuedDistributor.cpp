@@ -0,0 +1,313 @@
+#include <atomic>
+#include <exception>
+
+#include <Poco/Event.h>
+#include <Poco/Exception.h>
+#include <Poco/Logger.h>
+#include <Poco/Runnable.h>
+#include <Poco/Thread.h>
+
+#include "di/Injectable.h"
+#include "core/Exporter.h"
+#include "core/QueuedDistributor.h"
+#include "model/SensorData.h"
+#include "util/SPSCRing.h"
+
+BEEEON_OBJECT_BEGIN(BeeeOn, QueuedDistributor)
+BEEEON_OBJECT_CASTABLE(Distributor)
+BEEEON_OBJECT_NUMBER("queueSize", &QueuedDistributor::setQueueSize)
+BEEEON_OBJECT_TEXT("overflowPolicy", &QueuedDistributor::setOverflowPolicy)
+BEEEON_OBJECT_REF("exporter", &QueuedDistributor::registerExporter)
+BEEEON_OBJECT_END(BeeeOn, QueuedDistributor)
+
+using namespace BeeeOn;
+using namespace Poco;
+using namespace std;
+
+static const long WORKER_IDLE_WAIT_MS = 100;
+
+typedef SharedPtr<const vector<SensorData>> DataPtr;
+
+/*
+ * Queue of a single exporter consumed by its worker thread.
+ * The exporting thread is the only producer (guarded by
+ * QueuedDistributor::m_producerLock).
+ */
+class QueuedDistributor::ExporterQueue : public Runnable {
+public:
+	ExporterQueue(SharedPtr<Exporter> exporter, size_t size,
+			OverflowPolicy policy, Logger &logger):
+		m_exporter(exporter),
+		m_ring(size),
+		m_policy(policy),
+		m_logger(logger),
+		m_stop(false),
+		m_consumerWaiting(false),
+		m_producerWaiting(false),
+		m_depth(0),
+		m_shipped(0),
+		m_dropped(0),
+		m_failed(0)
+	{
+	}
+
+	~ExporterQueue()
+	{
+		stop();
+	}
+
+	void start()
+	{
+		m_thread.setName("exporter-queue");
+		m_thread.start(*this);
+	}
+
+	void stop()
+	{
+		m_stop = true;
+		m_dataEvent.set();
+		m_spaceEvent.set();
+
+		if (m_thread.isRunning())
+			m_thread.join();
+	}
+
+	void push(const DataPtr &data)
+	{
+		DataPtr *item = new DataPtr(data);
+
+		if (!m_ring.push(item)) {
+			switch (m_policy) {
+			case DROP_NEWEST:
+				drop(item);
+				return;
+
+			case DROP_OLDEST: {
+				DataPtr *oldest = m_ring.pushReplacingOldest(item);
+				if (oldest != NULL) {
+					--m_depth;
+					drop(oldest);
+				}
+				break;
+			}
+
+			case BLOCK:
+				if (!waitForSpace(item)) {
+					drop(item);
+					return;
+				}
+				break;
+			}
+		}
+
+		++m_depth;
+
+		if (m_consumerWaiting)
+			m_dataEvent.set();
+	}
+
+	void run() override
+	{
+		while (true) {
+			DataPtr *item = m_ring.pop();
+
+			if (item == NULL) {
+				if (m_stop)
+					break;
+
+				m_consumerWaiting = true;
+
+				item = m_ring.pop();
+				if (item == NULL) {
+					m_dataEvent.tryWait(WORKER_IDLE_WAIT_MS);
+					m_consumerWaiting = false;
+					continue;
+				}
+
+				m_consumerWaiting = false;
+			}
+
+			--m_depth;
+
+			if (m_producerWaiting)
+				m_spaceEvent.set();
+
+			ship(**item);
+			delete item;
+		}
+	}
+
+	Stats stats() const
+	{
+		Stats stats;
+		stats.depth = m_depth;
+		stats.capacity = m_ring.capacity();
+		stats.shipped = m_shipped;
+		stats.dropped = m_dropped;
+		stats.failed = m_failed;
+		return stats;
+	}
+
+private:
+	bool waitForSpace(DataPtr *item)
+	{
+		while (!m_stop) {
+			m_producerWaiting = true;
+
+			if (m_ring.push(item)) {
+				m_producerWaiting = false;
+				return true;
+			}
+
+			m_spaceEvent.tryWait(WORKER_IDLE_WAIT_MS);
+			m_producerWaiting = false;
+
+			if (m_ring.push(item))
+				return true;
+		}
+
+		return false;
+	}
+
+	void drop(DataPtr *item)
+	{
+		m_dropped += (*item)->size();
+		delete item;
+	}
+
+	void ship(const vector<SensorData> &data)
+	{
+		try {
+			bool shipped;
+
+			if (data.size() == 1)
+				shipped = m_exporter->ship(data.front());
+			else
+				shipped = m_exporter->shipBatch(data);
+
+			if (shipped) {
+				m_shipped += data.size();
+			}
+			else {
+				if (m_failed == 0)
+					poco_warning(m_logger, "exporter cannot ship data temporarily");
+
+				m_failed += data.size();
+			}
+		}
+		catch (const Exception &ex) {
+			poco_error(m_logger, "Data failed to ship: " + ex.displayText());
+		}
+		catch (const exception &ex) {
+			poco_critical(m_logger, "Data failed to ship: " + string(ex.what()));
+		}
+		catch (...) {
+			poco_critical(m_logger, "Unknown error occured when shipping data");
+		}
+	}
+
+private:
+	SharedPtr<Exporter> m_exporter;
+	SPSCRing<DataPtr> m_ring;
+	OverflowPolicy m_policy;
+	Logger &m_logger;
+	Thread m_thread;
+
+	atomic<bool> m_stop;
+	atomic<bool> m_consumerWaiting;
+	atomic<bool> m_producerWaiting;
+	Event m_dataEvent;
+	Event m_spaceEvent;
+
+	atomic<size_t> m_depth;
+	atomic<uint64_t> m_shipped;
+	atomic<uint64_t> m_dropped;
+	atomic<uint64_t> m_failed;
+};
+
+QueuedDistributor::QueuedDistributor():
+	m_queueSize(1024),
+	m_policy(DROP_OLDEST)
+{
+}
+
+QueuedDistributor::~QueuedDistributor()
+{
+	stop();
+}
+
+void QueuedDistributor::setQueueSize(int size)
+{
+	if (size <= 0)
+		throw InvalidArgumentException("queue size must be positive");
+
+	if (!m_queues.empty())
+		throw IllegalStateException("queue size must be set before exporters");
+
+	m_queueSize = size;
+}
+
+void QueuedDistributor::setOverflowPolicy(const string &policy)
+{
+	if (!m_queues.empty())
+		throw IllegalStateException("overflow policy must be set before exporters");
+
+	if (policy == "drop-oldest")
+		m_policy = DROP_OLDEST;
+	else if (policy == "drop-newest")
+		m_policy = DROP_NEWEST;
+	else if (policy == "block")
+		m_policy = BLOCK;
+	else
+		throw InvalidArgumentException("unknown overflow policy: " + policy);
+}
+
+void QueuedDistributor::registerExporter(SharedPtr<Exporter> exporter)
+{
+	FastMutex::ScopedLock lock(m_producerLock);
+
+	AbstractDistributor::registerExporter(exporter);
+
+	SharedPtr<ExporterQueue> queue(
+		new ExporterQueue(exporter, m_queueSize, m_policy, logger()));
+	queue->start();
+
+	m_queues.push_back(queue);
+}
+
+void QueuedDistributor::exportData(const SensorData &sensorData)
+{
+	enqueue(DataPtr(new vector<SensorData>(1, sensorData)));
+}
+
+void QueuedDistributor::exportBatch(const vector<SensorData> &batch)
+{
+	if (batch.empty())
+		return;
+
+	enqueue(DataPtr(new vector<SensorData>(batch)));
+}
+
+void QueuedDistributor::enqueue(DataPtr data)
+{
+	FastMutex::ScopedLock lock(m_producerLock);
+
+	for (auto &queue : m_queues)
+		queue->push(data);
+}
+
+vector<QueuedDistributor::Stats> QueuedDistributor::stats() const
+{
+	vector<Stats> result;
+
+	for (const auto &queue : m_queues)
+		result.push_back(queue->stats());
+
+	return result;
+}
+
+void QueuedDistributor::stop()
+{
+	for (auto &queue : m_queues)
+		queue->stop();
+}
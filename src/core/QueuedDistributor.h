@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Poco/Mutex.h>
+#include <Poco/SharedPtr.h>
+
+#include "core/AbstractDistributor.h"
+
+namespace BeeeOn {
+
+class Exporter;
+class SensorData;
+
+/*
+ * Distributor that never calls exporters from the exporting thread.
+ * Every registered exporter gets its own bounded queue and a dedicated
+ * worker thread shipping the queued data. A slow exporter thus blocks
+ * neither the ZMQBroker nor the other exporters.
+ *
+ * When the queue of an exporter is full, the overflow policy decides:
+ *
+ *  - drop-oldest: the oldest queued data are dropped
+ *  - drop-newest: the data being exported are dropped
+ *  - block: the exporting thread waits until there is a free space
+ *
+ * The queue size and the overflow policy must be configured before
+ * the exporters are registered.
+ */
+class QueuedDistributor : public AbstractDistributor {
+public:
+	enum OverflowPolicy {
+		DROP_OLDEST,
+		DROP_NEWEST,
+		BLOCK,
+	};
+
+	/*
+	 * Statistics of a single exporter queue. The depth is the count
+	 * of queued exports (a batch counts as one), shipped, dropped
+	 * and failed are counts of SensorData. The failed data were
+	 * refused by the exporter (its ship() returned false).
+	 */
+	struct Stats {
+		size_t depth;
+		size_t capacity;
+		uint64_t shipped;
+		uint64_t dropped;
+		uint64_t failed;
+	};
+
+	QueuedDistributor();
+	~QueuedDistributor();
+
+	void setQueueSize(int size);
+	void setOverflowPolicy(const std::string &policy);
+
+	/*
+	 * Register exporter and start its worker thread.
+	 */
+	void registerExporter(Poco::SharedPtr<Exporter> exporter) override;
+
+	/*
+	 * Queue data for all registered exporters.
+	 */
+	void exportData(const SensorData &sensorData) override;
+	void exportBatch(const std::vector<SensorData> &batch) override;
+
+	/*
+	 * Statistics of exporter queues in order of registration.
+	 */
+	std::vector<Stats> stats() const;
+
+	/*
+	 * Stop all workers. The already queued data are shipped first.
+	 */
+	void stop();
+
+private:
+	class ExporterQueue;
+
+	void enqueue(Poco::SharedPtr<const std::vector<SensorData>> data);
+
+private:
+	size_t m_queueSize;
+	OverflowPolicy m_policy;
+	std::vector<Poco::SharedPtr<ExporterQueue>> m_queues;
+	Poco::FastMutex m_producerLock;
+};
+
+}
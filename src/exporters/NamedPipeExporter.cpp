@@ -1,53 +1,194 @@
+#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <Poco/Exception.h>
 
 #include "di/Injectable.h"
 #include "NamedPipeExporter.h"
+#include "model/SensorData.h"
 #include "util/NullSensorDataFormatter.h"
 #include "util/SensorDataFormatter.h"
 
 #define ATTEMPTS_CREATE_PIPE 3
+#define DEFAULT_BUFFER_SIZE (64 * 1024)
+#define FLUSH_IOV_MAX 64
+#define CHUNK_SIZE 4096
+#define DEFAULT_FLUSH_INTERVAL_MS 100
 
 BEEEON_OBJECT_BEGIN(BeeeOn, NamedPipeExporter)
 BEEEON_OBJECT_CASTABLE(Exporter)
 BEEEON_OBJECT_TEXT("filePath", &NamedPipeExporter::setFilePath)
 BEEEON_OBJECT_REF("formatter", &NamedPipeExporter::setFormatter)
+BEEEON_OBJECT_NUMBER("persistent", &NamedPipeExporter::setPersistent)
+BEEEON_OBJECT_NUMBER("bufferSize", &NamedPipeExporter::setBufferSize)
+BEEEON_OBJECT_NUMBER("flushInterval", &NamedPipeExporter::setFlushInterval)
+BEEEON_OBJECT_NUMBER("dropWithoutReader", &NamedPipeExporter::setDropWithoutReader)
 BEEEON_OBJECT_END(BeeeOn, NamedPipeExporter)
 
 using namespace BeeeOn;
 using namespace Poco;
 using namespace std;
 
+/*
+ * Blocks SIGPIPE in the calling thread while writing into the pipe,
+ * so that a disappeared reader results only in EPIPE. The SIGPIPE
+ * raised meanwhile is consumed before the original mask is restored.
+ */
+class SigPipeGuard {
+public:
+	SigPipeGuard()
+	{
+		sigset_t pending;
+
+		sigemptyset(&m_sigpipe);
+		sigaddset(&m_sigpipe, SIGPIPE);
+
+		sigpending(&pending);
+		m_wasPending = sigismember(&pending, SIGPIPE) == 1;
+
+		pthread_sigmask(SIG_BLOCK, &m_sigpipe, &m_original);
+	}
+
+	~SigPipeGuard()
+	{
+		const int error = errno;
+
+		if (!m_wasPending) {
+			sigset_t pending;
+			const struct timespec timeout = {0, 0};
+
+			sigpending(&pending);
+
+			if (sigismember(&pending, SIGPIPE) == 1) {
+				while (sigtimedwait(&m_sigpipe, NULL, &timeout) < 0
+						&& errno == EINTR);
+			}
+		}
+
+		pthread_sigmask(SIG_SETMASK, &m_original, NULL);
+		errno = error;
+	}
+
+private:
+	sigset_t m_sigpipe;
+	sigset_t m_original;
+	bool m_wasPending;
+};
+
 NamedPipeExporter::NamedPipeExporter() :
-	m_formatter(&NullSensorDataFormatter::instance())
+	m_formatter(&NullSensorDataFormatter::instance()),
+	m_persistent(false),
+	m_bufferSize(DEFAULT_BUFFER_SIZE),
+	m_dropWithoutReader(true),
+	m_fd(-1),
+	m_writeBlocked(false),
+	m_pendingBytes(0),
+	m_headOffset(0),
+	m_flushInterval(DEFAULT_FLUSH_INTERVAL_MS),
+	m_flushing(false),
+	m_flushCallback(*this, &NamedPipeExporter::onFlush)
 {
 }
 
 NamedPipeExporter::~NamedPipeExporter()
 {
+	m_flushTimer.stop();
+
+	try {
+		string held;
+		m_formatter->flush(held);
+
+		if (!m_persistent)
+			writeMessage(held);
+		else if (!held.empty() && ensureOpen())
+			appendRaw(held);
+
+		flush();
+	}
+	catch (const Exception &e) {
+		logger().log(e, __FILE__, __LINE__);
+	}
+
+	closePipe();
+
 	if (!m_pipePath.empty())
 		remove(m_pipePath.c_str());
 }
 
 bool NamedPipeExporter::ship(const SensorData &data)
 {
+	FastMutex::ScopedLock guard(m_lock);
+
+	startFlushing();
+
+	if (m_persistent)
+		return shipPersistent(data);
+
+	return writeMessage(m_formatter->format(data));
+}
+
+bool NamedPipeExporter::shipBatch(const vector<SensorData> &batch)
+{
+	FastMutex::ScopedLock guard(m_lock);
+
+	startFlushing();
+
+	if (!m_persistent) {
+		string msg;
+
+		for (auto &data : batch)
+			m_formatter->format(data, msg);
+
+		m_formatter->flush(msg);
+		return writeMessage(msg);
+	}
+
+	if (!ensureOpen())
+		return m_dropWithoutReader && errno != EINTR;
+
+	for (auto &data : batch) {
+		if (append(data))
+			continue;
+
+		flush();
+
+		if (m_fd < 0)
+			return m_dropWithoutReader; // reader has gone, data dropped
+
+		if (!append(data))
+			return false;
+	}
+
+	appendHeld();
+	flush();
+	return true;
+}
+
+bool NamedPipeExporter::writeMessage(const string &msg)
+{
+	if (msg.empty())
+		return true; // held by the formatter
+
 	int fd = openPipe();
 
 	if (fd < 0 && errno == ENXIO)
-		return true;
+		return m_dropWithoutReader;
 	if (fd < 0 && errno == EINTR)
 		return false;
 
 	poco_assert(fd >= 0);
 
 	try {
-		return writeAndClose(fd, m_formatter->format(data));
+		return writeAndClose(fd, msg);
 	}
 	catch (...) {
 		close(fd);
@@ -55,6 +196,255 @@ bool NamedPipeExporter::ship(const SensorData &data)
 	}
 }
 
+bool NamedPipeExporter::shipPersistent(const SensorData &data)
+{
+	if (!ensureOpen())
+		return m_dropWithoutReader && errno != EINTR;
+
+	if (!append(data)) {
+		flush();
+
+		if (m_fd < 0)
+			return m_dropWithoutReader; // reader has gone, data dropped
+
+		if (!append(data))
+			return false;
+	}
+
+	flush();
+	return true;
+}
+
+void NamedPipeExporter::startFlushing()
+{
+	if (m_flushing)
+		return;
+
+	m_flushTimer.setStartInterval(m_flushInterval);
+	m_flushTimer.setPeriodicInterval(m_flushInterval);
+	m_flushTimer.start(m_flushCallback);
+	m_flushing = true;
+}
+
+void NamedPipeExporter::onFlush(Timer &)
+{
+	FastMutex::ScopedLock guard(m_lock);
+
+	try {
+		if (!m_persistent) {
+			string msg;
+			m_formatter->flushExpired(msg);
+			writeMessage(msg);
+		}
+		else if (m_fd >= 0) {
+			appendExpired();
+			flush();
+		}
+	}
+	catch (const Exception &e) {
+		logger().log(e, __FILE__, __LINE__);
+	}
+}
+
+bool NamedPipeExporter::ensureOpen()
+{
+	if (m_fd >= 0)
+		return true;
+
+	const int fd = openPipe();
+	if (fd < 0)
+		return false;
+
+	m_fd = fd;
+	m_writeBlocked = false;
+	return true;
+}
+
+void NamedPipeExporter::closePipe()
+{
+	if (m_fd >= 0)
+		close(m_fd);
+
+	m_fd = -1;
+	m_writeBlocked = false;
+	m_pending.clear();
+	m_pendingBytes = 0;
+	m_headOffset = 0;
+}
+
+string &NamedPipeExporter::tailChunk()
+{
+	if (m_pending.empty() || m_pending.back().size() >= CHUNK_SIZE) {
+		m_pending.emplace_back();
+		m_pending.back().reserve(CHUNK_SIZE);
+	}
+
+	return m_pending.back();
+}
+
+bool NamedPipeExporter::append(const SensorData &data)
+{
+	// the record is formatted only when accepted, formatters
+	// might hold some data internally
+	if (m_pendingBytes >= m_bufferSize)
+		return false;
+
+	string &chunk = tailChunk();
+	const size_t offset = chunk.size();
+
+	try {
+		m_formatter->format(data, chunk);
+	}
+	catch (...) {
+		commit(chunk, offset, false);
+		throw;
+	}
+
+	commit(chunk, offset, true);
+	return true;
+}
+
+void NamedPipeExporter::appendHeld()
+{
+	string &chunk = tailChunk();
+	const size_t offset = chunk.size();
+
+	try {
+		m_formatter->flush(chunk);
+	}
+	catch (...) {
+		commit(chunk, offset, false);
+		throw;
+	}
+
+	commit(chunk, offset, true);
+}
+
+void NamedPipeExporter::appendExpired()
+{
+	string &chunk = tailChunk();
+	const size_t offset = chunk.size();
+
+	try {
+		m_formatter->flushExpired(chunk);
+	}
+	catch (...) {
+		commit(chunk, offset, false);
+		throw;
+	}
+
+	commit(chunk, offset, true);
+}
+
+void NamedPipeExporter::appendRaw(const string &data)
+{
+	string &chunk = tailChunk();
+	const size_t offset = chunk.size();
+
+	chunk += data;
+	commit(chunk, offset, true);
+}
+
+void NamedPipeExporter::commit(string &chunk, size_t offset, bool accept)
+{
+	if (accept)
+		m_pendingBytes += chunk.size() - offset;
+	else
+		chunk.resize(offset);
+
+	if (chunk.empty())
+		m_pending.pop_back();
+}
+
+void NamedPipeExporter::flush()
+{
+	if (m_fd < 0 || m_pending.empty())
+		return;
+
+	if (m_writeBlocked) {
+		struct pollfd pfd = {m_fd, POLLOUT, 0};
+
+		const int ret = poll(&pfd, 1, 0);
+		if (ret < 0 && errno != EINTR) {
+			throw IOException(
+				"failed to poll fifo: "
+				+ string(strerror(errno)));
+		}
+		if (ret <= 0)
+			return;
+
+		if (pfd.revents & POLLERR) {
+			logger().information("reader of " + m_pipePath
+				+ " has gone, dropping " + to_string(m_pendingBytes)
+				+ " bytes",
+				__FILE__, __LINE__);
+			closePipe();
+			return;
+		}
+
+		m_writeBlocked = false;
+	}
+
+	while (!m_pending.empty()) {
+		struct iovec iov[FLUSH_IOV_MAX];
+		int count = 0;
+
+		for (auto it = m_pending.begin();
+				it != m_pending.end() && count < FLUSH_IOV_MAX; ++it, ++count) {
+			const size_t offset = count == 0 ? m_headOffset : 0;
+
+			iov[count].iov_base = const_cast<char *>(it->data() + offset);
+			iov[count].iov_len = it->size() - offset;
+		}
+
+		ssize_t written;
+
+		{
+			SigPipeGuard sigpipe;
+			written = writev(m_fd, iov, count);
+		}
+
+		if (written < 0 && errno == EINTR)
+			continue;
+
+		if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			// the reader is slow, wait for POLLOUT
+			m_writeBlocked = true;
+			return;
+		}
+
+		if (written < 0 && errno == EPIPE) {
+			logger().information("reader of " + m_pipePath
+				+ " has gone, dropping " + to_string(m_pendingBytes)
+				+ " bytes",
+				__FILE__, __LINE__);
+			closePipe();
+			return;
+		}
+
+		if (written < 0) {
+			throw IOException(
+				"failed to write fifo: "
+				+ string(strerror(errno)));
+		}
+
+		while (written > 0) {
+			const size_t rest = m_pending.front().size() - m_headOffset;
+
+			if ((size_t) written < rest) {
+				m_headOffset += written;
+				m_pendingBytes -= written;
+				break;
+			}
+
+			m_pending.pop_front();
+			m_pendingBytes -= rest;
+			m_headOffset = 0;
+			written -= rest;
+		}
+	}
+}
+
 void NamedPipeExporter::setFilePath(const string &path)
 {
 	m_pipePath = path;
@@ -65,6 +455,32 @@ void NamedPipeExporter::setFormatter(SensorDataFormatter *formatter)
 	m_formatter = formatter;
 }
 
+void NamedPipeExporter::setPersistent(int persistent)
+{
+	m_persistent = persistent != 0;
+}
+
+void NamedPipeExporter::setBufferSize(int size)
+{
+	if (size <= 0)
+		throw InvalidArgumentException("bufferSize must be positive");
+
+	m_bufferSize = size;
+}
+
+void NamedPipeExporter::setFlushInterval(int ms)
+{
+	if (ms <= 0)
+		throw InvalidArgumentException("flushInterval must be positive");
+
+	m_flushInterval = ms;
+}
+
+void NamedPipeExporter::setDropWithoutReader(int drop)
+{
+	m_dropWithoutReader = drop != 0;
+}
+
 int NamedPipeExporter::openPipe()
 {
 	unsigned int attempts = ATTEMPTS_CREATE_PIPE;
@@ -1,8 +1,13 @@
 #ifndef BEEEON_NAMED_PIPE_EXPORTER_H
 #define BEEEON_NAMED_PIPE_EXPORTER_H
 
+#include <deque>
 #include <string>
+#include <vector>
+
 #include <Poco/Logger.h>
+#include <Poco/Mutex.h>
+#include <Poco/Timer.h>
 
 #include "core/Exporter.h"
 #include "util/Loggable.h"
@@ -11,6 +16,28 @@ namespace BeeeOn {
 
 class SensorDataFormatter;
 
+/**
+ * Exporter writing the formatted SensorData into a named pipe.
+ *
+ * By default, the pipe is opened and closed for every shipped
+ * sample. In the persistent mode, the pipe is kept open and the
+ * formatted records are coalesced in a userspace buffer which is
+ * flushed via writev() whenever the pipe is writable. The exporter
+ * never blocks in this mode. Data pending after EAGAIN and data held
+ * by the formatter longer than it allows are flushed by a timer every
+ * flushInterval, not only by the next ship. When the
+ * reader disappears (EPIPE, ENXIO), the pending data are dropped and
+ * the pipe is reopened on next ship. SIGPIPE is blocked in the writing
+ * thread during the write, so the process-wide disposition of SIGPIPE
+ * is not changed.
+ *
+ * The data shipped while there is no reader are dropped and reported
+ * as shipped by default. Otherwise, ship() returns false, so that
+ * a decorator like SpoolingExporter can keep them. The data already
+ * accepted into the buffer of the persistent mode are lost when the
+ * reader disappears, thus such a decorator needs the non-persistent
+ * mode.
+ */
 class NamedPipeExporter :
 	public Exporter,
 	public Loggable {
@@ -23,6 +50,13 @@ public:
 	 */
 	bool ship(const SensorData &data) override;
 
+	/**
+	 * Export multiple data at once. In the persistent mode,
+	 * all the records are flushed by a single writev(). An empty
+	 * batch only flushes the data pending from previous calls.
+	 */
+	bool shipBatch(const std::vector<SensorData> &batch) override;
+
 	/**
 	 * Set file path of named pipe (mkfifo)
 	 */
@@ -34,7 +68,100 @@ public:
 	 */
 	void setFormatter(SensorDataFormatter * formatter);
 
+	/**
+	 * Keep the pipe open between subsequent ship() calls
+	 * and buffer the records instead of blocking.
+	 */
+	void setPersistent(int persistent);
+
+	/**
+	 * Maximal amount of bytes buffered in the persistent mode.
+	 * When the buffer is full, ship() returns false.
+	 */
+	void setBufferSize(int size);
+
+	/**
+	 * Period of flushing the data pending in the persistent mode
+	 * and the data held by the formatter.
+	 */
+	void setFlushInterval(int ms);
+
+	/**
+	 * Report data shipped without any reader as shipped (default)
+	 * or as not shipped.
+	 */
+	void setDropWithoutReader(int drop);
+
 private:
+	bool shipPersistent(const SensorData &data);
+
+	/**
+	 * Start the flush timer unless it is running already.
+	 */
+	void startFlushing();
+
+	/**
+	 * Called periodically by the flush timer.
+	 */
+	void onFlush(Poco::Timer &timer);
+
+	/**
+	 * Make sure the pipe is open in the persistent mode.
+	 * @return false when there is no reader
+	 */
+	bool ensureOpen();
+
+	/**
+	 * Close the persistent pipe and drop all pending data.
+	 */
+	void closePipe();
+
+	/**
+	 * Open the pipe, write the whole message and close the pipe.
+	 * An empty message is not written at all.
+	 */
+	bool writeMessage(const std::string &msg);
+
+	/**
+	 * @return chunk of the pending buffer to append to
+	 */
+	std::string &tailChunk();
+
+	/**
+	 * Format the data directly into the pending buffer.
+	 * The records are coalesced into chunks of a limited size.
+	 * @return false when the buffer is full
+	 */
+	bool append(const SensorData &data);
+
+	/**
+	 * Append data held by the formatter to the pending buffer.
+	 */
+	void appendHeld();
+
+	/**
+	 * Append data held by the formatter for too long
+	 * to the pending buffer.
+	 */
+	void appendExpired();
+
+	/**
+	 * Append already formatted data to the pending buffer.
+	 */
+	void appendRaw(const std::string &data);
+
+	/**
+	 * Account bytes appended to the chunk since the offset or
+	 * remove them when not accepted.
+	 */
+	void commit(std::string &chunk, size_t offset, bool accept);
+
+	/**
+	 * Write as much of the pending buffer as possible without blocking.
+	 * @throw IOException, when the write fails unexpectedly
+	 */
+	void flush();
+
 	/**
 	 * Create pipe file (mkfifo)
 	 * @return file descriptor to open mkfifo
@@ -51,6 +178,19 @@ private:
 
 	std::string m_pipePath;
 	SensorDataFormatter *m_formatter;
+	bool m_persistent;
+	size_t m_bufferSize;
+	bool m_dropWithoutReader;
+	int m_fd;
+	bool m_writeBlocked;
+	std::deque<std::string> m_pending;
+	size_t m_pendingBytes;
+	size_t m_headOffset;
+	long m_flushInterval;
+	bool m_flushing;
+	Poco::Timer m_flushTimer;
+	Poco::TimerCallback<NamedPipeExporter> m_flushCallback;
+	Poco::FastMutex m_lock;
 };
 
 }
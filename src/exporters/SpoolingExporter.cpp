@@ -0,0 +1,413 @@
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+#include <Poco/ByteOrder.h>
+#include <Poco/Exception.h>
+#include <Poco/Logger.h>
+#include <Poco/ScopedUnlock.h>
+
+#include "di/Injectable.h"
+#include "exporters/SpoolingExporter.h"
+#include "model/SensorData.h"
+
+#define DEFAULT_SEGMENT_SIZE (4 * 1024 * 1024)
+#define DEFAULT_SYNC_COUNT 256
+#define DEFAULT_SYNC_INTERVAL (1 * Timespan::SECONDS)
+#define DEFAULT_RETRY_INTERVAL (1 * Timespan::SECONDS)
+#define DEFAULT_REPLAY_BATCH 64
+
+#define RECORD_HEADER_SIZE (8 + 8 + 2)
+#define RECORD_VALUE_SIZE (2 + 1 + 8)
+
+BEEEON_OBJECT_BEGIN(BeeeOn, SpoolingExporter)
+BEEEON_OBJECT_CASTABLE(Exporter)
+BEEEON_OBJECT_REF("exporter", &SpoolingExporter::setExporter)
+BEEEON_OBJECT_TEXT("directory", &SpoolingExporter::setDirectory)
+BEEEON_OBJECT_NUMBER("segmentSize", &SpoolingExporter::setSegmentSize)
+BEEEON_OBJECT_NUMBER("maxSegments", &SpoolingExporter::setMaxSegments)
+BEEEON_OBJECT_NUMBER("syncCount", &SpoolingExporter::setSyncCount)
+BEEEON_OBJECT_NUMBER("syncInterval", &SpoolingExporter::setSyncInterval)
+BEEEON_OBJECT_NUMBER("retryInterval", &SpoolingExporter::setRetryInterval)
+BEEEON_OBJECT_NUMBER("replayBatch", &SpoolingExporter::setReplayBatch)
+BEEEON_OBJECT_END(BeeeOn, SpoolingExporter)
+
+using namespace BeeeOn;
+using namespace Poco;
+using namespace std;
+
+static void appendUInt16(string &buffer, uint16_t value)
+{
+	value = ByteOrder::toLittleEndian(value);
+	buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void appendUInt64(string &buffer, uint64_t value)
+{
+	value = ByteOrder::toLittleEndian(static_cast<UInt64>(value));
+	buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static uint16_t loadUInt16(const char *data)
+{
+	UInt16 value;
+	memcpy(&value, data, sizeof(value));
+	return ByteOrder::fromLittleEndian(value);
+}
+
+static uint64_t loadUInt64(const char *data)
+{
+	UInt64 value;
+	memcpy(&value, data, sizeof(value));
+	return ByteOrder::fromLittleEndian(value);
+}
+
+SpoolingExporter::SpoolingExporter():
+	m_segmentSize(DEFAULT_SEGMENT_SIZE),
+	m_maxSegments(0),
+	m_syncCount(DEFAULT_SYNC_COUNT),
+	m_syncInterval(DEFAULT_SYNC_INTERVAL),
+	m_retryInterval(DEFAULT_RETRY_INTERVAL),
+	m_replayBatch(DEFAULT_REPLAY_BATCH),
+	m_unsynced(0),
+	m_stop(false),
+	m_spooled(0),
+	m_replayed(0)
+{
+}
+
+SpoolingExporter::~SpoolingExporter()
+{
+	try {
+		stop();
+	}
+	catch (const Exception &e) {
+		logger().log(e, __FILE__, __LINE__);
+	}
+}
+
+void SpoolingExporter::setExporter(SharedPtr<Exporter> exporter)
+{
+	m_exporter = exporter;
+}
+
+void SpoolingExporter::setDirectory(const string &directory)
+{
+	m_directory = directory;
+}
+
+void SpoolingExporter::setSegmentSize(int size)
+{
+	if (size < 4096)
+		throw InvalidArgumentException("segmentSize must be at least 4096");
+
+	m_segmentSize = size;
+}
+
+void SpoolingExporter::setMaxSegments(int count)
+{
+	if (count < 0 || count == 1)
+		throw InvalidArgumentException("maxSegments must be 0 or at least 2");
+
+	m_maxSegments = count;
+}
+
+void SpoolingExporter::setSyncCount(int count)
+{
+	if (count <= 0)
+		throw InvalidArgumentException("syncCount must be positive");
+
+	m_syncCount = count;
+}
+
+void SpoolingExporter::setSyncInterval(int ms)
+{
+	if (ms <= 0)
+		throw InvalidArgumentException("syncInterval must be positive");
+
+	m_syncInterval = Timespan(ms * Timespan::MILLISECONDS);
+}
+
+void SpoolingExporter::setRetryInterval(int ms)
+{
+	if (ms <= 0)
+		throw InvalidArgumentException("retryInterval must be positive");
+
+	m_retryInterval = Timespan(ms * Timespan::MILLISECONDS);
+}
+
+void SpoolingExporter::setReplayBatch(int size)
+{
+	if (size <= 0)
+		throw InvalidArgumentException("replayBatch must be positive");
+
+	m_replayBatch = size;
+}
+
+bool SpoolingExporter::ship(const SensorData &data)
+{
+	return shipBatch(vector<SensorData>(1, data));
+}
+
+bool SpoolingExporter::shipBatch(const vector<SensorData> &batch)
+{
+	if (m_exporter.isNull())
+		throw IllegalStateException("no exporter to spool for");
+
+	if (batch.empty())
+		return true;
+
+	FastMutex::ScopedLock guard(m_lock);
+
+	ensureOpen();
+
+	// the spooled data must be shipped first
+	if (m_spool.empty() && shipDownstream(batch))
+		return true;
+
+	return spool(batch);
+}
+
+void SpoolingExporter::ensureOpen()
+{
+	if (m_spool.isOpen())
+		return;
+
+	m_spool.open(m_directory, m_segmentSize, m_maxSegments);
+	m_lastSync.update();
+
+	if (!m_spool.empty()) {
+		logger().notice("replaying spool " + m_directory
+			+ " of " + to_string(m_spool.segments()) + " segments",
+			__FILE__, __LINE__);
+
+		startReplay();
+	}
+}
+
+bool SpoolingExporter::shipDownstream(const vector<SensorData> &batch)
+{
+	try {
+		if (batch.size() == 1)
+			return m_exporter->ship(batch.front());
+
+		return m_exporter->shipBatch(batch);
+	}
+	catch (const Exception &e) {
+		logger().log(e, __FILE__, __LINE__);
+	}
+	catch (const exception &e) {
+		logger().critical(e.what(), __FILE__, __LINE__);
+	}
+
+	return false;
+}
+
+bool SpoolingExporter::spool(const vector<SensorData> &batch)
+{
+	const uint64_t dropped = m_spool.droppedSegments();
+	size_t count = 0;
+
+	try {
+		for (const auto &data : batch) {
+			m_buffer.clear();
+			encode(data, m_buffer);
+			m_spool.append(m_buffer.data(), m_buffer.size());
+			++count;
+		}
+	}
+	catch (const Exception &e) {
+		logger().log(e, __FILE__, __LINE__);
+	}
+
+	if (m_spool.droppedSegments() != dropped) {
+		logger().warning("spool " + m_directory
+			+ " is full, dropped the oldest segment",
+			__FILE__, __LINE__);
+	}
+
+	m_spooled += count;
+	m_unsynced += count;
+
+	try {
+		syncIfNeeded(false);
+	}
+	catch (const Exception &e) {
+		logger().log(e, __FILE__, __LINE__);
+	}
+
+	if (count > 0)
+		startReplay();
+
+	return count == batch.size();
+}
+
+void SpoolingExporter::syncIfNeeded(bool force)
+{
+	if (m_unsynced == 0 || !m_spool.isOpen())
+		return;
+
+	if (!force && m_unsynced < m_syncCount
+			&& !m_lastSync.isElapsed(m_syncInterval.totalMicroseconds()))
+		return;
+
+	m_spool.sync();
+	m_unsynced = 0;
+	m_lastSync.update();
+}
+
+void SpoolingExporter::startReplay()
+{
+	if (m_stop || m_thread.isRunning())
+		return;
+
+	m_thread.setName("spool-replay");
+	m_thread.start(*this);
+}
+
+bool SpoolingExporter::replay()
+{
+	vector<SensorData> batch;
+	const char *data;
+	size_t length;
+
+	while (batch.size() < m_replayBatch && m_spool.next(data, length)) {
+		try {
+			batch.emplace_back(decode(data, length));
+		}
+		catch (const Exception &e) {
+			logger().log(e, __FILE__, __LINE__);
+		}
+	}
+
+	if (batch.empty()) {
+		m_spool.commit();
+		return false;
+	}
+
+	if (!shipDownstream(batch)) {
+		m_spool.rewind();
+		return false;
+	}
+
+	m_spool.commit();
+	m_replayed += batch.size();
+	m_unsynced += batch.size();
+	syncIfNeeded(false);
+
+	return true;
+}
+
+void SpoolingExporter::run()
+{
+	FastMutex::ScopedLock guard(m_lock);
+
+	while (!m_stop) {
+		try {
+			if (replay()) {
+				// let the new data to be spooled meanwhile
+				ScopedUnlock<FastMutex> unlock(m_lock);
+				Thread::yield();
+				continue;
+			}
+
+			syncIfNeeded(false);
+		}
+		catch (const Exception &e) {
+			logger().log(e, __FILE__, __LINE__);
+		}
+
+		const Timespan &wait = m_spool.empty() ?
+			m_syncInterval : m_retryInterval;
+
+		m_condition.tryWait(m_lock, wait.totalMilliseconds());
+	}
+}
+
+void SpoolingExporter::stop()
+{
+	{
+		FastMutex::ScopedLock guard(m_lock);
+		m_stop = true;
+		m_condition.broadcast();
+	}
+
+	if (m_thread.isRunning())
+		m_thread.join();
+
+	FastMutex::ScopedLock guard(m_lock);
+	syncIfNeeded(true);
+}
+
+unsigned long SpoolingExporter::spooled() const
+{
+	return m_spooled;
+}
+
+unsigned long SpoolingExporter::replayed() const
+{
+	return m_replayed;
+}
+
+bool SpoolingExporter::empty()
+{
+	FastMutex::ScopedLock guard(m_lock);
+	return !m_spool.isOpen() || m_spool.empty();
+}
+
+void SpoolingExporter::encode(const SensorData &data, string &buffer)
+{
+	const size_t count = data.end() - data.begin();
+
+	if (count > 0xffff)
+		throw RangeException("too many values to spool");
+
+	buffer.reserve(buffer.size() + RECORD_HEADER_SIZE
+		+ count * RECORD_VALUE_SIZE);
+
+	appendUInt64(buffer, data.deviceID());
+	appendUInt64(buffer, data.timestamp().value().epochMicroseconds());
+	appendUInt16(buffer, count);
+
+	for (const auto &item : data) {
+		double value = item.value();
+		uint64_t raw;
+
+		memcpy(&raw, &value, sizeof(raw));
+
+		appendUInt16(buffer, item.moduleID().value());
+		buffer.push_back(item.isValid() ? 1 : 0);
+		appendUInt64(buffer, raw);
+	}
+}
+
+SensorData SpoolingExporter::decode(const char *data, size_t length)
+{
+	if (length < RECORD_HEADER_SIZE)
+		throw DataFormatException("spooled record is too short");
+
+	const size_t count = loadUInt16(data + 16);
+
+	if (length != RECORD_HEADER_SIZE + count * RECORD_VALUE_SIZE)
+		throw DataFormatException("spooled record has invalid length");
+
+	SensorData result;
+	result.setDeviceID(DeviceID(loadUInt64(data)));
+	result.setTimestamp(Timestamp(
+		static_cast<Timestamp::TimeVal>(loadUInt64(data + 8))));
+
+	const char *value = data + RECORD_HEADER_SIZE;
+
+	for (size_t i = 0; i < count; ++i, value += RECORD_VALUE_SIZE) {
+		const uint64_t raw = loadUInt64(value + 3);
+		double number;
+
+		memcpy(&number, &raw, sizeof(number));
+
+		SensorValue item(ModuleID(loadUInt16(value)), number);
+		item.setValid(value[2] != 0);
+		result.insertValue(item);
+	}
+
+	return result;
+}
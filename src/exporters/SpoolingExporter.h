@@ -0,0 +1,138 @@
+#ifndef BEEEON_SPOOLING_EXPORTER_H
+#define BEEEON_SPOOLING_EXPORTER_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <Poco/Condition.h>
+#include <Poco/Mutex.h>
+#include <Poco/Runnable.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/Thread.h>
+#include <Poco/Timespan.h>
+#include <Poco/Timestamp.h>
+
+#include "core/Exporter.h"
+#include "util/Loggable.h"
+#include "util/SpoolLog.h"
+
+namespace BeeeOn {
+
+/**
+ * Exporter decorator storing the data its downstream Exporter fails
+ * to ship into a SpoolLog on the disk. The spooled data are replayed
+ * in order by a separate thread as soon as the downstream Exporter
+ * accepts them again. While the spool is not empty, all new data are
+ * appended to it to preserve their order.
+ *
+ * The spool is synced (msync) after every syncCount spooled records
+ * and at least every syncInterval, thus no syscall is made per record.
+ * When the spool exceeds maxSegments, the oldest data are dropped.
+ *
+ * The delivery is at-least-once: a batch partially shipped before
+ * a failure is replayed as a whole and the records consumed after
+ * the last sync are replayed again after a crash.
+ */
+class SpoolingExporter :
+	public Exporter,
+	public Poco::Runnable,
+	public Loggable {
+public:
+	SpoolingExporter();
+	~SpoolingExporter();
+
+	/**
+	 * Ship the data downstream or spool them. Returns false only
+	 * when the data cannot be spooled.
+	 */
+	bool ship(const SensorData &data) override;
+	bool shipBatch(const std::vector<SensorData> &batch) override;
+
+	void setExporter(Poco::SharedPtr<Exporter> exporter);
+	void setDirectory(const std::string &directory);
+	void setSegmentSize(int size);
+
+	/**
+	 * Maximal count of segments kept on the disk, 0 is unlimited.
+	 */
+	void setMaxSegments(int count);
+	void setSyncCount(int count);
+	void setSyncInterval(int ms);
+
+	/**
+	 * Delay before the next replay attempt after a failure.
+	 */
+	void setRetryInterval(int ms);
+
+	/**
+	 * Maximal count of spooled records shipped downstream at once.
+	 */
+	void setReplayBatch(int size);
+
+	/**
+	 * Replay loop, it is started automatically when anything
+	 * is spooled.
+	 */
+	void run() override;
+
+	/**
+	 * Stop the replay and sync the spool.
+	 */
+	void stop();
+
+	unsigned long spooled() const;
+	unsigned long replayed() const;
+	bool empty();
+
+	/**
+	 * Encoding of SensorData in the spool.
+	 */
+	static void encode(const SensorData &data, std::string &buffer);
+	static SensorData decode(const char *data, size_t length);
+
+private:
+	void ensureOpen();
+
+	/**
+	 * Try to ship data downstream, exceptions are considered
+	 * as a failure.
+	 */
+	bool shipDownstream(const std::vector<SensorData> &batch);
+
+	bool spool(const std::vector<SensorData> &batch);
+	void syncIfNeeded(bool force);
+	void startReplay();
+
+	/**
+	 * Ship a single batch of spooled data.
+	 * @return false when nothing is to be replayed now
+	 */
+	bool replay();
+
+private:
+	Poco::SharedPtr<Exporter> m_exporter;
+	std::string m_directory;
+	size_t m_segmentSize;
+	size_t m_maxSegments;
+	unsigned int m_syncCount;
+	Poco::Timespan m_syncInterval;
+	Poco::Timespan m_retryInterval;
+	size_t m_replayBatch;
+
+	SpoolLog m_spool;
+	unsigned int m_unsynced;
+	Poco::Timestamp m_lastSync;
+	std::string m_buffer;
+
+	Poco::FastMutex m_lock;
+	Poco::Condition m_condition;
+	Poco::Thread m_thread;
+	bool m_stop;
+	std::atomic<unsigned long> m_spooled;
+	std::atomic<unsigned long> m_replayed;
+};
+
+}
+
+#endif
@@ -23,6 +23,11 @@ BEEEON_OBJECT_NUMBER("dataServerPort", &JablotronDeviceManager::setDataServerPor
 BEEEON_OBJECT_TEXT("helloServerHost", &JablotronDeviceManager::setHelloServerHost)
 BEEEON_OBJECT_NUMBER("helloServerPort", &JablotronDeviceManager::setHelloServerPort)
 BEEEON_OBJECT_TEXT("prefixName", &JablotronDeviceManager::setPrefixName)
+BEEEON_OBJECT_TEXT("encoding", &JablotronDeviceManager::setEncoding)
+BEEEON_OBJECT_NUMBER("batchSize", &JablotronDeviceManager::setBatchSize)
+BEEEON_OBJECT_NUMBER("batchDelay", &JablotronDeviceManager::setBatchDelay)
+BEEEON_OBJECT_NUMBER("creditBuffer", &JablotronDeviceManager::setCreditBuffer)
+BEEEON_OBJECT_NUMBER("creditWait", &JablotronDeviceManager::setCreditWait)
 BEEEON_OBJECT_TEXT("donglePath", &JablotronDeviceManager::setDonglePath)
 BEEEON_OBJECT_END(BeeeOn, JablotronDeviceManager)
 
@@ -95,11 +100,7 @@ void JablotronDeviceManager::getDeviceList()
 	Answer::Ptr answer = new Answer(m_queue);
 	ServerDeviceListCommand::Ptr cmd = new ServerDeviceListCommand(m_prefix);
 
-	ZMQMessage msg = ZMQMessage::fromCommand(cmd);
-	msg.setID(GlobalID::random());
-
-	m_zmqClient->send(msg.toString());
-	m_table.insert(make_pair(answer, ResultData{msg.id(), cmd}));
+	sendRequest(answer, cmd);
 
 	logger().debug("run cmd: " + cmd->name());
 }
@@ -110,11 +111,7 @@ void JablotronDeviceManager::getLastValue(const DeviceID &deviceID)
 	ServerLastValueCommand::Ptr cmd =
 		new ServerLastValueCommand(deviceID, JABLOTRON_MAINS_OUTLET);
 
-	ZMQMessage msg = ZMQMessage::fromCommand(cmd);
-	msg.setID(GlobalID::random());
-
-	m_zmqClient->send(msg.toString());
-	m_table.insert(make_pair(answer, ResultData{msg.id(), cmd}));
+	sendRequest(answer, cmd);
 
 	logger().debug("run cmd: " + cmd->name());
 }
@@ -125,27 +122,27 @@ void JablotronDeviceManager::checkQueue()
 	m_queue.wait(QUEUE_WAIT, dirtyList);
 
 	for (auto answer : dirtyList) {
-		auto it = m_table.find(answer);
+		Command::Ptr request = answeredCommand(answer);
 
-		if (it == m_table.end()) {
+		if (request.isNull()) {
 			logger().warning("unknown result");
 			break;
 		}
 
-		if (it->second.cmd->is<ServerDeviceListCommand>()) {
+		if (request->is<ServerDeviceListCommand>()) {
 			m_devicesWithFlag.clear();
 
 			for (auto deviceID : answer->at(0).cast<ServerDeviceListResult>()->deviceList())
 				m_devicesWithFlag.insert(deviceID);
 		}
 
-		if (it->second.cmd->is<ServerLastValueCommand>()) {
+		if (request->is<ServerLastValueCommand>()) {
 			if (answer->at(0).cast<ServerLastValueResult>()->status() != Result::SUCCESS) {
 				return;
 			}
 
 			setSwitch(
-				it->second.cmd.cast<ServerLastValueCommand>()->deviceID(),
+				request.cast<ServerLastValueCommand>()->deviceID(),
 				(short) answer->at(0).cast<ServerLastValueResult>()->value());
 		}
 	}
@@ -199,24 +196,30 @@ void JablotronDeviceManager::doListenCommand(ZMQMessage &zmqMessage)
 
 void JablotronDeviceManager::doTypeDeviceListResult(ZMQMessage &zmqMessage)
 {
-	for (auto item : m_table) {
-		if (item.second.id != zmqMessage.id())
-			continue;
+	Answer::Ptr answer = findAnswer(zmqMessage.id());
 
-		ServerDeviceListResult::Ptr res = new ServerDeviceListResult(item.first);
-		zmqMessage.toServerDeviceListResult(res);
+	if (answer.isNull()) {
+		logger().warning("unknown or expired result id "
+			+ zmqMessage.id().toString());
+		return;
 	}
+
+	ServerDeviceListResult::Ptr res = new ServerDeviceListResult(answer);
+	zmqMessage.toServerDeviceListResult(res);
 }
 
 void JablotronDeviceManager::doDeviceLastValueResult(ZMQMessage &zmqMessage)
 {
-	for (auto item : m_table) {
-		if (item.second.id != zmqMessage.id())
-			continue;
+	Answer::Ptr answer = findAnswer(zmqMessage.id());
 
-		ServerLastValueResult::Ptr res = new ServerLastValueResult(item.first);
-		zmqMessage.toServerLastValueResult(res);
+	if (answer.isNull()) {
+		logger().warning("unknown or expired result id "
+			+ zmqMessage.id().toString());
+		return;
 	}
+
+	ServerLastValueResult::Ptr res = new ServerLastValueResult(answer);
+	zmqMessage.toServerLastValueResult(res);
 }
 
 void JablotronDeviceManager::initJablotronSerial()
@@ -381,7 +384,7 @@ void JablotronDeviceManager::sendMeasuredValues(const string &message,
 		return;
 	}
 
-	m_zmqClient->send(ZMQMessage::fromSensorData(sensorData).toString());
+	m_zmqClient->send(sensorData);
 
 	if (m_sensorEvent) {
 		sleep(1);
@@ -389,7 +392,7 @@ void JablotronDeviceManager::sendMeasuredValues(const string &message,
 		sensorDataEvent.setDeviceID(sensorData.deviceID());
 		sensorData.insertValue(m_sensorEventValue);
 
-		m_zmqClient->send(ZMQMessage::fromSensorData(sensorDataEvent).toString());
+		m_zmqClient->send(sensorDataEvent);
 		m_sensorEvent = false;
 	}
 }
@@ -249,7 +249,6 @@ private:
 	std::vector<JablotronSerialNumber> m_devices;
 	bool m_sensorEvent;
 	SensorValue m_sensorEventValue;
-	AnswerQueue m_queue;
 
 	Poco::AtomicCounter m_queueLoop;
 	std::set<DeviceID> m_devicesWithFlag;
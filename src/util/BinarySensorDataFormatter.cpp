@@ -0,0 +1,71 @@
+#include <cstring>
+#include <limits>
+
+#include <Poco/ByteOrder.h>
+#include <Poco/Exception.h>
+
+#include "BinarySensorDataFormatter.h"
+#include "di/Injectable.h"
+#include "model/SensorData.h"
+
+BEEEON_OBJECT_BEGIN(BeeeOn, BinarySensorDataFormatter)
+BEEEON_OBJECT_CASTABLE(SensorDataFormatter)
+BEEEON_OBJECT_END(BeeeOn, BinarySensorDataFormatter)
+
+using namespace BeeeOn;
+using namespace Poco;
+using namespace std;
+
+static void appendUInt16(string &buffer, uint16_t value)
+{
+	value = ByteOrder::toLittleEndian(value);
+	buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void appendUInt64(string &buffer, uint64_t value)
+{
+	value = ByteOrder::toLittleEndian(static_cast<UInt64>(value));
+	buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void appendDouble(string &buffer, double value)
+{
+	uint64_t raw;
+	memcpy(&raw, &value, sizeof(raw));
+	appendUInt64(buffer, raw);
+}
+
+BinarySensorDataFormatter::BinarySensorDataFormatter()
+{
+}
+
+string BinarySensorDataFormatter::format(const SensorData &data)
+{
+	string output;
+	format(data, output);
+	return output;
+}
+
+void BinarySensorDataFormatter::format(const SensorData &data, string &buffer)
+{
+	const size_t count = data.end() - data.begin();
+
+	if (count > 0xffff)
+		throw RangeException("too many values for binary record");
+
+	const uint32_t length = ByteOrder::toLittleEndian(static_cast<UInt32>(
+		HEADER_SIZE - LENGTH_SIZE + count * VALUE_SIZE));
+
+	buffer.reserve(buffer.size() + HEADER_SIZE + count * VALUE_SIZE);
+	buffer.append(reinterpret_cast<const char *>(&length), sizeof(length));
+
+	appendUInt64(buffer, data.deviceID());
+	appendUInt64(buffer, data.timestamp().value().epochMicroseconds());
+	appendUInt16(buffer, count);
+
+	for (const auto &item : data) {
+		appendUInt16(buffer, item.moduleID().value());
+		appendDouble(buffer, item.isValid() ?
+			item.value() : numeric_limits<double>::quiet_NaN());
+	}
+}
@@ -0,0 +1,41 @@
+#ifndef BEEEON_BINARY_SENSOR_DATA_FORMATTER_H
+#define BEEEON_BINARY_SENSOR_DATA_FORMATTER_H
+
+#include <string>
+
+#include "SensorDataFormatter.h"
+
+namespace BeeeOn {
+
+class SensorData;
+
+/*
+ * Formatter producing a length-prefixed binary record for each
+ * SensorData. The reader does not need to parse any text.
+ *
+ * All numbers are little endian:
+ *
+ *  offset  size  description
+ *       0     4  length of the rest of the record
+ *       4     8  DeviceID
+ *      12     8  timestamp (microseconds since epoch, signed)
+ *      20     2  count of values
+ *      22  10*N  values: u16 ModuleID, f64 value (NaN when invalid)
+ */
+class BinarySensorDataFormatter : public SensorDataFormatter {
+public:
+	enum {
+		LENGTH_SIZE = 4,
+		HEADER_SIZE = 22,
+		VALUE_SIZE = 10,
+	};
+
+	BinarySensorDataFormatter();
+
+	std::string format(const SensorData &data) override;
+	void format(const SensorData &data, std::string &buffer) override;
+};
+
+}
+
+#endif // BEEEON_BINARY_SENSOR_DATA_FORMATTER_H
@@ -1,3 +1,5 @@
+#include <cmath>
+#include <cstdint>
 #include <string>
 
 #include <Poco/NumberFormatter.h>
@@ -14,11 +16,88 @@ BEEEON_OBJECT_END(BeeeOn, CSVSensorDataFormatter)
 
 #define DEFAULT_SEPARATOR ";"
 #define PRECISION_OF_VALUE 2
+#define SCALE_OF_VALUE 100
+// above this limit, rounding errors of the scaling might exceed TIE_EPSILON
+#define FAST_VALUE_LIMIT 1e7
+#define TIE_EPSILON 1e-6
 
 using namespace BeeeOn;
 using namespace Poco;
 using namespace std;
 
+static void appendUnsigned(string &buffer, uint64_t value)
+{
+	char digits[20];
+	size_t i = sizeof(digits);
+
+	do {
+		digits[--i] = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+
+	buffer.append(digits + i, sizeof(digits) - i);
+}
+
+static void appendSigned(string &buffer, int64_t value)
+{
+	if (value < 0) {
+		buffer += '-';
+		appendUnsigned(buffer, -static_cast<uint64_t>(value));
+	}
+	else {
+		appendUnsigned(buffer, value);
+	}
+}
+
+/*
+ * Same output as Poco::NumberFormatter::formatHex(value).
+ */
+static void appendHex(string &buffer, unsigned int value)
+{
+	static const char HEX[] = "0123456789ABCDEF";
+	char digits[8];
+	size_t i = sizeof(digits);
+
+	do {
+		digits[--i] = HEX[value & 0xf];
+		value >>= 4;
+	} while (value > 0);
+
+	buffer.append(digits + i, sizeof(digits) - i);
+}
+
+/*
+ * Same output as Poco::NumberFormatter::format(value, PRECISION_OF_VALUE).
+ * The value is scaled to an integer when it can be rounded unambiguously.
+ * Ties, negative zero, huge numbers, infinity and NaN are left to Poco.
+ */
+static void appendFixed(string &buffer, double value)
+{
+	const double scaled = value * SCALE_OF_VALUE;
+	const double rounded = std::nearbyint(scaled);
+	const double fraction = std::fabs(scaled - std::trunc(scaled));
+
+	if (!(std::fabs(value) < FAST_VALUE_LIMIT)
+			|| std::fabs(fraction - 0.5) < TIE_EPSILON
+			|| (rounded == 0 && std::signbit(value))) {
+		NumberFormatter::append(buffer, value, PRECISION_OF_VALUE);
+		return;
+	}
+
+	int64_t number = static_cast<int64_t>(rounded);
+	if (number < 0) {
+		buffer += '-';
+		number = -number;
+	}
+
+	appendUnsigned(buffer, number / SCALE_OF_VALUE);
+	buffer += '.';
+
+	const unsigned int cents = number % SCALE_OF_VALUE;
+	buffer += '0' + cents / 10;
+	buffer += '0' + cents % 10;
+}
+
 CSVSensorDataFormatter::CSVSensorDataFormatter() :
 	m_separator(DEFAULT_SEPARATOR)
 {
@@ -26,16 +105,37 @@ CSVSensorDataFormatter::CSVSensorDataFormatter() :
 
 string CSVSensorDataFormatter::format(const SensorData &data)
 {
-	string output = "";
-	string device = data.deviceID().toString();
-	string timestamp = to_string(data.timestamp().value().epochTime());
+	string output;
+	format(data, output);
+	return output;
+}
+
+void CSVSensorDataFormatter::format(const SensorData &data, string &buffer)
+{
+	const string &device = deviceText(data.deviceID());
+	const int64_t timestamp = data.timestamp().value().epochTime();
+
+	for (const auto &item : data) {
+		buffer += "sensor";
+		buffer += m_separator;
+		appendSigned(buffer, timestamp);
+		buffer += m_separator;
+		buffer += device;
+		buffer += m_separator;
+		appendHex(buffer, item.moduleID().value());
+		buffer += m_separator;
+		appendFixed(buffer, item.value());
+		buffer += m_separator;
+		buffer += '\n';
+	}
+}
 
-	for (auto item : data) {
-		output += "sensor" + separator() + timestamp + separator() + device + separator();
-		output += item.moduleID().toString() + separator();
-		output += NumberFormatter::format(item.value(), PRECISION_OF_VALUE) + separator();
-		output += "\n";
+const string &CSVSensorDataFormatter::deviceText(const DeviceID &id)
+{
+	if (m_lastDeviceText.empty() || !(m_lastDevice == id)) {
+		m_lastDevice = id;
+		m_lastDeviceText = id.toString();
 	}
 
-	return output;
+	return m_lastDeviceText;
 }
@@ -3,6 +3,7 @@
 
 #include <string>
 
+#include "model/DeviceID.h"
 #include "SensorDataFormatter.h"
 
 namespace BeeeOn {
@@ -20,6 +21,13 @@ public:
 	 */
 	std::string format(const SensorData &data) override;
 
+	/**
+	 * Append data in csv format to the given buffer without any
+	 * temporary strings. The text of the last formatted DeviceID
+	 * is cached, thus the formatter must not be shared among threads.
+	 */
+	void format(const SensorData &data, std::string &buffer) override;
+
 	/**
 	 * Optional custom separator
 	 */
@@ -38,7 +46,11 @@ public:
 	}
 
 private:
+	const std::string &deviceText(const DeviceID &id);
+
 	std::string m_separator;
+	DeviceID m_lastDevice;
+	std::string m_lastDeviceText;
 };
 
 }
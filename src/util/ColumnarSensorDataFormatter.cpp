@@ -0,0 +1,245 @@
+#include <cstring>
+#include <limits>
+
+#include <Poco/ByteOrder.h>
+#include <Poco/Exception.h>
+
+#include "ColumnarSensorDataFormatter.h"
+#include "di/Injectable.h"
+
+BEEEON_OBJECT_BEGIN(BeeeOn, ColumnarSensorDataFormatter)
+BEEEON_OBJECT_CASTABLE(SensorDataFormatter)
+BEEEON_OBJECT_NUMBER("blockSize", &ColumnarSensorDataFormatter::setBlockSize)
+BEEEON_OBJECT_NUMBER("blockDelay", &ColumnarSensorDataFormatter::setBlockDelay)
+BEEEON_OBJECT_END(BeeeOn, ColumnarSensorDataFormatter)
+
+#define DEFAULT_BLOCK_DELAY_MS 1000
+
+using namespace BeeeOn;
+using namespace Poco;
+using namespace std;
+
+static void appendUInt16(string &buffer, uint16_t value)
+{
+	value = ByteOrder::toLittleEndian(value);
+	buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void appendUInt64(string &buffer, uint64_t value)
+{
+	value = ByteOrder::toLittleEndian(static_cast<UInt64>(value));
+	buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void appendVarint(string &buffer, uint64_t value)
+{
+	while (value >= 0x80) {
+		buffer += static_cast<char>((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+
+	buffer += static_cast<char>(value);
+}
+
+static void appendSignedVarint(string &buffer, int64_t value)
+{
+	appendVarint(buffer, (static_cast<uint64_t>(value) << 1)
+		^ static_cast<uint64_t>(value >> 63));
+}
+
+static unsigned int leadingZeros(uint64_t value)
+{
+	return __builtin_clzll(value);
+}
+
+static unsigned int trailingZeros(uint64_t value)
+{
+	return __builtin_ctzll(value);
+}
+
+/*
+ * Appends bits to the buffer starting by the most significant bit.
+ */
+class BitWriter {
+public:
+	BitWriter(string &buffer):
+		m_buffer(buffer),
+		m_bits(0),
+		m_count(0)
+	{
+	}
+
+	void write(uint64_t value, unsigned int count)
+	{
+		while (count > 0) {
+			const unsigned int space = 8 - m_count;
+			const unsigned int n = count < space ? count : space;
+			const unsigned int shift = count - n;
+
+			m_bits = (m_bits << n) | ((value >> shift) & ((1u << n) - 1));
+			m_count += n;
+			count -= n;
+
+			if (m_count == 8) {
+				m_buffer += static_cast<char>(m_bits);
+				m_bits = 0;
+				m_count = 0;
+			}
+		}
+	}
+
+	void finish()
+	{
+		if (m_count > 0)
+			write(0, 8 - m_count);
+	}
+
+private:
+	string &m_buffer;
+	unsigned int m_bits;
+	unsigned int m_count;
+};
+
+ColumnarSensorDataFormatter::ColumnarSensorDataFormatter():
+	m_blockSize(DEFAULT_BLOCK_SIZE),
+	m_blockDelay(DEFAULT_BLOCK_DELAY_MS * Timespan::MILLISECONDS)
+{
+}
+
+void ColumnarSensorDataFormatter::setBlockSize(int size)
+{
+	if (size <= 0 || size > MAX_BLOCK_SIZE)
+		throw InvalidArgumentException("blockSize is out of range");
+
+	m_blockSize = size;
+}
+
+void ColumnarSensorDataFormatter::setBlockDelay(int ms)
+{
+	if (ms < 0)
+		throw InvalidArgumentException("blockDelay must not be negative");
+
+	m_blockDelay = ms * Timespan::MILLISECONDS;
+}
+
+string ColumnarSensorDataFormatter::format(const SensorData &data)
+{
+	string output;
+	format(data, output);
+	return output;
+}
+
+void ColumnarSensorDataFormatter::format(const SensorData &data, string &buffer)
+{
+	if (m_held.empty())
+		m_firstHeld.update();
+
+	m_held.push_back(data);
+
+	if (m_held.size() >= m_blockSize)
+		writeBlock(buffer);
+	else
+		flushExpired(buffer);
+}
+
+void ColumnarSensorDataFormatter::flush(string &buffer)
+{
+	if (!m_held.empty())
+		writeBlock(buffer);
+}
+
+void ColumnarSensorDataFormatter::flushExpired(string &buffer)
+{
+	if (!m_held.empty()
+			&& m_firstHeld.isElapsed(m_blockDelay.totalMicroseconds())) {
+		writeBlock(buffer);
+	}
+}
+
+void ColumnarSensorDataFormatter::writeBlock(string &buffer)
+{
+	const size_t start = buffer.size();
+	buffer.append(LENGTH_SIZE, '\0');
+
+	appendUInt16(buffer, m_held.size());
+
+	for (const auto &data : m_held)
+		appendUInt64(buffer, data.deviceID());
+
+	int64_t previous = 0;
+	for (const auto &data : m_held) {
+		const int64_t timestamp = data.timestamp().value().epochMicroseconds();
+
+		appendSignedVarint(buffer, timestamp - previous);
+		previous = timestamp;
+	}
+
+	for (const auto &data : m_held)
+		appendVarint(buffer, data.end() - data.begin());
+
+	for (const auto &data : m_held) {
+		for (const auto &item : data)
+			appendVarint(buffer, item.moduleID().value());
+	}
+
+	BitWriter bits(buffer);
+	bool first = true;
+	uint64_t last = 0;
+	unsigned int windowLeading = 0;
+	unsigned int windowTrailing = 0;
+	bool window = false;
+
+	for (const auto &data : m_held) {
+		for (const auto &item : data) {
+			const double value = item.isValid() ?
+				item.value() : numeric_limits<double>::quiet_NaN();
+			uint64_t raw;
+
+			memcpy(&raw, &value, sizeof(raw));
+
+			if (first) {
+				bits.write(raw, 64);
+				last = raw;
+				first = false;
+				continue;
+			}
+
+			const uint64_t xored = raw ^ last;
+			last = raw;
+
+			if (xored == 0) {
+				bits.write(0, 1);
+				continue;
+			}
+
+			const unsigned int leading = leadingZeros(xored);
+			const unsigned int trailing = trailingZeros(xored);
+
+			if (window && leading >= windowLeading && trailing >= windowTrailing) {
+				bits.write(0x2, 2);
+				bits.write(xored >> windowTrailing,
+					64 - windowLeading - windowTrailing);
+				continue;
+			}
+
+			const unsigned int meaningful = 64 - leading - trailing;
+
+			bits.write(0x3, 2);
+			bits.write(leading, 6);
+			bits.write(meaningful - 1, 6);
+			bits.write(xored >> trailing, meaningful);
+
+			window = true;
+			windowLeading = leading;
+			windowTrailing = trailing;
+		}
+	}
+
+	bits.finish();
+
+	const uint32_t length = ByteOrder::toLittleEndian(
+		static_cast<UInt32>(buffer.size() - start - LENGTH_SIZE));
+	memcpy(&buffer[start], &length, sizeof(length));
+
+	m_held.clear();
+}
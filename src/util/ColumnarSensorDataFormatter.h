@@ -0,0 +1,83 @@
+#ifndef BEEEON_COLUMNAR_SENSOR_DATA_FORMATTER_H
+#define BEEEON_COLUMNAR_SENSOR_DATA_FORMATTER_H
+
+#include <string>
+#include <vector>
+
+#include <Poco/Timespan.h>
+#include <Poco/Timestamp.h>
+
+#include "model/SensorData.h"
+#include "SensorDataFormatter.h"
+
+namespace BeeeOn {
+
+/*
+ * Formatter collecting SensorData into blocks stored by columns.
+ * A block is produced when it contains blockSize records, when the
+ * oldest held record is older than blockDelay (checked by format()
+ * and flushExpired()) or when flush() is called. Otherwise, the
+ * formatter produces nothing.
+ * Every block is self-contained.
+ *
+ * All fixed-size numbers are little endian, varints are LEB128
+ * (signed values are zigzag encoded):
+ *
+ *  size  description
+ *     4  length of the rest of the block
+ *     2  count of records N
+ *   8*N  DeviceIDs
+ *   var  N varints: timestamp (us) minus timestamp of the previous
+ *        record (zero for the first one), signed
+ *   var  N varints: count of values of each record
+ *   var  varints: ModuleIDs of all values
+ *   var  all values (NaN when invalid) compressed by XOR as described
+ *        in the Gorilla paper: the first value is stored as 64 bits,
+ *        for each next value its XOR with the previous one follows:
+ *          '0'    - the XOR is zero
+ *          '10'   - the meaningful bits of XOR fit into the previous
+ *                   window, they are stored in the window size
+ *          '11'   - 6 bits of leading zeros, 6 bits of the count of
+ *                   meaningful bits minus 1, the meaningful bits
+ *        the bit stream is padded by zeros to whole bytes
+ *
+ * The formatter holds the data, thus it must not be shared among
+ * multiple exporters.
+ */
+class ColumnarSensorDataFormatter : public SensorDataFormatter {
+public:
+	enum {
+		LENGTH_SIZE = 4,
+		DEFAULT_BLOCK_SIZE = 64,
+		MAX_BLOCK_SIZE = 0xffff,
+	};
+
+	ColumnarSensorDataFormatter();
+
+	/**
+	 * Maximal count of records in a single block.
+	 */
+	void setBlockSize(int size);
+
+	/**
+	 * Maximal time to hold a record before its block is produced.
+	 */
+	void setBlockDelay(int ms);
+
+	std::string format(const SensorData &data) override;
+	void format(const SensorData &data, std::string &buffer) override;
+	void flush(std::string &buffer) override;
+	void flushExpired(std::string &buffer) override;
+
+private:
+	void writeBlock(std::string &buffer);
+
+	size_t m_blockSize;
+	Poco::Timespan m_blockDelay;
+	std::vector<SensorData> m_held;
+	Poco::Timestamp m_firstHeld;
+};
+
+}
+
+#endif // BEEEON_COLUMNAR_SENSOR_DATA_FORMATTER_H
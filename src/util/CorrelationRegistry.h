@@ -0,0 +1,392 @@
+#ifndef BEEEON_CORRELATION_REGISTRY_H
+#define BEEEON_CORRELATION_REGISTRY_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <Poco/Timespan.h>
+#include <Poco/Timestamp.h>
+
+#include "model/GlobalID.h"
+
+namespace BeeeOn {
+
+/*
+ * Hash of GlobalID usable with the CorrelationRegistry.
+ */
+struct GlobalIDHash {
+	size_t operator()(const GlobalID &id) const
+	{
+		return std::hash<std::string>()(id.toString());
+	}
+};
+
+/*
+ * Registry of pending requests that matches responses to their
+ * requests. Every entry lives at most for the given TTL and the
+ * registry holds at most the given number of entries, so it does
+ * not grow without limits when the responses never come.
+ *
+ * Entries are allocated in blocks (slab) and reused via a free
+ * list. The index is an open addressing hash table with linear
+ * probing and backward shift deletion (no tombstones). The entries
+ * are linked in order of their insertion, the oldest entries are
+ * thus evicted in O(1) each.
+ *
+ * The registry is not thread-safe, the owner must serialize
+ * the access.
+ */
+template <typename Key, typename T, typename Hash = std::hash<Key>>
+class CorrelationRegistry {
+public:
+	CorrelationRegistry(
+			const Poco::Timespan &ttl = 60 * Poco::Timespan::SECONDS,
+			size_t capacity = 4096):
+		m_ttl(ttl),
+		m_capacity(capacity),
+		m_index(INITIAL_INDEX, NONE),
+		m_oldest(NONE),
+		m_newest(NONE),
+		m_size(0)
+	{
+	}
+
+	CorrelationRegistry(const CorrelationRegistry &) = delete;
+
+	~CorrelationRegistry()
+	{
+		clear();
+	}
+
+	void setTTL(const Poco::Timespan &ttl)
+	{
+		m_ttl = ttl;
+	}
+
+	Poco::Timespan ttl() const
+	{
+		return m_ttl;
+	}
+
+	/*
+	 * Maximal number of entries, it does not evict the entries
+	 * above the new capacity immediately.
+	 */
+	void setCapacity(size_t capacity)
+	{
+		m_capacity = capacity;
+	}
+
+	size_t capacity() const
+	{
+		return m_capacity;
+	}
+
+	/*
+	 * Register the value under the given key. An entry of the same
+	 * key is replaced. When the registry is full, the oldest entries
+	 * are evicted and their values are appended into evicted.
+	 */
+	void insert(const Key &key, const T &value,
+		std::vector<T> &evicted,
+		const Poco::Timestamp &now = Poco::Timestamp())
+	{
+		remove(key);
+
+		while (m_size > 0 && m_size >= m_capacity) {
+			evicted.push_back(entry(m_oldest).value);
+			erase(m_oldest);
+		}
+
+		if ((m_size + 1) * 2 > m_index.size())
+			rehash(m_index.size() * 2);
+
+		const uint32_t index = allocate(key, value, now);
+		Entry &e = entry(index);
+
+		size_t pos = e.hash & mask();
+		while (m_index[pos] != NONE)
+			pos = (pos + 1) & mask();
+
+		m_index[pos] = index;
+		link(index);
+		m_size++;
+	}
+
+	/*
+	 * Register the value under the given key, the values evicted
+	 * due to the capacity are dropped. Returns false when any entry
+	 * has been dropped.
+	 */
+	bool insert(const Key &key, const T &value,
+		const Poco::Timestamp &now = Poco::Timestamp())
+	{
+		std::vector<T> evicted;
+		insert(key, value, evicted, now);
+		return evicted.empty();
+	}
+
+	/*
+	 * Value registered under the given key or NULL. The pointer
+	 * is valid until the registry is modified.
+	 */
+	T *find(const Key &key)
+	{
+		const size_t pos = lookup(key);
+		if (pos == NOT_FOUND)
+			return NULL;
+
+		return &entry(m_index[pos]).value;
+	}
+
+	/*
+	 * Remove the entry of the given key and return its value.
+	 * Returns false when there is no such entry.
+	 */
+	bool take(const Key &key, T &value)
+	{
+		const size_t pos = lookup(key);
+		if (pos == NOT_FOUND)
+			return false;
+
+		value = entry(m_index[pos]).value;
+		erase(m_index[pos]);
+		return true;
+	}
+
+	bool remove(const Key &key)
+	{
+		const size_t pos = lookup(key);
+		if (pos == NOT_FOUND)
+			return false;
+
+		erase(m_index[pos]);
+		return true;
+	}
+
+	/*
+	 * Evict entries older than TTL and append their values into
+	 * expired in order of their insertion. Returns the number of
+	 * the evicted entries.
+	 */
+	size_t expire(const Poco::Timestamp &now, std::vector<T> &expired)
+	{
+		const Poco::Timestamp::TimeDiff limit =
+			now.epochMicroseconds() - m_ttl.totalMicroseconds();
+		size_t count = 0;
+
+		while (m_oldest != NONE && entry(m_oldest).created <= limit) {
+			expired.push_back(entry(m_oldest).value);
+			erase(m_oldest);
+			count++;
+		}
+
+		return count;
+	}
+
+	void clear()
+	{
+		while (m_oldest != NONE)
+			erase(m_oldest);
+	}
+
+	size_t size() const
+	{
+		return m_size;
+	}
+
+	bool empty() const
+	{
+		return m_size == 0;
+	}
+
+	/*
+	 * Memory allocated by the registry in bytes. The allocated
+	 * blocks are kept for reuse, so it reflects the peak usage.
+	 */
+	size_t memoryUsage() const
+	{
+		return m_blocks.size() * BLOCK_SIZE * sizeof(Entry)
+			+ m_blocks.capacity() * sizeof(Block)
+			+ m_index.capacity() * sizeof(uint32_t)
+			+ m_free.capacity() * sizeof(uint32_t);
+	}
+
+private:
+	enum {
+		BLOCK_SIZE = 64,
+		INITIAL_INDEX = 16,
+	};
+
+	static const uint32_t NONE = 0xffffffff;
+	static const size_t NOT_FOUND = SIZE_MAX;
+
+	struct Entry {
+		Key key;
+		T value;
+		size_t hash;
+		Poco::Timestamp::TimeDiff created;
+		uint32_t older;
+		uint32_t newer;
+	};
+
+	typedef typename std::aligned_storage<
+		sizeof(Entry), alignof(Entry)>::type Storage;
+	typedef std::unique_ptr<Storage[]> Block;
+
+	size_t mask() const
+	{
+		return m_index.size() - 1;
+	}
+
+	Entry &entry(uint32_t index)
+	{
+		return *reinterpret_cast<Entry *>(
+			&m_blocks[index / BLOCK_SIZE][index % BLOCK_SIZE]);
+	}
+
+	/*
+	 * Position of the given key in the index or NOT_FOUND.
+	 */
+	size_t lookup(const Key &key)
+	{
+		const size_t hash = m_hash(key);
+		size_t pos = hash & mask();
+
+		while (m_index[pos] != NONE) {
+			Entry &e = entry(m_index[pos]);
+
+			if (e.hash == hash && e.key == key)
+				return pos;
+
+			pos = (pos + 1) & mask();
+		}
+
+		return NOT_FOUND;
+	}
+
+	uint32_t allocate(const Key &key, const T &value,
+		const Poco::Timestamp &now)
+	{
+		if (m_free.empty()) {
+			const uint32_t first = m_blocks.size() * BLOCK_SIZE;
+			m_blocks.emplace_back(new Storage[BLOCK_SIZE]);
+
+			for (uint32_t i = BLOCK_SIZE; i > 0; --i)
+				m_free.push_back(first + i - 1);
+		}
+
+		const uint32_t index = m_free.back();
+		m_free.pop_back();
+
+		Entry *e = reinterpret_cast<Entry *>(
+			&m_blocks[index / BLOCK_SIZE][index % BLOCK_SIZE]);
+		new (e) Entry{key, value, m_hash(key), now.epochMicroseconds(), NONE, NONE};
+
+		return index;
+	}
+
+	void link(uint32_t index)
+	{
+		Entry &e = entry(index);
+
+		e.older = m_newest;
+		e.newer = NONE;
+
+		if (m_newest != NONE)
+			entry(m_newest).newer = index;
+		else
+			m_oldest = index;
+
+		m_newest = index;
+	}
+
+	void unlink(uint32_t index)
+	{
+		Entry &e = entry(index);
+
+		if (e.older != NONE)
+			entry(e.older).newer = e.newer;
+		else
+			m_oldest = e.newer;
+
+		if (e.newer != NONE)
+			entry(e.newer).older = e.older;
+		else
+			m_newest = e.older;
+	}
+
+	/*
+	 * Remove the entry from the index, the age list and release it.
+	 * The following entries of the same cluster are shifted back
+	 * to keep the probing sequences without holes.
+	 */
+	void erase(uint32_t index)
+	{
+		Entry &e = entry(index);
+		size_t hole = e.hash & mask();
+
+		while (m_index[hole] != index)
+			hole = (hole + 1) & mask();
+
+		m_index[hole] = NONE;
+
+		for (size_t pos = (hole + 1) & mask();
+				m_index[pos] != NONE; pos = (pos + 1) & mask()) {
+			const size_t ideal = entry(m_index[pos]).hash & mask();
+
+			// move back unless the ideal position is in (hole, pos]
+			if (((pos - ideal) & mask()) >= ((pos - hole) & mask())) {
+				m_index[hole] = m_index[pos];
+				m_index[pos] = NONE;
+				hole = pos;
+			}
+		}
+
+		unlink(index);
+		e.~Entry();
+		m_free.push_back(index);
+		m_size--;
+	}
+
+	void rehash(size_t size)
+	{
+		m_index.assign(size, NONE);
+
+		for (uint32_t index = m_oldest; index != NONE;
+				index = entry(index).newer) {
+			size_t pos = entry(index).hash & mask();
+
+			while (m_index[pos] != NONE)
+				pos = (pos + 1) & mask();
+
+			m_index[pos] = index;
+		}
+	}
+
+private:
+	Poco::Timespan m_ttl;
+	size_t m_capacity;
+	Hash m_hash;
+	std::vector<Block> m_blocks;
+	std::vector<uint32_t> m_free;
+	std::vector<uint32_t> m_index;
+	uint32_t m_oldest;
+	uint32_t m_newest;
+	size_t m_size;
+};
+
+template <typename Key, typename T, typename Hash>
+const uint32_t CorrelationRegistry<Key, T, Hash>::NONE;
+
+template <typename Key, typename T, typename Hash>
+const size_t CorrelationRegistry<Key, T, Hash>::NOT_FOUND;
+
+}
+
+#endif
@@ -0,0 +1,49 @@
+#include <cstdint>
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <Poco/Exception.h>
+
+#include "util/FdEvent.h"
+
+using namespace BeeeOn;
+using namespace Poco;
+using namespace std;
+
+FdEvent::FdEvent():
+	m_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+	if (m_fd < 0) {
+		throw IOException("failed to create eventfd: "
+			+ string(strerror(errno)));
+	}
+}
+
+FdEvent::~FdEvent()
+{
+	close(m_fd);
+}
+
+void FdEvent::set()
+{
+	const uint64_t one = 1;
+
+	// EAGAIN means the counter is saturated, the event is signalled anyway
+	while (write(m_fd, &one, sizeof(one)) < 0 && errno == EINTR)
+		;
+}
+
+void FdEvent::reset()
+{
+	uint64_t value;
+
+	while (read(m_fd, &value, sizeof(value)) < 0 && errno == EINTR)
+		;
+}
+
+int FdEvent::fd() const
+{
+	return m_fd;
+}
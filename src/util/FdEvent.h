@@ -0,0 +1,43 @@
+#ifndef BEEEON_FD_EVENT_H
+#define BEEEON_FD_EVENT_H
+
+namespace BeeeOn {
+
+/*
+ * Event backed by a file descriptor (eventfd). Unlike Poco::Event it
+ * can be watched by poll() or zmq_poll() together with other sockets,
+ * so a single loop can block on network traffic and on internal
+ * notifications at once.
+ *
+ * The event stays signalled until reset() is called. Multiple calls
+ * of set() before reset() are merged into a single wake-up.
+ */
+class FdEvent {
+public:
+	FdEvent();
+	~FdEvent();
+
+	FdEvent(const FdEvent &) = delete;
+
+	/*
+	 * Signal the event. The file descriptor becomes readable.
+	 */
+	void set();
+
+	/*
+	 * Consume all pending signals. The method is non-blocking.
+	 */
+	void reset();
+
+	/*
+	 * File descriptor to be watched for POLLIN.
+	 */
+	int fd() const;
+
+private:
+	int m_fd;
+};
+
+}
+
+#endif
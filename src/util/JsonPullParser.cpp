@@ -0,0 +1,351 @@
+#include <Poco/Exception.h>
+
+#include "util/JsonPullParser.h"
+
+using namespace BeeeOn;
+using namespace Poco;
+using namespace std;
+
+JsonPullParser::JsonPullParser(const char *data, size_t length):
+	m_begin(data),
+	m_pos(data),
+	m_end(data + length),
+	m_expectKey(false),
+	m_needComma(false),
+	m_afterComma(false)
+{
+	m_stack.reserve(8);
+}
+
+JsonPullParser::Token JsonPullParser::next()
+{
+	for (;;) {
+		skipWhitespace();
+
+		if (m_pos == m_end) {
+			if (!m_stack.empty())
+				fail("unexpected end of input");
+
+			return TOKEN_END;
+		}
+
+		switch (*m_pos) {
+		case ',':
+			if (m_stack.empty() || !m_needComma)
+				fail("unexpected ','");
+
+			++m_pos;
+			m_needComma = false;
+			m_afterComma = true;
+			m_expectKey = m_stack.back() == '{';
+			continue;
+
+		case '{':
+			beginValue();
+			++m_pos;
+			m_stack.push_back('{');
+			m_expectKey = true;
+			return TOKEN_BEGIN_OBJECT;
+
+		case '}':
+			if (m_stack.empty() || m_stack.back() != '{')
+				fail("unexpected '}'");
+
+			if (m_afterComma || (!m_expectKey && !m_needComma))
+				fail("missing value");
+
+			++m_pos;
+			m_stack.pop_back();
+			endValue();
+			return TOKEN_END_OBJECT;
+
+		case '[':
+			beginValue();
+			++m_pos;
+			m_stack.push_back('[');
+			return TOKEN_BEGIN_ARRAY;
+
+		case ']':
+			if (m_stack.empty() || m_stack.back() != '[')
+				fail("unexpected ']'");
+
+			if (m_afterComma)
+				fail("missing value");
+
+			++m_pos;
+			m_stack.pop_back();
+			endValue();
+			return TOKEN_END_ARRAY;
+
+		case '"':
+			if (m_expectKey) {
+				if (m_needComma)
+					fail("missing ','");
+
+				parseString();
+				m_expectKey = false;
+				m_afterComma = false;
+
+				skipWhitespace();
+				if (m_pos == m_end || *m_pos != ':')
+					fail("missing ':'");
+
+				++m_pos;
+				return TOKEN_KEY;
+			}
+
+			beginValue();
+			parseString();
+			endValue();
+			return TOKEN_STRING;
+
+		case 't':
+			beginValue();
+			parseLiteral("true");
+			endValue();
+			return TOKEN_TRUE;
+
+		case 'f':
+			beginValue();
+			parseLiteral("false");
+			endValue();
+			return TOKEN_FALSE;
+
+		case 'n':
+			beginValue();
+			parseLiteral("null");
+			endValue();
+			return TOKEN_NULL;
+
+		default:
+			if (*m_pos == '-' || (*m_pos >= '0' && *m_pos <= '9')) {
+				beginValue();
+				parseNumber();
+				endValue();
+				return TOKEN_NUMBER;
+			}
+
+			fail(string("unexpected character '") + *m_pos + "'");
+		}
+	}
+}
+
+void JsonPullParser::expect(Token token)
+{
+	if (next() != token)
+		fail("unexpected token");
+}
+
+void JsonPullParser::skipValue()
+{
+	unsigned int depth = 0;
+
+	do {
+		switch (next()) {
+		case TOKEN_BEGIN_OBJECT:
+		case TOKEN_BEGIN_ARRAY:
+			++depth;
+			break;
+		case TOKEN_END_OBJECT:
+		case TOKEN_END_ARRAY:
+			if (depth == 0)
+				fail("no value to skip");
+
+			--depth;
+			break;
+		case TOKEN_KEY:
+			if (depth == 0)
+				fail("no value to skip");
+			break;
+		case TOKEN_END:
+			fail("unexpected end of input");
+		default:
+			break;
+		}
+	} while (depth > 0);
+}
+
+void JsonPullParser::skipWhitespace()
+{
+	while (m_pos != m_end) {
+		switch (*m_pos) {
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+			++m_pos;
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+void JsonPullParser::beginValue()
+{
+	if (m_expectKey)
+		fail("expected key");
+
+	if (m_needComma)
+		fail("missing ','");
+
+	m_afterComma = false;
+}
+
+void JsonPullParser::endValue()
+{
+	m_needComma = !m_stack.empty();
+}
+
+void JsonPullParser::parseString()
+{
+	m_text.clear();
+	++m_pos; // opening quote
+
+	while (m_pos != m_end) {
+		const char c = *m_pos++;
+
+		if (c == '"')
+			return;
+
+		if (c != '\\') {
+			if ((unsigned char) c < 0x20)
+				fail("control character in string");
+
+			m_text += c;
+			continue;
+		}
+
+		if (m_pos == m_end)
+			break;
+
+		switch (*m_pos++) {
+		case '"':
+			m_text += '"';
+			break;
+		case '\\':
+			m_text += '\\';
+			break;
+		case '/':
+			m_text += '/';
+			break;
+		case 'b':
+			m_text += '\b';
+			break;
+		case 'f':
+			m_text += '\f';
+			break;
+		case 'n':
+			m_text += '\n';
+			break;
+		case 'r':
+			m_text += '\r';
+			break;
+		case 't':
+			m_text += '\t';
+			break;
+		case 'u': {
+			unsigned int codePoint = parseHex4();
+
+			if (codePoint >= 0xd800 && codePoint <= 0xdbff) {
+				if (m_end - m_pos < 6 || m_pos[0] != '\\' || m_pos[1] != 'u')
+					fail("invalid surrogate pair");
+
+				m_pos += 2;
+				const unsigned int low = parseHex4();
+				if (low < 0xdc00 || low > 0xdfff)
+					fail("invalid surrogate pair");
+
+				codePoint = 0x10000 + ((codePoint - 0xd800) << 10)
+					+ (low - 0xdc00);
+			}
+
+			appendUTF8(codePoint);
+			break;
+		}
+		default:
+			fail("invalid escape sequence");
+		}
+	}
+
+	fail("unterminated string");
+}
+
+void JsonPullParser::parseNumber()
+{
+	const char *start = m_pos;
+
+	while (m_pos != m_end) {
+		const char c = *m_pos;
+
+		if ((c >= '0' && c <= '9') || c == '-' || c == '+'
+				|| c == '.' || c == 'e' || c == 'E') {
+			++m_pos;
+			continue;
+		}
+
+		break;
+	}
+
+	m_text.assign(start, m_pos - start);
+}
+
+void JsonPullParser::parseLiteral(const char *literal)
+{
+	for (; *literal != '\0'; ++literal, ++m_pos) {
+		if (m_pos == m_end || *m_pos != *literal)
+			fail("invalid literal");
+	}
+}
+
+void JsonPullParser::appendUTF8(unsigned int codePoint)
+{
+	if (codePoint < 0x80) {
+		m_text += (char) codePoint;
+	}
+	else if (codePoint < 0x800) {
+		m_text += (char) (0xc0 | (codePoint >> 6));
+		m_text += (char) (0x80 | (codePoint & 0x3f));
+	}
+	else if (codePoint < 0x10000) {
+		m_text += (char) (0xe0 | (codePoint >> 12));
+		m_text += (char) (0x80 | ((codePoint >> 6) & 0x3f));
+		m_text += (char) (0x80 | (codePoint & 0x3f));
+	}
+	else {
+		m_text += (char) (0xf0 | (codePoint >> 18));
+		m_text += (char) (0x80 | ((codePoint >> 12) & 0x3f));
+		m_text += (char) (0x80 | ((codePoint >> 6) & 0x3f));
+		m_text += (char) (0x80 | (codePoint & 0x3f));
+	}
+}
+
+unsigned int JsonPullParser::parseHex4()
+{
+	unsigned int value = 0;
+
+	for (int i = 0; i < 4; ++i, ++m_pos) {
+		if (m_pos == m_end)
+			fail("invalid unicode escape");
+
+		const char c = *m_pos;
+		value <<= 4;
+
+		if (c >= '0' && c <= '9')
+			value |= c - '0';
+		else if (c >= 'a' && c <= 'f')
+			value |= c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			value |= c - 'A' + 10;
+		else
+			fail("invalid unicode escape");
+	}
+
+	return value;
+}
+
+void JsonPullParser::fail(const string &message) const
+{
+	throw SyntaxException(message + " at offset "
+		+ to_string(m_pos - m_begin));
+}
@@ -0,0 +1,101 @@
+#ifndef BEEEON_JSON_PULL_PARSER_H
+#define BEEEON_JSON_PULL_PARSER_H
+
+#include <string>
+#include <vector>
+
+namespace BeeeOn {
+
+/*
+ * Minimal streaming (pull) JSON parser. It reads the given buffer
+ * token by token and does not build any DOM. Keys, strings and
+ * numbers are decoded into a single internal buffer available via
+ * text() until the next call of next().
+ *
+ * Example:
+ *     JsonPullParser parser(data, size);
+ *
+ *     if (parser.next() != JsonPullParser::TOKEN_BEGIN_OBJECT)
+ *         throw ...;
+ *
+ *     while (parser.next() == JsonPullParser::TOKEN_KEY) {
+ *         if (parser.text() == "interesting")
+ *             ...
+ *         else
+ *             parser.skipValue();
+ *     }
+ *
+ * The parser throws Poco::SyntaxException on malformed input.
+ * The buffer must stay valid while the parser is used.
+ */
+class JsonPullParser {
+public:
+	enum Token {
+		TOKEN_BEGIN_OBJECT,
+		TOKEN_END_OBJECT,
+		TOKEN_BEGIN_ARRAY,
+		TOKEN_END_ARRAY,
+		TOKEN_KEY,
+		TOKEN_STRING,
+		TOKEN_NUMBER,
+		TOKEN_TRUE,
+		TOKEN_FALSE,
+		TOKEN_NULL,
+		TOKEN_END,
+	};
+
+	JsonPullParser(const char *data, size_t length);
+
+	/*
+	 * Reads the next token.
+	 */
+	Token next();
+
+	/*
+	 * Decoded text of the last TOKEN_KEY, TOKEN_STRING
+	 * or TOKEN_NUMBER.
+	 */
+	const std::string &text() const
+	{
+		return m_text;
+	}
+
+	/*
+	 * Reads the next token and throws Poco::SyntaxException
+	 * if it is not the expected one.
+	 */
+	void expect(Token token);
+
+	/*
+	 * Skips the next value (after TOKEN_KEY or inside an array)
+	 * including all its nested values.
+	 */
+	void skipValue();
+
+private:
+	void skipWhitespace();
+	void beginValue();
+	void endValue();
+
+	void parseString();
+	void parseNumber();
+	void parseLiteral(const char *literal);
+	void appendUTF8(unsigned int codePoint);
+	unsigned int parseHex4();
+
+	void fail(const std::string &message) const;
+
+private:
+	const char *m_begin;
+	const char *m_pos;
+	const char *m_end;
+	std::vector<char> m_stack;
+	bool m_expectKey;
+	bool m_needComma;
+	bool m_afterComma;
+	std::string m_text;
+};
+
+}
+
+#endif
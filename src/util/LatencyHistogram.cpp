@@ -0,0 +1,121 @@
+#include <cmath>
+
+#include "util/LatencyHistogram.h"
+
+/*
+ * Values below SUB_COUNT are recorded exactly. Every greater power
+ * of two is divided into HALF_COUNT buckets.
+ */
+#define SUB_BITS 7
+#define SUB_COUNT (1u << SUB_BITS)
+#define HALF_COUNT (SUB_COUNT / 2)
+#define BUCKET_COUNT (SUB_COUNT + (64 - SUB_BITS) * HALF_COUNT)
+
+using namespace BeeeOn;
+
+LatencyHistogram::LatencyHistogram():
+	m_buckets(BUCKET_COUNT, 0)
+{
+	reset();
+}
+
+unsigned int LatencyHistogram::bucketOf(uint64_t value)
+{
+	if (value < SUB_COUNT)
+		return value;
+
+	const unsigned int msb = 63 - __builtin_clzll(value);
+	const unsigned int shift = msb - SUB_BITS + 1;
+	const unsigned int mantissa = value >> shift;
+
+	return SUB_COUNT + (shift - 1) * HALF_COUNT + (mantissa - HALF_COUNT);
+}
+
+uint64_t LatencyHistogram::upperBound(unsigned int bucket)
+{
+	if (bucket < SUB_COUNT)
+		return bucket;
+
+	const unsigned int shift = (bucket - SUB_COUNT) / HALF_COUNT + 1;
+	const uint64_t mantissa = (bucket - SUB_COUNT) % HALF_COUNT + HALF_COUNT;
+
+	return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value)
+{
+	m_buckets[bucketOf(value)] += 1;
+	m_count += 1;
+	m_sum += value;
+
+	if (value < m_min)
+		m_min = value;
+	if (value > m_max)
+		m_max = value;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+	for (unsigned int i = 0; i < BUCKET_COUNT; ++i)
+		m_buckets[i] += other.m_buckets[i];
+
+	m_count += other.m_count;
+	m_sum += other.m_sum;
+
+	if (other.m_min < m_min)
+		m_min = other.m_min;
+	if (other.m_max > m_max)
+		m_max = other.m_max;
+}
+
+void LatencyHistogram::reset()
+{
+	m_buckets.assign(BUCKET_COUNT, 0);
+	m_count = 0;
+	m_min = UINT64_MAX;
+	m_max = 0;
+	m_sum = 0;
+}
+
+uint64_t LatencyHistogram::count() const
+{
+	return m_count;
+}
+
+uint64_t LatencyHistogram::min() const
+{
+	return m_count == 0 ? 0 : m_min;
+}
+
+uint64_t LatencyHistogram::max() const
+{
+	return m_max;
+}
+
+double LatencyHistogram::mean() const
+{
+	return m_count == 0 ? 0 : m_sum / m_count;
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const
+{
+	if (m_count == 0)
+		return 0;
+
+	uint64_t rank = std::ceil(percent / 100 * m_count);
+	if (rank < 1)
+		rank = 1;
+
+	uint64_t seen = 0;
+
+	for (unsigned int i = 0; i < BUCKET_COUNT; ++i) {
+		seen += m_buckets[i];
+
+		if (seen >= rank) {
+			const uint64_t bound = upperBound(i);
+			return bound < m_max ? bound : m_max;
+		}
+	}
+
+	return m_max;
+}
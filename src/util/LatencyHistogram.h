@@ -0,0 +1,59 @@
+#ifndef BEEEON_LATENCY_HISTOGRAM_H
+#define BEEEON_LATENCY_HISTOGRAM_H
+
+#include <cstdint>
+#include <vector>
+
+namespace BeeeOn {
+
+/*
+ * Histogram of latencies (or any other non-negative integer values)
+ * with a bounded relative error. Values less than 128 are recorded
+ * exactly, greater values fall into buckets of 64 sub-buckets per
+ * power of two, so the relative error is below 1/64 (~1.6 %).
+ * Recording is O(1) and the memory is constant (~30 kB) regardless
+ * of the number of the recorded values.
+ *
+ * The histogram is not thread-safe.
+ */
+class LatencyHistogram {
+public:
+	LatencyHistogram();
+
+	void record(uint64_t value);
+
+	/*
+	 * Add all values recorded by the other histogram.
+	 */
+	void merge(const LatencyHistogram &other);
+
+	void reset();
+
+	uint64_t count() const;
+	uint64_t min() const;
+	uint64_t max() const;
+	double mean() const;
+
+	/*
+	 * The least value such that the given percentage (0 - 100)
+	 * of the recorded values is less or equal to it. It is rounded
+	 * up to the upper bound of its bucket but never exceeds max().
+	 * Returns 0 for an empty histogram.
+	 */
+	uint64_t percentile(double percent) const;
+
+protected:
+	static unsigned int bucketOf(uint64_t value);
+	static uint64_t upperBound(unsigned int bucket);
+
+private:
+	std::vector<uint64_t> m_buckets;
+	uint64_t m_count;
+	uint64_t m_min;
+	uint64_t m_max;
+	double m_sum;
+};
+
+}
+
+#endif
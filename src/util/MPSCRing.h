@@ -0,0 +1,139 @@
+#ifndef BEEEON_MPSC_RING_H
+#define BEEEON_MPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include <Poco/Exception.h>
+
+namespace BeeeOn {
+
+/*
+ * Bounded lock-free ring buffer of values for multiple producer
+ * threads and a single consumer thread. The items are copied into
+ * preallocated slots, thus no allocation is done per item.
+ *
+ * Every slot has a sequence number telling whether it is free for
+ * the producer of the given position or filled for the consumer.
+ * Producers claim positions by compare-and-swap of the tail, the
+ * consumer is the only one moving the head.
+ *
+ * The capacity is rounded up to a power of 2, at least 2. With a single
+ * slot, the sequence of a filled slot would equal the one expected by
+ * the next producer and the item would be overwritten.
+ */
+template <typename T>
+class MPSCRing {
+public:
+	MPSCRing(size_t capacity):
+		m_head(0),
+		m_tail(0)
+	{
+		if (capacity == 0)
+			throw Poco::InvalidArgumentException("capacity must be positive");
+
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+
+		m_slots = std::vector<Slot>(size);
+		m_mask = size - 1;
+
+		for (size_t i = 0; i < size; ++i)
+			m_slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	MPSCRing(const MPSCRing &) = delete;
+
+	size_t capacity() const
+	{
+		return m_slots.size();
+	}
+
+	/*
+	 * Count of queued items, it is only approximate while
+	 * the ring is being used.
+	 */
+	size_t size() const
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		const size_t head = m_head.load(std::memory_order_relaxed);
+
+		return tail > head ? tail - head : 0;
+	}
+
+	/*
+	 * Called by any producer. Returns false when the ring is full,
+	 * the item is not queued then.
+	 */
+	bool push(const T &item)
+	{
+		size_t pos = m_tail.load(std::memory_order_relaxed);
+
+		while (true) {
+			Slot &slot = m_slots[pos & m_mask];
+			const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			const ptrdiff_t diff = (ptrdiff_t) sequence - (ptrdiff_t) pos;
+
+			if (diff == 0) {
+				if (m_tail.compare_exchange_weak(pos, pos + 1,
+						std::memory_order_relaxed)) {
+					slot.item = item;
+					slot.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				pos = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/*
+	 * Called by the consumer. Returns false when the ring is empty.
+	 */
+	bool pop(T &item)
+	{
+		const size_t pos = m_head.load(std::memory_order_relaxed);
+		Slot &slot = m_slots[pos & m_mask];
+
+		if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+			return false;
+
+		item = slot.item;
+		slot.sequence.store(pos + m_slots.size(), std::memory_order_release);
+		m_head.store(pos + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+private:
+	struct Slot {
+		Slot():
+			sequence(0)
+		{
+		}
+
+		Slot(const Slot &other):
+			sequence(other.sequence.load()),
+			item(other.item)
+		{
+		}
+
+		std::atomic<size_t> sequence;
+		T item;
+	};
+
+private:
+	std::vector<Slot> m_slots;
+	size_t m_mask;
+	alignas(64) std::atomic<size_t> m_head;
+	alignas(64) std::atomic<size_t> m_tail;
+};
+
+}
+
+#endif
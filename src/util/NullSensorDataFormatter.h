@@ -20,6 +20,8 @@ public:
 
 	static SensorDataFormatter &instance();
 
+	using SensorDataFormatter::format;
+
 	std::string format(const SensorData &data) override;
 };
 
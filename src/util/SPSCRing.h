@@ -0,0 +1,122 @@
+#ifndef BEEEON_SPSC_RING_H
+#define BEEEON_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include <Poco/Exception.h>
+
+namespace BeeeOn {
+
+/*
+ * Bounded lock-free ring buffer of pointers for a single producer
+ * and a single consumer thread. A slot holding NULL is free, so
+ * the producer and the consumer never share their positions,
+ * each of them only checks the slot it is going to use next.
+ *
+ * The head and the tail are counters of positions. The head is claimed
+ * by compare-and-swap, thus the producer can take the oldest item from
+ * a full ring (see pushReplacingOldest()) without racing with
+ * the consumer.
+ *
+ * The ring owns the queued items and deletes the remaining ones
+ * when destroyed.
+ */
+template <typename T>
+class SPSCRing {
+public:
+	SPSCRing(size_t capacity):
+		m_slots(capacity),
+		m_head(0),
+		m_tail(0)
+	{
+		if (capacity == 0)
+			throw Poco::InvalidArgumentException("capacity must be positive");
+
+		for (auto &slot : m_slots)
+			slot.store(NULL);
+	}
+
+	~SPSCRing()
+	{
+		for (auto &slot : m_slots)
+			delete slot.exchange(NULL);
+	}
+
+	SPSCRing(const SPSCRing &) = delete;
+
+	size_t capacity() const
+	{
+		return m_slots.size();
+	}
+
+	/*
+	 * Called by the producer. Returns false when the ring is full,
+	 * the item is not queued then.
+	 */
+	bool push(T *item)
+	{
+		std::atomic<T *> &slot = m_slots[m_tail.load() % m_slots.size()];
+
+		if (slot.load() != NULL)
+			return false;
+
+		slot.store(item);
+		m_tail.store(m_tail.load() + 1);
+		return true;
+	}
+
+	/*
+	 * Called by the producer. The item is always queued, when the ring
+	 * is full, the oldest item is removed first and returned to be
+	 * disposed by the caller. Returns NULL when nothing was removed.
+	 *
+	 * The order of the queued items is kept, the oldest item is
+	 * claimed like by pop() and the item is appended after the others.
+	 */
+	T *pushReplacingOldest(T *item)
+	{
+		while (!push(item)) {
+			size_t head = m_head.load();
+
+			// the consumer has claimed a slot and is just freeing it
+			if (m_tail.load() - head < m_slots.size())
+				continue;
+
+			if (m_head.compare_exchange_strong(head, head + 1)) {
+				T *oldest = m_slots[head % m_slots.size()].exchange(NULL);
+				push(item);
+				return oldest;
+			}
+		}
+
+		return NULL;
+	}
+
+	/*
+	 * Called by the consumer. Returns NULL when the ring is empty.
+	 */
+	T *pop()
+	{
+		while (true) {
+			size_t head = m_head.load();
+
+			if (head == m_tail.load())
+				return NULL;
+
+			// the producer may have taken the oldest item meanwhile
+			if (m_head.compare_exchange_weak(head, head + 1))
+				return m_slots[head % m_slots.size()].exchange(NULL);
+		}
+	}
+
+private:
+	std::vector<std::atomic<T *>> m_slots;
+	alignas(64) std::atomic<size_t> m_head;
+	alignas(64) std::atomic<size_t> m_tail;
+};
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include "SensorDataFormatter.h"
 
 using namespace BeeeOn;
+using namespace std;
 
 SensorDataFormatter::SensorDataFormatter()
 {
@@ -10,3 +11,16 @@ SensorDataFormatter::SensorDataFormatter()
 SensorDataFormatter::~SensorDataFormatter()
 {
 }
+
+void SensorDataFormatter::format(const SensorData &data, string &buffer)
+{
+	buffer += format(data);
+}
+
+void SensorDataFormatter::flush(string &)
+{
+}
+
+void SensorDataFormatter::flushExpired(string &)
+{
+}
@@ -16,6 +16,28 @@ public:
 	 * Convert data from struct SensorData to some formatted text
 	 */
 	virtual std::string format(const SensorData &data) = 0;
+
+	/**
+	 * Append the formatted data to the given buffer. This allows
+	 * to reuse a single buffer for many calls. The default
+	 * implementation appends the result of format(data).
+	 */
+	virtual void format(const SensorData &data, std::string &buffer);
+
+	/**
+	 * Append data held by the formatter to the given buffer. Formatters
+	 * producing blocks of multiple SensorData might hold the data until
+	 * a block is complete. The default implementation does nothing.
+	 */
+	virtual void flush(std::string &buffer);
+
+	/**
+	 * Append data held by the formatter for too long to the given
+	 * buffer. Exporters call it periodically, so that the held data
+	 * are not delayed until the next format(). The default
+	 * implementation does nothing.
+	 */
+	virtual void flushExpired(std::string &buffer);
 };
 
 }
@@ -0,0 +1,463 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <Poco/ByteOrder.h>
+#include <Poco/Checksum.h>
+#include <Poco/Exception.h>
+
+#include "util/SpoolLog.h"
+
+#define SEGMENT_SUFFIX ".spool"
+#define CONSUMED_FLAG 0x80000000u
+#define LENGTH_MASK 0x7fffffffu
+
+using namespace BeeeOn;
+using namespace Poco;
+using namespace std;
+
+static uint32_t loadUInt32(const char *data)
+{
+	UInt32 value;
+	memcpy(&value, data, sizeof(value));
+	return ByteOrder::fromLittleEndian(value);
+}
+
+static void storeUInt32(char *data, uint32_t value)
+{
+	const UInt32 raw = ByteOrder::toLittleEndian(static_cast<UInt32>(value));
+	memcpy(data, &raw, sizeof(raw));
+}
+
+static uint32_t crc32(const char *data, size_t length)
+{
+	Checksum checksum(Checksum::TYPE_CRC32);
+	checksum.update(data, length);
+	return checksum.checksum();
+}
+
+static size_t pageAlignDown(size_t offset)
+{
+	static const size_t pageSize = sysconf(_SC_PAGESIZE);
+	return offset - offset % pageSize;
+}
+
+static void throwErrno(const string &message)
+{
+	throw IOException(message + ": " + strerror(errno));
+}
+
+SpoolLog::SpoolLog():
+	m_segmentSize(0),
+	m_maxSegments(0),
+	m_write({0, -1, NULL, 0}),
+	m_writeOffset(0),
+	m_writeSynced(0),
+	m_read({0, -1, NULL, 0}),
+	m_readOffset(0),
+	m_readSynced(0),
+	m_peekOffset(0),
+	m_droppedSegments(0),
+	m_corruptedRecords(0)
+{
+}
+
+SpoolLog::~SpoolLog()
+{
+	try {
+		close();
+	}
+	catch (...) {
+		release();
+	}
+}
+
+size_t SpoolLog::recordSize(size_t length)
+{
+	return RECORD_HEADER_SIZE
+		+ (length + RECORD_ALIGN - 1) / RECORD_ALIGN * RECORD_ALIGN;
+}
+
+string SpoolLog::segmentPath(uint64_t sequence) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx" SEGMENT_SUFFIX,
+		static_cast<unsigned long long>(sequence));
+
+	return m_directory + "/" + name;
+}
+
+void SpoolLog::open(const string &directory,
+		size_t segmentSize, size_t maxSegments)
+{
+	if (segmentSize < 2 * RECORD_HEADER_SIZE)
+		throw InvalidArgumentException("segment size is too small");
+
+	if (maxSegments == 1)
+		throw InvalidArgumentException("at least 2 segments are needed");
+
+	close();
+
+	m_directory = directory;
+	m_segmentSize = segmentSize;
+	m_maxSegments = maxSegments;
+
+	if (mkdir(m_directory.c_str(), S_IRWXU) < 0 && errno != EEXIST)
+		throwErrno("failed to create spool " + m_directory);
+
+	DIR *dir = opendir(m_directory.c_str());
+	if (dir == NULL)
+		throwErrno("failed to open spool " + m_directory);
+
+	const size_t suffix = strlen(SEGMENT_SUFFIX);
+	struct dirent *entry;
+
+	while ((entry = readdir(dir)) != NULL) {
+		const string name = entry->d_name;
+
+		if (name.size() <= suffix
+				|| name.compare(name.size() - suffix, suffix, SEGMENT_SUFFIX))
+			continue;
+
+		char *end;
+		const unsigned long long sequence = strtoull(name.c_str(), &end, 16);
+
+		if (end == name.c_str() + name.size() - suffix)
+			m_sequences.push_back(sequence);
+	}
+
+	closedir(dir);
+	sort(m_sequences.begin(), m_sequences.end());
+
+	try {
+		if (m_sequences.empty()) {
+			m_sequences.push_back(0);
+			mapSegment(m_write, 0, true);
+		}
+		else {
+			mapSegment(m_write, m_sequences.back(), false);
+		}
+
+		// the data after a torn record must not be considered valid
+		// when a shorter record is appended there
+		m_writeOffset = scanEnd(m_write, 0);
+		memset(m_write.data + m_writeOffset, 0, m_write.size - m_writeOffset);
+		m_writeSynced = 0;
+
+		mapSegment(m_read, m_sequences.front(), false);
+		m_readOffset = 0;
+		m_readSynced = 0;
+		m_peekOffset = 0;
+	}
+	catch (...) {
+		release();
+		throw;
+	}
+}
+
+void SpoolLog::close()
+{
+	if (isOpen())
+		sync();
+
+	release();
+}
+
+void SpoolLog::release()
+{
+	unmapSegment(m_read);
+	unmapSegment(m_write);
+	m_sequences.clear();
+	m_writeOffset = 0;
+	m_readOffset = 0;
+	m_peekOffset = 0;
+}
+
+bool SpoolLog::isOpen() const
+{
+	return m_write.data != NULL;
+}
+
+void SpoolLog::mapSegment(Segment &segment, uint64_t sequence, bool create)
+{
+	const string path = segmentPath(sequence);
+	const int flags = O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0);
+
+	const int fd = ::open(path.c_str(), flags, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		throwErrno("failed to open segment " + path);
+
+	size_t size = m_segmentSize;
+
+	if (create) {
+		// allocate all blocks now, so writing via the mapping
+		// cannot fail with SIGBUS when the storage is full
+		const int ret = posix_fallocate(fd, 0, size);
+
+		if (ret != 0) {
+			::close(fd);
+			unlink(path.c_str());
+			errno = ret;
+			throwErrno("failed to allocate segment " + path);
+		}
+
+		// make the new file durable in the directory
+		const int dirfd = ::open(m_directory.c_str(), O_RDONLY | O_CLOEXEC);
+		if (dirfd >= 0) {
+			fsync(dirfd);
+			::close(dirfd);
+		}
+	}
+	else {
+		struct stat st;
+
+		if (fstat(fd, &st) < 0) {
+			::close(fd);
+			throwErrno("failed to stat segment " + path);
+		}
+
+		size = st.st_size;
+	}
+
+	if (size < RECORD_HEADER_SIZE) {
+		::close(fd);
+		throw IOException("segment " + path + " is truncated");
+	}
+
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		::close(fd);
+		throwErrno("failed to map segment " + path);
+	}
+
+	unmapSegment(segment);
+
+	segment.sequence = sequence;
+	segment.fd = fd;
+	segment.data = static_cast<char *>(data);
+	segment.size = size;
+}
+
+void SpoolLog::unmapSegment(Segment &segment)
+{
+	if (segment.data != NULL)
+		munmap(segment.data, segment.size);
+
+	if (segment.fd >= 0)
+		::close(segment.fd);
+
+	segment.data = NULL;
+	segment.fd = -1;
+	segment.size = 0;
+}
+
+void SpoolLog::syncRange(const Segment &segment, size_t begin, size_t end)
+{
+	if (begin >= end)
+		return;
+
+	const size_t aligned = pageAlignDown(begin);
+
+	if (msync(segment.data + aligned, end - aligned, MS_SYNC) < 0)
+		throwErrno("failed to sync segment " + segmentPath(segment.sequence));
+}
+
+bool SpoolLog::readHeader(const Segment &segment, size_t offset,
+		uint32_t &length, bool &consumed)
+{
+	if (offset + RECORD_HEADER_SIZE > segment.size)
+		return false;
+
+	const uint32_t raw = loadUInt32(segment.data + offset);
+
+	length = raw & LENGTH_MASK;
+	consumed = (raw & CONSUMED_FLAG) != 0;
+
+	if (length == 0)
+		return false;
+
+	if (offset + recordSize(length) > segment.size
+			|| loadUInt32(segment.data + offset + 4)
+				!= crc32(segment.data + offset + RECORD_HEADER_SIZE, length)) {
+		m_corruptedRecords += 1;
+		return false;
+	}
+
+	return true;
+}
+
+size_t SpoolLog::scanEnd(const Segment &segment, size_t offset)
+{
+	uint32_t length;
+	bool consumed;
+
+	while (readHeader(segment, offset, length, consumed))
+		offset += recordSize(length);
+
+	return offset;
+}
+
+bool SpoolLog::sameSegment() const
+{
+	return m_read.sequence == m_write.sequence;
+}
+
+void SpoolLog::append(const char *data, size_t length)
+{
+	const size_t size = recordSize(length);
+
+	if (length == 0 || length > LENGTH_MASK
+			|| size + RECORD_HEADER_SIZE > m_segmentSize)
+		throw RangeException("record of size " + to_string(length)
+			+ " does not fit into a segment");
+
+	// keep space for the terminating zero length
+	if (m_writeOffset + size + RECORD_HEADER_SIZE > m_write.size)
+		rotate();
+
+	char *record = m_write.data + m_writeOffset;
+
+	memcpy(record + RECORD_HEADER_SIZE, data, length);
+	memset(record + RECORD_HEADER_SIZE + length, 0,
+		size - RECORD_HEADER_SIZE - length);
+	storeUInt32(record + 4, crc32(data, length));
+	storeUInt32(record, length);
+
+	m_writeOffset += size;
+}
+
+void SpoolLog::rotate()
+{
+	syncRange(m_write, m_writeSynced, m_writeOffset);
+
+	if (m_maxSegments > 0 && m_sequences.size() >= m_maxSegments)
+		dropOldest();
+
+	const uint64_t sequence = m_write.sequence + 1;
+
+	Segment segment = {0, -1, NULL, 0};
+	mapSegment(segment, sequence, true);
+
+	unmapSegment(m_write);
+	m_write = segment;
+	m_sequences.push_back(sequence);
+	m_writeOffset = 0;
+	m_writeSynced = 0;
+}
+
+void SpoolLog::dropOldest()
+{
+	if (m_sequences.size() < 2)
+		return;
+
+	m_droppedSegments += 1;
+
+	// the read segment is always the oldest one
+	advanceReader();
+}
+
+void SpoolLog::advanceReader()
+{
+	const uint64_t sequence = m_read.sequence;
+
+	unmapSegment(m_read);
+	unlink(segmentPath(sequence).c_str());
+	m_sequences.pop_front();
+
+	mapSegment(m_read, m_sequences.front(), false);
+	m_readOffset = 0;
+	m_readSynced = 0;
+	m_peekOffset = 0;
+}
+
+bool SpoolLog::next(const char *&data, size_t &length)
+{
+	while (true) {
+		uint32_t recordLength;
+		bool consumed;
+
+		const bool end = sameSegment() && m_peekOffset >= m_writeOffset;
+
+		if (!end && readHeader(m_read, m_peekOffset, recordLength, consumed)) {
+			const size_t offset = m_peekOffset;
+			const bool skipped = m_peekOffset == m_readOffset;
+
+			m_peekOffset += recordSize(recordLength);
+
+			if (!consumed) {
+				data = m_read.data + offset + RECORD_HEADER_SIZE;
+				length = recordLength;
+				return true;
+			}
+
+			// consumed in the previous run, nothing to commit
+			if (skipped)
+				m_readOffset = m_peekOffset;
+
+			continue;
+		}
+
+		// the records read so far must be committed before
+		// the segment is deleted
+		if (sameSegment() || m_peekOffset != m_readOffset)
+			return false;
+
+		advanceReader();
+	}
+}
+
+void SpoolLog::commit()
+{
+	uint32_t length;
+	bool consumed;
+
+	while (m_readOffset < m_peekOffset
+			&& readHeader(m_read, m_readOffset, length, consumed)) {
+		if (!consumed)
+			storeUInt32(m_read.data + m_readOffset, length | CONSUMED_FLAG);
+
+		m_readOffset += recordSize(length);
+	}
+
+	m_peekOffset = m_readOffset;
+}
+
+void SpoolLog::rewind()
+{
+	m_peekOffset = m_readOffset;
+}
+
+bool SpoolLog::empty() const
+{
+	return sameSegment() && m_readOffset >= m_writeOffset;
+}
+
+void SpoolLog::sync()
+{
+	syncRange(m_write, m_writeSynced, m_writeOffset);
+	m_writeSynced = pageAlignDown(m_writeOffset);
+
+	syncRange(m_read, m_readSynced, m_readOffset);
+	m_readSynced = pageAlignDown(m_readOffset);
+}
+
+size_t SpoolLog::segments() const
+{
+	return m_sequences.size();
+}
+
+uint64_t SpoolLog::droppedSegments() const
+{
+	return m_droppedSegments;
+}
+
+uint64_t SpoolLog::corruptedRecords() const
+{
+	return m_corruptedRecords;
+}
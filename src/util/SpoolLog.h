@@ -0,0 +1,182 @@
+#ifndef BEEEON_SPOOL_LOG_H
+#define BEEEON_SPOOL_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+namespace BeeeOn {
+
+/*
+ * Durable FIFO of opaque records stored in a directory as a sequence
+ * of segment files of a fixed size. The segments are preallocated and
+ * memory mapped, so appending and consuming of records are plain memory
+ * accesses without any syscall. Syscalls are made only when a segment
+ * is rotated and by sync() that flushes the dirty pages (msync) and is
+ * expected to be called for batches of records.
+ *
+ * The segment file <sequence>.spool contains records at offsets aligned
+ * to 8 bytes. All numbers are little endian:
+ *
+ *  offset  size  description
+ *       0     4  length of the payload (bit 31: consumed)
+ *       4     4  CRC-32 of the payload
+ *       8     N  payload padded by zeros to 8 bytes
+ *
+ * A zero length marks the end of the data in a segment. A record
+ * of an invalid CRC (a torn write) is considered the end of data
+ * as well. The consumed records are marked in place and a segment
+ * is deleted when all its records are consumed.
+ *
+ * Records are read by next() without being consumed. The records
+ * returned by next() are consumed by commit() or returned again after
+ * rewind(). A single read never crosses a segment boundary, next()
+ * returns false at the end of a segment until the records read so far
+ * are committed.
+ *
+ * When open() finds existing segments, the records not consumed
+ * are read again. The consumed marks become durable by sync(), thus
+ * records consumed after the last sync() may be read again after
+ * a crash.
+ *
+ * The class is not thread-safe.
+ */
+class SpoolLog {
+public:
+	enum {
+		RECORD_HEADER_SIZE = 8,
+		RECORD_ALIGN = 8,
+	};
+
+	SpoolLog();
+	~SpoolLog();
+
+	/*
+	 * Open the log stored in the given directory (it is created
+	 * when missing). The segment size is used for the new segments.
+	 * At most maxSegments segments are kept, the oldest ones are
+	 * dropped when exceeded (0 means unlimited).
+	 * Throws Poco::IOException on failure.
+	 */
+	void open(const std::string &directory,
+		size_t segmentSize, size_t maxSegments = 0);
+	void close();
+	bool isOpen() const;
+
+	/*
+	 * Append a record. Throws Poco::RangeException when the record
+	 * does not fit into a segment and Poco::IOException when a new
+	 * segment cannot be created.
+	 */
+	void append(const char *data, size_t length);
+
+	/*
+	 * Read the next record not consumed. The data are valid until
+	 * commit(), rewind() or close(). Returns false when there is no
+	 * record to read now.
+	 */
+	bool next(const char *&data, size_t &length);
+
+	/*
+	 * Consume all records returned by next().
+	 */
+	void commit();
+
+	/*
+	 * Return to the first record not consumed.
+	 */
+	void rewind();
+
+	/*
+	 * True when there is no record to be consumed (records consumed
+	 * since the previous run might be still counted).
+	 */
+	bool empty() const;
+
+	/*
+	 * Flush appended records and consumed marks to the storage.
+	 */
+	void sync();
+
+	size_t segments() const;
+
+	/*
+	 * Number of segments dropped because of maxSegments and number
+	 * of records found corrupted.
+	 */
+	uint64_t droppedSegments() const;
+	uint64_t corruptedRecords() const;
+
+	/*
+	 * Space occupied by a record of the given length.
+	 */
+	static size_t recordSize(size_t length);
+
+private:
+	struct Segment {
+		uint64_t sequence;
+		int fd;
+		char *data;
+		size_t size;
+	};
+
+	std::string segmentPath(uint64_t sequence) const;
+
+	void mapSegment(Segment &segment, uint64_t sequence, bool create);
+	void unmapSegment(Segment &segment);
+
+	/*
+	 * Unmap all segments without syncing.
+	 */
+	void release();
+	void syncRange(const Segment &segment, size_t begin, size_t end);
+
+	/*
+	 * Offset after the last valid record starting from the given one.
+	 */
+	size_t scanEnd(const Segment &segment, size_t offset);
+
+	/*
+	 * Create a new segment for writing.
+	 */
+	void rotate();
+
+	/*
+	 * Delete the read segment and continue with the following one.
+	 */
+	void advanceReader();
+
+	void dropOldest();
+
+	/*
+	 * Header of the record at the given offset, false when there
+	 * is no valid record.
+	 */
+	bool readHeader(const Segment &segment, size_t offset,
+		uint32_t &length, bool &consumed);
+
+	bool sameSegment() const;
+
+private:
+	std::string m_directory;
+	size_t m_segmentSize;
+	size_t m_maxSegments;
+	std::deque<uint64_t> m_sequences;
+
+	Segment m_write;
+	size_t m_writeOffset;
+	size_t m_writeSynced;
+
+	Segment m_read;
+	size_t m_readOffset;
+	size_t m_readSynced;
+	size_t m_peekOffset;
+
+	uint64_t m_droppedSegments;
+	uint64_t m_corruptedRecords;
+};
+
+}
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef BEEEON_TIMING_WHEEL_H
+#define BEEEON_TIMING_WHEEL_H
+
+#include <cstdint>
+#include <vector>
+
+#include <Poco/Timespan.h>
+#include <Poco/Timestamp.h>
+
+namespace BeeeOn {
+
+/*
+ * Hierarchical timing wheel with the resolution of 1 ms. Timers
+ * are scheduled and cancelled in O(1). Level 0 holds timers
+ * expiring within 256 ms, each next level covers 256 times longer
+ * period. When the lower level wraps around, the current slot of
+ * the higher level is cascaded down. Timers beyond the range of
+ * the wheel (about 49 days) are kept in the top level until they
+ * get into the range.
+ *
+ * Each timer carries an item that is returned when the timer
+ * expires, the item must be default constructible. The wheel is
+ * not thread-safe, it is intended to be owned by a single event
+ * loop.
+ */
+template <typename T>
+class TimingWheel {
+public:
+	/*
+	 * Identification of a scheduled timer. The handle contains
+	 * a generation of the timer's slot, so cancelling a timer
+	 * that has already expired or has been cancelled is safe.
+	 */
+	typedef uint64_t Handle;
+
+	static const Handle INVALID = 0;
+
+	TimingWheel(const Poco::Timestamp &now = Poco::Timestamp()):
+		m_now(toTick(now)),
+		m_free(NONE),
+		m_size(0)
+	{
+		for (unsigned int level = 0; level < LEVELS; ++level) {
+			m_count[level] = 0;
+
+			for (unsigned int slot = 0; slot < SLOTS; ++slot)
+				m_slots[level][slot] = NONE;
+		}
+	}
+
+	TimingWheel(const TimingWheel &) = delete;
+
+	/*
+	 * Schedule a timer expiring at the given time. Timers in
+	 * the past expire on the next advance().
+	 */
+	Handle schedule(const Poco::Timestamp &deadline, const T &item)
+	{
+		const uint32_t index = allocate();
+		Node &node = m_nodes[index];
+
+		node.item = item;
+		node.deadline = toTick(deadline);
+
+		if (node.deadline <= m_now)
+			node.deadline = m_now + 1;
+
+		insert(index);
+		m_size++;
+
+		return static_cast<Handle>(node.generation) << 32 | index;
+	}
+
+	/*
+	 * Cancel the given timer. Returns false when there is no such
+	 * timer (it has already expired or it has been cancelled).
+	 */
+	bool cancel(Handle handle)
+	{
+		const uint32_t index = handle & 0xffffffff;
+
+		if (index >= m_nodes.size())
+			return false;
+
+		Node &node = m_nodes[index];
+
+		if (!node.active || node.generation != handle >> 32)
+			return false;
+
+		unlink(index);
+		release(index);
+		m_size--;
+
+		return true;
+	}
+
+	/*
+	 * Advance the wheel up to the given time and append items
+	 * of the expired timers. The items are appended in the order
+	 * of their deadlines with the precision of 1 ms.
+	 */
+	void advance(const Poco::Timestamp &now, std::vector<T> &expired)
+	{
+		const uint64_t target = toTick(now);
+
+		while (m_size > 0) {
+			const uint64_t next = nextEvent();
+
+			if (next > target)
+				break;
+
+			m_now = next;
+
+			if ((m_now & MASK) == 0)
+				cascade(1);
+
+			const unsigned int slot = m_now & MASK;
+
+			while (m_slots[0][slot] != NONE) {
+				const uint32_t index = m_slots[0][slot];
+
+				unlink(index);
+				expired.push_back(m_nodes[index].item);
+				release(index);
+				m_size--;
+			}
+		}
+
+		if (target > m_now)
+			m_now = target;
+	}
+
+	/*
+	 * Time from now until the wheel must be advanced. It is exact
+	 * for timers expiring within the range of the level 0, for
+	 * others it is the time of their cascade to a lower level.
+	 * Returns a negative value when there is no timer.
+	 */
+	Poco::Timespan nextTimeout(const Poco::Timestamp &now) const
+	{
+		if (m_size == 0)
+			return -1;
+
+		const uint64_t next = nextEvent();
+		const uint64_t current = toTick(now);
+
+		if (next <= current)
+			return 0;
+
+		return (next - current) * Poco::Timespan::MILLISECONDS;
+	}
+
+	size_t size() const
+	{
+		return m_size;
+	}
+
+	bool empty() const
+	{
+		return m_size == 0;
+	}
+
+private:
+	enum {
+		BITS = 8,
+		SLOTS = 1 << BITS,
+		MASK = SLOTS - 1,
+		LEVELS = 4,
+	};
+
+	static const uint32_t NONE = 0xffffffff;
+
+	struct Node {
+		T item;
+		uint64_t deadline;
+		uint32_t prev;
+		uint32_t next;
+		uint32_t generation;
+		uint16_t level;
+		uint16_t slot;
+		bool active;
+	};
+
+	static uint64_t toTick(const Poco::Timestamp &time)
+	{
+		return time.epochMicroseconds() / 1000;
+	}
+
+	/*
+	 * The nearest tick after the current one when a timer expires
+	 * or when a non-empty slot of a higher level is cascaded. The
+	 * ticks in between can be skipped.
+	 */
+	uint64_t nextEvent() const
+	{
+		uint64_t next = UINT64_MAX;
+
+		for (unsigned int level = 0; level < LEVELS; ++level) {
+			if (m_count[level] == 0)
+				continue;
+
+			const unsigned int shift = BITS * level;
+
+			for (uint64_t i = 1; i <= SLOTS; ++i) {
+				const uint64_t tick = ((m_now >> shift) + i) << shift;
+
+				if (tick >= next)
+					break;
+
+				if (m_slots[level][(tick >> shift) & MASK] != NONE) {
+					next = tick;
+					break;
+				}
+			}
+		}
+
+		return next;
+	}
+
+	uint32_t allocate()
+	{
+		if (m_free == NONE) {
+			Node node;
+			node.generation = 0;
+			node.active = false;
+
+			m_nodes.push_back(node);
+			m_free = m_nodes.size() - 1;
+			m_nodes[m_free].next = NONE;
+		}
+
+		const uint32_t index = m_free;
+		Node &node = m_nodes[index];
+
+		m_free = node.next;
+		node.generation++;
+		node.active = true;
+
+		return index;
+	}
+
+	void release(uint32_t index)
+	{
+		Node &node = m_nodes[index];
+
+		node.item = T();
+		node.active = false;
+		node.next = m_free;
+		m_free = index;
+	}
+
+	/*
+	 * Put the node into the slot given by its deadline relatively
+	 * to the current tick.
+	 */
+	void insert(uint32_t index)
+	{
+		Node &node = m_nodes[index];
+		uint64_t delta = node.deadline - m_now;
+		unsigned int level = 0;
+
+		while (level < LEVELS - 1 && delta >= (1ULL << (BITS * (level + 1))))
+			level++;
+
+		if (level == LEVELS - 1 && delta >= (1ULL << (BITS * LEVELS)))
+			delta = (1ULL << (BITS * LEVELS)) - 1;
+
+		const uint64_t tick = m_now + delta;
+
+		node.level = level;
+		node.slot = (tick >> (BITS * level)) & MASK;
+		node.prev = NONE;
+		node.next = m_slots[level][node.slot];
+
+		if (node.next != NONE)
+			m_nodes[node.next].prev = index;
+
+		m_slots[level][node.slot] = index;
+		m_count[level]++;
+	}
+
+	void unlink(uint32_t index)
+	{
+		Node &node = m_nodes[index];
+
+		if (node.prev != NONE)
+			m_nodes[node.prev].next = node.next;
+		else
+			m_slots[node.level][node.slot] = node.next;
+
+		if (node.next != NONE)
+			m_nodes[node.next].prev = node.prev;
+
+		m_count[node.level]--;
+	}
+
+	/*
+	 * Move timers of the current slot of the given level into
+	 * the lower levels. The higher level is cascaded first when
+	 * this level wraps around as well.
+	 */
+	void cascade(unsigned int level)
+	{
+		if (level >= LEVELS)
+			return;
+
+		const unsigned int slot = (m_now >> (BITS * level)) & MASK;
+
+		if (slot == 0)
+			cascade(level + 1);
+
+		uint32_t index = m_slots[level][slot];
+		m_slots[level][slot] = NONE;
+
+		while (index != NONE) {
+			const uint32_t next = m_nodes[index].next;
+
+			m_count[level]--;
+			insert(index);
+			index = next;
+		}
+	}
+
+private:
+	uint64_t m_now;
+	std::vector<Node> m_nodes;
+	uint32_t m_free;
+	size_t m_size;
+	uint32_t m_slots[LEVELS][SLOTS];
+	size_t m_count[LEVELS];
+};
+
+template <typename T>
+const typename TimingWheel<T>::Handle TimingWheel<T>::INVALID;
+
+template <typename T>
+const uint32_t TimingWheel<T>::NONE;
+
+}
+
+#endif
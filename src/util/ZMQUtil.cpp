@@ -1,9 +1,16 @@
+#include <utility>
+
 #include "ZMQUtil.h"
 
 using namespace BeeeOn;
 using namespace std;
 using namespace Poco;
 
+static void freeString(void *, void *hint)
+{
+	delete static_cast<string *>(hint);
+}
+
 int ZMQUtil::receive(SharedPtr<zmq::socket_t> socket,
 	string &message)
 {
@@ -18,6 +25,12 @@ int ZMQUtil::receive(SharedPtr<zmq::socket_t> socket,
 	return returnCode;
 }
 
+int ZMQUtil::receive(SharedPtr<zmq::socket_t> socket,
+	zmq::message_t &message)
+{
+	return socket->recv(&message, ZMQ_DONTWAIT);
+}
+
 bool ZMQUtil::send(SharedPtr<zmq::socket_t> socket, const string &message)
 {
 	zmq::message_t zmqMessage(message.size());
@@ -34,3 +47,34 @@ bool ZMQUtil::sendMultipart(SharedPtr<zmq::socket_t> socket,
 
 	return socket->send(zmqMessage, ZMQ_SNDMORE);
 }
+
+bool ZMQUtil::send(SharedPtr<zmq::socket_t> socket, string &&message,
+	int flags)
+{
+	string *buffer = new string(std::move(message));
+
+	// the buffer is released by freeString() even if the send fails
+	zmq::message_t zmqMessage(&(*buffer)[0], buffer->size(),
+		freeString, buffer);
+
+	return socket->send(zmqMessage, flags);
+}
+
+bool ZMQUtil::sendMultipart(SharedPtr<zmq::socket_t> socket,
+	const string &identity, string &&message)
+{
+	if (!sendMultipart(socket, identity))
+		return false;
+
+	return send(socket, std::move(message));
+}
+
+bool ZMQUtil::hasInput(SharedPtr<zmq::socket_t> socket)
+{
+	int events = 0;
+	size_t size = sizeof(events);
+
+	socket->getsockopt(ZMQ_EVENTS, &events, &size);
+
+	return events & ZMQ_POLLIN;
+}
@@ -9,6 +9,50 @@
 
 namespace BeeeOn {
 
+/*
+ * Read-only view of a received ZMQ frame. The view borrows the data
+ * of the given zmq::message_t and thus it must not outlive it.
+ * No data are copied unless toString() is called.
+ */
+class ZMQFrameView {
+public:
+	ZMQFrameView(const zmq::message_t &message):
+		m_data(static_cast<const char *>(message.data())),
+		m_size(message.size())
+	{
+	}
+
+	ZMQFrameView(const std::string &data):
+		m_data(data.data()),
+		m_size(data.size())
+	{
+	}
+
+	const char *data() const
+	{
+		return m_data;
+	}
+
+	size_t size() const
+	{
+		return m_size;
+	}
+
+	bool empty() const
+	{
+		return m_size == 0;
+	}
+
+	std::string toString() const
+	{
+		return std::string(m_data, m_size);
+	}
+
+private:
+	const char *m_data;
+	size_t m_size;
+};
+
 /*
  * Zjednodusenie posielania a prijimania sprav pomocou ZMQ protokolu.
  * Metoda na prijem dat je neblokujuca. Ak sa jedna o endpoint typu
@@ -17,6 +61,10 @@ namespace BeeeOn {
  * send je nutne poslat spravy s identifikatorom pomoocout sendMultipart.
  * Na endpointe typu klient staci posielat data pomocou send pretoze
  * identifikacia klienta sa nastavuje pri vytvarani socketu.
+ *
+ * The zero-copy variants hand over ownership of the given buffer to
+ * ZMQ (zmq_msg_init_data) and receive into a zmq::message_t that can
+ * be accessed via ZMQFrameView without copying.
  */
 class ZMQUtil {
 public:
@@ -27,17 +75,47 @@ public:
 	static int receive(Poco::SharedPtr<zmq::socket_t> socket,
 		std::string &message);
 
+	/*
+	 * Receive ZMQ frame from socket without copying its data.
+	 * The method is non-blocking.
+	 */
+	static int receive(Poco::SharedPtr<zmq::socket_t> socket,
+		zmq::message_t &message);
+
 	/*
 	 * Convert string to ZMQ string and send to socket.
 	 */
 	static bool send(Poco::SharedPtr<zmq::socket_t> socket,
 		const std::string &message);
 
+	/*
+	 * Send the string without copying. The buffer of the string
+	 * is owned by ZMQ until it is sent and released by a free
+	 * callback then.
+	 */
+	static bool send(Poco::SharedPtr<zmq::socket_t> socket,
+		std::string &&message, int flags = 0);
+
 	/*
 	 *  Sends string as ZMQ string as multipart.
 	 */
 	static bool sendMultipart(Poco::SharedPtr<zmq::socket_t> socket,
 		const std::string &message);
+
+	/*
+	 * Sends the routing frame (identity of the receiver) together
+	 * with the payload. The payload is sent without copying.
+	 */
+	static bool sendMultipart(Poco::SharedPtr<zmq::socket_t> socket,
+		const std::string &identity, std::string &&message);
+
+	/*
+	 * True if at least one message can be received from the socket
+	 * without blocking. ZMQ signals readiness of its sockets in an
+	 * edge-triggered way, so the socket must be drained until this
+	 * method returns false before the next zmq_poll().
+	 */
+	static bool hasInput(Poco::SharedPtr<zmq::socket_t> socket);
 };
 
 }
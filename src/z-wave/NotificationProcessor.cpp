@@ -1,6 +1,3 @@
-#include <list>
-#include <map>
-
 #include <Poco/Logger.h>
 #include <Poco/ScopedLock.h>
 #include <Poco/NumberParser.h>
@@ -10,20 +7,116 @@
 #include "z-wave/NotificationProcessor.h"
 #include "zmq/ZMQMessage.h"
 
+#define DEFAULT_QUEUE_SIZE 1024
+#define IDLE_WAIT_MS 100
+
 using namespace BeeeOn;
 using namespace OpenZWave;
 using Poco::NumberParser;
 
-map<uint8_t, NodeInfo> NotificationProcessor::m_nodesMap;
+NodeInfo NotificationProcessor::m_nodes[256];
+
+NodeInfo::NodeInfo():
+	m_present(false),
+	m_polled(false),
+	m_identified(false),
+	m_manufacturer(0),
+	m_product(0)
+{
+}
+
+NotificationProcessor::Event::Event():
+	type(Notification::Type_Notification),
+	homeId(0),
+	nodeId(0)
+{
+}
+
+NotificationProcessor::Event::Event(const Notification *notification):
+	type(notification->GetType()),
+	homeId(notification->GetHomeId()),
+	nodeId(notification->GetNodeId()),
+	valueID(notification->GetValueID())
+{
+}
 
-NotificationProcessor::NotificationProcessor(set<DeviceID> &pairedDevices,
+NotificationProcessor::NotificationProcessor(const PairedDevices &pairedDevices,
 		Poco::AtomicCounter &listen):
 	m_initFailed(false),
+	m_deltaValues(true),
+	m_queueSize(DEFAULT_QUEUE_SIZE),
+	m_policy(DROP_NEWEST),
+	m_thread("zwave-notify"),
+	m_stop(false),
+	m_refresh(false),
+	m_consumerWaiting(false),
+	m_producerWaiting(false),
+	m_maxDepth(0),
+	m_queued(0),
+	m_processed(0),
+	m_dropped(0),
 	m_pairedDevices(pairedDevices),
 	m_listen(listen)
 {
 }
 
+NotificationProcessor::~NotificationProcessor()
+{
+	stop();
+}
+
+void NotificationProcessor::setQueueSize(int size)
+{
+	if (size <= 0)
+		throw Poco::InvalidArgumentException("queue size must be positive");
+
+	if (!m_queue.isNull())
+		throw Poco::IllegalStateException("queue size must be set before start");
+
+	m_queueSize = size;
+}
+
+void NotificationProcessor::setOverflowPolicy(const string &policy)
+{
+	if (policy == "drop-newest")
+		m_policy = DROP_NEWEST;
+	else if (policy == "block")
+		m_policy = BLOCK;
+	else
+		throw Poco::InvalidArgumentException("unknown overflow policy: " + policy);
+}
+
+void NotificationProcessor::start()
+{
+	if (m_queue.isNull())
+		m_queue = new MPSCRing<Event>(m_queueSize);
+
+	m_stop = false;
+	m_thread.start(*this);
+}
+
+void NotificationProcessor::stop()
+{
+	m_stop = true;
+	m_eventReady.set();
+	m_spaceReady.set();
+
+	if (m_thread.isRunning())
+		m_thread.join();
+}
+
+NotificationProcessor::Stats NotificationProcessor::stats() const
+{
+	Stats stats;
+	stats.depth = m_queue.isNull() ? 0 : m_queue->size();
+	stats.maxDepth = m_maxDepth;
+	stats.capacity = m_queue.isNull() ? 0 : m_queue->capacity();
+	stats.queued = m_queued;
+	stats.processed = m_processed;
+	stats.dropped = m_dropped;
+	return stats;
+}
+
 void NotificationProcessor::waitUntilQueried()
 {
 	m_initMutex.lock();
@@ -35,170 +128,316 @@ Poco::Nullable<NodeInfo> NotificationProcessor::findNodeInfo(const uint8 &nodeId
 {
 	Poco::Nullable<NodeInfo> nullable;
 
-	auto search = m_nodesMap.find(nodeId);
-
-	if (search != m_nodesMap.end()) {
-		NodeInfo &nodeI = search->second;
-		nullable = nodeI;
-	}
+	if (m_nodes[nodeId].m_present)
+		nullable = m_nodes[nodeId];
 
 	return nullable;
 }
 
-void NotificationProcessor::valueAdded(const Notification *notification)
+void NotificationProcessor::valueAdded(const Event &event)
 {
-	nodeInfoMap::iterator it = m_nodesMap.find(notification->GetNodeId());
+	NodeInfo &node = m_nodes[event.nodeId];
 
-	if (it == m_nodesMap.end())
+	if (!node.m_present)
 		return;
 
-	it->second.m_values.push_back(notification->GetValueID());
+	node.m_values.push_back(event.valueID);
 }
 
-void NotificationProcessor::valueChanged(const Notification *notification)
+void NotificationProcessor::valueChanged(const Event &event)
 {
-	nodeInfoMap::iterator it = m_nodesMap.find(notification->GetNodeId());
-	ZWaveMessage *message;
-	uint32_t manufacturer;
-	uint32_t product;
-	uint8_t nodeId;
+	const uint8_t nodeId = event.nodeId;
+	NodeInfo &node = m_nodes[nodeId];
 
-	if (it == m_nodesMap.end())
+	if (!node.m_present)
 		return;
 
-	nodeId = notification->GetNodeId();
+	if (!node.m_identified && !identifyNode(nodeId, node))
+		return;
+
+	if (node.m_message.isNull())
+		return;
+
+	if (m_deltaValues) {
+		const vector<ValueID> changed = {event.valueID};
+		sendValue(nodeId, node.m_message.get(), changed);
+	}
+	else {
+		sendValue(nodeId, node.m_message.get(), node.m_values);
+	}
+}
+
+bool NotificationProcessor::identifyNode(const uint8_t nodeId, NodeInfo &node)
+{
+	const string manufacturer = nodeManufacturer(nodeId);
+	const string product = nodeProduct(nodeId);
+
+	if (manufacturer.empty() || product.empty())
+		return false;
 
 	try {
-		manufacturer = NumberParser::parseHex(
-			Manager::Get()->GetNodeManufacturerId(m_homeId, nodeId));
-		product = NumberParser::parseHex(
-			Manager::Get()->GetNodeProductId(m_homeId, nodeId));
+		node.m_manufacturer = NumberParser::parseHex(manufacturer);
+		node.m_product = NumberParser::parseHex(product);
 	}
 	catch (Poco::Exception &ex) {
 		logger().error("failed to parse manufacturer/product value");
 		logger().log(ex, __FILE__, __LINE__);
-		return;
+		return false;
 	}
 
+	node.m_identified = true;
+
 	try {
-		message = m_factory->create(manufacturer, product);
+		node.m_message = m_factory->create(node.m_manufacturer, node.m_product);
 	}
 	catch (Poco::Exception &ex) {
-		logger().error("manufacturer: " + std::to_string(manufacturer)
-			+ " product: " + std::to_string(product));
+		logger().error("manufacturer: " + std::to_string(node.m_manufacturer)
+			+ " product: " + std::to_string(node.m_product));
 		logger().log(ex, __FILE__, __LINE__);
-		return;
 	}
 
-	sendValue(nodeId, message, it->second.m_values);
-	delete message;
+	return true;
 }
 
 int NotificationProcessor::sendValue(const uint8_t &nodeId, ZWaveMessage *message,
-	const std::list<OpenZWave::ValueID> &values)
+	const std::vector<OpenZWave::ValueID> &values)
 {
 	SensorData sensorData;
 	vector<ZWaveSensorValue> zwaveValues;
 
-	for (auto &item : values) {
-		string value;
-		Manager::Get()->GetValueAsString(item, &value);
+	zwaveValues.reserve(values.size());
 
-		zwaveValues.push_back({
-			item.GetCommandClassId(),
-			item.GetIndex(),
-			item,
-			value,
-			Manager::Get()->GetValueUnits(item)});
-		}
+	for (auto &item : values)
+		zwaveValues.push_back(readValue(item));
 
 	sensorData = message->extractValues(zwaveValues);
 
+	// the values are not mapped to any module
+	if (sensorData.begin() == sensorData.end())
+		return 0;
+
 	sensorData.setDeviceID(DeviceID(
 		DevicePrefix::fromRaw(DevicePrefix::PREFIX_ZWAVE),
 		message->getEUID(m_homeId, nodeId)));
 
-	auto it = m_pairedDevices.find(sensorData.deviceID());
-	if (it == m_pairedDevices.end() && !m_listen) {
+	const PairedDevices pairedDevices = std::atomic_load(&m_pairedDevices);
+
+	if (pairedDevices->count(sensorData.deviceID()) == 0 && !m_listen) {
 		logger().warning("drop message");
 		return -1;
 	}
 
-	ZMQMessage msg = ZMQMessage::fromSensorData(sensorData);
-	return m_zmqClient->send(msg.toString());
+	if (!m_zmqClient->send(sensorData))
+		return -1;
+
+	return 1;
 }
 
-void NotificationProcessor::valueRemoved(const Notification *notification)
+string NotificationProcessor::nodeManufacturer(const uint8_t nodeId)
 {
-	nodeInfoMap::iterator it = m_nodesMap.find(notification->GetNodeId());
+	return Manager::Get()->GetNodeManufacturerId(m_homeId, nodeId);
+}
 
-	if (it == m_nodesMap.end())
-		return;
+string NotificationProcessor::nodeProduct(const uint8_t nodeId)
+{
+	return Manager::Get()->GetNodeProductId(m_homeId, nodeId);
+}
 
-	m_nodesMap.erase(it);
-	return;
+ZWaveSensorValue NotificationProcessor::readValue(const ValueID &valueID)
+{
+	string value;
+	Manager::Get()->GetValueAsString(valueID, &value);
+
+	return {
+		valueID.GetCommandClassId(),
+		valueID.GetIndex(),
+		valueID,
+		value,
+		Manager::Get()->GetValueUnits(valueID)};
 }
 
-void NotificationProcessor::nodeAdded(const Notification *notification)
+void NotificationProcessor::cancelControllerCommand(const uint32_t homeId)
 {
-	NodeInfo nodeInfo;
-	nodeInfo.m_polled = false;
-	m_nodesMap.emplace(std::pair<uint8_t, NodeInfo>(notification->GetNodeId(), nodeInfo));
+	Manager::Get()->CancelControllerCommand(homeId);
+}
 
-	Manager::Get()->CancelControllerCommand(notification->GetHomeId());
+void NotificationProcessor::writeConfig()
+{
 	Manager::Get()->WriteConfig(m_homeId);
 }
 
-void NotificationProcessor::nodeRemoved(const Notification *notification)
+void NotificationProcessor::valueRemoved(const Event &event)
 {
-	uint8_t nodeId = notification->GetNodeId();
-	nodeInfoMap::iterator it = m_nodesMap.find(nodeId);
+	NodeInfo &node = m_nodes[event.nodeId];
 
-	if (it != m_nodesMap.end())
-		m_nodesMap.erase(nodeId);
+	if (!node.m_present)
+		return;
 
-	Manager::Get()->WriteConfig(m_homeId);
+	node = NodeInfo();
+}
+
+void NotificationProcessor::nodeAdded(const Event &event)
+{
+	const uint8_t nodeId = event.nodeId;
+	NodeInfo &node = m_nodes[nodeId];
+
+	if (!node.m_present) {
+		node.m_present = true;
+
+		// known only for nodes already queried in a previous run
+		identifyNode(nodeId, node);
+	}
+
+	cancelControllerCommand(event.homeId);
+	writeConfig();
+}
+
+void NotificationProcessor::nodeRemoved(const Event &event)
+{
+	m_nodes[event.nodeId] = NodeInfo();
+
+	writeConfig();
+}
+
+void NotificationProcessor::nodeQueriesComplete(const Event &event)
+{
+	const uint8_t nodeId = event.nodeId;
+	NodeInfo &node = m_nodes[nodeId];
+
+	if (node.m_present && !node.m_identified)
+		identifyNode(nodeId, node);
 }
 
 void NotificationProcessor::onNotification(const Notification *notification)
+{
+	switch (notification->GetType()) {
+	case Notification::Type_ValueChanged:
+	case Notification::Type_ValueRefreshed:
+		enqueue(Event(notification), m_policy == DROP_NEWEST);
+		break;
+	default:
+		enqueue(Event(notification), false);
+		break;
+	}
+}
+
+bool NotificationProcessor::enqueue(const Event &event, bool droppable)
+{
+	while (!m_queue->push(event)) {
+		if (droppable || m_stop) {
+			if (m_dropped++ == 0) {
+				logger().warning("notification queue is full, dropping value notifications",
+					__FILE__, __LINE__);
+			}
+
+			return false;
+		}
+
+		m_producerWaiting = true;
+
+		if (!m_queue->push(event)) {
+			m_spaceReady.tryWait(IDLE_WAIT_MS);
+			m_producerWaiting = false;
+			continue;
+		}
+
+		m_producerWaiting = false;
+		break;
+	}
+
+	++m_queued;
+
+	const size_t depth = m_queue->size();
+	size_t maxDepth = m_maxDepth;
+
+	while (depth > maxDepth && !m_maxDepth.compare_exchange_weak(maxDepth, depth))
+		;
+
+	if (m_consumerWaiting)
+		m_eventReady.set();
+
+	return true;
+}
+
+void NotificationProcessor::run()
+{
+	Event event;
+
+	while (true) {
+		if (m_refresh.exchange(false))
+			refreshNodes();
+
+		if (!m_queue->pop(event)) {
+			if (m_stop)
+				break;
+
+			m_consumerWaiting = true;
+
+			if (!m_queue->pop(event)) {
+				m_eventReady.tryWait(IDLE_WAIT_MS);
+				m_consumerWaiting = false;
+				continue;
+			}
+
+			m_consumerWaiting = false;
+		}
+
+		if (m_producerWaiting)
+			m_spaceReady.set();
+
+		try {
+			process(event);
+		}
+		catch (const Poco::Exception &e) {
+			logger().log(e, __FILE__, __LINE__);
+		}
+		catch (const std::exception &e) {
+			logger().critical(e.what(), __FILE__, __LINE__);
+		}
+
+		++m_processed;
+	}
+}
+
+void NotificationProcessor::process(const Event &event)
 {
 	Poco::Mutex::ScopedLock guard(m_lock);
-	nodeInfoMap::iterator it = m_nodesMap.find(notification->GetNodeId());
+	NodeInfo &node = m_nodes[event.nodeId];
 
-	switch (notification->GetType()) {
+	switch (event.type) {
 	case Notification::Type_ValueAdded:
-		valueAdded(notification);
+		valueAdded(event);
 		break;
 	case Notification::Type_ValueRemoved:
-		valueRemoved(notification);
+		valueRemoved(event);
 		break;
 	case Notification::Type_ValueChanged:
-		valueChanged(notification);
+		valueChanged(event);
 		break;
 	case Notification::Type_NodeAdded:
-		nodeAdded(notification);
+		nodeAdded(event);
 		break;
 	case Notification::Type_NodeRemoved:
-		nodeRemoved(notification);
+		nodeRemoved(event);
 		break;
 	case Notification::Type_NodeEvent: {
 		break;
 	}
 	case Notification::Type_PollingDisabled: {
-		if (it != m_nodesMap.end())
-			it->second.m_polled = false;
+		if (node.m_present)
+			node.m_polled = false;
 
 		break;
 	}
 	case Notification::Type_PollingEnabled: {
-		if (it != m_nodesMap.end())
-			it->second.m_polled = true;
+		if (node.m_present)
+			node.m_polled = true;
 
 		break;
 	}
 	case Notification::Type_DriverReady: {
-		m_homeId = notification->GetHomeId();
-		Manager::Get()->WriteConfig(m_homeId);
+		m_homeId = event.homeId;
+		writeConfig();
 		break;
 	}
 	case Notification::Type_DriverFailed: {
@@ -223,12 +462,14 @@ void NotificationProcessor::onNotification(const Notification *notification)
 		 */
 		m_initCondition.broadcast();
 
+		break;
+	case Notification::Type_NodeQueriesComplete:
+		nodeQueriesComplete(event);
 		break;
 	case Notification::Type_DriverReset:
 	case Notification::Type_Notification:
 	case Notification::Type_NodeNaming:
 	case Notification::Type_NodeProtocolInfo:
-	case Notification::Type_NodeQueriesComplete:
 	default:
 		break;
 	}
@@ -261,6 +502,39 @@ void NotificationProcessor::setGenericMessageFactory(
 	m_factory = factory;
 }
 
+void NotificationProcessor::setDeltaValues(bool delta)
+{
+	m_deltaValues = delta;
+}
+
+void NotificationProcessor::refresh()
+{
+	m_refresh = true;
+
+	if (m_consumerWaiting)
+		m_eventReady.set();
+}
+
+void NotificationProcessor::refreshNodes()
+{
+	Poco::Mutex::ScopedLock guard(m_lock);
+
+	for (unsigned int i = 0; i < 256; ++i) {
+		NodeInfo &node = m_nodes[i];
+
+		if (!node.m_present)
+			continue;
+
+		if (!node.m_identified && !identifyNode(i, node))
+			continue;
+
+		if (node.m_message.isNull() || node.m_values.empty())
+			continue;
+
+		sendValue(i, node.m_message.get(), node.m_values);
+	}
+}
+
 void onNotification(OpenZWave::Notification const *notification,
 	void *context)
 {
@@ -1,16 +1,24 @@
 #pragma once
 
-#include <map>
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <set>
+#include <string>
+#include <vector>
 
 #include <Poco/Condition.h>
+#include <Poco/Event.h>
 #include <Poco/Mutex.h>
 #include <Poco/Nullable.h>
+#include <Poco/Runnable.h>
 #include <Poco/SharedPtr.h>
+#include <Poco/Thread.h>
 
 #include <Notification.h>
 
 #include "util/Loggable.h"
+#include "util/MPSCRing.h"
 #include "z-wave/GenericZWaveMessageFactory.h"
 #include "z-wave/ZWaveMessage.h"
 #include "zmq/ZMQClient.h"
@@ -19,22 +27,93 @@
 
 namespace BeeeOn {
 
+/*
+ * Information about a node of the Z-Wave network. The manufacturer
+ * and product are parsed and the ZWaveMessage of the product is
+ * created only once for the node (when it is identified), thus
+ * a changed value is processed without any parsing or allocation
+ * of the message.
+ */
 struct NodeInfo {
+	NodeInfo();
+
+	bool m_present;
 	bool m_polled;
-	std::list<OpenZWave::ValueID> m_values;
+	bool m_identified;
+	uint32_t m_manufacturer;
+	uint32_t m_product;
+	Poco::SharedPtr<ZWaveMessage> m_message;
+	std::vector<OpenZWave::ValueID> m_values;
 };
 
-typedef std::map<uint8_t, NodeInfo> nodeInfoMap;
-
 /*
  * In OpenZWave, all feedback from the Z-Wave network is sent to the
  * application via callbacks. This class allows the application to add
  * a notification callback handler. All notifications will be reported to it.
+ *
+ * The callbacks are called by the driver thread of OpenZWave, thus
+ * onNotification() only copies the notification into a bounded
+ * lock-free queue. The notifications are processed (OpenZWave queried,
+ * SensorData built and queued to the ZMQClient, whose thread is the only
+ * one using the socket) by a dedicated thread started by start().
+ * When the queue is full, the overflow policy
+ * decides what happens to value notifications:
+ *
+ *  - drop-newest: the notification is dropped
+ *  - block: the driver thread waits until there is a free space
+ *
+ * Other notifications (nodes, driver state) are never dropped,
+ * the driver thread always waits for them.
  */
-class NotificationProcessor : public Loggable {
+class NotificationProcessor : public Loggable, public Poco::Runnable {
 public:
-	NotificationProcessor(std::set<DeviceID> &pairedDevices,
+	enum OverflowPolicy {
+		DROP_NEWEST,
+		BLOCK,
+	};
+
+	/*
+	 * Statistics of the notification queue. The maxDepth is
+	 * the highest depth of the queue seen since start.
+	 */
+	struct Stats {
+		size_t depth;
+		size_t maxDepth;
+		size_t capacity;
+		uint64_t queued;
+		uint64_t processed;
+		uint64_t dropped;
+	};
+
+	/*
+	 * Immutable set of the paired devices. The owner replaces it
+	 * as a whole via atomic_store(), the processing thread reads
+	 * it via atomic_load().
+	 */
+	typedef std::shared_ptr<const std::set<DeviceID>> PairedDevices;
+
+	NotificationProcessor(const PairedDevices &pairedDevices,
 		Poco::AtomicCounter &listen);
+	~NotificationProcessor();
+
+	/*
+	 * The queue size and the overflow policy must be configured
+	 * before start(). The size is rounded up by the MPSCRing
+	 * (a power of 2, at least 2), see Stats::capacity.
+	 */
+	void setQueueSize(int size);
+	void setOverflowPolicy(const std::string &policy);
+
+	/*
+	 * Start and stop the thread processing the notifications.
+	 * The queued notifications are processed before stop() returns.
+	 */
+	void start();
+	void stop();
+
+	void run() override;
+
+	Stats stats() const;
 
 	void waitUntilQueried();
 
@@ -48,6 +127,20 @@ public:
 	 */
 	void setGenericMessageFactory(GenericZWaveMessageFactory *factory);
 
+	/*
+	 * Send only modules of the changed value instead of all values
+	 * of the node. Enabled by default.
+	 * @param delta True to send only the changed values
+	 */
+	void setDeltaValues(bool delta);
+
+	/*
+	 * Send all values of all identified nodes regardless of
+	 * the delta mode. The values are sent asynchronously by
+	 * the processing thread.
+	 */
+	void refresh();
+
 	/*
 	 * Find data using notification
 	 * @param &notification Provides a container for data sent via the notification
@@ -69,63 +162,144 @@ public:
 	bool initFailed() const;
 
 	/*
-	 * It handles notification from Z-Wave network.
+	 * It queues notification from Z-Wave network to be processed.
 	 * @param *notification Provides a container for data sent via the notification
 	 */
 	void onNotification(const OpenZWave::Notification *notification);
 
+protected:
+	/*
+	 * Fields of a notification needed for its processing.
+	 */
+	struct Event {
+		Event();
+		Event(const OpenZWave::Notification *notification);
+
+		OpenZWave::Notification::NotificationType type;
+		uint32_t homeId;
+		uint8_t nodeId;
+		OpenZWave::ValueID valueID;
+	};
+
+	/*
+	 * Queue the event, waits for a free space in the queue unless
+	 * the event can be dropped.
+	 */
+	bool enqueue(const Event &event, bool droppable);
+
+	/*
+	 * It handles notification from Z-Wave network.
+	 * @param &event Fields of the notification
+	 */
+	virtual void process(const Event &event);
+
+	/*
+	 * Send all values of all identified nodes, called by the
+	 * processing thread when refresh() has been requested.
+	 */
+	virtual void refreshNodes();
+
+	/*
+	 * Queries and commands of the OpenZWave Manager
+	 * used while processing the notifications.
+	 */
+	virtual std::string nodeManufacturer(const uint8_t nodeId);
+	virtual std::string nodeProduct(const uint8_t nodeId);
+	virtual ZWaveSensorValue readValue(const OpenZWave::ValueID &valueID);
+	virtual void cancelControllerCommand(const uint32_t homeId);
+	virtual void writeConfig();
+
 private:
 	/*
 	 * A new node value has been added to OpenZWave's list. These notifications
 	 * occur after a node has been discovered.
-	 * @param *notification Provides a container for data sent via the notification
+	 * @param &event Fields of the notification
 	 */
-	void valueAdded(const OpenZWave::Notification *noticiation);
+	void valueAdded(const Event &event);
 
 	/*
 	 * A node value has been updated from the Z-Wave and it is different
-	 * from the previous value. It creates ZWaveMessage which contains
-	 * specific method of product.
-	 * @param *notification Provides a container for data sent via the notification
+	 * from the previous value. The ZWaveMessage of the product extracts
+	 * modules of the changed value only (in delta mode) or of all values
+	 * of the node.
+	 * @param &event Fields of the notification
 	 */
-	void valueChanged(const OpenZWave::Notification *noticiation);
+	void valueChanged(const Event &event);
 
 	/*
 	 * A node value has been removed from OpenZWave's list.
-	 * @param *notification Provides a container for data sent via the notification
+	 * @param &event Fields of the notification
 	 */
-	void valueRemoved(const OpenZWave::Notification *notification);
+	void valueRemoved(const Event &event);
 
 	/*
 	 * A new node has been added to OpenZWave's list. This may be due to a
 	 * device being added to the Z-Wave network, or because the application is
 	 * initializing itself.
-	 * @param *notification Provides a container for data sent via the notification
+	 * @param &event Fields of the notification
 	 */
-	void nodeAdded(const OpenZWave::Notification *notification);
+	void nodeAdded(const Event &event);
 
 	/*
 	 * A node has been removed from OpenZWave's list. This may be due to a device
 	 * being removed from the Z-Wave network, or because the application is closing.
-	 * @param *notification Provides a container for data sent via the notification
+	 * @param &event Fields of the notification
+	 */
+	void nodeRemoved(const Event &event);
+
+	/*
+	 * The node information about all of its values has been
+	 * received, the node can be identified.
+	 * @param &event Fields of the notification
+	 */
+	void nodeQueriesComplete(const Event &event);
+
+	/*
+	 * Parse manufacturer and product of the node and create its
+	 * ZWaveMessage. When the manufacturer or product is not known
+	 * by OpenZWave yet, the node is left unidentified to be tried
+	 * again later. An unsupported product is identified without
+	 * a message.
+	 * @return true if the node is identified
 	 */
-	void nodeRemoved(const OpenZWave::Notification *notification);
+	bool identifyNode(const uint8_t nodeId, NodeInfo &node);
 
+	/*
+	 * Send the values mapped to modules of the device.
+	 * @return 1 if the values are sent (or queued by the client),
+	 * 0 when no value is mapped, -1 when the values are dropped
+	 */
 	int sendValue(const uint8_t &nodeId, ZWaveMessage *message,
-		const std::list<OpenZWave::ValueID> &values);
+		const std::vector<OpenZWave::ValueID> &values);
 
 private:
 	Poco::Mutex m_lock;
 	Poco::Mutex m_initMutex;
 	Poco::Condition m_initCondition;
-	static std::map<uint8_t, NodeInfo> m_nodesMap;
+	static NodeInfo m_nodes[256];
 	Poco::SharedPtr<ZMQClient> m_zmqClient;
 	GenericZWaveMessageFactory *m_factory;
 
 	uint32_t m_homeId;
 	bool m_initFailed;
+	bool m_deltaValues;
+
+	size_t m_queueSize;
+	OverflowPolicy m_policy;
+	Poco::SharedPtr<MPSCRing<Event>> m_queue;
+	Poco::Thread m_thread;
+	Poco::Event m_eventReady;
+	Poco::Event m_spaceReady;
+	std::atomic<bool> m_stop;
+	std::atomic<bool> m_refresh;
+	std::atomic<bool> m_consumerWaiting;
+	std::atomic<bool> m_producerWaiting;
+	std::atomic<size_t> m_maxDepth;
+	std::atomic<uint64_t> m_queued;
+	std::atomic<uint64_t> m_processed;
+	std::atomic<uint64_t> m_dropped;
 
-	std::set<DeviceID> &m_pairedDevices;
+	const PairedDevices &m_pairedDevices;
 	Poco::AtomicCounter &m_listen;
 };
 
@@ -23,12 +23,20 @@ BEEEON_OBJECT_NUMBER("dataServerPort", &ZWaveDeviceManager::setDataServerPort)
 BEEEON_OBJECT_TEXT("helloServerHost", &ZWaveDeviceManager::setHelloServerHost)
 BEEEON_OBJECT_NUMBER("helloServerPort", &ZWaveDeviceManager::setHelloServerPort)
 BEEEON_OBJECT_TEXT("prefixName", &ZWaveDeviceManager::setPrefixName)
+BEEEON_OBJECT_TEXT("encoding", &ZWaveDeviceManager::setEncoding)
+BEEEON_OBJECT_NUMBER("batchSize", &ZWaveDeviceManager::setBatchSize)
+BEEEON_OBJECT_NUMBER("batchDelay", &ZWaveDeviceManager::setBatchDelay)
+BEEEON_OBJECT_NUMBER("creditBuffer", &ZWaveDeviceManager::setCreditBuffer)
+BEEEON_OBJECT_NUMBER("creditWait", &ZWaveDeviceManager::setCreditWait)
 BEEEON_OBJECT_TEXT("setUserPath", &ZWaveDeviceManager::setUserPath)
 BEEEON_OBJECT_TEXT("donglePath", &ZWaveDeviceManager::setDonglePath)
 BEEEON_OBJECT_TEXT("setConfigPath", &ZWaveDeviceManager::setConfigPath)
 BEEEON_OBJECT_NUMBER("setPollInterval", &ZWaveDeviceManager::setPollInterval)
 BEEEON_OBJECT_NUMBER("setDriverMaxAttempts", &ZWaveDeviceManager::setDriverMaxAttempts)
 BEEEON_OBJECT_NUMBER("setSaveConfigurationFile", &ZWaveDeviceManager::setSaveConfigurationFile)
+BEEEON_OBJECT_NUMBER("deltaValues", &ZWaveDeviceManager::setDeltaValues)
+BEEEON_OBJECT_NUMBER("queueSize", &ZWaveDeviceManager::setQueueSize)
+BEEEON_OBJECT_TEXT("overflowPolicy", &ZWaveDeviceManager::setOverflowPolicy)
 BEEEON_OBJECT_END(BeeeOn, ZWaveDeviceManager)
 
 using namespace BeeeOn;
@@ -38,6 +46,7 @@ using namespace OpenZWave;
 
 ZWaveDeviceManager::ZWaveDeviceManager():
 	m_notificationProcessor(m_devices, m_listen),
+	m_devices(std::make_shared<const std::set<DeviceID>>()),
 	m_listen(false),
 	m_callback(*this, &ZWaveDeviceManager::stopListen),
 	m_derefListen(1000, 0),
@@ -104,7 +113,7 @@ void ZWaveDeviceManager::doDeviceUnpairCommand(ZMQMessage &zmqMessage)
 {
 	DeviceUnpairCommand::Ptr cmd = zmqMessage.toDeviceUnpairCommand();
 
-	m_devices.erase(cmd->deviceID());
+	removeDevice(cmd->deviceID());
 	Manager::Get()->RemoveNode(m_homeId);
 
 	m_derefUnpair.start(m_callbackUnpair);
@@ -112,13 +121,16 @@ void ZWaveDeviceManager::doDeviceUnpairCommand(ZMQMessage &zmqMessage)
 
 void ZWaveDeviceManager::doDeviceLastValueResult(ZMQMessage &zmqMessage)
 {
-	for (auto item : m_table) {
-		if (item.second.id != zmqMessage.id())
-			continue;
+	Answer::Ptr answer = findAnswer(zmqMessage.id());
 
-		ServerLastValueResult::Ptr res = new ServerLastValueResult(item.first);
-		zmqMessage.toServerLastValueResult(res);
+	if (answer.isNull()) {
+		logger().warning("unknown or expired result id "
+			+ zmqMessage.id().toString());
+		return;
 	}
+
+	ServerLastValueResult::Ptr res = new ServerLastValueResult(answer);
+	zmqMessage.toServerLastValueResult(res);
 }
 
 void ZWaveDeviceManager::doListenCommand(ZMQMessage &zmqMessage)
@@ -131,13 +143,16 @@ void ZWaveDeviceManager::doListenCommand(ZMQMessage &zmqMessage)
 
 void ZWaveDeviceManager::doDeviceListResult(ZMQMessage &zmqMessage)
 {
-	for (auto item : m_table) {
-		if (item.second.id != zmqMessage.id())
-			continue;
+	Answer::Ptr answer = findAnswer(zmqMessage.id());
 
-		ServerDeviceListResult::Ptr res = new ServerDeviceListResult(item.first);
-		zmqMessage.toServerDeviceListResult(res);
+	if (answer.isNull()) {
+		logger().warning("unknown or expired result id "
+			+ zmqMessage.id().toString());
+		return;
 	}
+
+	ServerDeviceListResult::Ptr res = new ServerDeviceListResult(answer);
+	zmqMessage.toServerDeviceListResult(res);
 }
 
 void ZWaveDeviceManager::setUserPath(const std::string &userPath)
@@ -169,6 +184,21 @@ void ZWaveDeviceManager::setSaveConfigurationFile(bool)
 {
 }
 
+void ZWaveDeviceManager::setDeltaValues(bool delta)
+{
+	m_notificationProcessor.setDeltaValues(delta);
+}
+
+void ZWaveDeviceManager::setQueueSize(int size)
+{
+	m_notificationProcessor.setQueueSize(size);
+}
+
+void ZWaveDeviceManager::setOverflowPolicy(const std::string &policy)
+{
+	m_notificationProcessor.setOverflowPolicy(policy);
+}
+
 void ZWaveDeviceManager::installOption()
 {
 	OpenZWave::Options::Create(m_configPath, m_userPath, "");
@@ -188,6 +218,7 @@ void ZWaveDeviceManager::run()
 	DeviceManager::runClient();
 	sleep(1);
 	m_notificationProcessor.setZMQClient(m_zmqClient);
+	m_notificationProcessor.start();
 
 	m_driver.assign(new ZWaveDriver(m_donglePath));
 	Manager::Create();
@@ -210,6 +241,15 @@ void ZWaveDeviceManager::stop()
 	m_driver->unregisterItself();
 
 	Manager::Get()->RemoveWatcher(onNotification, &m_notificationProcessor);
+	m_notificationProcessor.stop();
+
+	const NotificationProcessor::Stats stats = m_notificationProcessor.stats();
+	logger().information("notifications queued: " + to_string(stats.queued)
+		+ ", processed: " + to_string(stats.processed)
+		+ ", dropped: " + to_string(stats.dropped)
+		+ ", max depth: " + to_string(stats.maxDepth)
+		+ "/" + to_string(stats.capacity));
+
 	Manager::Destroy();
 	Options::Destroy();
 
@@ -234,16 +274,12 @@ void ZWaveDeviceManager::installManufacturers()
 
 void ZWaveDeviceManager::getDeviceList()
 {
-	m_devices.clear();
+	setDevices({});
 
 	Answer::Ptr answer = new Answer(m_queue);
 	ServerDeviceListCommand::Ptr cmd = new ServerDeviceListCommand(m_prefix);
 
-	ZMQMessage msg = ZMQMessage::fromCommand(cmd);
-	msg.setID(GlobalID::random());
-
-	m_zmqClient->send(msg.toString());
-	m_table.insert(make_pair(answer, ResultData{msg.id(), cmd}));
+	sendRequest(answer, cmd);
 
 	logger().debug("run cmd: " + cmd->name());
 }
@@ -255,11 +291,7 @@ void ZWaveDeviceManager::getLastValue(const DeviceID &deviceID,
 	ServerLastValueCommand::Ptr cmd =
 		new ServerLastValueCommand(deviceID, moduleID);
 
-	ZMQMessage msg = ZMQMessage::fromCommand(cmd);
-	msg.setID(GlobalID::random());
-
-	m_zmqClient->send(msg.toString());
-	m_table.insert(make_pair(answer, ResultData{msg.id(), cmd}));
+	sendRequest(answer, cmd);
 
 	logger().debug("run cmd: " + cmd->name());
 }
@@ -270,25 +302,30 @@ void ZWaveDeviceManager::checkQueue()
 	m_queue.wait(QUEUE_WAIT, dirtyList);
 
 	for (auto answer : dirtyList) {
-		auto it = m_table.find(answer);
+		Command::Ptr request = answeredCommand(answer);
 
-		if (it == m_table.end()) {
+		if (request.isNull()) {
 			logger().warning("unknown result");
 			break;
 		}
 
-		if (it->second.cmd->is<ServerDeviceListCommand>()) {
-			m_devices.clear();
+		if (request->is<ServerDeviceListCommand>()) {
+			std::set<DeviceID> devices;
 
 			for (auto deviceID : answer->at(0).cast<ServerDeviceListResult>()->deviceList())
-				m_devices.insert(deviceID);
+				devices.insert(deviceID);
+
+			setDevices(std::move(devices));
 
 			setLastState();
+
+			// full state of the (newly) paired devices
+			m_notificationProcessor.refresh();
 		}
 
-		if (it->second.cmd->is<ServerLastValueCommand>()) {
+		if (request->is<ServerLastValueCommand>()) {
 			ServerLastValueResult::Ptr result = answer->at(0).cast<ServerLastValueResult>();
-			ServerLastValueCommand::Ptr cmd = it->second.cmd.cast<ServerLastValueCommand>();
+			ServerLastValueCommand::Ptr cmd = request.cast<ServerLastValueCommand>();
 
 			if (result->status() != Result::SUCCESS)
 				return;
@@ -338,9 +375,29 @@ void ZWaveDeviceManager::stopListen(Poco::Timer &)
 	getDeviceList();
 }
 
+void ZWaveDeviceManager::setDevices(std::set<DeviceID> &&devices)
+{
+	Poco::FastMutex::ScopedLock guard(m_devicesLock);
+	std::atomic_store(&m_devices, NotificationProcessor::PairedDevices(
+		std::make_shared<const std::set<DeviceID>>(std::move(devices))));
+}
+
+void ZWaveDeviceManager::removeDevice(const DeviceID &deviceID)
+{
+	Poco::FastMutex::ScopedLock guard(m_devicesLock);
+	std::set<DeviceID> devices(*std::atomic_load(&m_devices));
+
+	devices.erase(deviceID);
+	std::atomic_store(&m_devices, NotificationProcessor::PairedDevices(
+		std::make_shared<const std::set<DeviceID>>(std::move(devices))));
+}
+
 void ZWaveDeviceManager::setLastState()
 {
-	for (auto item : m_devices) {
+	const NotificationProcessor::PairedDevices devices =
+		std::atomic_load(&m_devices);
+
+	for (auto item : *devices) {
 		string manufacturer =
 			Manager::Get()->GetNodeManufacturerId(m_homeId, item.ident()&0xff);
 
@@ -24,6 +24,9 @@ public:
 	void setPollInterval(int pollInterval);
 	void setDriverMaxAttempts(int maxAttempts);
 	void setSaveConfigurationFile(bool save);
+	void setDeltaValues(bool delta);
+	void setQueueSize(int size);
+	void setOverflowPolicy(const std::string &policy);
 
 protected:
 	void onEvent(const void*, ZMQMessage &zmqMessage) override;
@@ -41,6 +44,13 @@ protected:
 
 	void setLastState();
 
+	/*
+	 * Publish a new set of the paired devices, it is read
+	 * by the NotificationProcessor from its own thread.
+	 */
+	void setDevices(std::set<DeviceID> &&devices);
+	void removeDevice(const DeviceID &deviceID);
+
 	void doDeviceListResult(ZMQMessage &zmqMessage);
 	void doListenCommand(ZMQMessage &zmqMessage);
 	void doDeviceLastValueResult(ZMQMessage &zmqMessage);
@@ -59,8 +69,8 @@ protected:
 	NotificationProcessor m_notificationProcessor;
 	GenericZWaveMessageFactory m_factory;
 
-	std::set<DeviceID> m_devices;
-	AnswerQueue m_queue;
+	NotificationProcessor::PairedDevices m_devices;
+	Poco::FastMutex m_devicesLock;
 	Poco::AtomicCounter m_listen;
 	Poco::TimerCallback<ZWaveDeviceManager> m_callback;
 	Poco::Timer m_derefListen;
@@ -1,4 +1,5 @@
 #include <Poco/Logger.h>
+#include <Poco/Thread.h>
 #include <commands/ServerLastValueResult.h>
 
 #include "di/Injectable.h"
@@ -1,4 +1,5 @@
 #include <Poco/Logger.h>
+#include <Poco/Mutex.h>
 #include <Poco/NumberParser.h>
 
 #include "commands/ServerDeviceListCommand.h"
@@ -14,6 +15,8 @@
 BEEEON_OBJECT_BEGIN(BeeeOn, FakeHandlerTest)
 BEEEON_OBJECT_CASTABLE(CommandHandler)
 BEEEON_OBJECT_REF("commandDispatcher", &FakeHandlerTest::setCommandDispatcher)
+BEEEON_OBJECT_REF("deviceRegistry", &FakeHandlerTest::setDeviceRegistry)
+BEEEON_OBJECT_REF("lastValueCache", &FakeHandlerTest::setLastValueCache)
 BEEEON_OBJECT_TEXT("setAction", &FakeHandlerTest::setAction)
 BEEEON_OBJECT_TEXT("setParameter1", &FakeHandlerTest::setParameter1)
 BEEEON_OBJECT_TEXT("setParameter2", &FakeHandlerTest::setParameter2)
@@ -58,12 +61,34 @@ FakeHandlerTest::FakeHandlerTest() :
 {
 }
 
+vector<CommandHandler::Route> FakeHandlerTest::routes() const
+{
+	return {
+		Route::of<ServerDeviceListCommand>(true),
+		Route::of<ServerLastValueCommand>(true),
+	};
+}
+
 bool FakeHandlerTest::accept(const Command::Ptr cmd)
 {
-	if (cmd->is<ServerDeviceListCommand>())
-		return true;
-	else if (cmd->is<ServerLastValueCommand>())
-		return true;
+	if (cmd->is<ServerDeviceListCommand>()) {
+		if (m_deviceRegistry.isNull())
+			return true;
+
+		// the device list is answered by the registry
+		deferAction();
+		return false;
+	}
+	else if (cmd->is<ServerLastValueCommand>()) {
+		if (m_lastValueCache.isNull())
+			return true;
+
+		const ServerLastValueCommand &last = cmd->cast<ServerLastValueCommand>();
+		double value;
+
+		// the cached value is answered by the cache
+		return !m_lastValueCache->lookup(last.deviceID(), last.moduleID(), value);
+	}
 
 	return false;
 }
@@ -74,10 +99,7 @@ void FakeHandlerTest::handle(Command::Ptr cmd, Answer::Ptr answer)
 
 	if (cmd->is<ServerDeviceListCommand>()) {
 		logger().debug("handle: server device list ");
-		if (m_activeAction) {
-			startAction(m_defer);
-			m_activeAction = false;
-		}
+		deferAction();
 
 		ServerDeviceListResult::Ptr result = new ServerDeviceListResult(answer);
 		std::vector<DeviceID> deviceList =
@@ -155,6 +177,14 @@ void FakeHandlerTest::startAction(Poco::Timer &timer)
 	timer.start(m_callback);
 }
 
+void FakeHandlerTest::deferAction()
+{
+	if (m_activeAction) {
+		startAction(m_defer);
+		m_activeAction = false;
+	}
+}
+
 void FakeHandlerTest::fire(Timer &)
 {
 	AnswerQueue queue;
@@ -204,9 +234,24 @@ void FakeHandlerTest::setCommandDispatcher(
 	m_dispatcher = dispatcher;
 }
 
+void FakeHandlerTest::setDeviceRegistry(SharedPtr<DeviceRegistry> registry)
+{
+	FastMutex::ScopedLock guard(m_pairedLock);
+	m_deviceRegistry = registry;
+
+	for (const auto &deviceID : m_pairedDevice)
+		m_deviceRegistry->add(deviceID);
+}
+
+void FakeHandlerTest::setLastValueCache(SharedPtr<LastValueCache> cache)
+{
+	m_lastValueCache = cache;
+}
+
 vector<DeviceID> FakeHandlerTest::pairedDevices(
 	const DevicePrefix &prefix)
 {
+	FastMutex::ScopedLock guard(m_pairedLock);
 	vector<DeviceID> deviceList;
 
 	for (auto deviceID : m_pairedDevice) {
@@ -219,7 +264,11 @@ vector<DeviceID> FakeHandlerTest::pairedDevices(
 
 void FakeHandlerTest::addPairedDeviceID(const DeviceID &deviceID)
 {
+	FastMutex::ScopedLock guard(m_pairedLock);
 	m_pairedDevice.insert(deviceID);
+
+	if (!m_deviceRegistry.isNull())
+		m_deviceRegistry->add(deviceID);
 }
 
 // settings methods
@@ -228,7 +277,7 @@ void FakeHandlerTest::setJablotronAC881(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(jablotronPrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 
 	m_deviceAC881 = deviceid;
 }
@@ -237,7 +286,7 @@ void FakeHandlerTest::setJablotronAC882(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(jablotronPrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 
 	m_deviceAC882 = deviceid;
 }
@@ -246,56 +295,56 @@ void FakeHandlerTest::setJablotronJA81M(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(jablotronPrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 }
 
 void FakeHandlerTest::setJablotronJA82SH(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(jablotronPrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 }
 
 void FakeHandlerTest::setJablotronJA83M(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(jablotronPrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 }
 
 void FakeHandlerTest::setJablotronJA83P(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(jablotronPrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 }
 
 void FakeHandlerTest::setJablotronJA85ST(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(jablotronPrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 }
 
 void FakeHandlerTest::setJablotronRC86K(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(jablotronPrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 }
 
 void FakeHandlerTest::setJablotronTP82N(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(jablotronPrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 }
 
 void FakeHandlerTest::setZWaveAeotec(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(zwavePrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 
 	m_deviceAeotec = deviceid;
 }
@@ -304,7 +353,7 @@ void FakeHandlerTest::setZWaveDLink(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(zwavePrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 
 	m_deviceDLink = deviceid;
 }
@@ -313,21 +362,21 @@ void FakeHandlerTest::setZWaveFibaro(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(zwavePrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 }
 
 void FakeHandlerTest::setZWavePhilio(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(zwavePrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 }
 
 void FakeHandlerTest::setZWavePopp(const string &serialNumber)
 {
 	Nullable<DeviceID> deviceid = generateDeviceID(zwavePrefix, serialNumber);
 	if (!deviceid.isNull())
-		m_pairedDevice.insert(deviceid);
+		addPairedDeviceID(deviceid);
 
 	m_devicePopp = deviceid;
 }
@@ -1,20 +1,31 @@
 #ifndef BEEEEON_FAKEHANDLER_TEST_H
 #define BEEEEON_FAKEHANDLER_TEST_H
 
+#include <Poco/Mutex.h>
 #include <Poco/Nullable.h>
 #include <Poco/Timer.h>
 
 #include "core/CommandDispatcher.h"
 #include "core/CommandHandler.h"
+#include "core/DeviceRegistry.h"
+#include "core/LastValueCache.h"
 #include "model/DeviceID.h"
 #include "util/Loggable.h"
 
 namespace BeeeOn {
 
+/*
+ * Handler for testing of device managers. It answers device lists
+ * and last values of the configured devices. When a DeviceRegistry
+ * is set, the configured devices are added into it and the device
+ * lists are left for the registry to answer. When a LastValueCache
+ * is set, the last values it holds are left for the cache to answer.
+ */
 class FakeHandlerTest : public CommandHandler, public Loggable {
 public:
 	FakeHandlerTest();
 
+	std::vector<Route> routes() const override;
 	bool accept(const Command::Ptr cmd);
 	void handle(Command::Ptr cmd, Answer::Ptr answer);
 
@@ -51,6 +62,8 @@ public:
 	void setRunTime(int time);
 
 	void setCommandDispatcher(Poco::SharedPtr<CommandDispatcher> dispatcher);
+	void setDeviceRegistry(Poco::SharedPtr<DeviceRegistry> registry);
+	void setLastValueCache(Poco::SharedPtr<LastValueCache> cache);
 	void addPairedDeviceID(const DeviceID &deviceID);
 
 private:
@@ -60,6 +73,12 @@ private:
 	std::vector<DeviceID> pairedDevices(const DevicePrefix &prefix);
 
 	void startAction(Poco::Timer &timer);
+
+	/*
+	 * Start the configured action when the first device list
+	 * is requested.
+	 */
+	void deferAction();
 	void fire(Poco::Timer &timer);
 
 private:
@@ -89,7 +108,10 @@ private:
 	Poco::Timer m_defer;
 	Poco::TimerCallback<FakeHandlerTest> m_callback;
 	Poco::SharedPtr<CommandDispatcher> m_dispatcher;
+	Poco::SharedPtr<DeviceRegistry> m_deviceRegistry;
+	Poco::SharedPtr<LastValueCache> m_lastValueCache;
 	std::set<DeviceID> m_pairedDevice;
+	Poco::FastMutex m_pairedLock;
 	Poco::AtomicCounter m_activeAction;
 };
 
@@ -0,0 +1,253 @@
+#include <cstring>
+
+#include <Poco/ByteOrder.h>
+#include <Poco/Exception.h>
+#include <Poco/UUID.h>
+
+#include "model/SensorData.h"
+#include "zmq/ZMQBinaryMessage.h"
+
+using namespace BeeeOn;
+using namespace Poco;
+using namespace std;
+
+static const size_t ID_OFFSET = 4;
+static const size_t ID_SIZE = 16;
+static const uint8_t FLAG_ID = 0x01;
+
+static void appendUInt16(string &buffer, uint16_t value)
+{
+	value = ByteOrder::toLittleEndian(value);
+	buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void appendUInt64(string &buffer, uint64_t value)
+{
+	value = ByteOrder::toLittleEndian(static_cast<UInt64>(value));
+	buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void appendDouble(string &buffer, double value)
+{
+	uint64_t raw;
+	memcpy(&raw, &value, sizeof(raw));
+	appendUInt64(buffer, raw);
+}
+
+static uint16_t readUInt16(const char *data)
+{
+	uint16_t value;
+	memcpy(&value, data, sizeof(value));
+	return ByteOrder::fromLittleEndian(value);
+}
+
+static uint64_t readUInt64(const char *data)
+{
+	UInt64 value;
+	memcpy(&value, data, sizeof(value));
+	return ByteOrder::fromLittleEndian(value);
+}
+
+static double readDouble(const char *data)
+{
+	const uint64_t raw = readUInt64(data);
+	double value;
+
+	memcpy(&value, &raw, sizeof(value));
+	return value;
+}
+
+bool ZMQBinaryMessage::isBinary(const char *data, size_t length)
+{
+	return length > 0 && static_cast<uint8_t>(data[0]) == MAGIC;
+}
+
+void ZMQBinaryMessage::checkHeader(const char *data, size_t length)
+{
+	if (length < HEADER_SIZE)
+		throw SyntaxException("binary message is too short");
+
+	if (!isBinary(data, length))
+		throw SyntaxException("binary message has invalid magic");
+
+	if (static_cast<uint8_t>(data[1]) != VERSION) {
+		throw SyntaxException("unsupported binary message version "
+			+ to_string(static_cast<uint8_t>(data[1])));
+	}
+}
+
+ZMQMessageType ZMQBinaryMessage::type(const char *data, size_t length)
+{
+	checkHeader(data, length);
+
+	try {
+		return ZMQMessageType::fromRaw(
+			static_cast<ZMQMessageType::Raw>(static_cast<uint8_t>(data[2])));
+	}
+	catch (const InvalidArgumentException &ex) {
+		throw SyntaxException("unknown type of binary message", ex);
+	}
+}
+
+Nullable<GlobalID> ZMQBinaryMessage::id(const char *data, size_t length)
+{
+	checkHeader(data, length);
+
+	if (!(data[3] & FLAG_ID))
+		return Nullable<GlobalID>();
+
+	UUID uuid;
+	uuid.copyFrom(data + ID_OFFSET);
+
+	return GlobalID::parse(uuid.toString());
+}
+
+void ZMQBinaryMessage::writeHeader(string &buffer,
+	const ZMQMessageType &type, const Nullable<GlobalID> &id)
+{
+	buffer += static_cast<char>(MAGIC);
+	buffer += static_cast<char>(VERSION);
+	buffer += static_cast<char>(type.raw());
+
+	if (id.isNull()) {
+		buffer += static_cast<char>(0);
+		buffer.append(ID_SIZE, '\0');
+		return;
+	}
+
+	char uuid[ID_SIZE];
+	UUID(id.value().toString()).copyTo(uuid);
+
+	buffer += static_cast<char>(FLAG_ID);
+	buffer.append(uuid, ID_SIZE);
+}
+
+static void appendSensorData(string &buffer, const SensorData &sensorData)
+{
+	const size_t count = sensorData.end() - sensorData.begin();
+	if (count > 0xffff)
+		throw RangeException("too many values for binary message");
+
+	appendUInt64(buffer, sensorData.deviceID());
+	appendUInt16(buffer, count);
+
+	for (const auto &value : sensorData) {
+		appendUInt16(buffer, value.moduleID().value());
+		buffer += static_cast<char>(value.isValid() ? 1 : 0);
+		buffer += '\0';
+		appendDouble(buffer, value.value());
+	}
+}
+
+/*
+ * Reads a single SensorData record starting at p and moves p
+ * behind it.
+ */
+static SensorData readSensorData(const char *&p, const char *end)
+{
+	if (end - p < ZMQBinaryMessage::SENSOR_DATA_SIZE)
+		throw SyntaxException("binary measured_values is too short");
+
+	SensorData sensorData;
+	sensorData.setDeviceID(DeviceID(readUInt64(p)));
+
+	const size_t count = readUInt16(p + 8);
+	p += ZMQBinaryMessage::SENSOR_DATA_SIZE;
+
+	if (static_cast<size_t>(end - p) < count * ZMQBinaryMessage::SENSOR_VALUE_SIZE)
+		throw SyntaxException("binary measured_values is too short");
+
+	for (size_t i = 0; i < count; ++i, p += ZMQBinaryMessage::SENSOR_VALUE_SIZE) {
+		const ModuleID moduleID(readUInt16(p));
+
+		if (p[2])
+			sensorData.insertValue(SensorValue(moduleID, readDouble(p + 4)));
+		else
+			sensorData.insertValue(SensorValue(moduleID));
+	}
+
+	return sensorData;
+}
+
+string ZMQBinaryMessage::fromSensorData(const SensorData &sensorData,
+	const Nullable<GlobalID> &id)
+{
+	const size_t count = sensorData.end() - sensorData.begin();
+
+	string buffer;
+	buffer.reserve(HEADER_SIZE + SENSOR_DATA_SIZE
+		+ count * SENSOR_VALUE_SIZE);
+
+	writeHeader(buffer, ZMQMessageType::fromRaw(
+		ZMQMessageType::TYPE_MEASURED_VALUES), id);
+	appendSensorData(buffer, sensorData);
+
+	return buffer;
+}
+
+string ZMQBinaryMessage::fromSensorDataBatch(const vector<SensorData> &batch,
+	const Nullable<GlobalID> &id)
+{
+	if (batch.size() > 0xffff)
+		throw RangeException("too many records for binary message");
+
+	size_t size = HEADER_SIZE + BATCH_SIZE;
+	for (const auto &sensorData : batch) {
+		size += SENSOR_DATA_SIZE
+			+ (sensorData.end() - sensorData.begin()) * SENSOR_VALUE_SIZE;
+	}
+
+	string buffer;
+	buffer.reserve(size);
+
+	writeHeader(buffer, ZMQMessageType::fromRaw(
+		ZMQMessageType::TYPE_MEASURED_VALUES_BATCH), id);
+	appendUInt16(buffer, batch.size());
+
+	for (const auto &sensorData : batch)
+		appendSensorData(buffer, sensorData);
+
+	return buffer;
+}
+
+SensorData ZMQBinaryMessage::toSensorData(const char *data, size_t length)
+{
+	if (type(data, length).raw() != ZMQMessageType::TYPE_MEASURED_VALUES)
+		throw SyntaxException("binary message is not measured_values");
+
+	const char *p = data + HEADER_SIZE;
+	const char *end = data + length;
+
+	SensorData sensorData = readSensorData(p, end);
+	if (p != end)
+		throw SyntaxException("binary measured_values has invalid length");
+
+	return sensorData;
+}
+
+vector<SensorData> ZMQBinaryMessage::toSensorDataBatch(
+	const char *data, size_t length)
+{
+	if (type(data, length).raw() != ZMQMessageType::TYPE_MEASURED_VALUES_BATCH)
+		throw SyntaxException("binary message is not measured_values_batch");
+
+	if (length < HEADER_SIZE + BATCH_SIZE)
+		throw SyntaxException("binary measured_values_batch is too short");
+
+	const char *p = data + HEADER_SIZE;
+	const char *end = data + length;
+
+	const size_t count = readUInt16(p);
+	p += BATCH_SIZE;
+
+	vector<SensorData> batch;
+	batch.reserve(count);
+
+	for (size_t i = 0; i < count; ++i)
+		batch.push_back(readSensorData(p, end));
+
+	if (p != end)
+		throw SyntaxException("binary measured_values_batch has invalid length");
+
+	return batch;
+}
@@ -0,0 +1,100 @@
+#ifndef BEEEON_ZMQ_BINARY_MESSAGE_H
+#define BEEEON_ZMQ_BINARY_MESSAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Poco/Nullable.h>
+
+#include "model/GlobalID.h"
+#include "zmq/ZMQMessageType.h"
+
+namespace BeeeOn {
+
+class SensorData;
+
+/*
+ * Compact binary encoding of the zmq messages. It is used instead
+ * of JSON on the data socket when negotiated by hello_request and
+ * hello_response (see ZMQMessageEncoding). Only the measured_values
+ * and measured_values_batch messages are encoded, all other messages
+ * are always sent as JSON.
+ *
+ * All numbers are little endian. Every message starts with a fixed
+ * header:
+ *
+ *  offset  size  description
+ *       0     1  magic 0xBE (never the first byte of a JSON message)
+ *       1     1  version of the encoding (1)
+ *       2     1  type of message (ZMQMessageType::Raw)
+ *       3     1  flags (bit 0: the id is present)
+ *       4    16  id of the message (GlobalID), zeros when not present
+ *
+ * The measured_values body follows:
+ *
+ *  offset  size  description
+ *      20     8  DeviceID
+ *      28     2  count of values
+ *      30  12*N  values: u16 ModuleID, u8 valid, u8 padding, f64 value
+ *
+ * The measured_values_batch body contains u16 count of records followed
+ * by the records in the same format as the measured_values body.
+ */
+class ZMQBinaryMessage {
+public:
+	enum {
+		MAGIC = 0xbe,
+		VERSION = 1,
+		HEADER_SIZE = 20,
+		SENSOR_DATA_SIZE = 10,
+		SENSOR_VALUE_SIZE = 12,
+		BATCH_SIZE = 2,
+	};
+
+	/*
+	 * Returns true when the given buffer contains a binary encoded
+	 * message (starts with the magic byte).
+	 */
+	static bool isBinary(const char *data, size_t length);
+
+	/*
+	 * Type of message from the header.
+	 * Throws Poco::SyntaxException when the header is invalid.
+	 */
+	static ZMQMessageType type(const char *data, size_t length);
+
+	/*
+	 * Id of message from the header, null if not present.
+	 */
+	static Poco::Nullable<GlobalID> id(const char *data, size_t length);
+
+	static std::string fromSensorData(const SensorData &sensorData,
+		const Poco::Nullable<GlobalID> &id = Poco::Nullable<GlobalID>());
+
+	/*
+	 * Reads the message of type measured_values.
+	 * Throws Poco::SyntaxException when the message is malformed.
+	 */
+	static SensorData toSensorData(const char *data, size_t length);
+
+	static std::string fromSensorDataBatch(const std::vector<SensorData> &batch,
+		const Poco::Nullable<GlobalID> &id = Poco::Nullable<GlobalID>());
+
+	/*
+	 * Reads the message of type measured_values_batch.
+	 * Throws Poco::SyntaxException when the message is malformed.
+	 */
+	static std::vector<SensorData> toSensorDataBatch(
+		const char *data, size_t length);
+
+private:
+	static void writeHeader(std::string &buffer,
+		const ZMQMessageType &type, const Poco::Nullable<GlobalID> &id);
+	static void checkHeader(const char *data, size_t length);
+};
+
+}
+
+#endif
@@ -1,11 +1,15 @@
+#include <algorithm>
+#include <errno.h>
 #include <unistd.h>
 
 #include "di/Injectable.h"
 #include "model/DeviceManagerID.h"
 #include "model/SensorData.h"
 #include "util/ZMQUtil.h"
+#include "zmq/ZMQBinaryMessage.h"
 #include "zmq/ZMQBroker.h"
 #include "zmq/ZMQMessage.h"
+#include "zmq/ZMQMessageParser.h"
 
 BEEEON_OBJECT_BEGIN(BeeeOn, ZMQBroker)
 BEEEON_OBJECT_CASTABLE(StoppableRunnable)
@@ -16,11 +20,23 @@ BEEEON_OBJECT_TEXT("helloServerHost", &ZMQBroker::setHelloServerHost)
 BEEEON_OBJECT_NUMBER("helloServerPort", &ZMQBroker::setHelloServerPort)
 BEEEON_OBJECT_REF("distributor", &ZMQBroker::setDistributor)
 BEEEON_OBJECT_REF("commandDispatcher", &ZMQBroker::setCommandDispatcher)
-BEEEON_OBJECT_REF("fakeHandlerTest", &ZMQBroker::setFakeHandlerTest)
+BEEEON_OBJECT_NUMBER("reactor", &ZMQBroker::setReactor)
+BEEEON_OBJECT_NUMBER("workers", &ZMQBroker::setWorkers)
+BEEEON_OBJECT_TEXT("encoding", &ZMQBroker::setEncoding)
+BEEEON_OBJECT_NUMBER("requestTTL", &ZMQBroker::setRequestTTL)
+BEEEON_OBJECT_NUMBER("requestCapacity", &ZMQBroker::setRequestCapacity)
+BEEEON_OBJECT_NUMBER("heartbeatInterval", &ZMQBroker::setHeartbeatInterval)
+BEEEON_OBJECT_NUMBER("heartbeatLiveness", &ZMQBroker::setHeartbeatLiveness)
+BEEEON_OBJECT_NUMBER("creditWindow", &ZMQBroker::setCreditWindow)
 BEEEON_OBJECT_END(BeeeOn, ZMQBroker)
 
 const int LOOP_USLEEP = 100;
 const int QUEUE_WAIT = 10000;
+const long EXPIRE_PERIOD = 1000;
+const string WORKER_ADDRESS = "inproc://zmq-broker-worker-";
+const string RETURN_ADDRESS = "inproc://zmq-broker-return";
+const unsigned int DEFAULT_HEARTBEAT_LIVENESS = 3;
+const unsigned long DROP_LOG_PERIOD = 1024;
 
 using namespace BeeeOn;
 using namespace Poco;
@@ -29,10 +45,17 @@ using namespace std;
 ZMQBroker::ZMQBroker():
 	ZMQConnector(),
 	CommandHandler("ZMQBroker"),
-	m_timer(0, 1000),
-	m_callback(*this, &ZMQBroker::checkSettingTable)
+	m_reactor(false),
+	m_encoding(ZMQMessageEncoding::fromRaw(ZMQMessageEncoding::ENCODING_JSON)),
+	m_workerCount(0),
+	m_heartbeatInterval(0),
+	m_heartbeatLiveness(DEFAULT_HEARTBEAT_LIVENESS),
+	m_liveness(UINT8_MAX + 1, Liveness{false, DeviceManagerID(), 0}),
+	m_creditWindow(0),
+	m_credits(UINT8_MAX + 1, Credits{DeviceManagerID(), 0, 0, 0, false}),
+	m_creditsGranted(0),
+	m_framesDropped(0)
 {
-	m_timer.start(m_callback);
 }
 
 void ZMQBroker::setDistributor(SharedPtr<Distributor> distributor)
@@ -40,6 +63,19 @@ void ZMQBroker::setDistributor(SharedPtr<Distributor> distributor)
 	m_distributor = distributor;
 }
 
+/*
+ * The DeviceSetValueCommand is served only when there is a device
+ * manager of the appropriate prefix, accept() checks it.
+ */
+vector<CommandHandler::Route> ZMQBroker::routes() const
+{
+	return {
+		Route::of<DeviceSetValueCommand>(true),
+		Route::of<DeviceUnpairCommand>(),
+		Route::of<GatewayListenCommand>(),
+	};
+}
+
 bool ZMQBroker::accept(const Command::Ptr cmd)
 {
 	if (cmd->is<DeviceSetValueCommand>()) {
@@ -60,34 +96,234 @@ bool ZMQBroker::accept(const Command::Ptr cmd)
 
 void ZMQBroker::handle(Command::Ptr cmd, Answer::Ptr answer)
 {
-	vector<DeviceManagerID> managers;
+	const ZMQDeviceManagerTable::Snapshot::Ptr snapshot =
+		m_deviceManagersTable.snapshot();
+	ZMQDeviceManagerTable::Snapshot::Range managers(
+		snapshot->all().end(), snapshot->all().end());
+	Nullable<Timestamp> deadline;
 
 	if (cmd->is<DeviceSetValueCommand>()) {
 		DeviceSetValueCommand::Ptr setCmd = cmd.cast<DeviceSetValueCommand>();
-		managers = m_deviceManagersTable.getAll(setCmd->deviceID().prefix());
+		managers = snapshot->byPrefix(setCmd->deviceID().prefix());
 
-		Timestamp endTime = Timestamp() + setCmd->timeout().totalMicroseconds();
-		m_settingTable.insert(make_pair(
-				setCmd->deviceID(),
-				SettingValueItem{cmd, answer, endTime}));
+		deadline = Timestamp() + setCmd->timeout().totalMicroseconds();
 	}
 	else if (cmd->is<DeviceUnpairCommand>()) {
-		managers = m_deviceManagersTable.getAll(
+		managers = snapshot->byPrefix(
 			cmd.cast<DeviceUnpairCommand>()->deviceID().prefix());
 	}
 	else if (cmd->is<GatewayListenCommand>()) {
-		managers = m_deviceManagersTable.getAll();
+		managers = snapshot->range();
 	}
 
-	for (auto deviceManagerID : managers) {
+	for (auto &deviceManagerID : managers) {
 		ZMQMessage msg = ZMQMessage::fromCommand(cmd);
+		Result::Ptr result;
+
+		if (deadline.isNull())
+			result = new Result(answer);
+		else
+			result = new DeviceSetValueResult(answer);
+
+		enqueue(OutgoingCommand{
+			deviceManagerID,
+			msg.toString(),
+			msg.id(),
+			ResultData2{answer, cmd, result},
+			deadline});
+	}
+}
+
+void ZMQBroker::enqueue(const OutgoingCommand &command)
+{
+	FastMutex::ScopedLock guard(m_outgoingLock);
+	m_outgoing.push_back(command);
+
+	if (m_reactor)
+		m_answerEvent.set();
+}
+
+void ZMQBroker::sendQueued()
+{
+	deque<OutgoingCommand> outgoing;
+
+	{
+		FastMutex::ScopedLock guard(m_outgoingLock);
+		outgoing.swap(m_outgoing);
+	}
+
+	for (auto &item : outgoing) {
+		vector<ResultData2> evicted;
+		m_cmdTable.insert(item.id, item.data, evicted);
+
+		for (auto &data : evicted) {
+			logger().warning("too many pending commands, dropping "
+				+ data.cmd->name());
+
+			completeSetting(data.result);
+			failResult(data.result);
+		}
+
+		if (!item.deadline.isNull()) {
+			Result::Ptr result = item.data.result;
+
+			m_settingTable[result.get()] =
+				m_settingWheel.schedule(item.deadline.value(), result);
+		}
+
+		ZMQUtil::sendMultipart(m_dataServerSocket,
+			item.deviceManagerID.toString(), std::move(item.message));
+	}
+}
+
+long ZMQBroker::pollTimeout() const
+{
+	const Timespan timeout = m_settingWheel.nextTimeout(Timestamp());
+	const bool waiting = !m_cmdTable.empty() || !m_resultTable.empty();
+	long result = timeout.totalMilliseconds();
+
+	if (waiting)
+		result = result < 0 ? EXPIRE_PERIOD : min<long>(result, EXPIRE_PERIOD);
+
+	// check the liveness of device managers periodically
+	if (m_heartbeatInterval > 0) {
+		const long interval = m_heartbeatInterval.totalMilliseconds();
+		result = result < 0 ? interval : min<long>(result, interval);
+	}
+
+	return result;
+}
+
+void ZMQBroker::expireSettings()
+{
+	vector<Result::Ptr> expired;
+	m_settingWheel.advance(Timestamp(), expired);
+
+	for (auto &result : expired) {
+		m_settingTable.erase(result.get());
+		failResult(result);
+	}
+}
+
+void ZMQBroker::completeSetting(Result::Ptr result)
+{
+	auto it = m_settingTable.find(result.get());
+	if (it == m_settingTable.end())
+		return;
+
+	m_settingWheel.cancel(it->second);
+	m_settingTable.erase(it);
+}
+
+void ZMQBroker::expireRequests()
+{
+	const Timestamp now;
+	vector<ResultData2> commands;
+	vector<ResultData> requests;
+
+	m_cmdTable.expire(now, commands);
+
+	for (auto &data : commands) {
+		if (logger().debug())
+			logger().debug("no result of " + data.cmd->name());
+
+		completeSetting(data.result);
+		failResult(data.result);
+	}
+
+	m_resultTable.expire(now, requests);
+
+	for (auto &data : requests) {
+		logger().warning("request " + data.resultID.toString()
+			+ " (" + data.cmd->name() + ") has not been answered");
+
+		m_answerQueue.remove(data.answer);
+	}
+}
 
-		m_cmdTable.insert(
-			make_pair(msg.id(), ResultData2{answer, cmd, new Result(answer)}));
+void ZMQBroker::failResult(Result::Ptr result)
+{
+	FastMutex::ScopedLock guard(result->lock());
+
+	if (result->statusUnlocked() != Result::PENDING)
+		return;
 
-		ZMQUtil::sendMultipart(m_dataServerSocket, deviceManagerID.toString());
-		ZMQUtil::send(m_dataServerSocket, msg.toString());
+	if (result->is<DeviceSetValueResult>()) {
+		result->cast<DeviceSetValueResult>().setExtendetSetStatusUnlocked(
+			DeviceSetValueResult::GW_DEVICE_TIMEOUT);
 	}
+
+	result->setStatusUnlocked(Result::FAILED);
+}
+
+void ZMQBroker::setReactor(bool reactor)
+{
+	m_reactor = reactor;
+}
+
+void ZMQBroker::setWorkers(const int workers)
+{
+	if (workers < 0)
+		throw InvalidArgumentException("number of workers must not be negative");
+
+	m_workerCount = workers;
+}
+
+void ZMQBroker::setHeartbeatInterval(const int interval)
+{
+	if (interval < 0)
+		throw InvalidArgumentException("heartbeat interval must not be negative");
+
+	m_heartbeatInterval = interval * Timespan::MILLISECONDS;
+}
+
+void ZMQBroker::setHeartbeatLiveness(const int liveness)
+{
+	if (liveness <= 0)
+		throw InvalidArgumentException("heartbeat liveness must be positive");
+
+	m_heartbeatLiveness = liveness;
+}
+
+void ZMQBroker::setCreditWindow(const int window)
+{
+	if (window < 0)
+		throw InvalidArgumentException("credit window must not be negative");
+
+	m_creditWindow = window;
+}
+
+unsigned long ZMQBroker::creditsGranted() const
+{
+	return m_creditsGranted;
+}
+
+unsigned long ZMQBroker::framesDropped() const
+{
+	return m_framesDropped;
+}
+
+void ZMQBroker::setEncoding(const string &encoding)
+{
+	m_encoding = ZMQMessageEncoding::parse(encoding);
+}
+
+void ZMQBroker::setRequestTTL(const int ttl)
+{
+	if (ttl <= 0)
+		throw InvalidArgumentException("request TTL must be positive");
+
+	m_cmdTable.setTTL(ttl * Timespan::MILLISECONDS);
+	m_resultTable.setTTL(ttl * Timespan::MILLISECONDS);
+}
+
+void ZMQBroker::setRequestCapacity(const int capacity)
+{
+	if (capacity <= 0)
+		throw InvalidArgumentException("request capacity must be positive");
+
+	m_cmdTable.setCapacity(capacity);
+	m_resultTable.setCapacity(capacity);
 }
 
 void ZMQBroker::run()
@@ -95,34 +331,166 @@ void ZMQBroker::run()
 	configureDataSockets();
 	configureHelloSockets();
 
+	if (m_workerCount > 0)
+		startWorkers();
+
+	if (m_reactor)
+		runReactor();
+	else
+		runPolling();
+
+	stopWorkers();
+
+	if (logger().debug())
+		logger().debug("ZMQ_REP and ZMQ_ROUTER stop");
+}
+
+void ZMQBroker::stop()
+{
+	ZMQConnector::stop();
+
+	// wake up the reactor blocked in zmq_poll()
+	m_answerEvent.set();
+}
+
+void ZMQBroker::startWorkers()
+{
+	const int linger = 0;
+
+	m_returnSocket.assign(new zmq::socket_t(m_context, ZMQ_PULL));
+	m_returnSocket->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+	m_returnSocket->bind(RETURN_ADDRESS);
+
+	for (unsigned int i = 0; i < m_workerCount; ++i) {
+		const string address = WORKER_ADDRESS + to_string(i);
+		SharedPtr<zmq::socket_t> socket = new zmq::socket_t(m_context, ZMQ_PUSH);
+
+		socket->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+		socket->bind(address);
+		m_workerSockets.push_back(socket);
+
+		m_workerRunner.addRunnable(
+			new ZMQBrokerWorker(*this, m_context, address, RETURN_ADDRESS));
+	}
+
+	m_workerRunner.start();
+
+	if (logger().debug())
+		logger().debug("started " + to_string(m_workerCount) + " workers");
+}
+
+void ZMQBroker::stopWorkers()
+{
+	if (m_workerSockets.empty())
+		return;
+
+	m_workerRunner.stop();
+
+	m_workerSockets.clear();
+	m_returnSocket = NULL;
+}
+
+void ZMQBroker::runPolling()
+{
 	while(!m_stop) {
 		dataServerReceive();
+		grantCredits();
+		returnedReceive();
 		helloServerReceive();
 		checkQueue();
 		usleep(LOOP_USLEEP);
 	}
+}
 
-	if (logger().debug())
-		logger().debug("ZMQ_REP and ZMQ_ROUTER stop");
+void ZMQBroker::runReactor()
+{
+	m_answerQueue.setFdEvent(&m_answerEvent);
+
+	zmq::pollitem_t items[] = {
+		{static_cast<void *>(*m_dataServerSocket), 0, ZMQ_POLLIN, 0},
+		{static_cast<void *>(*m_helloServerSocket), 0, ZMQ_POLLIN, 0},
+		{NULL, m_answerEvent.fd(), ZMQ_POLLIN, 0},
+		{NULL, -1, ZMQ_POLLIN, 0},
+	};
+
+	// the frames passed back by the workers
+	if (!m_returnSocket.isNull())
+		items[3].socket = static_cast<void *>(*m_returnSocket);
+
+	const int count = m_returnSocket.isNull() ? 3 : 4;
+
+	while (!m_stop) {
+		try {
+			zmq::poll(items, count, pollTimeout());
+		}
+		catch (zmq::error_t &ex) {
+			if (ex.num() == EINTR)
+				continue;
+
+			logger().error(string("zmq_poll failed: ") + ex.what(),
+				__FILE__, __LINE__);
+			break;
+		}
+
+		if (items[2].revents & ZMQ_POLLIN) {
+			m_answerEvent.reset();
+			checkQueue(0);
+		}
+
+		expireSettings();
+		expireRequests();
+		reapDeviceManagers();
+
+		while (!m_stop && ZMQUtil::hasInput(m_dataServerSocket))
+			dataServerReceive();
+
+		grantCredits();
+
+		while (!m_stop && ZMQUtil::hasInput(m_helloServerSocket))
+			helloServerReceive();
 
-	m_timer.stop();
+		while (!m_stop && count > 3 && ZMQUtil::hasInput(m_returnSocket))
+			returnedReceive();
+	}
+
+	m_answerQueue.setFdEvent(NULL);
 }
 
 void ZMQBroker::checkQueue()
 {
+	checkQueue(QUEUE_WAIT);
+}
+
+void ZMQBroker::checkQueue(const Timespan &timeout)
+{
+	expireSettings();
+	expireRequests();
+	reapDeviceManagers();
+	sendQueued();
+
 	std::list<Answer::Ptr> dirtyList;
-	m_answerQueue.wait(QUEUE_WAIT, dirtyList);
+	m_answerQueue.wait(timeout, dirtyList);
 
 	for (auto &answer : dirtyList) {
+		const ResultData *data = m_resultTable.find(answer.get());
+
+		if (data == NULL) {
+			logger().warning("unknown or expired answer");
+			m_answerQueue.remove(answer);
+			continue;
+		}
+
 		for (unsigned long i = 0; i < answer->resultsCount(); ++i) {
-			auto it = m_resultTable.find(answer);
+			ZMQMessage msg = ZMQMessage::fromResult(answer->at(i));
+			msg.setID(data->resultID);
 
 			ZMQUtil::sendMultipart(m_dataServerSocket,
-				it->second.deviceManagerID.toString());
+				data->deviceManagerID.toString(), msg.toString());
+		}
 
-			ZMQMessage msg = ZMQMessage::fromResult(answer->at(i));
-			msg.setID(it->second.resultID);
-			ZMQUtil::send(m_dataServerSocket, msg.toString());
+		if (!answer->isPending()) {
+			m_resultTable.remove(answer.get());
+			m_answerQueue.remove(answer);
 		}
 	}
 }
@@ -175,14 +543,16 @@ void ZMQBroker::configureHelloSockets()
 
 void ZMQBroker::helloServerReceive()
 {
-	string jsonMessage;
+	zmq::message_t frame;
 
-	if (!ZMQUtil::receive(m_helloServerSocket, jsonMessage))
+	if (!ZMQUtil::receive(m_helloServerSocket, frame))
 		return;
 
+	ZMQFrameView jsonMessage(frame);
+
 	if (logger().debug())
 		logger().debug("broker receive data (helloServerSocket):\n"
-			+ jsonMessage);
+			+ jsonMessage.toString());
 
 	ZMQMessage zmqMessage;
 	if (!parseMessage(jsonMessage, m_dataServerSocket, zmqMessage))
@@ -218,20 +588,264 @@ void ZMQBroker::handleHelloMessage(ZMQMessage &zmqMessage)
 
 void ZMQBroker::dataServerReceive()
 {
-	string deviceManagerID;
-	string jsonMessage;
+	zmq::message_t identity;
+	zmq::message_t frame;
+
+	if (!ZMQUtil::receive(m_dataServerSocket, identity)
+		|| !ZMQUtil::receive(m_dataServerSocket, frame))
+		return;
+
+	if (m_heartbeatInterval > 0 && !touchDeviceManager(identity))
+		return;
 
-	if (!ZMQUtil::receive(m_dataServerSocket, deviceManagerID)
-		|| !ZMQUtil::receive(m_dataServerSocket, jsonMessage))
+	if (m_creditWindow > 0 && !takeCredit(identity))
 		return;
 
+	if (m_workerSockets.empty()) {
+		handleDataFrame(identity, frame, true);
+		return;
+	}
+
+	// FNV-1a of the identity, it is the DeviceManagerID
+	const unsigned char *data = static_cast<const unsigned char *>(identity.data());
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < identity.size(); ++i)
+		hash = (hash ^ data[i]) * 16777619u;
+
+	zmq::socket_t &worker = *m_workerSockets[hash % m_workerSockets.size()];
+
+	worker.send(identity, ZMQ_SNDMORE);
+	worker.send(frame);
+}
+
+/*
+ * Parse the identity of a device manager (hex representation
+ * of its DeviceManagerID) without any allocation.
+ */
+static bool parseIdentity(const zmq::message_t &identity, uint16_t &id)
+{
+	const char *data = static_cast<const char *>(identity.data());
+	size_t size = identity.size();
+
+	if (size > 2 && data[0] == '0' && (data[1] == 'x' || data[1] == 'X')) {
+		data += 2;
+		size -= 2;
+	}
+
+	if (size == 0 || size > 4)
+		return false;
+
+	id = 0;
+
+	for (size_t i = 0; i < size; ++i) {
+		const char c = data[i];
+
+		if (c >= '0' && c <= '9')
+			id = (id << 4) | (c - '0');
+		else if (c >= 'a' && c <= 'f')
+			id = (id << 4) | (c - 'a' + 10);
+		else if (c >= 'A' && c <= 'F')
+			id = (id << 4) | (c - 'A' + 10);
+		else
+			return false;
+	}
+
+	return true;
+}
+
+bool ZMQBroker::touchDeviceManager(const zmq::message_t &identity)
+{
+	uint16_t value;
+
+	if (!parseIdentity(identity, value))
+		return true; // let the message be processed and reported
+
+	Liveness &liveness = m_liveness[value & 0xff];
+
+	if (liveness.registered && liveness.id.value() == value) {
+		liveness.lastSeen = Timestamp().epochMicroseconds();
+		return true;
+	}
+
+	try {
+		const DeviceManagerID deviceManagerID(value);
+
+		if (m_deviceManagersTable.registerDaemonID(deviceManagerID)) {
+			logger().information("device manager "
+				+ deviceManagerID.toString() + " is alive again");
+
+			markAlive(deviceManagerID);
+			resetCredits(deviceManagerID);
+			return true;
+		}
+
+		logger().warning("device manager " + deviceManagerID.toString()
+			+ " is not registered and its ident is used");
+	}
+	catch (const Exception &ex) {
+		logger().log(ex, __FILE__, __LINE__);
+	}
+
+	ZMQMessage msg = ZMQMessage::fromError(
+		ZMQMessageError::ERROR_UNKNOWN_DEVICE_MANAGER,
+		"unknown device manager, register again");
+
+	ZMQUtil::sendMultipart(m_dataServerSocket,
+		ZMQFrameView(identity).toString(), msg.toString());
+
+	return false;
+}
+
+void ZMQBroker::markAlive(const DeviceManagerID &deviceManagerID)
+{
+	m_liveness[deviceManagerID.ident()] = Liveness{
+		true, deviceManagerID, Timestamp().epochMicroseconds()};
+}
+
+void ZMQBroker::reapDeviceManagers()
+{
+	if (m_heartbeatInterval <= 0)
+		return;
+
+	if (!m_lastReap.isElapsed(m_heartbeatInterval.totalMicroseconds()))
+		return;
+
+	m_lastReap.update();
+
+	const Timestamp::TimeDiff limit = m_lastReap.epochMicroseconds()
+		- m_heartbeatInterval.totalMicroseconds() * m_heartbeatLiveness;
+
+	for (auto &liveness : m_liveness) {
+		if (!liveness.registered || liveness.lastSeen > limit)
+			continue;
+
+		logger().warning("device manager " + liveness.id.toString()
+			+ " is not alive, unregistering");
+
+		liveness.registered = false;
+
+		try {
+			m_deviceManagersTable.unregisterDaemon(liveness.id);
+		}
+		catch (const Exception &ex) {
+			logger().log(ex, __FILE__, __LINE__);
+		}
+	}
+}
+
+bool ZMQBroker::takeCredit(const zmq::message_t &identity)
+{
+	uint16_t value;
+
+	if (!parseIdentity(identity, value))
+		return true;
+
+	Credits &credits = m_credits[value & 0xff];
+
+	if (credits.id.value() != value)
+		return true;
+
+	if (credits.available == 0) {
+		if (credits.dropped++ % DROP_LOG_PERIOD == 0) {
+			logger().warning("device manager " + credits.id.toString()
+				+ " exceeds its credits, dropped "
+				+ to_string(credits.dropped) + " messages so far");
+		}
+
+		m_framesDropped++;
+		return false;
+	}
+
+	credits.available -= 1;
+	credits.consumed += 1;
+
+	if (!credits.pending) {
+		credits.pending = true;
+		m_pendingCredits.push_back(value & 0xff);
+	}
+
+	return true;
+}
+
+void ZMQBroker::resetCredits(const DeviceManagerID &deviceManagerID)
+{
+	Credits &credits = m_credits[deviceManagerID.ident()];
+
+	credits.id = deviceManagerID;
+	credits.available = m_creditWindow;
+	credits.consumed = 0;
+	credits.dropped = 0;
+}
+
+void ZMQBroker::grantCredits()
+{
+	if (m_pendingCredits.empty())
+		return;
+
+	// grant in chunks to save messages, the device manager has still
+	// at least a half of the window when it is not granted
+	const unsigned int threshold = max(m_creditWindow / 2, 1u);
+	size_t kept = 0;
+
+	for (const auto ident : m_pendingCredits) {
+		Credits &credits = m_credits[ident];
+
+		if (credits.consumed < threshold) {
+			m_pendingCredits[kept++] = ident;
+			continue;
+		}
+
+		ZMQMessage msg = ZMQMessage::fromCredit(credits.consumed);
+
+		ZMQUtil::sendMultipart(m_dataServerSocket,
+			credits.id.toString(), msg.toString());
+
+		m_creditsGranted += credits.consumed;
+		credits.available += credits.consumed;
+		credits.consumed = 0;
+		credits.pending = false;
+	}
+
+	m_pendingCredits.resize(kept);
+}
+
+void ZMQBroker::returnedReceive()
+{
+	if (m_returnSocket.isNull())
+		return;
+
+	zmq::message_t identity;
+	zmq::message_t frame;
+
+	if (!ZMQUtil::receive(m_returnSocket, identity)
+		|| !ZMQUtil::receive(m_returnSocket, frame))
+		return;
+
+	handleDataFrame(identity, frame, false);
+}
+
+void ZMQBroker::handleDataFrame(const zmq::message_t &identity,
+		const zmq::message_t &frame, bool fastPath)
+{
+	const string deviceManagerID = ZMQFrameView(identity).toString();
+	ZMQFrameView jsonMessage(frame);
+
 	if (logger().debug()) {
 		logger().debug(
 			"broker receive data (dataServerSocket) from: "
 			+ deviceManagerID + "\n"
-			+ jsonMessage);
+			+ jsonMessage.toString());
+	}
+
+	if (ZMQBinaryMessage::isBinary(jsonMessage.data(), jsonMessage.size())) {
+		handleBinaryMessage(jsonMessage);
+		return;
 	}
 
+	if (fastPath && handleMeasuredValues(jsonMessage))
+		return;
+
 	ZMQMessage zmqMessage;
 	if (!parseMessage(jsonMessage, m_dataServerSocket, zmqMessage))
 		return;
@@ -253,14 +867,127 @@ void ZMQBroker::dataServerReceive()
 	}
 }
 
+void ZMQBroker::handleBinaryMessage(const ZMQFrameView &message)
+{
+	if (m_encoding.raw() != ZMQMessageEncoding::ENCODING_BINARY) {
+		sendError(
+			ZMQMessageError::ERROR_UNSUPPORTED_MESSAGE,
+			"binary encoding is not enabled",
+			m_dataServerSocket);
+		return;
+	}
+
+	try {
+		switch (ZMQBinaryMessage::type(message.data(), message.size()).raw()) {
+		case ZMQMessageType::TYPE_MEASURED_VALUES:
+			exportSensorData(ZMQBinaryMessage::toSensorData(
+				message.data(), message.size()));
+			break;
+		case ZMQMessageType::TYPE_MEASURED_VALUES_BATCH:
+			exportSensorDataBatch(ZMQBinaryMessage::toSensorDataBatch(
+				message.data(), message.size()));
+			break;
+		default:
+			sendError(
+				ZMQMessageError::ERROR_UNSUPPORTED_MESSAGE,
+				"unsupported binary message type",
+				m_dataServerSocket);
+		}
+	}
+	catch (const SyntaxException &ex) {
+		logger().log(ex, __FILE__, __LINE__);
+
+		sendError(
+			ZMQMessageError::ERROR_UNSUPPORTED_MESSAGE,
+			"malformed binary message",
+			m_dataServerSocket);
+	}
+}
+
+bool ZMQBroker::exportMeasuredValues(const ZMQFrameView &message)
+{
+	if (!ZMQBinaryMessage::isBinary(message.data(), message.size()))
+		return handleMeasuredValues(message);
+
+	if (m_encoding.raw() != ZMQMessageEncoding::ENCODING_BINARY)
+		return false;
+
+	try {
+		switch (ZMQBinaryMessage::type(message.data(), message.size()).raw()) {
+		case ZMQMessageType::TYPE_MEASURED_VALUES:
+			exportSensorData(ZMQBinaryMessage::toSensorData(
+				message.data(), message.size()));
+			return true;
+		case ZMQMessageType::TYPE_MEASURED_VALUES_BATCH:
+			exportSensorDataBatch(ZMQBinaryMessage::toSensorDataBatch(
+				message.data(), message.size()));
+			return true;
+		default:
+			return false;
+		}
+	}
+	catch (const Exception &) {
+		// let the broker thread report the error
+		return false;
+	}
+}
+
+bool ZMQBroker::handleMeasuredValues(const ZMQFrameView &jsonMessage)
+{
+	vector<SensorData> data;
+
+	try {
+		switch (ZMQMessageParser::parse(
+				jsonMessage.data(), jsonMessage.size(), data).raw()) {
+		case ZMQMessageType::TYPE_MEASURED_VALUES:
+			exportSensorData(data.front());
+			return true;
+		case ZMQMessageType::TYPE_MEASURED_VALUES_BATCH:
+			exportSensorDataBatch(data);
+			return true;
+		default:
+			return false;
+		}
+	}
+	catch (const Exception &) {
+		// let the generic path report the error
+		return false;
+	}
+}
+
+void ZMQBroker::exportSensorData(const SensorData &sensorData)
+{
+	try {
+		m_distributor->exportData(sensorData);
+	}
+	catch (const Exception &ex) {
+		logger().log(ex, __FILE__, __LINE__);
+	}
+}
+
+void ZMQBroker::exportSensorDataBatch(const vector<SensorData> &batch)
+{
+	try {
+		m_distributor->exportBatch(batch);
+	}
+	catch (const Exception &ex) {
+		logger().log(ex, __FILE__, __LINE__);
+	}
+}
+
 void ZMQBroker::handleDataMessage(ZMQMessage &zmqMessage,
 		const DeviceManagerID &deviceManagerID)
 {
 	switch (zmqMessage.type().raw()) {
 	case ZMQMessageType::TYPE_MEASURED_VALUES:
 		m_distributor->exportData(zmqMessage.toSensorData());
-		m_fakeHandlerTest->addPairedDeviceID(zmqMessage.toSensorData().deviceID()); // for testing
 		break;
+	case ZMQMessageType::TYPE_MEASURED_VALUES_BATCH: {
+		const vector<SensorData> batch = zmqMessage.toSensorDataBatch();
+
+		m_distributor->exportBatch(batch);
+		break;
+	}
 	case ZMQMessageType::TYPE_DEFAULT_RESULT:
 		doDefaultResult(zmqMessage);
 		break;
@@ -270,6 +997,9 @@ void ZMQBroker::handleDataMessage(ZMQMessage &zmqMessage,
 	case ZMQMessageType::TYPE_DEVICE_LIST_CMD:
 		doDeviceListCommand(zmqMessage, deviceManagerID);
 		break;
+	case ZMQMessageType::TYPE_HEARTBEAT:
+		// the liveness is updated for every received message
+		break;
 	default:
 		sendError(
 			ZMQMessageError::ERROR_UNSUPPORTED_MESSAGE,
@@ -284,9 +1014,7 @@ void ZMQBroker::doDeviceListCommand(ZMQMessage &zmqMessage,
 	Answer::Ptr answer = new Answer(m_answerQueue);
 	ServerDeviceListCommand::Ptr cmd = zmqMessage.toDeviceListRequest();
 
-	m_resultTable.insert(
-		make_pair(answer, ResultData{zmqMessage.id(),deviceManagerID, cmd}));
-
+	registerRequest(ResultData{answer, zmqMessage.id(), deviceManagerID, cmd});
 	m_commandDispatcher->dispatch(cmd, answer);
 }
 
@@ -296,21 +1024,42 @@ void ZMQBroker::doDeviceLastValueCommand(ZMQMessage &zmqMessage,
 	Answer::Ptr answer =  new Answer(m_answerQueue);
 	ServerLastValueCommand::Ptr cmd = zmqMessage.toServerLastValueCommand();
 
-	m_resultTable.insert(
-		make_pair(answer, ResultData{zmqMessage.id(),deviceManagerID, cmd}));
-
+	registerRequest(ResultData{answer, zmqMessage.id(), deviceManagerID, cmd});
 	m_commandDispatcher->dispatch(cmd, answer);
 }
 
+void ZMQBroker::registerRequest(const ResultData &data)
+{
+	vector<ResultData> evicted;
+	m_resultTable.insert(data.answer.get(), data, evicted);
+
+	for (auto &item : evicted) {
+		logger().warning("too many pending requests, dropping "
+			+ item.resultID.toString());
+
+		m_answerQueue.remove(item.answer);
+	}
+}
+
 void ZMQBroker::doDefaultResult(ZMQMessage &zmqMessage)
 {
-	auto it = m_cmdTable.find(zmqMessage.id());
+	ResultData2 data;
 
-	if (it == m_cmdTable.end())
-		logger().warning("unknown result id");
+	if (!m_cmdTable.take(zmqMessage.id(), data)) {
+		logger().warning("unknown or expired result id "
+			+ zmqMessage.id().toString());
+		return;
+	}
 
-	Result::Ptr result = it->second.result;
+	Result::Ptr result = data.result;
 
+	if (result->status() != Result::PENDING) {
+		logger().warning("result " + zmqMessage.id().toString()
+			+ " came too late");
+		return;
+	}
+
+	completeSetting(result);
 	zmqMessage.toDefaultResult(result);
 }
 
@@ -324,12 +1073,45 @@ unsigned long ZMQBroker::deviceManagersCount()
 	return m_deviceManagersTable.count();
 }
 
+/*
+ * The previous DeviceManagerID of the device manager if it asks
+ * to resume it and it is valid for the given prefix.
+ */
+static Nullable<DeviceManagerID> resumeID(ZMQMessage &zmqMessage,
+		const DevicePrefix &prefix)
+{
+	Nullable<DeviceManagerID> deviceManagerID;
+
+	try {
+		deviceManagerID = zmqMessage.resumeID();
+	}
+	catch (const Exception &) {
+		deviceManagerID.clear();
+	}
+
+	if (!deviceManagerID.isNull() && deviceManagerID.value().prefix() != prefix)
+		deviceManagerID.clear();
+
+	return deviceManagerID;
+}
+
 void ZMQBroker::registerDeviceManager(ZMQMessage &zmqMessage)
 {
 	try {
-		DeviceManagerID deviceManagerID =
-			m_deviceManagersTable.registerDaemonPrefix(
-				zmqMessage.toHelloRequest());
+		const DevicePrefix prefix = zmqMessage.toHelloRequest();
+		const Nullable<DeviceManagerID> previous = resumeID(zmqMessage, prefix);
+		DeviceManagerID deviceManagerID;
+
+		if (!previous.isNull()
+				&& m_deviceManagersTable.registerDaemonID(previous.value())) {
+			deviceManagerID = previous.value();
+		}
+		else {
+			deviceManagerID = m_deviceManagersTable.registerDaemonPrefix(prefix);
+		}
+
+		markAlive(deviceManagerID);
+		resetCredits(deviceManagerID);
 
 		if (logger().debug())
 			logger().debug("register device manager id: "
@@ -337,6 +1119,16 @@ void ZMQBroker::registerDeviceManager(ZMQMessage &zmqMessage)
 
 		ZMQMessage msg = ZMQMessage::fromHelloResponse(deviceManagerID);
 
+		if (m_heartbeatInterval > 0)
+			msg.setHeartbeatInterval(m_heartbeatInterval);
+
+		if (m_creditWindow > 0)
+			msg.setCreditWindow(m_creditWindow);
+
+		if (m_encoding == ZMQMessageEncoding::ENCODING_BINARY
+				&& zmqMessage.encoding() == ZMQMessageEncoding::ENCODING_BINARY)
+			msg.setEncoding(m_encoding);
+
 		ZMQUtil::send(m_helloServerSocket, msg.toString());
 	}
 	catch(RangeException &ex) {
@@ -348,35 +1140,3 @@ void ZMQBroker::registerDeviceManager(ZMQMessage &zmqMessage)
 			m_helloServerSocket);
 	}
 }
-
-void ZMQBroker::setFakeHandlerTest(SharedPtr<FakeHandlerTest> handler)
-{
-	m_fakeHandlerTest = handler;
-}
-
-void ZMQBroker::checkSettingTable(Timer &)
-{
-	for (auto item : m_settingTable) {
-		if (item.second.answer->resultsCount() == 0)
-			continue;
-
-		DeviceSetValueResult::Ptr result =
-			item.second.answer->at(0).cast<DeviceSetValueResult>();
-
-		if (Timestamp() > item.second.endTime) {
-			result->setExtendetSetStatus(DeviceSetValueResult::GW_DEVICE_TIMEOUT);
-			m_settingTable.erase(item.first);
-		}
-
-		if (result->extendetSetStatus() == DeviceSetValueResult::DEVICE_FAILED) {
-			result->setExtendetSetStatus(DeviceSetValueResult::GW_DEVICE_FAILED);
-			m_settingTable.erase(item.first);
-		}
-
-		if (result->extendetSetStatus() == DeviceSetValueResult::DEVICE_SUCCESS) {
-			result->setExtendetSetStatus(DeviceSetValueResult::GW_DEVICE_SUCCESS);
-			m_settingTable.erase(item.first);
-		}
-	}
-
-}
@@ -1,17 +1,29 @@
 #ifndef BEEEON_ZMQ_BROKER_H
 #define BEEEON_ZMQ_BROKER_H
 
-#include <map>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include <Poco/Nullable.h>
+#include <Poco/Timespan.h>
+#include <Poco/Timestamp.h>
 
 #include "core/AnswerQueue.h"
 #include "core/CommandDispatcher.h"
 #include "core/CommandHandler.h"
 #include "core/Distributor.h"
+#include "loop/LoopRunner.h"
 #include "loop/StoppableLoop.h"
 #include "model/GlobalID.h"
+#include "util/CorrelationRegistry.h"
+#include "util/FdEvent.h"
+#include "util/TimingWheel.h"
+#include "zmq/ZMQBrokerWorker.h"
 #include "zmq/ZMQConnector.h"
 #include "zmq/ZMQDeviceManagerTable.h"
-#include "zmq/FakeHandlerTest.h"
+#include "zmq/ZMQMessageEncoding.h"
 
 namespace BeeeOn {
 
@@ -19,6 +31,7 @@ class ZMQProtocolMessage;
 
 class DeviceManagerID;
 class Distributor;
+class SensorData;
 
 /*
  * ZMQBroker ensures data receiving using zmq protocol.
@@ -28,15 +41,122 @@ class Distributor;
  * and measured values. The type of the HelloSocket is a
  * server-client and this socket serves for registering of
  * device mangers to enable communication using dataSocket.
+ *
+ * By default, the broker polls both sockets and the AnswerQueue
+ * periodically. In the reactor mode (setReactor(true)) the broker
+ * blocks in zmq_poll() on both sockets and on an FdEvent signalled
+ * by the AnswerQueue. Every wake-up drains all messages that are
+ * ready, so there is no added latency and an idle broker does
+ * not consume CPU.
+ *
+ * Deadlines of DeviceSetValueCommands are kept in a TimingWheel
+ * owned by the broker's loop. The reactor sleeps at most until
+ * the nearest deadline, so the timeouts are reported with the
+ * resolution of 1 ms (about QUEUE_WAIT in the polling mode).
+ * A result received in time cancels the deadline.
+ *
+ * Requests waiting for a response (commands sent to device managers
+ * and requests of device managers dispatched to the CommandDispatcher)
+ * are kept in CorrelationRegistries. An entry is removed when its
+ * response is processed or after requestTTL at the latest, so the
+ * broker does not accumulate requests that are never answered.
+ * Results of the expired commands are reported as failed.
+ *
+ * In the sharded mode (setWorkers(N) with N > 0), the broker thread
+ * only forwards frames received on the data socket to N workers
+ * via inproc sockets. A device manager is always assigned to the same
+ * worker by its DeviceManagerID. The workers parse and export measured
+ * values in parallel, other messages are passed back to the broker
+ * thread that sends all replies via the data socket.
+ *
+ * When the heartbeat interval is set, the broker announces it to
+ * the device managers in hello_response and tracks the time it has
+ * received the last message (of any type) from each of them. Device
+ * managers silent for heartbeatLiveness intervals are unregistered
+ * and their idents are reused. A device manager that comes back
+ * continues with its previous DeviceManagerID (on its first message
+ * or via hello_request) unless the ID has been assigned to another
+ * device manager meanwhile. Commands waiting for its results are kept
+ * until requestTTL, so they are not lost by a short outage.
+ *
+ * When the credit window is set, the broker limits the number of
+ * messages each device manager may send before it is processed.
+ * The window is announced in hello_response and every frame received
+ * via the data socket consumes a credit, so the frames are not parsed
+ * by the receiving thread to be charged. The consumed
+ * credits are granted back by the message credit after the data
+ * socket has been drained, so a device manager can never have more
+ * than the window of messages queued in the broker. Messages received
+ * without a credit are dropped before they are parsed, thus a device
+ * manager ignoring the credits cannot starve the others. In the sharded
+ * mode, the credits are granted when the messages are passed to
+ * the workers.
+ *
+ * The broker accepts the binary encoding of measured_values
+ * (ZMQBinaryMessage) from device managers that ask for it during
+ * registration, when enabled by setEncoding("binary"). JSON is
+ * always accepted.
  */
 class ZMQBroker : public ZMQConnector, public CommandHandler {
 public:
 	ZMQBroker();
 
+	std::vector<Route> routes() const override;
 	bool accept(const Command::Ptr cmd) override;
 	void handle(Command::Ptr cmd, Answer::Ptr answer) override;
 
 	void run() override;
+	void stop() override;
+
+	void setReactor(bool reactor);
+
+	/*
+	 * Number of worker threads exporting measured values,
+	 * 0 means that everything is done by the broker thread.
+	 */
+	void setWorkers(const int workers);
+
+	/*
+	 * Export measured values contained in the given frame. Returns
+	 * false when it is another message or when it cannot be parsed.
+	 * It is thread-safe, the workers call it concurrently.
+	 */
+	bool exportMeasuredValues(const ZMQFrameView &message);
+
+	/*
+	 * Time in milliseconds to wait for a response of a request
+	 * and the maximal number of requests waiting for a response.
+	 */
+	void setRequestTTL(const int ttl);
+	void setRequestCapacity(const int capacity);
+
+	/*
+	 * Interval of heartbeats in milliseconds expected from device
+	 * managers, 0 disables tracking of their liveness. A device
+	 * manager is considered dead after the given number (liveness)
+	 * of intervals without any message.
+	 */
+	void setHeartbeatInterval(const int interval);
+	void setHeartbeatLiveness(const int liveness);
+
+	/*
+	 * Number of messages a device manager may send without
+	 * waiting for credits, 0 disables the flow control.
+	 */
+	void setCreditWindow(const int window);
+
+	/*
+	 * Credits granted to device managers and messages dropped
+	 * because of missing credits so far.
+	 */
+	unsigned long creditsGranted() const;
+	unsigned long framesDropped() const;
+
+	/*
+	 * The most compact encoding ("json" or "binary") the broker
+	 * accepts from device managers.
+	 */
+	void setEncoding(const std::string &encoding);
 
 	void setDistributor(Poco::SharedPtr<Distributor> distributor);
 
@@ -44,8 +164,6 @@ public:
 
 	unsigned long deviceManagersCount();
 
-	void setFakeHandlerTest(Poco::SharedPtr<FakeHandlerTest> handler);
-
 protected:
 	void configureDataSockets() override;
 	void configureHelloSockets() override;
@@ -53,7 +171,70 @@ protected:
 	void dataServerReceive() override;
 	void helloServerReceive() override;
 
+	/*
+	 * Receive a frame passed back by a worker.
+	 */
+	void returnedReceive();
+
+	/*
+	 * Process a frame of a device manager received on the data
+	 * socket. The fast path of measured values is skipped when
+	 * the frame has been passed back by a worker.
+	 */
+	void handleDataFrame(const zmq::message_t &identity,
+		const zmq::message_t &frame, bool fastPath);
+
+	void startWorkers();
+	void stopWorkers();
+
+	/*
+	 * Record a message received from the device manager of the given
+	 * identity. A device manager that is not registered (it has been
+	 * considered dead) is registered again with the same ID if
+	 * possible. Returns false when the message must be dropped.
+	 */
+	bool touchDeviceManager(const zmq::message_t &identity);
+
+	void markAlive(const DeviceManagerID &deviceManagerID);
+
+	/*
+	 * Unregister the device managers that have not sent anything
+	 * for heartbeatLiveness intervals.
+	 */
+	void reapDeviceManagers();
+
+	/*
+	 * Consume a credit of the device manager of the given identity.
+	 * Returns false when there is no credit and the frame must
+	 * be dropped.
+	 */
+	bool takeCredit(const zmq::message_t &identity);
+
+	void resetCredits(const DeviceManagerID &deviceManagerID);
+
+	/*
+	 * Grant back the credits consumed by the processed messages.
+	 */
+	void grantCredits();
+
 	void handleHelloMessage(ZMQMessage &zmqMessage);
+
+	/*
+	 * Fast path for the most frequent messages measured_values
+	 * and measured_values_batch.
+	 * The message is parsed by ZMQMessageParser in a single pass
+	 * without building the JSON DOM. Returns false when the message
+	 * is not measured values or when it cannot be parsed, in such case
+	 * the message must be processed by the generic path that
+	 * reports the errors.
+	 */
+	bool handleMeasuredValues(const ZMQFrameView &jsonMessage);
+
+	void handleBinaryMessage(const ZMQFrameView &message);
+
+	void exportSensorData(const SensorData &sensorData);
+	void exportSensorDataBatch(const std::vector<SensorData> &batch);
+
 	void handleDataMessage(ZMQMessage &zmqMessage,
 		const DeviceManagerID &deviceManagerID);
 
@@ -63,9 +244,53 @@ protected:
 	 */
 	void registerDeviceManager(ZMQMessage &zmqMessage);
 
+	/*
+	 * Main loop that polls the sockets and the AnswerQueue
+	 * periodically.
+	 */
+	void runPolling();
+
+	/*
+	 * Main loop driven by zmq_poll(), it sleeps until there
+	 * is a message or an updated Answer to be processed.
+	 */
+	void runReactor();
+
+	/*
+	 * Sends queued commands to device managers and sends results
+	 * of the updated Answers.
+	 */
 	void checkQueue();
+	void checkQueue(const Poco::Timespan &timeout);
+
+	/*
+	 * Time until the nearest deadline of a DeviceSetValueCommand
+	 * in milliseconds or -1 when there is none.
+	 */
+	long pollTimeout() const;
+
+	/*
+	 * Report the expired DeviceSetValueCommands as failed with
+	 * the extended status GW_DEVICE_TIMEOUT.
+	 */
+	void expireSettings();
+
+	/*
+	 * Cancel deadline of the given result if any.
+	 */
+	void completeSetting(Result::Ptr result);
+
+	/*
+	 * Drop the requests waiting for a response longer than
+	 * requestTTL. Results of the dropped commands are failed.
+	 */
+	void expireRequests();
 
-	void checkSettingTable(Poco::Timer &timer);
+	/*
+	 * Set the result as FAILED unless it is already finished.
+	 * The DeviceSetValueResult is marked as GW_DEVICE_TIMEOUT.
+	 */
+	void failResult(Result::Ptr result);
 
 	void doDefaultResult(ZMQMessage &zmqMessage);
 
@@ -77,6 +302,7 @@ protected:
 
 protected:
 	struct ResultData {
+		Answer::Ptr answer;
 		GlobalID resultID;
 		DeviceManagerID deviceManagerID;
 		Command::Ptr cmd;
@@ -88,25 +314,91 @@ protected:
 		Result::Ptr result;
 	};
 
+	/*
+	 * Register a request of a device manager dispatched via the given
+	 * Answer. Its results are sent back with the id of the request.
+	 */
+	void registerRequest(const ResultData &data);
+
+	/*
+	 * Command to be sent to a device manager together with data
+	 * to match its result. The deadline is set for commands that
+	 * time out (DeviceSetValueCommand).
+	 */
+	struct OutgoingCommand {
+		DeviceManagerID deviceManagerID;
+		std::string message;
+		GlobalID id;
+		ResultData2 data;
+		Poco::Nullable<Poco::Timestamp> deadline;
+	};
+
+	/*
+	 * Commands are handled in threads of the CommandDispatcher but
+	 * the zmq socket and the tables of pending commands must be used
+	 * only by the thread of the broker. Outgoing commands are thus
+	 * queued and registered and sent by sendQueued().
+	 */
+	void enqueue(const OutgoingCommand &command);
+	void sendQueued();
+
 protected:
 	Poco::SharedPtr<Distributor> m_distributor;
 	Poco::SharedPtr<CommandDispatcher> m_commandDispatcher;
 	ZMQDeviceManagerTable m_deviceManagersTable;
-	std::map<Answer::Ptr, ResultData> m_resultTable;
+	CorrelationRegistry<const Answer *, ResultData> m_resultTable;
 	AnswerQueue m_answerQueue;
+	FdEvent m_answerEvent;
+	bool m_reactor;
+	ZMQMessageEncoding m_encoding;
 
-	std::map<GlobalID, ResultData2> m_cmdTable;
-	Poco::SharedPtr<FakeHandlerTest> m_fakeHandlerTest;
+	unsigned int m_workerCount;
+	LoopRunner m_workerRunner;
+	std::vector<Poco::SharedPtr<zmq::socket_t>> m_workerSockets;
+	Poco::SharedPtr<zmq::socket_t> m_returnSocket;
 
-	Poco::Timer m_timer;
-	Poco::TimerCallback<ZMQBroker> m_callback;
+	/*
+	 * Liveness of the registered device managers indexed by their
+	 * idents (unique among all prefixes). It is used only by
+	 * the thread of the broker.
+	 */
+	struct Liveness {
+		bool registered;
+		DeviceManagerID id;
+		Poco::Timestamp::TimeDiff lastSeen;
+	};
 
-	struct SettingValueItem {
-		Command::Ptr cmd;
-		Answer::Ptr answer;
-		Poco::Timestamp endTime;
+	Poco::Timespan m_heartbeatInterval;
+	unsigned int m_heartbeatLiveness;
+	std::vector<Liveness> m_liveness;
+	Poco::Timestamp m_lastReap;
+
+	/*
+	 * Credits of the registered device managers indexed by their
+	 * idents. It is used only by the thread of the broker.
+	 */
+	struct Credits {
+		DeviceManagerID id;
+		unsigned int available;
+		unsigned int consumed;
+		unsigned long dropped;
+		bool pending;
 	};
-	std::map<DeviceID, SettingValueItem> m_settingTable;
+
+	unsigned int m_creditWindow;
+	std::vector<Credits> m_credits;
+	std::vector<uint8_t> m_pendingCredits;
+	std::atomic<unsigned long> m_creditsGranted;
+	std::atomic<unsigned long> m_framesDropped;
+
+	std::deque<OutgoingCommand> m_outgoing;
+	Poco::FastMutex m_outgoingLock;
+
+	CorrelationRegistry<GlobalID, ResultData2, GlobalIDHash> m_cmdTable;
+
+	TimingWheel<Result::Ptr> m_settingWheel;
+	std::unordered_map<const Result *,
+		TimingWheel<Result::Ptr>::Handle> m_settingTable;
 };
 
 }
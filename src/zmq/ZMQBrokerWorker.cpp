@@ -0,0 +1,99 @@
+#include <errno.h>
+
+#include "util/ZMQUtil.h"
+#include "zmq/ZMQBroker.h"
+#include "zmq/ZMQBrokerWorker.h"
+
+/*
+ * The stop flag is checked at least this often (ms).
+ */
+const long WORKER_POLL_TIMEOUT = 100;
+
+using namespace BeeeOn;
+using namespace std;
+
+ZMQBrokerWorker::ZMQBrokerWorker(ZMQBroker &broker, zmq::context_t &context,
+		const string &input, const string &output):
+	m_broker(broker),
+	m_context(context),
+	m_input(input),
+	m_output(output),
+	m_stop(false)
+{
+}
+
+void ZMQBrokerWorker::run()
+{
+	const int linger = 0;
+
+	zmq::socket_t input(m_context, ZMQ_PULL);
+	zmq::socket_t output(m_context, ZMQ_PUSH);
+
+	input.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+	output.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+
+	input.connect(m_input);
+	output.connect(m_output);
+
+	zmq::pollitem_t items[] = {
+		{static_cast<void *>(input), 0, ZMQ_POLLIN, 0},
+	};
+
+	while (!m_stop) {
+		try {
+			zmq::poll(items, 1, WORKER_POLL_TIMEOUT);
+		}
+		catch (zmq::error_t &ex) {
+			if (ex.num() == EINTR)
+				continue;
+
+			logger().error(string("zmq_poll failed: ") + ex.what(),
+				__FILE__, __LINE__);
+			break;
+		}
+
+		if (!(items[0].revents & ZMQ_POLLIN))
+			continue;
+
+		int events;
+		size_t size = sizeof(events);
+
+		do {
+			process(input, output);
+			input.getsockopt(ZMQ_EVENTS, &events, &size);
+		} while (!m_stop && (events & ZMQ_POLLIN));
+	}
+}
+
+void ZMQBrokerWorker::stop()
+{
+	m_stop = true;
+}
+
+void ZMQBrokerWorker::process(zmq::socket_t &input, zmq::socket_t &output)
+{
+	zmq::message_t identity;
+	zmq::message_t frame;
+
+	if (!input.recv(&identity, ZMQ_DONTWAIT) || !input.recv(&frame, ZMQ_DONTWAIT))
+		return;
+
+	if (m_broker.exportMeasuredValues(ZMQFrameView(frame))) {
+		m_exported++;
+		return;
+	}
+
+	output.send(identity, ZMQ_SNDMORE);
+	output.send(frame);
+	m_returned++;
+}
+
+unsigned long ZMQBrokerWorker::exported() const
+{
+	return m_exported;
+}
+
+unsigned long ZMQBrokerWorker::returned() const
+{
+	return m_returned;
+}
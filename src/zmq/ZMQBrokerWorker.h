@@ -0,0 +1,62 @@
+#ifndef BEEEON_ZMQ_BROKER_WORKER_H
+#define BEEEON_ZMQ_BROKER_WORKER_H
+
+#include <string>
+
+#include <Poco/AtomicCounter.h>
+
+#include <zmq.hpp>
+
+#include "loop/StoppableRunnable.h"
+#include "util/Loggable.h"
+
+namespace BeeeOn {
+
+class ZMQBroker;
+
+/*
+ * Worker of the sharded ZMQBroker. It receives frames of the device
+ * managers assigned to it (pairs identity and payload) from an inproc
+ * PULL socket and exports the measured values in its own thread.
+ * Frames of other types (and measured values that cannot be parsed)
+ * are pushed back to the broker thread that owns the data socket
+ * and the tables of pending requests.
+ *
+ * Frames of a single device manager are always assigned to the same
+ * worker, so its measured values are exported in order.
+ */
+class ZMQBrokerWorker : public StoppableRunnable, public Loggable {
+public:
+	/*
+	 * The input and output are inproc addresses already bound
+	 * by the broker in the given context.
+	 */
+	ZMQBrokerWorker(ZMQBroker &broker, zmq::context_t &context,
+		const std::string &input, const std::string &output);
+
+	void run() override;
+	void stop() override;
+
+	/*
+	 * Number of the frames exported by this worker and the frames
+	 * passed back to the broker.
+	 */
+	unsigned long exported() const;
+	unsigned long returned() const;
+
+protected:
+	void process(zmq::socket_t &input, zmq::socket_t &output);
+
+private:
+	ZMQBroker &m_broker;
+	zmq::context_t &m_context;
+	std::string m_input;
+	std::string m_output;
+	Poco::AtomicCounter m_stop;
+	Poco::AtomicCounter m_exported;
+	Poco::AtomicCounter m_returned;
+};
+
+}
+
+#endif
@@ -1,18 +1,36 @@
+#include <algorithm>
+#include <deque>
+#include <iterator>
 #include <unistd.h>
 
 #include "di/Injectable.h"
+#include "model/SensorData.h"
 #include "util/ZMQUtil.h"
+#include "zmq/ZMQBinaryMessage.h"
 #include "zmq/ZMQClient.h"
 #include "zmq/ZMQMessage.h"
 
 const int LOOP_USLEEP = 100;
+const unsigned int DEFAULT_CREDIT_BUFFER = 1024;
 
 using namespace BeeeOn;
 using namespace std;
 
 ZMQClient::ZMQClient():
 	ZMQConnector(),
-	m_devicePrefix(DevicePrefix::parse("Invalid"))
+	m_devicePrefix(DevicePrefix::parse("Invalid")),
+	m_preferredEncoding(ZMQMessageEncoding::fromRaw(ZMQMessageEncoding::ENCODING_JSON)),
+	m_encoding(ZMQMessageEncoding::ENCODING_JSON),
+	m_batchSize(1),
+	m_batchDelay(0),
+	m_creditWindow(0),
+	m_credits(0),
+	m_creditBuffer(DEFAULT_CREDIT_BUFFER),
+	m_creditWait(0),
+	m_throttled(0),
+	m_dropped(0),
+	m_registered(false),
+	m_heartbeatInterval(0)
 {
 }
 
@@ -26,32 +44,134 @@ Poco::Nullable<DeviceManagerID> ZMQClient::deviceManagerID()
 	return m_deviceMangerID;
 }
 
+void ZMQClient::setEncoding(const ZMQMessageEncoding &encoding)
+{
+	m_preferredEncoding = encoding;
+}
+
+ZMQMessageEncoding ZMQClient::encoding() const
+{
+	return ZMQMessageEncoding::fromRaw(m_encoding);
+}
+
+void ZMQClient::setBatchSize(unsigned int size)
+{
+	m_batchSize = size;
+}
+
+void ZMQClient::setBatchDelay(const Poco::Timespan &delay)
+{
+	m_batchDelay = delay;
+}
+
+void ZMQClient::setCreditBuffer(unsigned int size)
+{
+	m_creditBuffer = size;
+}
+
+void ZMQClient::setCreditWait(const Poco::Timespan &wait)
+{
+	m_creditWait = wait;
+}
+
+int ZMQClient::credits()
+{
+	Poco::FastMutex::ScopedLock guard(m_batchLock);
+	return m_creditWindow == 0 ? -1 : m_credits;
+}
+
+unsigned long ZMQClient::throttled() const
+{
+	return m_throttled;
+}
+
+unsigned long ZMQClient::dropped() const
+{
+	return m_dropped;
+}
+
 void ZMQClient::run()
 {
 	configureHelloSockets();
-
-	ZMQMessage helloRequest = ZMQMessage::fromHelloRequest(m_devicePrefix);
-	ZMQUtil::send(m_helloServerSocket, helloRequest.toString());
+	sendHelloRequest();
 
 	while (!m_stop) {
-		if (!m_deviceMangerID.isNull()) {
-			configureDataSockets();
-			break;
+		if (!m_registered) {
+			helloServerReceive();
+			usleep(LOOP_USLEEP);
+			continue;
 		}
 
-		helloServerReceive();
+		dataServerReceive();
+		flushOutbox();
+		flushBatch(false);
+		sendHeartbeat();
 		usleep(LOOP_USLEEP);
 	}
 
-	while (!m_stop) {
-		dataServerReceive();
-		usleep(LOOP_USLEEP);
+	if (!m_dataServerSocket.isNull()) {
+		flushOutbox();
+		flushBatch(true);
+	}
+
+	{
+		Poco::FastMutex::ScopedLock guard(m_batchLock);
+
+		if (!m_batch.empty()) {
+			logger().warning("dropping " + to_string(m_batch.size())
+				+ " SensorData waiting for credits");
+
+			m_dropped += m_batch.size();
+			m_batch.clear();
+		}
+
+		m_batchCondition.broadcast();
+	}
+
+	{
+		Poco::FastMutex::ScopedLock guard(m_outboxLock);
+
+		if (!m_outbox.empty()) {
+			logger().warning("dropping " + to_string(m_outbox.size())
+				+ " unsent messages");
+
+			m_dropped += m_outbox.size();
+			m_outbox.clear();
+		}
 	}
 
 	if (logger().debug())
 		logger().debug("ZMQ_REP and ZMQ_ROUTER stop");
 }
 
+void ZMQClient::sendHelloRequest()
+{
+	ZMQMessage helloRequest = ZMQMessage::fromHelloRequest(m_devicePrefix);
+	if (m_preferredEncoding.raw() != ZMQMessageEncoding::ENCODING_JSON)
+		helloRequest.setEncoding(m_preferredEncoding);
+
+	if (!m_deviceMangerID.isNull())
+		helloRequest.setResumeID(m_deviceMangerID.value());
+
+	m_registered = false;
+	ZMQUtil::send(m_helloServerSocket, helloRequest.toString());
+}
+
+void ZMQClient::sendHeartbeat()
+{
+	if (m_heartbeatInterval <= 0)
+		return;
+
+	// any message proves the liveness
+	if (!m_lastSend.isElapsed(m_heartbeatInterval.totalMicroseconds()))
+		return;
+
+	if (takeCredits(1) == 0)
+		return;
+
+	sendData(ZMQMessage::fromHeartbeat().toString());
+}
+
 void ZMQClient::configureDataSockets()
 {
 	m_dataServerSocket.assign(new zmq::socket_t(m_context, ZMQ_DEALER));
@@ -118,14 +238,32 @@ void ZMQClient::helloServerReceive()
 		return;
 
 	switch (zmqMessage.type().raw()) {
-	case ZMQMessageType::TYPE_HELLO_RESPONSE:
-		m_deviceMangerID = zmqMessage.toHelloResponse();
+	case ZMQMessageType::TYPE_HELLO_RESPONSE: {
+		const DeviceManagerID deviceManagerID = zmqMessage.toHelloResponse();
+		const bool changed = m_deviceMangerID.isNull()
+			|| m_deviceMangerID.value() != deviceManagerID;
+
+		m_encoding = zmqMessage.encoding().raw();
+		m_heartbeatInterval = zmqMessage.heartbeatInterval();
+		m_deviceMangerID = deviceManagerID;
+		m_registered = true;
+
+		{
+			Poco::FastMutex::ScopedLock guard(m_batchLock);
+			m_creditWindow = zmqMessage.creditWindow();
+			m_credits = m_creditWindow;
+		}
 
 		if (logger().debug()) {
 			logger().debug("assigned device manger ID: "
 				+ m_deviceMangerID.value().toString());
 		}
+
+		// the identity of the data socket is the DeviceManagerID
+		if (changed)
+			configureDataSockets();
 		break;
+	}
 	default:
 		sendError(
 			ZMQMessageError::ERROR_UNSUPPORTED_MESSAGE,
@@ -136,24 +274,218 @@ void ZMQClient::helloServerReceive()
 
 void ZMQClient::dataServerReceive()
 {
-	string deviceManagerID;
-	string jsonMessage;
+	zmq::message_t frame;
 
-	if (!ZMQUtil::receive(m_dataServerSocket, jsonMessage))
+	if (!ZMQUtil::receive(m_dataServerSocket, frame))
 		return;
 
+	ZMQFrameView jsonMessage(frame);
+
 	if (logger().debug())
 		logger().debug("client receive data (dataServerSocket):\n"
-			+ jsonMessage);
+			+ jsonMessage.toString());
 
 	ZMQMessage zmqMessage;
 	if (!parseMessage(jsonMessage, m_dataServerSocket, zmqMessage))
 		return;
 
+	if (zmqMessage.type() == ZMQMessageType::TYPE_ERROR
+			&& zmqMessage.toError().errorCode()
+				== ZMQMessageError::ERROR_UNKNOWN_DEVICE_MANAGER) {
+		logger().warning("not registered by the broker, registering again");
+		sendHelloRequest();
+		return;
+	}
+
+	if (zmqMessage.type() == ZMQMessageType::TYPE_CREDIT) {
+		Poco::FastMutex::ScopedLock guard(m_batchLock);
+		m_credits += zmqMessage.credits();
+		return;
+	}
+
 	onReceive(this, zmqMessage);
 }
 
 int ZMQClient::send(const std::string &message)
 {
-	return ZMQUtil::send(m_dataServerSocket, message);
+	return send(std::string(message));
+}
+
+int ZMQClient::send(std::string &&message)
+{
+	if (m_stop)
+		return 0;
+
+	Poco::FastMutex::ScopedLock guard(m_outboxLock);
+
+	if (m_outbox.size() >= m_creditBuffer) {
+		m_dropped++;
+		return 0;
+	}
+
+	m_outbox.push_back(std::move(message));
+	return 1;
+}
+
+int ZMQClient::send(const SensorData &sensorData)
+{
+	Poco::FastMutex::ScopedLock guard(m_batchLock);
+
+	if (!waitForBuffer()) {
+		m_dropped++;
+		return 0;
+	}
+
+	const size_t batchSize = std::max<size_t>(m_batchSize, 1);
+
+	// the credits are not enough for the already queued SensorData
+	if (m_creditWindow > 0 && m_batch.size() >= m_credits * batchSize)
+		m_throttled++;
+
+	if (m_batch.empty())
+		m_batchStart.update();
+
+	m_batch.push_back(sensorData);
+	return 1;
+}
+
+bool ZMQClient::waitForBuffer()
+{
+	const Poco::Timestamp start;
+
+	while (m_batch.size() >= m_creditBuffer) {
+		const Poco::Timespan left =
+			m_creditWait.totalMicroseconds() - start.elapsed();
+
+		if (m_stop || left <= 0)
+			return false;
+
+		m_batchCondition.tryWait(m_batchLock,
+			std::max<long>(left.totalMilliseconds(), 1));
+	}
+
+	return true;
+}
+
+int ZMQClient::sendData(std::string &&message)
+{
+	if (!ZMQUtil::send(m_dataServerSocket, std::move(message)))
+		return 0;
+
+	m_lastSend.update();
+	return 1;
+}
+
+int ZMQClient::sendNow(const SensorData &sensorData)
+{
+	if (m_encoding == ZMQMessageEncoding::ENCODING_BINARY)
+		return sendData(ZMQBinaryMessage::fromSensorData(sensorData));
+
+	return sendData(ZMQMessage::fromSensorData(sensorData).toString());
+}
+
+int ZMQClient::sendBatch(const vector<SensorData> &batch)
+{
+	if (batch.size() == 1)
+		return sendNow(batch.front());
+
+	if (m_encoding == ZMQMessageEncoding::ENCODING_BINARY)
+		return sendData(ZMQBinaryMessage::fromSensorDataBatch(batch));
+
+	return sendData(ZMQMessage::fromSensorDataBatch(batch).toString());
+}
+
+void ZMQClient::flushOutbox()
+{
+	std::deque<std::string> outbox;
+
+	{
+		Poco::FastMutex::ScopedLock guard(m_outboxLock);
+
+		if (m_outbox.empty())
+			return;
+
+		const size_t count = takeCredits(m_outbox.size());
+
+		if (count == m_outbox.size()) {
+			outbox.swap(m_outbox);
+		}
+		else {
+			std::move(m_outbox.begin(), m_outbox.begin() + count,
+				std::back_inserter(outbox));
+			m_outbox.erase(m_outbox.begin(), m_outbox.begin() + count);
+		}
+	}
+
+	for (auto &message : outbox) {
+		if (!sendData(std::move(message))) {
+			logger().warning("failed to send a message");
+			m_dropped++;
+		}
+	}
+}
+
+size_t ZMQClient::takeCredits(size_t count)
+{
+	Poco::FastMutex::ScopedLock guard(m_batchLock);
+
+	if (m_creditWindow == 0)
+		return count;
+
+	count = std::min<size_t>(count, m_credits);
+	m_credits -= count;
+	return count;
+}
+
+void ZMQClient::flushBatch(bool force)
+{
+	const size_t batchSize = std::max<size_t>(m_batchSize, 1);
+	vector<SensorData> batch;
+
+	{
+		Poco::FastMutex::ScopedLock guard(m_batchLock);
+
+		if (m_batch.empty())
+			return;
+
+		if (!force && m_batch.size() < m_batchSize
+				&& !m_batchStart.isElapsed(m_batchDelay.totalMicroseconds()))
+			return;
+
+		size_t count = m_batch.size();
+
+		// every message consumes a credit
+		if (m_creditWindow > 0) {
+			count = std::min<size_t>(count, m_credits * batchSize);
+			m_credits -= (count + batchSize - 1) / batchSize;
+		}
+
+		if (count == 0)
+			return;
+
+		if (count == m_batch.size()) {
+			batch.swap(m_batch);
+		}
+		else {
+			batch.assign(m_batch.begin(), m_batch.begin() + count);
+			m_batch.erase(m_batch.begin(), m_batch.begin() + count);
+		}
+
+		m_batchCondition.broadcast();
+	}
+
+	for (size_t i = 0; i < batch.size(); i += batchSize) {
+		const size_t end = std::min<size_t>(i + batchSize, batch.size());
+		int ret;
+
+		if (i == 0 && end == batch.size())
+			ret = sendBatch(batch);
+		else
+			ret = sendBatch(vector<SensorData>(batch.begin() + i, batch.begin() + end));
+
+		if (!ret) {
+			logger().warning("failed to send " + to_string(end - i) + " SensorData");
+			m_dropped += end - i;
+		}
+	}
 }
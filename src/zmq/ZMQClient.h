@@ -1,12 +1,23 @@
 #ifndef BEEEON_ZMQ_CLIENT_H
 #define BEEEON_ZMQ_CLIENT_H
 
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+
 #include <Poco/BasicEvent.h>
+#include <Poco/Condition.h>
+#include <Poco/Mutex.h>
 #include <Poco/Nullable.h>
+#include <Poco/Timespan.h>
+#include <Poco/Timestamp.h>
 
 #include "model/DeviceManagerID.h"
 #include "model/DevicePrefix.h"
+#include "model/SensorData.h"
 #include "zmq/ZMQConnector.h"
+#include "zmq/ZMQMessageEncoding.h"
 #include "model/DeviceManagerID.h"
 
 namespace BeeeOn {
@@ -24,6 +35,37 @@ namespace BeeeOn {
  *
  * Client si po starte vyziada od servera device manager ID, ktorym
  * bude dalej identifikovany na datovom sockete (m_dataServerSocket).
+ *
+ * All messages are queued by send() and sent by the client thread,
+ * thus the data socket is used by the client thread only and the
+ * device manager is never blocked by the socket.
+ *
+ * The client asks for the preferred encoding (setEncoding()) during
+ * registration. Measured values sent via send(const SensorData &)
+ * use the encoding confirmed by the server, JSON otherwise.
+ *
+ * When the batch size is greater than 1, measured values are
+ * collected and sent as a single measured_values_batch message
+ * when the batch size is reached or when the oldest collected value
+ * waits longer than the batch delay.
+ *
+ * When the broker announces a heartbeat interval in hello_response,
+ * the client sends a heartbeat message whenever it has sent nothing
+ * else for that interval. If the broker
+ * does not know the client anymore (e.g. it has been considered dead),
+ * the client registers again asking to resume its previous ID.
+ *
+ * When the broker announces a credit window in hello_response, every
+ * message sent via the data socket consumes a credit and the client
+ * sends nothing more until the broker grants new credits.
+ *
+ * The queues are bounded whether the flow is limited or not, so a
+ * stalled broker does not make them grow: at most creditBuffer
+ * SensorData and creditBuffer other messages are queued. When the
+ * SensorData queue is full, send() blocks at most creditWait and drops
+ * the SensorData then, other messages are dropped at once. The number
+ * of throttled SensorData and dropped messages is available via
+ * throttled() and dropped().
  */
 class ZMQClient : public ZMQConnector {
 public:
@@ -38,8 +80,63 @@ public:
 
 	Poco::Nullable<DeviceManagerID> deviceManagerID();
 
+	void setEncoding(const ZMQMessageEncoding &encoding);
+
+	/*
+	 * Encoding negotiated with the server.
+	 */
+	ZMQMessageEncoding encoding() const;
+
+	/*
+	 * Queue the message to be sent by the client thread.
+	 * @return non-zero when queued, 0 when the client is stopped
+	 */
 	int send(const std::string &message);
 
+	/*
+	 * Queue the message without copying its buffer.
+	 */
+	int send(std::string &&message);
+
+	/*
+	 * Queue measured values to be sent by the client thread using
+	 * the negotiated encoding.
+	 * @return non-zero when the values are queued,
+	 * 0 when they are dropped
+	 */
+	int send(const SensorData &sensorData);
+
+	/*
+	 * Maximal count of SensorData sent in a single message.
+	 * Values less than 2 disable batching.
+	 */
+	void setBatchSize(unsigned int size);
+
+	/*
+	 * Maximal time the queued SensorData waits before it is sent.
+	 */
+	void setBatchDelay(const Poco::Timespan &delay);
+
+	/*
+	 * Maximal count of queued SensorData (and of other queued messages)
+	 * and maximal time send() blocks when the SensorData queue is full.
+	 */
+	void setCreditBuffer(unsigned int size);
+	void setCreditWait(const Poco::Timespan &wait);
+
+	/*
+	 * Credits available or -1 when the flow is not limited.
+	 */
+	int credits();
+
+	/*
+	 * Number of SensorData that had to wait for credits and number
+	 * of SensorData and other messages that have been dropped (the
+	 * queue was full or they could not be sent).
+	 */
+	unsigned long throttled() const;
+	unsigned long dropped() const;
+
 private:
 	void configureDataSockets() override;
 	void configureHelloSockets() override;
@@ -47,9 +144,74 @@ private:
 	void dataServerReceive() override;
 	void helloServerReceive() override;
 
+	/*
+	 * Sends the queued SensorData when the batch is full, its
+	 * delay has elapsed or when forced.
+	 */
+	void flushBatch(bool force);
+
+	/*
+	 * Wait until there is space in the buffer of SensorData.
+	 * The m_batchLock must be locked.
+	 */
+	bool waitForBuffer();
+
+	int sendBatch(const std::vector<SensorData> &batch);
+	int sendNow(const SensorData &sensorData);
+
+	/*
+	 * Send the message via the data socket, called
+	 * by the client thread only.
+	 */
+	int sendData(std::string &&message);
+
+	/*
+	 * Send the messages queued by send() as long as there
+	 * are credits.
+	 */
+	void flushOutbox();
+
+	/*
+	 * Consume credits for at most the given count of messages.
+	 * Returns the count of messages that can be sent.
+	 */
+	size_t takeCredits(size_t count);
+
+	/*
+	 * Send hello_request, the previous DeviceManagerID (if any)
+	 * is asked to be resumed.
+	 */
+	void sendHelloRequest();
+
+	/*
+	 * Send heartbeat when nothing has been sent for the interval.
+	 */
+	void sendHeartbeat();
+
 private:
 	Poco::Nullable<DeviceManagerID> m_deviceMangerID;
 	DevicePrefix m_devicePrefix;
+	ZMQMessageEncoding m_preferredEncoding;
+	std::atomic<ZMQMessageEncoding::Raw> m_encoding;
+
+	unsigned int m_batchSize;
+	Poco::Timespan m_batchDelay;
+	std::vector<SensorData> m_batch;
+	Poco::Timestamp m_batchStart;
+	Poco::FastMutex m_batchLock;
+	Poco::Condition m_batchCondition;
+	unsigned int m_creditWindow;
+	unsigned int m_credits;
+	unsigned int m_creditBuffer;
+	Poco::Timespan m_creditWait;
+	std::atomic<unsigned long> m_throttled;
+	std::atomic<unsigned long> m_dropped;
+	bool m_registered;
+	Poco::Timespan m_heartbeatInterval;
+	Poco::Timestamp m_lastSend;
+
+	std::deque<std::string> m_outbox;
+	Poco::FastMutex m_outboxLock;
 };
 
 }
@@ -66,9 +66,15 @@ string ZMQConnector::createAddress(const string &host, int port)
 
 bool ZMQConnector::parseMessage(const std::string &jsonMessage,
 	Poco::SharedPtr<zmq::socket_t> socket, ZMQMessage &msg)
+{
+	return parseMessage(ZMQFrameView(jsonMessage), socket, msg);
+}
+
+bool ZMQConnector::parseMessage(const ZMQFrameView &jsonMessage,
+	Poco::SharedPtr<zmq::socket_t> socket, ZMQMessage &msg)
 {
 	try {
-		msg = ZMQMessage::fromJSON(jsonMessage);
+		msg = ZMQMessage::fromJSON(jsonMessage.data(), jsonMessage.size());
 
 		msg.type();
 	}
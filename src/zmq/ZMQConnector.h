@@ -10,6 +10,7 @@
 
 #include "loop/StoppableRunnable.h"
 #include "util/Loggable.h"
+#include "util/ZMQUtil.h"
 #include "zmq/ZMQMessageError.h"
 
 namespace BeeeOn {
@@ -76,6 +77,13 @@ protected:
 	bool parseMessage(const std::string &jsonMessage,
 		Poco::SharedPtr<zmq::socket_t> socket, ZMQMessage &msg);
 
+	/*
+	 * Same as above but the message is parsed directly from
+	 * the received ZMQ frame.
+	 */
+	bool parseMessage(const ZMQFrameView &jsonMessage,
+		Poco::SharedPtr<zmq::socket_t> socket, ZMQMessage &msg);
+
 	int sendError(const ZMQMessageError::Error errorType,
 		const std::string message, Poco::SharedPtr<zmq::socket_t> socket);
 
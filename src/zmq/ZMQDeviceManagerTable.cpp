@@ -1,95 +1,162 @@
-#include "zmq/ZMQDeviceManagerTable.h"
+#include <algorithm>
+
+#include <Poco/Exception.h>
 
-const uint8_t FIRST_DAEMON_IDENT = 0;
+#include "zmq/ZMQDeviceManagerTable.h"
 
 using namespace BeeeOn;
 using namespace Poco;
 using namespace std;
 
+ZMQDeviceManagerTable::Snapshot::Snapshot()
+{
+}
+
+ZMQDeviceManagerTable::Snapshot::Snapshot(
+		vector<DeviceManagerID> &&deviceManagers):
+	m_deviceManagers(std::move(deviceManagers))
+{
+}
+
+ZMQDeviceManagerTable::Snapshot::Range
+ZMQDeviceManagerTable::Snapshot::byPrefix(const DevicePrefix &prefix) const
+{
+	return Range(
+		lower_bound(m_deviceManagers.begin(), m_deviceManagers.end(),
+			DeviceManagerID(prefix, 0)),
+		upper_bound(m_deviceManagers.begin(), m_deviceManagers.end(),
+			DeviceManagerID(prefix, UINT8_MAX)));
+}
+
+bool ZMQDeviceManagerTable::Snapshot::contains(const DevicePrefix &prefix) const
+{
+	return !byPrefix(prefix).empty();
+}
+
+ZMQDeviceManagerTable::ZMQDeviceManagerTable():
+	m_snapshot(new Snapshot)
+{
+	fill(begin(m_usedIdents), end(m_usedIdents), 0);
+}
+
 DeviceManagerID ZMQDeviceManagerTable::registerDaemonPrefix(
 	const DevicePrefix &prefix)
 {
-	Mutex::ScopedLock guard(m_mutex);
+	FastMutex::ScopedLock guard(m_mutex);
 
 	DeviceManagerID deviceManagerID = fromPrefix(prefix);
-	m_deviceManagers.push_back(deviceManagerID);
 
+	vector<DeviceManagerID> deviceManagers = m_snapshot->all();
+	deviceManagers.insert(
+		upper_bound(deviceManagers.begin(), deviceManagers.end(), deviceManagerID),
+		deviceManagerID);
+
+	publish(std::move(deviceManagers));
 	return deviceManagerID;
 }
 
+bool ZMQDeviceManagerTable::registerDaemonID(
+	const DeviceManagerID &deviceManagerID)
+{
+	FastMutex::ScopedLock guard(m_mutex);
+
+	vector<DeviceManagerID> deviceManagers = m_snapshot->all();
+	auto item = lower_bound(deviceManagers.begin(), deviceManagers.end(),
+		deviceManagerID);
+
+	if (item != deviceManagers.end() && *item == deviceManagerID)
+		return true;
+
+	const uint8_t ident = deviceManagerID.ident();
+	const uint64_t bit = uint64_t(1) << (ident % 64);
+
+	if (m_usedIdents[ident / 64] & bit)
+		return false;
+
+	m_usedIdents[ident / 64] |= bit;
+	deviceManagers.insert(item, deviceManagerID);
+
+	publish(std::move(deviceManagers));
+	return true;
+}
+
 void ZMQDeviceManagerTable::unregisterDaemon(
 	const DeviceManagerID &deviceManagerID)
 {
-	auto item = find(m_deviceManagers.begin(), m_deviceManagers.end(), deviceManagerID);
+	FastMutex::ScopedLock guard(m_mutex);
+
+	vector<DeviceManagerID> deviceManagers = m_snapshot->all();
+	auto item = lower_bound(deviceManagers.begin(), deviceManagers.end(),
+		deviceManagerID);
 
-	if (item == m_deviceManagers.end())
+	if (item == deviceManagers.end() || *item != deviceManagerID)
 		throw InvalidArgumentException(
 			"device manager ID : " + deviceManagerID.toString()
 			+ "not found");
 
-	m_deviceManagers.erase(item);
+	deviceManagers.erase(item);
+
+	const uint8_t ident = deviceManagerID.ident();
+	m_usedIdents[ident / 64] &= ~(uint64_t(1) << (ident % 64));
+
+	publish(std::move(deviceManagers));
 }
 
 DeviceManagerID ZMQDeviceManagerTable::fromPrefix(
 	const DevicePrefix &prefix)
 {
-	if (m_deviceManagers.size() > UINT8_MAX)
-		throw RangeException("maximum registered of device managers IDs");
-
 	return DeviceManagerID(prefix, getFirstEmptyID());
 }
 
 uint8_t ZMQDeviceManagerTable::getFirstEmptyID()
 {
-	if (m_deviceManagers.empty())
-		return FIRST_DAEMON_IDENT;
+	for (unsigned int i = 0; i < 4; ++i) {
+		const uint64_t free = ~m_usedIdents[i];
 
-	uint8_t daemonID = m_deviceManagers.front().ident();
-
-	for (auto &item : m_deviceManagers) {
-		if (item.ident() == daemonID) {
-			daemonID++;
+		if (free == 0)
 			continue;
-		}
-		else {
-			break;
-		}
+
+		const unsigned int bit = __builtin_ctzll(free);
+		m_usedIdents[i] |= uint64_t(1) << bit;
+
+		return i * 64 + bit;
 	}
 
-	return daemonID;
+	throw RangeException("maximum registered of device managers IDs");
+}
+
+void ZMQDeviceManagerTable::publish(vector<DeviceManagerID> &&deviceManagers)
+{
+	Snapshot::Ptr snapshot = make_shared<const Snapshot>(std::move(deviceManagers));
+	atomic_store(&m_snapshot, snapshot);
+}
+
+ZMQDeviceManagerTable::Snapshot::Ptr ZMQDeviceManagerTable::snapshot() const
+{
+	return atomic_load(&m_snapshot);
 }
 
 std::vector<DeviceManagerID> ZMQDeviceManagerTable::getAll() const
 {
-	return m_deviceManagers;
+	return snapshot()->all();
 }
 
 std::vector<DeviceManagerID> ZMQDeviceManagerTable::getAll(
 	const DevicePrefix &prefix) const
 {
-	std::vector<DeviceManagerID> deviceManagers;
+	const Snapshot::Ptr current = snapshot();
+	const Snapshot::Range range = current->byPrefix(prefix);
 
-	for (auto item : m_deviceManagers) {
-		if (item.prefix() == prefix)
-			deviceManagers.push_back(item);
-	}
-
-	return deviceManagers;
+	return std::vector<DeviceManagerID>(range.begin(), range.end());
 }
 
 unsigned long ZMQDeviceManagerTable::count() const
 {
-	return m_deviceManagers.size();
+	return snapshot()->all().size();
 }
 
-bool ZMQDeviceManagerTable::isDeviceManagerRegistered(const DevicePrefix &prefix)
+bool ZMQDeviceManagerTable::isDeviceManagerRegistered(
+	const DevicePrefix &prefix) const
 {
-	Mutex::ScopedLock guard(m_mutex);
-
-	for (auto item : m_deviceManagers) {
-		if (prefix == item.prefix())
-			return true;
-	}
-
-	return false;
+	return snapshot()->contains(prefix);
 }
@@ -1,6 +1,8 @@
 #ifndef BEEEON_ZMQ_DEVICE_MANAGER_TABLE_H
 #define BEEEON_ZMQ_DEVICE_MANAGER_TABLE_H
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 #include <Poco/Mutex.h>
@@ -16,21 +18,118 @@ namespace BeeeOn {
  * this socket, device asks about ID that will be used during
  * the communication. The request contains prefix that marks
  * the type of device manager.
+ *
+ * The table is copy-on-write. Readers obtain an immutable Snapshot
+ * without taking any lock held by the writers, the writers (serialized
+ * by a mutex) publish a new Snapshot atomically. The registration
+ * is rare while the lookups are done for every dispatched command.
+ *
+ * The idents of device managers are allocated from a bitmap of 256
+ * bits, the lowest free ident is always used.
  */
 class ZMQDeviceManagerTable {
 public:
+	/*
+	 * Immutable list of the registered device managers sorted
+	 * by their IDs. The prefix is the most significant part of
+	 * DeviceManagerID, so device managers of the same prefix
+	 * form a contiguous range.
+	 */
+	class Snapshot {
+	public:
+		typedef std::shared_ptr<const Snapshot> Ptr;
+		typedef std::vector<DeviceManagerID>::const_iterator Iterator;
+
+		/*
+		 * Range of the device managers of a single prefix. It is
+		 * valid as long as the Snapshot it comes from.
+		 */
+		class Range {
+		public:
+			Range(Iterator begin, Iterator end):
+				m_begin(begin),
+				m_end(end)
+			{
+			}
+
+			Iterator begin() const
+			{
+				return m_begin;
+			}
+
+			Iterator end() const
+			{
+				return m_end;
+			}
+
+			size_t size() const
+			{
+				return m_end - m_begin;
+			}
+
+			bool empty() const
+			{
+				return m_begin == m_end;
+			}
+
+		private:
+			Iterator m_begin;
+			Iterator m_end;
+		};
+
+		Snapshot();
+		Snapshot(std::vector<DeviceManagerID> &&deviceManagers);
+
+		const std::vector<DeviceManagerID> &all() const
+		{
+			return m_deviceManagers;
+		}
+
+		Range range() const
+		{
+			return Range(m_deviceManagers.begin(), m_deviceManagers.end());
+		}
+
+		Range byPrefix(const DevicePrefix &prefix) const;
+
+		bool contains(const DevicePrefix &prefix) const;
+
+	private:
+		std::vector<DeviceManagerID> m_deviceManagers;
+	};
+
+	ZMQDeviceManagerTable();
+
 	DeviceManagerID registerDaemonPrefix(const DevicePrefix &prefix);
+
+	/*
+	 * Register the given DeviceManagerID again (a device manager
+	 * resumes its previous registration). Returns false when its
+	 * ident is used by another device manager. Registering of an ID
+	 * that is already registered succeeds and changes nothing.
+	 */
+	bool registerDaemonID(const DeviceManagerID &deviceManagerID);
+
 	void unregisterDaemon(const DeviceManagerID &deviceManagerID);
 
+	/*
+	 * Current state of the table, it is not affected by
+	 * the following changes.
+	 */
+	Snapshot::Ptr snapshot() const;
+
 	std::vector<DeviceManagerID> getAll() const;
 	std::vector<DeviceManagerID> getAll(
 		const DevicePrefix &prefix) const;
 
 	unsigned long count() const;
 
-	bool isDeviceManagerRegistered(const DevicePrefix &prefix);
+	bool isDeviceManagerRegistered(const DevicePrefix &prefix) const;
 
 private:
+	/*
+	 * Allocate the lowest free ident or throw RangeException.
+	 */
 	uint8_t getFirstEmptyID();
 
 	/*
@@ -38,9 +137,12 @@ private:
 	 */
 	DeviceManagerID fromPrefix(const DevicePrefix &prefix);
 
+	void publish(std::vector<DeviceManagerID> &&deviceManagers);
+
 private:
-	std::vector<DeviceManagerID> m_deviceManagers;
-	Poco::Mutex m_mutex;
+	Snapshot::Ptr m_snapshot;
+	uint64_t m_usedIdents[4];
+	Poco::FastMutex m_mutex;
 };
 
 }
@@ -1,3 +1,8 @@
+#include <Poco/MemoryStream.h>
+#include <Poco/Mutex.h>
+#include <Poco/JSON/JSONException.h>
+#include <Poco/JSON/Parser.h>
+
 #include "util/JsonUtil.h"
 #include "zmq/ZMQMessage.h"
 
@@ -189,6 +194,34 @@ SensorValue ZMQMessage::getSensorValue(Object::Ptr jsonObject)
 	return SensorValue(moduleId, raw);
 }
 
+void ZMQMessage::setSensorData(Object::Ptr jsonObject,
+	const SensorData &sensorData)
+{
+	Array::Ptr jsonArray = new Array();
+
+	setDeviceID(jsonObject, sensorData.deviceID());
+
+	for (auto item : sensorData) {
+		Object::Ptr arrayItem = new Object();
+		setSensorValue(arrayItem, item);
+		jsonArray->add(Dynamic::Var(arrayItem));
+	}
+
+	jsonObject->set("values", jsonArray);
+}
+
+SensorData ZMQMessage::getSensorData(Object::Ptr jsonObject)
+{
+	SensorData sensorData;
+	sensorData.setDeviceID(getDeviceID(jsonObject));
+
+	Array::Ptr jsonArray = jsonObject->getArray("values");
+	for (size_t i = 0; i < jsonArray->size(); ++i)
+		sensorData.insertValue(getSensorValue(jsonArray->getObject(i)));
+
+	return sensorData;
+}
+
 Timespan ZMQMessage::getDuration()
 {
 	return Timespan(Timespan::SECONDS
@@ -253,24 +286,53 @@ ZMQMessage ZMQMessage::fromHelloResponse(const DeviceManagerID &deviceManagerID)
 	return msg;
 }
 
+ZMQMessage ZMQMessage::fromHeartbeat()
+{
+	ZMQMessage msg;
+
+	msg.setType(ZMQMessageType::fromRaw(
+		ZMQMessageType::TYPE_HEARTBEAT));
+
+	return msg;
+}
+
+ZMQMessage ZMQMessage::fromCredit(unsigned int credits)
+{
+	ZMQMessage msg;
+
+	msg.setType(ZMQMessageType::fromRaw(
+		ZMQMessageType::TYPE_CREDIT));
+	msg.m_json->set("credits", credits);
+
+	return msg;
+}
+
 ZMQMessage ZMQMessage::fromSensorData(const SensorData &sensorData)
 {
 	ZMQMessage msg;
 
-	Object::Ptr json = msg.jsonObject();
+	msg.setType(ZMQMessageType::fromRaw(
+		ZMQMessageType::TYPE_MEASURED_VALUES));
+	msg.setSensorData(msg.jsonObject(), sensorData);
+
+	return msg;
+}
+
+ZMQMessage ZMQMessage::fromSensorDataBatch(const vector<SensorData> &batch)
+{
+	ZMQMessage msg;
 	Array::Ptr jsonArray = new Array();
 
 	msg.setType(ZMQMessageType::fromRaw(
-		ZMQMessageType::TYPE_MEASURED_VALUES));
-	msg.setDeviceID(json, sensorData.deviceID());
+		ZMQMessageType::TYPE_MEASURED_VALUES_BATCH));
 
-	for (auto item : sensorData) {
+	for (const auto &sensorData : batch) {
 		Object::Ptr arrayItem = new Object();
-		msg.setSensorValue(arrayItem, item);
+		msg.setSensorData(arrayItem, sensorData);
 		jsonArray->add(Dynamic::Var(arrayItem));
 	}
 
-	json->set("values", jsonArray);
+	msg.jsonObject()->set("data", jsonArray);
 
 	return msg;
 }
@@ -455,6 +517,22 @@ ZMQMessage ZMQMessage::fromJSON(const string &json)
 	return ZMQMessage(JsonUtil::parse(json));
 }
 
+ZMQMessage ZMQMessage::fromJSON(const char *json, size_t length)
+{
+	MemoryInputStream input(json, length);
+	Parser parser;
+
+	try {
+		return ZMQMessage(parser.parse(input).extract<Object::Ptr>());
+	}
+	catch (const JSONException &ex) {
+		throw SyntaxException("failed to parse JSON", ex);
+	}
+	catch (const BadCastException &ex) {
+		throw SyntaxException("JSON message is not an object", ex);
+	}
+}
+
 ZMQMessageError ZMQMessage::toError()
 {
 	return ZMQMessageError(getErrorCode(), getErrorMessage());
@@ -471,16 +549,97 @@ DeviceManagerID ZMQMessage::toHelloResponse()
 		JsonUtil::extract<string>(m_json, "device_manager_id")));
 }
 
+ZMQMessageEncoding ZMQMessage::encoding()
+{
+	if (!m_json->has("encoding"))
+		return ZMQMessageEncoding::fromRaw(ZMQMessageEncoding::ENCODING_JSON);
+
+	try {
+		return ZMQMessageEncoding::parse(
+			JsonUtil::extract<string>(m_json, "encoding"));
+	}
+	catch (const InvalidArgumentException &) {
+		return ZMQMessageEncoding::fromRaw(ZMQMessageEncoding::ENCODING_JSON);
+	}
+}
+
+void ZMQMessage::setEncoding(const ZMQMessageEncoding &encoding)
+{
+	m_json->set("encoding", encoding.toString());
+}
+
+Nullable<DeviceManagerID> ZMQMessage::resumeID()
+{
+	Nullable<DeviceManagerID> deviceManagerID;
+
+	if (m_json->has("device_manager_id")) {
+		deviceManagerID = DeviceManagerID::parse(
+			JsonUtil::extract<string>(m_json, "device_manager_id"));
+	}
+
+	return deviceManagerID;
+}
+
+void ZMQMessage::setResumeID(const DeviceManagerID &deviceManagerID)
+{
+	setDeviceManagerID(deviceManagerID);
+}
+
+Timespan ZMQMessage::heartbeatInterval()
+{
+	if (!m_json->has("heartbeat_interval"))
+		return 0;
+
+	return JsonUtil::extract<int>(m_json, "heartbeat_interval")
+		* Timespan::MILLISECONDS;
+}
+
+void ZMQMessage::setHeartbeatInterval(const Timespan &interval)
+{
+	m_json->set("heartbeat_interval", (int) interval.totalMilliseconds());
+}
+
+unsigned int ZMQMessage::creditWindow()
+{
+	if (!m_json->has("credit_window"))
+		return 0;
+
+	return JsonUtil::extract<unsigned int>(m_json, "credit_window");
+}
+
+void ZMQMessage::setCreditWindow(unsigned int window)
+{
+	m_json->set("credit_window", window);
+}
+
+unsigned int ZMQMessage::credits()
+{
+	return JsonUtil::extract<unsigned int>(m_json, "credits");
+}
+
 SensorData ZMQMessage::toSensorData()
 {
-	SensorData sensorData;
-	sensorData.setDeviceID(getDeviceID(m_json));
+	return getSensorData(m_json);
+}
 
-	Array::Ptr jsonArray = m_json->getArray("values");
-	for (size_t i = 0; i < jsonArray->size(); ++i)
-		sensorData.insertValue(getSensorValue(jsonArray->getObject(i)));
+vector<SensorData> ZMQMessage::toSensorDataBatch()
+{
+	Array::Ptr jsonArray = m_json->getArray("data");
+	if (jsonArray.isNull())
+		throw InvalidAccessException("missing attribute data");
 
-	return sensorData;
+	vector<SensorData> batch;
+	batch.reserve(jsonArray->size());
+
+	for (size_t i = 0; i < jsonArray->size(); ++i) {
+		Object::Ptr item = jsonArray->getObject(i);
+		if (item.isNull())
+			throw InvalidAccessException("invalid item of data");
+
+		batch.push_back(getSensorData(item));
+	}
+
+	return batch;
 }
 
 GatewayListenCommand::Ptr ZMQMessage::toGatewayListenCommand()
@@ -490,7 +649,20 @@ GatewayListenCommand::Ptr ZMQMessage::toGatewayListenCommand()
 
 void ZMQMessage::toDefaultResult(Result::Ptr result)
 {
-	result->setStatus(getResultState());
+	const Result::Status status = getResultState();
+
+	if (!result->is<DeviceSetValueResult>()) {
+		result->setStatus(status);
+		return;
+	}
+
+	FastMutex::ScopedLock guard(result->lock());
+
+	result->cast<DeviceSetValueResult>().setExtendetSetStatusUnlocked(
+		status == Result::SUCCESS ?
+			DeviceSetValueResult::GW_DEVICE_SUCCESS
+			: DeviceSetValueResult::GW_DEVICE_FAILED);
+	result->setStatusUnlocked(status);
 }
 
 DeviceSetValueCommand::Ptr ZMQMessage::toDeviceSetValueCommand()
@@ -2,7 +2,10 @@
 #define BEEEON_ZMQ_PROTOCOL_MESSAGE_H
 
 #include <string>
+#include <vector>
 
+#include <Poco/Nullable.h>
+#include <Poco/Timespan.h>
 #include <Poco/JSON/Object.h>
 
 #include "core/Answer.h"
@@ -11,6 +14,7 @@
 #include "model/DeviceManagerID.h"
 #include "model/DevicePrefix.h"
 #include "model/GlobalID.h"
+#include "zmq/ZMQMessageEncoding.h"
 #include "zmq/ZMQMessageError.h"
 #include "zmq/ZMQMessageType.h"
 #include "zmq/ZMQMessageValueType.h"
@@ -84,10 +88,66 @@ public:
 
 	DeviceManagerID toHelloResponse();
 
+	/*
+	 * Encoding requested by hello_request or confirmed
+	 * by hello_response. JSON when not present or unknown.
+	 *
+	 * {
+	 *     "encoding" : "binary"
+	 * }
+	 */
+	ZMQMessageEncoding encoding();
+	void setEncoding(const ZMQMessageEncoding &encoding);
+
+	/*
+	 * DeviceManagerID that the device manager asks to resume
+	 * by hello_request. Null when not present.
+	 *
+	 * {
+	 *     "device_manager_id" : "0xa800"
+	 * }
+	 */
+	Poco::Nullable<DeviceManagerID> resumeID();
+	void setResumeID(const DeviceManagerID &deviceManagerID);
+
+	/*
+	 * Interval of heartbeats announced by hello_response.
+	 * Zero when not present (heartbeats are not required).
+	 *
+	 * {
+	 *     "heartbeat_interval" : 5000
+	 * }
+	 */
+	Poco::Timespan heartbeatInterval();
+	void setHeartbeatInterval(const Poco::Timespan &interval);
+
+	/*
+	 * Initial number of credits announced by hello_response.
+	 * Zero when not present (the flow is not limited).
+	 *
+	 * {
+	 *     "credit_window" : 256
+	 * }
+	 */
+	unsigned int creditWindow();
+	void setCreditWindow(unsigned int window);
+
+	/*
+	 * Number of credits granted by the message credit.
+	 */
+	unsigned int credits();
+
 	SensorData toSensorData();
 
+	std::vector<SensorData> toSensorDataBatch();
+
 	GatewayListenCommand::Ptr toGatewayListenCommand();
 
+	/*
+	 * Set status of the result. The DeviceSetValueResult gets also
+	 * the extended status GW_DEVICE_SUCCESS or GW_DEVICE_FAILED,
+	 * both are set at once.
+	 */
 	void toDefaultResult(Result::Ptr result);
 
 	DeviceSetValueCommand::Ptr toDeviceSetValueCommand();
@@ -109,8 +169,17 @@ public:
 	 */
 	static ZMQMessage fromJSON(const std::string &json);
 
+	/*
+	 * Parses json message directly from the given buffer
+	 * (e.g. a received ZMQ frame) without copying it into
+	 * a temporary string.
+	 */
+	static ZMQMessage fromJSON(const char *json, size_t length);
+
 	static ZMQMessage fromSensorData(const SensorData &sensorData);
 
+	static ZMQMessage fromSensorDataBatch(const std::vector<SensorData> &batch);
+
 	/*
 	 * It is a response to an unknown message/attribute.
 	 */
@@ -121,6 +190,10 @@ public:
 
 	static ZMQMessage fromHelloResponse(const DeviceManagerID &deviceManagerID);
 
+	static ZMQMessage fromHeartbeat();
+
+	static ZMQMessage fromCredit(unsigned int credits);
+
 	static ZMQMessage fromCommand(const Command::Ptr cmd);
 
 	static ZMQMessage fromResult(const Result::Ptr result);
@@ -249,6 +322,16 @@ private:
 		const SensorValue &sensorValue);
 	SensorValue getSensorValue(Poco::JSON::Object::Ptr jsonObject);
 
+	/*
+	 * {
+	 *     "device_id" : "0x12345678945",
+	 *     "values" : [ ... ]
+	 * }
+	 */
+	void setSensorData(Poco::JSON::Object::Ptr jsonObject,
+		const SensorData &sensorData);
+	SensorData getSensorData(Poco::JSON::Object::Ptr jsonObject);
+
 	/*
 	 * {
 	 *     "type" : "double"
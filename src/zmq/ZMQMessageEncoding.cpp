@@ -0,0 +1,14 @@
+#include "zmq/ZMQMessageEncoding.h"
+
+using namespace BeeeOn;
+
+EnumHelper<ZMQMessageEncodingEnum::Raw>::ValueMap
+	&ZMQMessageEncodingEnum::valueMap()
+{
+	static EnumHelper<ZMQMessageEncodingEnum::Raw>::ValueMap valueMap = {
+		{ZMQMessageEncodingEnum::ENCODING_JSON, "json"},
+		{ZMQMessageEncodingEnum::ENCODING_BINARY, "binary"},
+	};
+
+	return valueMap;
+}
@@ -0,0 +1,36 @@
+#ifndef BEEEON_ZMQ_MESSAGE_ENCODING_H
+#define BEEEON_ZMQ_MESSAGE_ENCODING_H
+
+#include "util/Enum.h"
+
+namespace BeeeOn {
+
+/*
+ * Encoding of messages sent over the data socket. The encoding
+ * is negotiated during registration of a device manager. The client
+ * asks for the preferred encoding in hello_request and the broker
+ * confirms it in hello_response. When the attribute is missing
+ * in any of these messages, JSON is used.
+ *
+ * {
+ *     "message_type" : "hello_request",
+ *     "device_manager_prefix" : "Fitprotocol",
+ *     "encoding" : "binary"
+ * }
+ *
+ * The binary encoding is described in ZMQBinaryMessage.
+ */
+struct ZMQMessageEncodingEnum {
+	enum Raw {
+		ENCODING_JSON,
+		ENCODING_BINARY,
+	};
+
+	static EnumHelper<Raw>::ValueMap &valueMap();
+};
+
+typedef Enum<ZMQMessageEncodingEnum> ZMQMessageEncoding;
+
+}
+
+#endif
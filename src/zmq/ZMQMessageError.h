@@ -16,6 +16,7 @@ public:
 		ERROR_MAXIMUM_DEVICE_MANAGERS,
 		ERROR_MISSING_ATTRIBUTE,
 		ERROR_UNSUPPORTED_MESSAGE,
+		ERROR_UNKNOWN_DEVICE_MANAGER,
 	};
 
 	ZMQMessageError(const Error errorCode,
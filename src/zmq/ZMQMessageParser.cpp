@@ -0,0 +1,280 @@
+#include <string>
+
+#include <Poco/Exception.h>
+#include <Poco/NumberParser.h>
+
+#include "model/DeviceID.h"
+#include "model/ModuleID.h"
+#include "model/SensorData.h"
+#include "model/SensorValue.h"
+#include "util/JsonPullParser.h"
+#include "zmq/ZMQMessageParser.h"
+#include "zmq/ZMQMessageValueType.h"
+
+using namespace BeeeOn;
+using namespace Poco;
+using namespace std;
+
+/*
+ * Reads a scalar value (string, number or boolean) following the key
+ * as text. It corresponds to JsonUtil::extract<string>() that converts
+ * the scalar values too.
+ */
+static const string &readScalar(JsonPullParser &parser, const string &key)
+{
+	switch (parser.next()) {
+	case JsonPullParser::TOKEN_STRING:
+	case JsonPullParser::TOKEN_NUMBER:
+		return parser.text();
+	default:
+		throw SyntaxException("attribute " + key + " is not a scalar");
+	}
+}
+
+static SensorValue parseSensorValue(JsonPullParser &parser)
+{
+	bool hasModuleID = false;
+	bool hasRaw = false;
+	bool hasType = false;
+	ModuleID moduleID;
+	string raw;
+	bool isDouble = false;
+
+	JsonPullParser::Token token;
+	while ((token = parser.next()) == JsonPullParser::TOKEN_KEY) {
+		if (parser.text() == "module_id") {
+			moduleID = ModuleID::parse(readScalar(parser, "module_id"));
+			hasModuleID = true;
+		}
+		else if (parser.text() == "raw") {
+			raw = readScalar(parser, "raw");
+			hasRaw = true;
+		}
+		else if (parser.text() == "type") {
+			isDouble = ZMQMessageValueType::parse(readScalar(parser, "type")).raw()
+				== ZMQMessageValueType::TYPE_DOUBLE;
+			hasType = true;
+		}
+		else {
+			parser.skipValue();
+		}
+	}
+
+	if (token != JsonPullParser::TOKEN_END_OBJECT)
+		throw SyntaxException("unexpected token in values");
+
+	if (!hasModuleID)
+		throw InvalidAccessException("missing attribute module_id");
+	if (!hasType)
+		throw InvalidAccessException("missing attribute type");
+
+	if (!isDouble)
+		return SensorValue(moduleID);
+
+	if (!hasRaw)
+		throw InvalidAccessException("missing attribute raw");
+
+	return SensorValue(moduleID, NumberParser::parseFloat(raw));
+}
+
+static void parseValues(JsonPullParser &parser, SensorData &sensorData)
+{
+	parser.expect(JsonPullParser::TOKEN_BEGIN_ARRAY);
+
+	JsonPullParser::Token token;
+	while ((token = parser.next()) == JsonPullParser::TOKEN_BEGIN_OBJECT)
+		sensorData.insertValue(parseSensorValue(parser));
+
+	if (token != JsonPullParser::TOKEN_END_ARRAY)
+		throw SyntaxException("values must contain only objects");
+}
+
+ZMQMessageType ZMQMessageParser::type(const char *json, size_t length)
+{
+	JsonPullParser parser(json, length);
+	parser.expect(JsonPullParser::TOKEN_BEGIN_OBJECT);
+
+	while (parser.next() == JsonPullParser::TOKEN_KEY) {
+		if (parser.text() == "message_type")
+			return ZMQMessageType::parse(readScalar(parser, "message_type"));
+
+		parser.skipValue();
+	}
+
+	throw InvalidAccessException("missing attribute message_type");
+}
+
+/*
+ * Reads the value of the given key when it is an attribute
+ * of measured_values. Returns false for any other key.
+ */
+static bool parseSensorDataKey(JsonPullParser &parser,
+		SensorData &sensorData, bool &hasDeviceID, bool &hasValues)
+{
+	if (parser.text() == "device_id") {
+		sensorData.setDeviceID(
+			DeviceID::parse(readScalar(parser, "device_id")));
+		hasDeviceID = true;
+		return true;
+	}
+	else if (parser.text() == "values") {
+		parseValues(parser, sensorData);
+		hasValues = true;
+		return true;
+	}
+
+	return false;
+}
+
+static void checkSensorData(bool hasDeviceID, bool hasValues)
+{
+	if (!hasDeviceID)
+		throw InvalidAccessException("missing attribute device_id");
+	if (!hasValues)
+		throw InvalidAccessException("missing attribute values");
+}
+
+/*
+ * Reads attributes of a measured_values object. The opening brace
+ * must be already consumed.
+ */
+static SensorData parseSensorData(JsonPullParser &parser)
+{
+	SensorData sensorData;
+	bool hasDeviceID = false;
+	bool hasValues = false;
+
+	JsonPullParser::Token token;
+	while ((token = parser.next()) == JsonPullParser::TOKEN_KEY) {
+		if (!parseSensorDataKey(parser, sensorData, hasDeviceID, hasValues))
+			parser.skipValue();
+	}
+
+	if (token != JsonPullParser::TOKEN_END_OBJECT)
+		throw SyntaxException("unexpected token in message");
+
+	checkSensorData(hasDeviceID, hasValues);
+	return sensorData;
+}
+
+/*
+ * Reads the array of measured_values objects of the attribute data.
+ */
+static void parseBatchData(JsonPullParser &parser, vector<SensorData> &batch)
+{
+	parser.expect(JsonPullParser::TOKEN_BEGIN_ARRAY);
+
+	JsonPullParser::Token token;
+	while ((token = parser.next()) == JsonPullParser::TOKEN_BEGIN_OBJECT)
+		batch.push_back(parseSensorData(parser));
+
+	if (token != JsonPullParser::TOKEN_END_ARRAY)
+		throw SyntaxException("data must contain only objects");
+}
+
+static void expectEnd(JsonPullParser &parser)
+{
+	if (parser.next() != JsonPullParser::TOKEN_END)
+		throw SyntaxException("unexpected data after message");
+}
+
+SensorData ZMQMessageParser::toSensorData(const char *json, size_t length)
+{
+	JsonPullParser parser(json, length);
+	parser.expect(JsonPullParser::TOKEN_BEGIN_OBJECT);
+
+	SensorData sensorData = parseSensorData(parser);
+	expectEnd(parser);
+
+	return sensorData;
+}
+
+vector<SensorData> ZMQMessageParser::toSensorDataBatch(
+	const char *json, size_t length)
+{
+	JsonPullParser parser(json, length);
+	parser.expect(JsonPullParser::TOKEN_BEGIN_OBJECT);
+
+	vector<SensorData> batch;
+	bool hasData = false;
+
+	JsonPullParser::Token token;
+	while ((token = parser.next()) == JsonPullParser::TOKEN_KEY) {
+		if (parser.text() != "data") {
+			parser.skipValue();
+			continue;
+		}
+
+		parseBatchData(parser, batch);
+		hasData = true;
+	}
+
+	if (token != JsonPullParser::TOKEN_END_OBJECT)
+		throw SyntaxException("unexpected token in message");
+
+	expectEnd(parser);
+
+	if (!hasData)
+		throw InvalidAccessException("missing attribute data");
+
+	return batch;
+}
+
+ZMQMessageType ZMQMessageParser::parse(const char *json, size_t length,
+	vector<SensorData> &data)
+{
+	JsonPullParser parser(json, length);
+	parser.expect(JsonPullParser::TOKEN_BEGIN_OBJECT);
+
+	SensorData sensorData;
+	vector<SensorData> batch;
+	bool hasType = false;
+	bool isBatch = false;
+	bool hasDeviceID = false;
+	bool hasValues = false;
+	bool hasData = false;
+
+	JsonPullParser::Token token;
+	while ((token = parser.next()) == JsonPullParser::TOKEN_KEY) {
+		if (parser.text() == "message_type") {
+			const ZMQMessageType type = ZMQMessageType::parse(
+				readScalar(parser, "message_type"));
+
+			if (type == ZMQMessageType::TYPE_MEASURED_VALUES_BATCH)
+				isBatch = true;
+			else if (type != ZMQMessageType::TYPE_MEASURED_VALUES)
+				return type;
+
+			hasType = true;
+		}
+		else if (parser.text() == "data") {
+			parseBatchData(parser, batch);
+			hasData = true;
+		}
+		else if (!parseSensorDataKey(parser, sensorData, hasDeviceID, hasValues)) {
+			parser.skipValue();
+		}
+	}
+
+	if (token != JsonPullParser::TOKEN_END_OBJECT)
+		throw SyntaxException("unexpected token in message");
+
+	expectEnd(parser);
+
+	if (!hasType)
+		throw InvalidAccessException("missing attribute message_type");
+
+	if (isBatch) {
+		if (!hasData)
+			throw InvalidAccessException("missing attribute data");
+
+		data = std::move(batch);
+		return ZMQMessageType::fromRaw(ZMQMessageType::TYPE_MEASURED_VALUES_BATCH);
+	}
+
+	checkSensorData(hasDeviceID, hasValues);
+
+	data.clear();
+	data.push_back(sensorData);
+	return ZMQMessageType::fromRaw(ZMQMessageType::TYPE_MEASURED_VALUES);
+}
@@ -0,0 +1,61 @@
+#ifndef BEEEON_ZMQ_MESSAGE_PARSER_H
+#define BEEEON_ZMQ_MESSAGE_PARSER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "zmq/ZMQMessageType.h"
+
+namespace BeeeOn {
+
+class SensorData;
+
+/*
+ * Streaming parser of the hot-path zmq messages. Unlike
+ * ZMQMessage::fromJSON() it does not build a Poco::JSON DOM,
+ * it reads the received frame token by token and creates
+ * the target objects directly.
+ *
+ * Example:
+ *     vector<SensorData> batch;
+ *
+ *     if (ZMQMessageParser::parse(data, size, batch)
+ *             == ZMQMessageType::TYPE_MEASURED_VALUES)
+ *         exportData(batch.front());
+ *
+ * Malformed JSON is reported as Poco::SyntaxException, missing
+ * attributes as Poco::InvalidAccessException, exactly as the
+ * ZMQMessage would do.
+ */
+class ZMQMessageParser {
+public:
+	/*
+	 * Type of message given by the attribute message_type.
+	 */
+	static ZMQMessageType type(const char *json, size_t length);
+
+	/*
+	 * Reads the message of type measured_values.
+	 */
+	static SensorData toSensorData(const char *json, size_t length);
+
+	/*
+	 * Reads the message of type measured_values_batch.
+	 */
+	static std::vector<SensorData> toSensorDataBatch(
+		const char *json, size_t length);
+
+	/*
+	 * Reads the message of type measured_values or
+	 * measured_values_batch in a single pass. The given vector
+	 * is replaced by the read data (a single item for measured_values).
+	 * Other types of messages are only recognized and the vector
+	 * is left untouched.
+	 */
+	static ZMQMessageType parse(const char *json, size_t length,
+		std::vector<SensorData> &data);
+};
+
+}
+
+#endif
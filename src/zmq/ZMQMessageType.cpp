@@ -18,6 +18,9 @@ EnumHelper<ZMQMessageTypeEnum::Raw>::ValueMap &ZMQMessageTypeEnum::valueMap()
 		{ZMQMessageTypeEnum::TYPE_MEASURED_VALUES, "measured_values"},
 		{ZMQMessageTypeEnum::TYPE_SET_VALUES_CMD, "set_values_cmd"},
 		{ZMQMessageTypeEnum::TYPE_SET_VALUES_RESULT, "set_values_result"},
+		{ZMQMessageTypeEnum::TYPE_MEASURED_VALUES_BATCH, "measured_values_batch"},
+		{ZMQMessageTypeEnum::TYPE_HEARTBEAT, "heartbeat"},
+		{ZMQMessageTypeEnum::TYPE_CREDIT, "credit"},
 	};
 
 	return valueMap;
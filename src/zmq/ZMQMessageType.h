@@ -30,6 +30,11 @@ namespace BeeeOn {
  *     "device_manager_prefix" : "Fitprotocol"
  * }
  *
+ * A device manager that has been registered before may ask to resume
+ * its previous DeviceManagerID (optional attribute device_manager_id).
+ * The broker assigns it again unless it is used by another device
+ * manager.
+ *
  * 3. message_type: hello_response
  *
  * Sprava obsahujuca vygenerovane DeviceManagerID, ktore sa dalej
@@ -40,6 +45,14 @@ namespace BeeeOn {
  *     "device_manager_id" : "0xa100"
  * }
  *
+ * When the broker tracks liveness of device managers, it announces
+ * the interval of heartbeats in milliseconds (optional attribute
+ * heartbeat_interval).
+ *
+ * When the broker limits the flow of measured values, it announces
+ * the initial number of credits (optional attribute credit_window).
+ * See the message credit.
+ *
  * 4. message_type: measured_values
  *
  * Psrava s nameranymi hodnota zo zariadenia. Pre identifikaciu
@@ -146,6 +159,50 @@ namespace BeeeOn {
  *     "device_id" : "0x132465789"
  * }
  *
+ * 13. message_type: measured_values_batch
+ *
+ * Viacero sprav measured_values odoslanych naraz. Kazda polozka
+ * v poli data ma rovnaky format ako sprava measured_values.
+ *
+ * {
+ *     "message_type" : "measured_values_batch",
+ *     "data" : [
+ *         {
+ *             "device_id" : "0x132465789",
+ *             "values" : [
+ *                 {
+ *                     "raw" : "103.5",
+ *                     "type" : "double",
+ *                     "module_id" : "0"
+ *                 }
+ *             ]
+ *         }
+ *     ]
+ * }
+ *
+ * 14. message_type: heartbeat
+ *
+ * Sprava zasielana manazerom zariadeni cez datovy socket v intervale
+ * heartbeat_interval. Broker povazuje manazera zariadeni za ziveho,
+ * kym od neho prijima akekolvek spravy. Manazer zariadeni, od ktoreho
+ * neprisla ziadna sprava pocas niekolkych intervalov, je odregistrovany.
+ *
+ * {
+ *     "message_type" : "heartbeat"
+ * }
+ *
+ * 15. message_type: credit
+ *
+ * Sprava zasielana brokerom manazerovi zariadeni cez datovy socket.
+ * Kazda sprava measured_values alebo measured_values_batch spotrebuje
+ * jeden kredit, broker vracia kredity po spracovani sprav. Spravy
+ * measured_values prijate bez kreditu broker zahadzuje.
+ *
+ * {
+ *     "message_type" : "credit",
+ *     "credits" : 32
+ * }
+ *
  */
 struct ZMQMessageTypeEnum {
 	enum Raw {
@@ -162,6 +219,9 @@ struct ZMQMessageTypeEnum {
 		TYPE_MEASURED_VALUES,
 		TYPE_SET_VALUES_CMD,
 		TYPE_SET_VALUES_RESULT,
+		TYPE_MEASURED_VALUES_BATCH,
+		TYPE_HEARTBEAT,
+		TYPE_CREDIT,
 	};
 
 	static EnumHelper<Raw>::ValueMap &valueMap();
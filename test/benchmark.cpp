@@ -0,0 +1,28 @@
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+
+#include <Poco/AutoPtr.h>
+#include <Poco/ConsoleChannel.h>
+#include <Poco/Logger.h>
+
+using namespace Poco;
+
+/*
+ * Runner of the benchmarks registered into the "benchmark" registry
+ * (CPPUNIT_TEST_SUITE_NAMED_REGISTRATION) by the test sources. They
+ * are built by the benchmark-suite-gateway target only. The benchmarks
+ * report their results via the loggers and take too long to be a part
+ * of the test suite, the default registry used by test-suite-gateway
+ * does not contain them.
+ */
+int main()
+{
+	AutoPtr<ConsoleChannel> channel(new ConsoleChannel);
+	Logger::root().setChannel(channel);
+	Logger::root().setLevel(Message::PRIO_INFORMATION);
+
+	CppUnit::TextUi::TestRunner runner;
+	runner.addTest(CppUnit::TestFactoryRegistry::getRegistry("benchmark").makeTest());
+
+	return runner.run() ? 0 : 1;
+}
@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <vector>
+
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <Poco/Logger.h>
 #include <Poco/Timer.h>
 #include <Poco/Timespan.h>
 
@@ -17,6 +21,8 @@ class AnswerQueueTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(testWaitTimeout);
 	CPPUNIT_TEST(testRemove);
 	CPPUNIT_TEST(testResultUpdated);
+	CPPUNIT_TEST(testRemovedDirty);
+	CPPUNIT_TEST(testDirtyOrder);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -24,10 +30,23 @@ public:
 	void testWaitTimeout();
 	void testRemove();
 	void testResultUpdated();
+	void testRemovedDirty();
+	void testDirtyOrder();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(AnswerQueueTest);
 
+class AnswerQueueBenchmark : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(AnswerQueueBenchmark);
+	CPPUNIT_TEST(benchmarkListDirty);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void benchmarkListDirty();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(AnswerQueueBenchmark, "benchmark");
+
 class TestableAnswerQueue : public AnswerQueue {
 public:
 	using AnswerQueue::listDirty;
@@ -268,4 +287,97 @@ void AnswerQueueTest::testResultUpdated()
 	CPPUNIT_ASSERT(0 == queue.size());
 }
 
+/*
+ * A dirty Answer removed from the queue is never listed.
+ */
+void AnswerQueueTest::testRemovedDirty()
+{
+	TestableAnswerQueue queue;
+	std::list<Answer::Ptr> answerList;
+
+	Answer::Ptr answer0 = new Answer(queue);
+	Answer::Ptr answer1 = new Answer(queue);
+
+	answer0->setDirty(true);
+	answer1->setDirty(true);
+	queue.remove(answer0);
+
+	queue.listDirty(answerList);
+	CPPUNIT_ASSERT(1 == answerList.size());
+	CPPUNIT_ASSERT_EQUAL(answer1, answerList.front());
+}
+
+/*
+ * The dirty Answers are listed in order of their updates and every
+ * Answer is listed just once, even when updated multiple times.
+ */
+void AnswerQueueTest::testDirtyOrder()
+{
+	TestableAnswerQueue queue;
+	std::list<Answer::Ptr> answerList;
+
+	Answer::Ptr answer0 = new Answer(queue);
+	Answer::Ptr answer1 = new Answer(queue);
+	Answer::Ptr answer2 = new Answer(queue);
+
+	answer2->setDirty(true);
+	answer0->setDirty(true);
+	answer2->setDirty(true);
+
+	queue.listDirty(answerList);
+	CPPUNIT_ASSERT(2 == answerList.size());
+	CPPUNIT_ASSERT_EQUAL(answer2, answerList.front());
+	CPPUNIT_ASSERT_EQUAL(answer0, answerList.back());
+
+	// the update after listing enqueues the Answer again
+	answerList.clear();
+	answer2->setDirty(true);
+
+	queue.listDirty(answerList);
+	CPPUNIT_ASSERT(1 == answerList.size());
+	CPPUNIT_ASSERT_EQUAL(answer2, answerList.front());
+}
+
+/*
+ * Measure wait() collecting a few dirty Answers among
+ * a growing count of live Answers.
+ */
+void AnswerQueueBenchmark::benchmarkListDirty()
+{
+	const unsigned int counts[] = {10, 100, 1000, 10000, 100000};
+	const unsigned int rounds = 1000;
+	const unsigned int dirtyPerRound = 10;
+	Logger &logger = Logger::get("AnswerQueueTest");
+
+	for (auto count : counts) {
+		TestableAnswerQueue queue;
+		std::vector<Answer::Ptr> answers;
+		std::list<Answer::Ptr> answerList;
+		size_t listed = 0;
+
+		for (unsigned int i = 0; i < count; ++i)
+			answers.push_back(new Answer(queue));
+
+		Timestamp start;
+
+		for (unsigned int r = 0; r < rounds; ++r) {
+			for (unsigned int i = 0; i < dirtyPerRound; ++i)
+				answers[(r * dirtyPerRound + i) % count]->setDirty(true);
+
+			answerList.clear();
+			queue.wait(0, answerList);
+			listed += answerList.size();
+		}
+
+		const Timestamp::TimeDiff elapsed = start.elapsed();
+
+		logger.information(
+			std::to_string(count) + " answers: "
+			+ std::to_string(elapsed / rounds) + " us per wait");
+
+		CPPUNIT_ASSERT_EQUAL(
+			(size_t) rounds * std::min(count, dirtyPerRound), listed);
+	}
+}
+
 }
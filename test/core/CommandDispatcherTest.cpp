@@ -1,5 +1,13 @@
+#include <atomic>
+#include <vector>
+
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <Poco/Exception.h>
+#include <Poco/Logger.h>
+#include <Poco/Thread.h>
+#include <Poco/Timestamp.h>
+
 #include "core/AnswerQueue.h"
 #include "core/CommandDispatcher.h"
 #include "core/Result.h"
@@ -11,15 +19,36 @@ class CommandDispatcherTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(CommandDispatcherTest);
 	CPPUNIT_TEST(testSupportedCommand);
 	CPPUNIT_TEST(testUnsupportedCommand);
+	CPPUNIT_TEST(testSharedExecutor);
+	CPPUNIT_TEST(testRoutedCommand);
+	CPPUNIT_TEST(testConfirmedRoute);
+	CPPUNIT_TEST(testDuplicateHandler);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void testSupportedCommand();
 	void testUnsupportedCommand();
+	void testSharedExecutor();
+	void testRoutedCommand();
+	void testConfirmedRoute();
+	void testDuplicateHandler();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(CommandDispatcherTest);
 
+class CommandDispatcherBenchmark : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(CommandDispatcherBenchmark);
+	CPPUNIT_TEST(benchmarkDispatch);
+	CPPUNIT_TEST(benchmarkRouting);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void benchmarkDispatch();
+	void benchmarkRouting();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(CommandDispatcherBenchmark, "benchmark");
+
 class FakeCommand : public Command {
 public:
 	FakeCommand(const DeviceID &deviceID):
@@ -28,13 +57,24 @@ public:
 	{
 	}
 
-	DeviceID deviceID() const
+	bool hasDeviceID() const override
+	{
+		return true;
+	}
+
+	DeviceID deviceID() const override
 	{
 		return m_deviceID;
 	}
 
+	const Poco::Timestamp &created() const
+	{
+		return m_created;
+	}
+
 private:
 	DeviceID m_deviceID;
+	Poco::Timestamp m_created;
 };
 
 /*
@@ -107,6 +147,87 @@ private:
 	DeviceID m_deviceID;
 };
 
+/*
+ * The handler immediately succeeds and measures the latency
+ * since the command creation.
+ */
+class LatencyHandler : public CommandHandler {
+public:
+	LatencyHandler():
+		CommandHandler("LatencyHandler"),
+		m_latency(0),
+		m_handled(0)
+	{
+	}
+
+	bool accept(Command::Ptr cmd) override
+	{
+		return cmd->is<FakeCommand>();
+	}
+
+	void handle(Command::Ptr cmd, Answer::Ptr answer) override
+	{
+		m_latency += cmd.cast<FakeCommand>()->created().elapsed();
+		++m_handled;
+
+		Result::Ptr result = new Result(answer);
+		result->setStatus(Result::SUCCESS);
+	}
+
+	std::atomic<int64_t> m_latency;
+	std::atomic<unsigned int> m_handled;
+};
+
+/*
+ * Command not served by any handler in the tests.
+ */
+class OtherCommand : public Command {
+public:
+	OtherCommand():
+		Command("OtherCommand")
+	{
+	}
+};
+
+/*
+ * The handler declares routes and counts calls of accept().
+ */
+class RoutedHandler : public CommandHandler {
+public:
+	RoutedHandler(const std::vector<Route> &routes, bool accepting = true):
+		CommandHandler("RoutedHandler"),
+		m_routes(routes),
+		m_accepting(accepting),
+		m_accepted(0),
+		m_handled(0)
+	{
+	}
+
+	std::vector<Route> routes() const override
+	{
+		return m_routes;
+	}
+
+	bool accept(Command::Ptr) override
+	{
+		++m_accepted;
+		return m_accepting;
+	}
+
+	void handle(Command::Ptr, Answer::Ptr answer) override
+	{
+		++m_handled;
+
+		Result::Ptr result = new Result(answer);
+		result->setStatus(Result::SUCCESS);
+	}
+
+	std::vector<Route> m_routes;
+	bool m_accepting;
+	std::atomic<unsigned int> m_accepted;
+	std::atomic<unsigned int> m_handled;
+};
+
 class NonAcceptingCommandHandler : public CommandHandler {
 public:
 	NonAcceptingCommandHandler():
@@ -173,7 +294,6 @@ void CommandDispatcherTest::testSupportedCommand()
 	CPPUNIT_ASSERT(!answer->isEmpty());
 
 	queue.remove(answer);
-	Poco::ThreadPool::defaultPool().joinAll();
 }
 
 /*
@@ -208,4 +328,267 @@ void CommandDispatcherTest::testUnsupportedCommand()
 	queue.remove(answer);
 }
 
+/*
+ * Two dispatchers share a single executor.
+ */
+void CommandDispatcherTest::testSharedExecutor()
+{
+	CommandExecutor::Ptr executor(new CommandExecutor);
+	executor->setThreadsCount(2);
+
+	CommandDispatcher dispatcher0;
+	CommandDispatcher dispatcher1;
+	dispatcher0.setExecutor(executor);
+	dispatcher1.setExecutor(executor);
+
+	Poco::SharedPtr<LatencyHandler> handler(new LatencyHandler);
+	dispatcher0.registerHandler(handler);
+	dispatcher1.registerHandler(handler);
+
+	AnswerQueue queue;
+
+	Answer::Ptr answer0 = new Answer(queue);
+	Answer::Ptr answer1 = new Answer(queue);
+
+	dispatcher0.dispatch(new FakeCommand(DeviceID(1)), answer0);
+	dispatcher1.dispatch(new FakeCommand(DeviceID(2)), answer1);
+
+	for (int i = 0; i < 100 && handler->m_handled < 2; ++i)
+		Poco::Thread::sleep(10);
+
+	executor->stop();
+
+	CPPUNIT_ASSERT(2 == handler->m_handled);
+	CPPUNIT_ASSERT(answer0->at(0)->status() == Result::SUCCESS);
+	CPPUNIT_ASSERT(answer1->at(0)->status() == Result::SUCCESS);
+}
+
+static DeviceID zwaveDevice(uint32_t ident)
+{
+	return DeviceID(DevicePrefix::fromRaw(DevicePrefix::PREFIX_ZWAVE), ident);
+}
+
+static DeviceID jablotronDevice(uint32_t ident)
+{
+	return DeviceID(DevicePrefix::fromRaw(DevicePrefix::PREFIX_JABLOTRON), ident);
+}
+
+/*
+ * Dispatch the command and wait until it is processed.
+ */
+static Answer::Ptr dispatchAndWait(CommandDispatcher &dispatcher,
+		AnswerQueue &queue, Command::Ptr cmd)
+{
+	Answer::Ptr answer = new Answer(queue);
+	dispatcher.dispatch(cmd, answer);
+
+	for (int i = 0; i < 100 && answer->isPending(); ++i)
+		Poco::Thread::sleep(10);
+
+	queue.remove(answer);
+	return answer;
+}
+
+/*
+ * Commands matching a route are passed to the handler without calling
+ * accept(), routes of a particular prefix do not match other prefixes.
+ * Dynamic handlers are still asked via accept().
+ */
+void CommandDispatcherTest::testRoutedCommand()
+{
+	CommandDispatcher dispatcher;
+	AnswerQueue queue;
+
+	Poco::SharedPtr<RoutedHandler> any(new RoutedHandler({
+		CommandHandler::Route::of<FakeCommand>()}));
+	Poco::SharedPtr<RoutedHandler> zwave(new RoutedHandler({
+		CommandHandler::Route::of<FakeCommand>(
+			DevicePrefix::fromRaw(DevicePrefix::PREFIX_ZWAVE))}));
+	Poco::SharedPtr<RoutedHandler> dynamic(new RoutedHandler({}, false));
+
+	dispatcher.registerHandler(any);
+	dispatcher.registerHandler(zwave);
+	dispatcher.registerHandler(dynamic);
+
+	Answer::Ptr answer = dispatchAndWait(
+		dispatcher, queue, new FakeCommand(zwaveDevice(1)));
+
+	CPPUNIT_ASSERT_EQUAL((unsigned long) 2, answer->resultsCount());
+	CPPUNIT_ASSERT(1 == any->m_handled);
+	CPPUNIT_ASSERT(1 == zwave->m_handled);
+
+	answer = dispatchAndWait(
+		dispatcher, queue, new FakeCommand(jablotronDevice(1)));
+
+	CPPUNIT_ASSERT_EQUAL((unsigned long) 1, answer->resultsCount());
+	CPPUNIT_ASSERT(2 == any->m_handled);
+	CPPUNIT_ASSERT(1 == zwave->m_handled);
+
+	answer = dispatchAndWait(dispatcher, queue, new OtherCommand);
+
+	CPPUNIT_ASSERT(answer->isEmpty());
+
+	CPPUNIT_ASSERT(0 == any->m_accepted);
+	CPPUNIT_ASSERT(0 == zwave->m_accepted);
+	CPPUNIT_ASSERT(3 == dynamic->m_accepted);
+	CPPUNIT_ASSERT(0 == dynamic->m_handled);
+}
+
+/*
+ * The accept() is called for commands matching a confirmed route
+ * only.
+ */
+void CommandDispatcherTest::testConfirmedRoute()
+{
+	CommandDispatcher dispatcher;
+	AnswerQueue queue;
+
+	Poco::SharedPtr<RoutedHandler> handler(new RoutedHandler({
+		CommandHandler::Route::of<FakeCommand>(true)}, false));
+
+	dispatcher.registerHandler(handler);
+
+	Answer::Ptr answer = dispatchAndWait(
+		dispatcher, queue, new FakeCommand(zwaveDevice(1)));
+
+	CPPUNIT_ASSERT(answer->isEmpty());
+	CPPUNIT_ASSERT(1 == handler->m_accepted);
+
+	answer = dispatchAndWait(dispatcher, queue, new OtherCommand);
+
+	CPPUNIT_ASSERT(answer->isEmpty());
+	CPPUNIT_ASSERT(1 == handler->m_accepted);
+	CPPUNIT_ASSERT(0 == handler->m_handled);
+}
+
+void CommandDispatcherTest::testDuplicateHandler()
+{
+	CommandDispatcher dispatcher;
+
+	Poco::SharedPtr<RoutedHandler> handler(new RoutedHandler({
+		CommandHandler::Route::of<FakeCommand>()}));
+
+	dispatcher.registerHandler(handler);
+
+	CPPUNIT_ASSERT_THROW(dispatcher.registerHandler(handler),
+		Poco::ExistsException);
+}
+
+/*
+ * Measure the latency of dispatching a command (from its creation
+ * until it is being handled) and the throughput of the dispatching
+ * up to the processing of all Answers for various counts of threads.
+ */
+void CommandDispatcherBenchmark::benchmarkDispatch()
+{
+	const unsigned int threads[] = {1, 2, 4, 8};
+	const unsigned int count = 20000;
+	Poco::Logger &logger = Poco::Logger::get("CommandDispatcherTest");
+
+	for (auto threadsCount : threads) {
+		CommandExecutor::Ptr executor(new CommandExecutor);
+		executor->setThreadsCount(threadsCount);
+
+		CommandDispatcher dispatcher;
+		dispatcher.setExecutor(executor);
+
+		Poco::SharedPtr<LatencyHandler> handler(new LatencyHandler);
+		dispatcher.registerHandler(handler);
+
+		AnswerQueue queue;
+		std::list<Answer::Ptr> answerList;
+		unsigned int done = 0;
+
+		Poco::Timestamp start;
+
+		for (unsigned int i = 0; i < count; ++i) {
+			Answer::Ptr answer = new Answer(queue);
+			dispatcher.dispatch(new FakeCommand(DeviceID(i)), answer);
+		}
+
+		while (done < count) {
+			if (!queue.wait(1000 * Poco::Timespan::MILLISECONDS, answerList))
+				break;
+
+			for (auto &answer : answerList) {
+				if (!answer->isPending()) {
+					queue.remove(answer);
+					done++;
+				}
+			}
+		}
+
+		const Poco::Timestamp::TimeDiff elapsed = start.elapsed();
+
+		logger.information(
+			std::to_string(threadsCount) + " threads: "
+			+ std::to_string(count) + " commands in "
+			+ std::to_string(elapsed / 1000) + " ms, average latency "
+			+ std::to_string(handler->m_latency / count) + " us, "
+			+ std::to_string(elapsed > 0 ? count * 1000000ULL / elapsed : 0)
+			+ " commands/s");
+
+		CPPUNIT_ASSERT_EQUAL(count, done);
+	}
+}
+
+/*
+ * Compare the time of dispatching with many dynamic handlers
+ * to the time with the same handlers declaring routes.
+ */
+void CommandDispatcherBenchmark::benchmarkRouting()
+{
+	const unsigned int handlersCount = 64;
+	const unsigned int count = 20000;
+	Poco::Logger &logger = Poco::Logger::get("CommandDispatcherTest");
+
+	for (int routed = 0; routed <= 1; ++routed) {
+		CommandExecutor::Ptr executor(new CommandExecutor);
+		CommandDispatcher dispatcher;
+		dispatcher.setExecutor(executor);
+
+		std::vector<CommandHandler::Route> otherRoutes;
+		std::vector<CommandHandler::Route> fakeRoutes;
+
+		if (routed) {
+			otherRoutes.push_back(CommandHandler::Route::of<OtherCommand>(true));
+			fakeRoutes.push_back(CommandHandler::Route::of<FakeCommand>());
+		}
+
+		for (unsigned int i = 0; i < handlersCount; ++i) {
+			dispatcher.registerHandler(Poco::SharedPtr<CommandHandler>(
+				new RoutedHandler(otherRoutes, false)));
+		}
+
+		Poco::SharedPtr<RoutedHandler> handler(new RoutedHandler(fakeRoutes));
+		dispatcher.registerHandler(handler);
+
+		AnswerQueue queue;
+		std::vector<Answer::Ptr> answers;
+		answers.reserve(count);
+
+		Poco::Timestamp start;
+
+		for (unsigned int i = 0; i < count; ++i) {
+			answers.push_back(new Answer(queue));
+			dispatcher.dispatch(new FakeCommand(zwaveDevice(i)), answers.back());
+		}
+
+		const Poco::Timestamp::TimeDiff elapsed = start.elapsed();
+
+		executor->stop();
+
+		for (auto &answer : answers)
+			queue.remove(answer);
+
+		logger.information(
+			std::string(routed ? "routed" : "dynamic") + ": "
+			+ std::to_string(count) + " commands, "
+			+ std::to_string(handlersCount + 1) + " handlers, dispatched in "
+			+ std::to_string(elapsed / 1000) + " ms");
+
+		CPPUNIT_ASSERT_EQUAL(count, (unsigned int) handler->m_handled);
+	}
+}
+
 }
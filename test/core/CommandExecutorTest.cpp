@@ -0,0 +1,239 @@
+#include <atomic>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Event.h>
+#include <Poco/Exception.h>
+#include <Poco/Runnable.h>
+#include <Poco/Thread.h>
+
+#include "cppunit/BetterAssert.h"
+
+#include "core/CommandExecutor.h"
+
+using namespace Poco;
+using namespace std;
+
+namespace BeeeOn {
+
+class CommandExecutorTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(CommandExecutorTest);
+	CPPUNIT_TEST(testExecuteAll);
+	CPPUNIT_TEST(testStealFromBlockedWorker);
+	CPPUNIT_TEST(testStopExecutesQueued);
+	CPPUNIT_TEST(testExecuteWhileStopping);
+	CPPUNIT_TEST(testFailingJob);
+	CPPUNIT_TEST(testThreadsCount);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testExecuteAll();
+	void testStealFromBlockedWorker();
+	void testStopExecutesQueued();
+	void testExecuteWhileStopping();
+	void testFailingJob();
+	void testThreadsCount();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CommandExecutorTest);
+
+class CountingJob : public Runnable {
+public:
+	CountingJob(atomic<unsigned int> &counter, Event *release = NULL):
+		m_counter(counter),
+		m_release(release)
+	{
+	}
+
+	void run() override
+	{
+		if (m_release != NULL)
+			m_release->wait();
+
+		++m_counter;
+	}
+
+private:
+	atomic<unsigned int> &m_counter;
+	Event *m_release;
+};
+
+class FailingJob : public Runnable {
+public:
+	void run() override
+	{
+		throw IOException("job failed");
+	}
+};
+
+static bool waitCount(atomic<unsigned int> &counter, unsigned int count)
+{
+	for (int i = 0; i < 500; ++i) {
+		if (counter >= count)
+			return true;
+
+		Thread::sleep(10);
+	}
+
+	return false;
+}
+
+void CommandExecutorTest::testExecuteAll()
+{
+	CommandExecutor executor;
+	atomic<unsigned int> counter(0);
+
+	for (int i = 0; i < 1000; ++i)
+		executor.execute(new CountingJob(counter));
+
+	CPPUNIT_ASSERT(waitCount(counter, 1000));
+	CPPUNIT_ASSERT_EQUAL((size_t) 0, executor.pending());
+}
+
+/*
+ * Jobs queued to a worker blocked by a long running job
+ * are stolen and executed by the other worker.
+ */
+void CommandExecutorTest::testStealFromBlockedWorker()
+{
+	CommandExecutor executor;
+	executor.setThreadsCount(2);
+
+	Event release;
+	atomic<unsigned int> blocked(0);
+	atomic<unsigned int> counter(0);
+
+	// round-robin, the first job goes to the first worker
+	executor.execute(new CountingJob(blocked, &release));
+
+	for (int i = 0; i < 10; ++i)
+		executor.execute(new CountingJob(counter));
+
+	CPPUNIT_ASSERT(waitCount(counter, 10));
+	CPPUNIT_ASSERT_EQUAL(0U, blocked.load());
+
+	release.set();
+	CPPUNIT_ASSERT(waitCount(blocked, 1));
+}
+
+void CommandExecutorTest::testStopExecutesQueued()
+{
+	CommandExecutor executor;
+	executor.setThreadsCount(1);
+
+	Event release;
+	atomic<unsigned int> counter(0);
+
+	executor.execute(new CountingJob(counter, &release));
+
+	for (int i = 0; i < 10; ++i)
+		executor.execute(new CountingJob(counter));
+
+	release.set();
+	executor.stop();
+
+	CPPUNIT_ASSERT_EQUAL(11U, counter.load());
+	CPPUNIT_ASSERT_THROW(executor.execute(new CountingJob(counter)),
+		IllegalStateException);
+}
+
+/*
+ * Submits jobs until the executor refuses them.
+ */
+class Submitter : public Runnable {
+public:
+	Submitter(CommandExecutor &executor, atomic<unsigned int> &counter):
+		m_executor(executor),
+		m_counter(counter),
+		m_accepted(0)
+	{
+	}
+
+	void run() override
+	{
+		while (true) {
+			try {
+				m_executor.execute(new CountingJob(m_counter));
+			}
+			catch (const IllegalStateException &) {
+				break;
+			}
+
+			++m_accepted;
+		}
+	}
+
+	unsigned int accepted() const
+	{
+		return m_accepted;
+	}
+
+private:
+	CommandExecutor &m_executor;
+	atomic<unsigned int> &m_counter;
+	unsigned int m_accepted;
+};
+
+/*
+ * Every job accepted concurrently with stop() is executed.
+ */
+void CommandExecutorTest::testExecuteWhileStopping()
+{
+	for (int round = 0; round < 20; ++round) {
+		CommandExecutor executor;
+		executor.setThreadsCount(2);
+
+		atomic<unsigned int> counter(0);
+		Submitter submitter0(executor, counter);
+		Submitter submitter1(executor, counter);
+		Thread thread0;
+		Thread thread1;
+
+		thread0.start(submitter0);
+		thread1.start(submitter1);
+
+		Thread::sleep(5);
+		executor.stop();
+
+		thread0.join();
+		thread1.join();
+
+		CPPUNIT_ASSERT_EQUAL(
+			submitter0.accepted() + submitter1.accepted(),
+			counter.load());
+	}
+}
+
+/*
+ * A failing job does not affect the other jobs.
+ */
+void CommandExecutorTest::testFailingJob()
+{
+	CommandExecutor executor;
+	executor.setThreadsCount(1);
+
+	atomic<unsigned int> counter(0);
+
+	executor.execute(new FailingJob);
+	executor.execute(new CountingJob(counter));
+
+	CPPUNIT_ASSERT(waitCount(counter, 1));
+}
+
+void CommandExecutorTest::testThreadsCount()
+{
+	CommandExecutor executor;
+
+	CPPUNIT_ASSERT(executor.threadsCount() >= 4);
+	CPPUNIT_ASSERT_THROW(executor.setThreadsCount(0), InvalidArgumentException);
+
+	executor.setThreadsCount(3);
+	CPPUNIT_ASSERT_EQUAL(3U, executor.threadsCount());
+
+	atomic<unsigned int> counter(0);
+	executor.execute(new CountingJob(counter));
+
+	CPPUNIT_ASSERT_THROW(executor.setThreadsCount(2), IllegalStateException);
+}
+
+}
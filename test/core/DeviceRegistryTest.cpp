@@ -0,0 +1,332 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/SharedPtr.h>
+#include <Poco/Thread.h>
+
+#include "cppunit/BetterAssert.h"
+
+#include "commands/DeviceUnpairCommand.h"
+#include "commands/ServerDeviceListCommand.h"
+#include "commands/ServerDeviceListResult.h"
+#include "core/AnswerQueue.h"
+#include "core/CommandDispatcher.h"
+#include "core/DeviceRegistry.h"
+#include "model/SensorData.h"
+
+using namespace Poco;
+using namespace std;
+
+namespace BeeeOn {
+
+class DeviceRegistryTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DeviceRegistryTest);
+	CPPUNIT_TEST(testShip);
+	CPPUNIT_TEST(testDevicesByPrefix);
+	CPPUNIT_TEST(testPersistence);
+	CPPUNIT_TEST(testTornRecord);
+	CPPUNIT_TEST(testRemove);
+	CPPUNIT_TEST(testRemovePersistence);
+	CPPUNIT_TEST(testHandle);
+	CPPUNIT_TEST(testObserveUnpair);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp();
+	void tearDown();
+
+	void testShip();
+	void testDevicesByPrefix();
+	void testPersistence();
+	void testTornRecord();
+	void testRemove();
+	void testRemovePersistence();
+	void testHandle();
+	void testObserveUnpair();
+
+private:
+	string m_file;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DeviceRegistryTest);
+
+static const DevicePrefix JABLOTRON = DevicePrefix::fromRaw(DevicePrefix::PREFIX_JABLOTRON);
+static const DevicePrefix ZWAVE = DevicePrefix::fromRaw(DevicePrefix::PREFIX_ZWAVE);
+
+void DeviceRegistryTest::setUp()
+{
+	m_file = "/tmp/beeeon-test-paired-devices-" + to_string(getpid());
+	remove(m_file.c_str());
+}
+
+void DeviceRegistryTest::tearDown()
+{
+	remove(m_file.c_str());
+}
+
+/*
+ * Every shipped device is registered once.
+ */
+void DeviceRegistryTest::testShip()
+{
+	DeviceRegistry registry;
+	SensorData data;
+
+	data.setDeviceID(DeviceID(JABLOTRON, 1));
+
+	CPPUNIT_ASSERT(registry.ship(data));
+	CPPUNIT_ASSERT(registry.ship(data));
+
+	data.setDeviceID(DeviceID(JABLOTRON, 2));
+	CPPUNIT_ASSERT(registry.ship(data));
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, registry.size());
+	CPPUNIT_ASSERT(registry.contains(DeviceID(JABLOTRON, 1)));
+	CPPUNIT_ASSERT(registry.contains(DeviceID(JABLOTRON, 2)));
+	CPPUNIT_ASSERT(!registry.contains(DeviceID(JABLOTRON, 3)));
+
+	CPPUNIT_ASSERT(!registry.add(DeviceID(JABLOTRON, 1)));
+	CPPUNIT_ASSERT(registry.add(DeviceID(JABLOTRON, 3)));
+}
+
+/*
+ * Devices are listed per prefix in order of their registration.
+ */
+void DeviceRegistryTest::testDevicesByPrefix()
+{
+	DeviceRegistry registry;
+
+	registry.add(DeviceID(ZWAVE, 7));
+	registry.add(DeviceID(JABLOTRON, 3));
+	registry.add(DeviceID(ZWAVE, 5));
+	registry.add(DeviceID(JABLOTRON, 1));
+
+	const vector<DeviceID> jablotron = registry.devices(JABLOTRON);
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, jablotron.size());
+	CPPUNIT_ASSERT(DeviceID(JABLOTRON, 3) == jablotron[0]);
+	CPPUNIT_ASSERT(DeviceID(JABLOTRON, 1) == jablotron[1]);
+
+	const vector<DeviceID> zwave = registry.devices(ZWAVE);
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, zwave.size());
+	CPPUNIT_ASSERT(DeviceID(ZWAVE, 7) == zwave[0]);
+	CPPUNIT_ASSERT(DeviceID(ZWAVE, 5) == zwave[1]);
+
+	CPPUNIT_ASSERT(registry.devices(
+		DevicePrefix::fromRaw(DevicePrefix::PREFIX_FITPROTOCOL)).empty());
+}
+
+/*
+ * The devices are restored from the file, a file of an unknown
+ * format is reinitialized.
+ */
+void DeviceRegistryTest::testPersistence()
+{
+	{
+		DeviceRegistry registry;
+		registry.setFile(m_file);
+
+		for (unsigned int i = 1; i <= 100; ++i)
+			registry.add(DeviceID(i % 2 ? JABLOTRON : ZWAVE, i));
+
+		registry.add(DeviceID(JABLOTRON, 1));
+	}
+
+	{
+		DeviceRegistry registry;
+		registry.setFile(m_file);
+
+		CPPUNIT_ASSERT_EQUAL((size_t) 100, registry.size());
+		CPPUNIT_ASSERT_EQUAL((size_t) 50, registry.devices(JABLOTRON).size());
+		CPPUNIT_ASSERT(DeviceID(ZWAVE, 2) == registry.devices(ZWAVE).front());
+
+		CPPUNIT_ASSERT(registry.add(DeviceID(ZWAVE, 1000)));
+	}
+
+	{
+		DeviceRegistry registry;
+		registry.setFile(m_file);
+
+		CPPUNIT_ASSERT_EQUAL((size_t) 101, registry.size());
+		CPPUNIT_ASSERT(registry.contains(DeviceID(ZWAVE, 1000)));
+	}
+
+	FILE *f = fopen(m_file.c_str(), "w");
+	CPPUNIT_ASSERT(f != NULL);
+	fputs("garbage", f);
+	fclose(f);
+
+	DeviceRegistry registry;
+	registry.setFile(m_file);
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 0, registry.size());
+}
+
+/*
+ * An incomplete record at the end of the file is dropped and
+ * the following records are appended after the last complete one.
+ */
+void DeviceRegistryTest::testTornRecord()
+{
+	{
+		DeviceRegistry registry;
+		registry.setFile(m_file);
+
+		registry.add(DeviceID(JABLOTRON, 1));
+		registry.add(DeviceID(JABLOTRON, 2));
+	}
+
+	const int fd = open(m_file.c_str(), O_WRONLY | O_APPEND);
+	CPPUNIT_ASSERT(fd >= 0);
+	CPPUNIT_ASSERT_EQUAL(3L, (long) write(fd, "\x01\x02\x03", 3));
+	close(fd);
+
+	{
+		DeviceRegistry registry;
+		registry.setFile(m_file);
+
+		CPPUNIT_ASSERT_EQUAL((size_t) 2, registry.size());
+		CPPUNIT_ASSERT(registry.add(DeviceID(JABLOTRON, 3)));
+	}
+
+	DeviceRegistry registry;
+	registry.setFile(m_file);
+
+	const vector<DeviceID> devices = registry.devices(JABLOTRON);
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, devices.size());
+	CPPUNIT_ASSERT(DeviceID(JABLOTRON, 3) == devices[2]);
+}
+
+/*
+ * A removed device is not listed anymore and it can be registered again.
+ */
+void DeviceRegistryTest::testRemove()
+{
+	DeviceRegistry registry;
+
+	registry.add(DeviceID(JABLOTRON, 1));
+	registry.add(DeviceID(JABLOTRON, 2));
+	registry.add(DeviceID(JABLOTRON, 3));
+
+	CPPUNIT_ASSERT(registry.remove(DeviceID(JABLOTRON, 2)));
+	CPPUNIT_ASSERT(!registry.remove(DeviceID(JABLOTRON, 2)));
+	CPPUNIT_ASSERT(!registry.remove(DeviceID(ZWAVE, 2)));
+
+	CPPUNIT_ASSERT(!registry.contains(DeviceID(JABLOTRON, 2)));
+
+	vector<DeviceID> devices = registry.devices(JABLOTRON);
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, devices.size());
+	CPPUNIT_ASSERT(DeviceID(JABLOTRON, 1) == devices[0]);
+	CPPUNIT_ASSERT(DeviceID(JABLOTRON, 3) == devices[1]);
+
+	CPPUNIT_ASSERT(registry.add(DeviceID(JABLOTRON, 2)));
+
+	devices = registry.devices(JABLOTRON);
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, devices.size());
+	CPPUNIT_ASSERT(DeviceID(JABLOTRON, 2) == devices[2]);
+}
+
+/*
+ * The removed devices are not restored from the file, an incomplete
+ * record of a removed device is dropped.
+ */
+void DeviceRegistryTest::testRemovePersistence()
+{
+	{
+		DeviceRegistry registry;
+		registry.setFile(m_file);
+
+		registry.add(DeviceID(JABLOTRON, 1));
+		registry.add(DeviceID(ZWAVE, 2));
+		registry.add(DeviceID(JABLOTRON, 3));
+		registry.remove(DeviceID(JABLOTRON, 1));
+		registry.remove(DeviceID(ZWAVE, 2));
+		registry.add(DeviceID(ZWAVE, 2));
+	}
+
+	const int fd = open(m_file.c_str(), O_WRONLY | O_APPEND);
+	CPPUNIT_ASSERT(fd >= 0);
+	CPPUNIT_ASSERT_EQUAL(12L, (long) write(fd,
+		"\xff\xff\xff\xff\xff\xff\xff\xff\x03\x00\x00\x00", 12));
+	close(fd);
+
+	{
+		DeviceRegistry registry;
+		registry.setFile(m_file);
+
+		CPPUNIT_ASSERT_EQUAL((size_t) 2, registry.size());
+		CPPUNIT_ASSERT(!registry.contains(DeviceID(JABLOTRON, 1)));
+		CPPUNIT_ASSERT(registry.contains(DeviceID(ZWAVE, 2)));
+		CPPUNIT_ASSERT(registry.contains(DeviceID(JABLOTRON, 3)));
+
+		CPPUNIT_ASSERT(registry.remove(DeviceID(JABLOTRON, 3)));
+	}
+
+	DeviceRegistry registry;
+	registry.setFile(m_file);
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, registry.size());
+	CPPUNIT_ASSERT(registry.contains(DeviceID(ZWAVE, 2)));
+}
+
+/*
+ * ServerDeviceListCommand is answered with the devices of the prefix.
+ */
+void DeviceRegistryTest::testHandle()
+{
+	SharedPtr<DeviceRegistry> registry(new DeviceRegistry);
+	CommandDispatcher dispatcher;
+	AnswerQueue queue;
+
+	dispatcher.registerHandler(registry);
+	registry->add(DeviceID(JABLOTRON, 1));
+	registry->add(DeviceID(ZWAVE, 2));
+
+	Answer::Ptr answer = new Answer(queue);
+	dispatcher.dispatch(new ServerDeviceListCommand(JABLOTRON), answer);
+
+	for (int i = 0; i < 100 && answer->isPending(); ++i)
+		Thread::sleep(10);
+
+	CPPUNIT_ASSERT(!answer->isPending());
+	CPPUNIT_ASSERT_EQUAL((unsigned long) 1, answer->resultsCount());
+
+	ServerDeviceListResult::Ptr result = answer->at(0).cast<ServerDeviceListResult>();
+	CPPUNIT_ASSERT_EQUAL(Result::SUCCESS, result->status());
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, result->deviceList().size());
+	CPPUNIT_ASSERT(DeviceID(JABLOTRON, 1) == result->deviceList()[0]);
+
+	queue.remove(answer);
+}
+
+/*
+ * DeviceUnpairCommand removes the device without adding any result,
+ * it is answered by the device managers.
+ */
+void DeviceRegistryTest::testObserveUnpair()
+{
+	SharedPtr<DeviceRegistry> registry(new DeviceRegistry);
+	CommandDispatcher dispatcher;
+	AnswerQueue queue;
+
+	dispatcher.registerHandler(registry);
+	registry->add(DeviceID(JABLOTRON, 1));
+	registry->add(DeviceID(JABLOTRON, 2));
+
+	Answer::Ptr answer = new Answer(queue);
+	dispatcher.dispatch(new DeviceUnpairCommand(DeviceID(JABLOTRON, 1)), answer);
+
+	CPPUNIT_ASSERT(!answer->isPending());
+	CPPUNIT_ASSERT_EQUAL((unsigned long) 0, answer->resultsCount());
+
+	CPPUNIT_ASSERT(!registry->contains(DeviceID(JABLOTRON, 1)));
+	CPPUNIT_ASSERT(registry->contains(DeviceID(JABLOTRON, 2)));
+
+	queue.remove(answer);
+}
+
+}
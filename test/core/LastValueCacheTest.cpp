@@ -0,0 +1,215 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/SharedPtr.h>
+#include <Poco/Thread.h>
+#include <Poco/Timestamp.h>
+
+#include "cppunit/BetterAssert.h"
+
+#include "commands/ServerLastValueCommand.h"
+#include "commands/ServerLastValueResult.h"
+#include "core/AnswerQueue.h"
+#include "core/CommandDispatcher.h"
+#include "core/LastValueCache.h"
+#include "model/SensorData.h"
+
+using namespace Poco;
+using namespace std;
+
+namespace BeeeOn {
+
+class LastValueCacheTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(LastValueCacheTest);
+	CPPUNIT_TEST(testUpdateLookup);
+	CPPUNIT_TEST(testOlderIgnored);
+	CPPUNIT_TEST(testShip);
+	CPPUNIT_TEST(testFull);
+	CPPUNIT_TEST(testPersistence);
+	CPPUNIT_TEST(testHandle);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp();
+	void tearDown();
+
+	void testUpdateLookup();
+	void testOlderIgnored();
+	void testShip();
+	void testFull();
+	void testPersistence();
+	void testHandle();
+
+private:
+	string m_file;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(LastValueCacheTest);
+
+static const DeviceID DEVICE(0xa300000000000001);
+
+void LastValueCacheTest::setUp()
+{
+	m_file = "/tmp/beeeon-test-last-values-" + to_string(getpid());
+	remove(m_file.c_str());
+}
+
+void LastValueCacheTest::tearDown()
+{
+	remove(m_file.c_str());
+}
+
+void LastValueCacheTest::testUpdateLookup()
+{
+	LastValueCache cache;
+	double value = 0;
+
+	CPPUNIT_ASSERT(!cache.lookup(DEVICE, ModuleID(0), value));
+
+	CPPUNIT_ASSERT(cache.update(DEVICE, ModuleID(0), 10.5, 1));
+	CPPUNIT_ASSERT(cache.update(DEVICE, ModuleID(1), -3, 1));
+	CPPUNIT_ASSERT(cache.update(DEVICE, ModuleID(0), 11.5, 2));
+
+	CPPUNIT_ASSERT(cache.lookup(DEVICE, ModuleID(0), value));
+	CPPUNIT_ASSERT_EQUAL(11.5, value);
+	CPPUNIT_ASSERT(cache.lookup(DEVICE, ModuleID(1), value));
+	CPPUNIT_ASSERT_EQUAL(-3.0, value);
+	CPPUNIT_ASSERT(!cache.lookup(DEVICE, ModuleID(2), value));
+	CPPUNIT_ASSERT(!cache.lookup(DeviceID(0xa300000000000002), ModuleID(0), value));
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, cache.size());
+}
+
+/*
+ * A value older than the cached one (e.g. replayed) is ignored.
+ */
+void LastValueCacheTest::testOlderIgnored()
+{
+	LastValueCache cache;
+	double value = 0;
+
+	cache.update(DEVICE, ModuleID(0), 2, 200);
+	cache.update(DEVICE, ModuleID(0), 1, 100);
+
+	CPPUNIT_ASSERT(cache.lookup(DEVICE, ModuleID(0), value));
+	CPPUNIT_ASSERT_EQUAL(2.0, value);
+}
+
+/*
+ * Only valid values are cached.
+ */
+void LastValueCacheTest::testShip()
+{
+	LastValueCache cache;
+	double value = 0;
+
+	SensorData data;
+	data.setDeviceID(DEVICE);
+	data.setTimestamp(Timestamp());
+	data.insertValue(SensorValue(ModuleID(0), 21.5));
+	data.insertValue(SensorValue(ModuleID(1)));
+
+	CPPUNIT_ASSERT(cache.ship(data));
+
+	CPPUNIT_ASSERT(cache.lookup(DEVICE, ModuleID(0), value));
+	CPPUNIT_ASSERT_EQUAL(21.5, value);
+	CPPUNIT_ASSERT(!cache.lookup(DEVICE, ModuleID(1), value));
+}
+
+/*
+ * Values of new modules are dropped when the cache is full,
+ * the cached ones are still updated.
+ */
+void LastValueCacheTest::testFull()
+{
+	LastValueCache cache;
+	cache.setCapacity(16);
+	double value = 0;
+
+	for (unsigned int i = 0; i < 1000; ++i)
+		cache.update(DeviceID(0xa300000000000000 | i), ModuleID(0), i, 1);
+
+	CPPUNIT_ASSERT(cache.dropped() > 0);
+	CPPUNIT_ASSERT(cache.size() >= 16);
+	CPPUNIT_ASSERT(cache.size() < 1000);
+
+	CPPUNIT_ASSERT(cache.lookup(DeviceID(0xa300000000000000), ModuleID(0), value));
+	CPPUNIT_ASSERT(cache.update(DeviceID(0xa300000000000000), ModuleID(0), 42, 2));
+	CPPUNIT_ASSERT(cache.lookup(DeviceID(0xa300000000000000), ModuleID(0), value));
+	CPPUNIT_ASSERT_EQUAL(42.0, value);
+}
+
+/*
+ * The values are restored from the file. A file of a different
+ * layout is reinitialized.
+ */
+void LastValueCacheTest::testPersistence()
+{
+	{
+		LastValueCache cache;
+		cache.setFile(m_file);
+
+		for (unsigned int i = 0; i < 100; ++i)
+			cache.update(DeviceID(0xa300000000000000 | i), ModuleID(i % 4), i, 1);
+	}
+
+	{
+		LastValueCache cache;
+		cache.setFile(m_file);
+		double value = 0;
+
+		CPPUNIT_ASSERT_EQUAL((size_t) 100, cache.size());
+
+		for (unsigned int i = 0; i < 100; ++i) {
+			CPPUNIT_ASSERT(cache.lookup(
+				DeviceID(0xa300000000000000 | i), ModuleID(i % 4), value));
+			CPPUNIT_ASSERT_EQUAL((double) i, value);
+		}
+	}
+
+	LastValueCache cache;
+	cache.setFile(m_file);
+	cache.setCapacity(100000);
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 0, cache.size());
+}
+
+/*
+ * ServerLastValueCommand is handled only when the value is cached.
+ */
+void LastValueCacheTest::testHandle()
+{
+	SharedPtr<LastValueCache> cache(new LastValueCache);
+	CommandDispatcher dispatcher;
+	AnswerQueue queue;
+
+	dispatcher.registerHandler(cache);
+	cache->update(DEVICE, ModuleID(3), 1, 1);
+
+	Answer::Ptr answer = new Answer(queue);
+	dispatcher.dispatch(new ServerLastValueCommand(DEVICE, ModuleID(3)), answer);
+
+	for (int i = 0; i < 100 && answer->isPending(); ++i)
+		Thread::sleep(10);
+
+	CPPUNIT_ASSERT(!answer->isPending());
+	CPPUNIT_ASSERT_EQUAL((unsigned long) 1, answer->resultsCount());
+
+	ServerLastValueResult::Ptr result = answer->at(0).cast<ServerLastValueResult>();
+	CPPUNIT_ASSERT_EQUAL(Result::SUCCESS, result->status());
+	CPPUNIT_ASSERT_EQUAL(1.0, result->value());
+
+	queue.remove(answer);
+
+	answer = new Answer(queue);
+	dispatcher.dispatch(new ServerLastValueCommand(DEVICE, ModuleID(4)), answer);
+
+	CPPUNIT_ASSERT(answer->isEmpty());
+	queue.remove(answer);
+}
+
+}
@@ -0,0 +1,354 @@
+#include <vector>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Event.h>
+#include <Poco/Mutex.h>
+#include <Poco/Runnable.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/Thread.h>
+
+#include "cppunit/BetterAssert.h"
+
+#include "core/Exporter.h"
+#include "core/QueuedDistributor.h"
+#include "model/SensorData.h"
+
+using namespace Poco;
+using namespace std;
+
+namespace BeeeOn {
+
+class QueuedDistributorTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(QueuedDistributorTest);
+	CPPUNIT_TEST(testSlowExporterDoesNotBlock);
+	CPPUNIT_TEST(testDropNewest);
+	CPPUNIT_TEST(testDropOldest);
+	CPPUNIT_TEST(testDropOldestKeepsOrder);
+	CPPUNIT_TEST(testBlock);
+	CPPUNIT_TEST(testBatch);
+	CPPUNIT_TEST(testRefused);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testSlowExporterDoesNotBlock();
+	void testDropNewest();
+	void testDropOldest();
+	void testDropOldestKeepsOrder();
+	void testBlock();
+	void testBatch();
+	void testRefused();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(QueuedDistributorTest);
+
+/*
+ * Exporter recording the shipped data. When blocking, every ship()
+ * waits until release() is called.
+ */
+class RecordingExporter : public Exporter {
+public:
+	RecordingExporter(bool blocking = false, bool refusing = false):
+		m_blocking(blocking),
+		m_refusing(refusing),
+		m_release(false),
+		m_batches(0)
+	{
+	}
+
+	bool ship(const SensorData &data) override
+	{
+		m_entered.set();
+
+		if (m_blocking)
+			m_release.wait();
+
+		FastMutex::ScopedLock guard(m_lock);
+		m_shipped.push_back(data.deviceID());
+		return !m_refusing;
+	}
+
+	bool shipBatch(const vector<SensorData> &batch) override
+	{
+		{
+			FastMutex::ScopedLock guard(m_lock);
+			m_batches++;
+		}
+
+		return Exporter::shipBatch(batch);
+	}
+
+	void waitEntered()
+	{
+		m_entered.wait(1000);
+	}
+
+	void release()
+	{
+		m_release.set();
+	}
+
+	vector<DeviceID> shipped()
+	{
+		FastMutex::ScopedLock guard(m_lock);
+		return m_shipped;
+	}
+
+	unsigned int batches()
+	{
+		FastMutex::ScopedLock guard(m_lock);
+		return m_batches;
+	}
+
+	bool waitShipped(size_t count)
+	{
+		for (int i = 0; i < 200; ++i) {
+			if (shipped().size() >= count)
+				return true;
+
+			Thread::sleep(10);
+		}
+
+		return false;
+	}
+
+private:
+	bool m_blocking;
+	bool m_refusing;
+	Event m_entered;
+	Event m_release;
+	FastMutex m_lock;
+	vector<DeviceID> m_shipped;
+	unsigned int m_batches;
+};
+
+static SensorData createData(uint64_t id)
+{
+	SensorData data;
+	data.setDeviceID(DeviceID(id));
+	data.insertValue(SensorValue(ModuleID(0), id));
+	return data;
+}
+
+/*
+ * A blocked exporter must not block the exporting thread nor
+ * the other exporters.
+ */
+void QueuedDistributorTest::testSlowExporterDoesNotBlock()
+{
+	QueuedDistributor distributor;
+	SharedPtr<RecordingExporter> slow(new RecordingExporter(true));
+	SharedPtr<RecordingExporter> fast(new RecordingExporter);
+
+	distributor.registerExporter(slow);
+	distributor.registerExporter(fast);
+
+	for (uint64_t i = 1; i <= 10; ++i)
+		distributor.exportData(createData(i));
+
+	CPPUNIT_ASSERT(fast->waitShipped(10));
+	CPPUNIT_ASSERT(slow->shipped().empty());
+
+	slow->release();
+	CPPUNIT_ASSERT(slow->waitShipped(10));
+
+	distributor.stop();
+
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 10, distributor.stats()[0].shipped);
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 0, distributor.stats()[0].dropped);
+	CPPUNIT_ASSERT_EQUAL((size_t) 0, distributor.stats()[0].depth);
+}
+
+void QueuedDistributorTest::testDropNewest()
+{
+	QueuedDistributor distributor;
+	distributor.setQueueSize(2);
+	distributor.setOverflowPolicy("drop-newest");
+
+	SharedPtr<RecordingExporter> exporter(new RecordingExporter(true));
+	distributor.registerExporter(exporter);
+
+	distributor.exportData(createData(1));
+	exporter->waitEntered();
+
+	for (uint64_t i = 2; i <= 5; ++i)
+		distributor.exportData(createData(i));
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, distributor.stats()[0].depth);
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 2, distributor.stats()[0].dropped);
+
+	exporter->release();
+	CPPUNIT_ASSERT(exporter->waitShipped(3));
+	distributor.stop();
+
+	const vector<DeviceID> shipped = exporter->shipped();
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, shipped.size());
+	CPPUNIT_ASSERT(shipped[0] == DeviceID(1));
+	CPPUNIT_ASSERT(shipped[1] == DeviceID(2));
+	CPPUNIT_ASSERT(shipped[2] == DeviceID(3));
+}
+
+void QueuedDistributorTest::testDropOldest()
+{
+	QueuedDistributor distributor;
+	distributor.setQueueSize(2);
+	distributor.setOverflowPolicy("drop-oldest");
+
+	SharedPtr<RecordingExporter> exporter(new RecordingExporter(true));
+	distributor.registerExporter(exporter);
+
+	distributor.exportData(createData(1));
+	exporter->waitEntered();
+
+	for (uint64_t i = 2; i <= 5; ++i)
+		distributor.exportData(createData(i));
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, distributor.stats()[0].depth);
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 2, distributor.stats()[0].dropped);
+
+	exporter->release();
+	CPPUNIT_ASSERT(exporter->waitShipped(3));
+	distributor.stop();
+
+	const vector<DeviceID> shipped = exporter->shipped();
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, shipped.size());
+	CPPUNIT_ASSERT(shipped[0] == DeviceID(1));
+	CPPUNIT_ASSERT(shipped[1] == DeviceID(4));
+	CPPUNIT_ASSERT(shipped[2] == DeviceID(5));
+}
+
+/*
+ * The dropped data are the oldest ones and the remaining data
+ * are shipped in order they were exported.
+ */
+void QueuedDistributorTest::testDropOldestKeepsOrder()
+{
+	QueuedDistributor distributor;
+	distributor.setQueueSize(3);
+	distributor.setOverflowPolicy("drop-oldest");
+
+	SharedPtr<RecordingExporter> exporter(new RecordingExporter(true));
+	distributor.registerExporter(exporter);
+
+	distributor.exportData(createData(1));
+	exporter->waitEntered();
+
+	for (uint64_t i = 2; i <= 10; ++i)
+		distributor.exportData(createData(i));
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, distributor.stats()[0].depth);
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 6, distributor.stats()[0].dropped);
+
+	exporter->release();
+	CPPUNIT_ASSERT(exporter->waitShipped(4));
+	distributor.stop();
+
+	const vector<DeviceID> shipped = exporter->shipped();
+	CPPUNIT_ASSERT_EQUAL((size_t) 4, shipped.size());
+	CPPUNIT_ASSERT(shipped[0] == DeviceID(1));
+	CPPUNIT_ASSERT(shipped[1] == DeviceID(8));
+	CPPUNIT_ASSERT(shipped[2] == DeviceID(9));
+	CPPUNIT_ASSERT(shipped[3] == DeviceID(10));
+}
+
+class ExportLater : public Runnable {
+public:
+	ExportLater(Distributor &distributor, uint64_t id):
+		m_distributor(distributor),
+		m_id(id)
+	{
+	}
+
+	void run() override
+	{
+		m_distributor.exportData(createData(m_id));
+		m_done.set();
+	}
+
+	bool waitDone(long ms)
+	{
+		return m_done.tryWait(ms);
+	}
+
+private:
+	Distributor &m_distributor;
+	uint64_t m_id;
+	Event m_done;
+};
+
+/*
+ * The exporting thread is blocked while the queue is full
+ * and nothing is lost.
+ */
+void QueuedDistributorTest::testBlock()
+{
+	QueuedDistributor distributor;
+	distributor.setQueueSize(1);
+	distributor.setOverflowPolicy("block");
+
+	SharedPtr<RecordingExporter> exporter(new RecordingExporter(true));
+	distributor.registerExporter(exporter);
+
+	distributor.exportData(createData(1));
+	exporter->waitEntered();
+	distributor.exportData(createData(2));
+
+	ExportLater later(distributor, 3);
+	Thread thread;
+	thread.start(later);
+
+	CPPUNIT_ASSERT(!later.waitDone(200));
+
+	exporter->release();
+	CPPUNIT_ASSERT(later.waitDone(1000));
+	thread.join();
+
+	CPPUNIT_ASSERT(exporter->waitShipped(3));
+	distributor.stop();
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, exporter->shipped().size());
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 0, distributor.stats()[0].dropped);
+}
+
+/*
+ * The whole batch is passed to the exporter at once.
+ */
+void QueuedDistributorTest::testBatch()
+{
+	QueuedDistributor distributor;
+	SharedPtr<RecordingExporter> exporter(new RecordingExporter);
+	distributor.registerExporter(exporter);
+
+	vector<SensorData> batch;
+	for (uint64_t i = 1; i <= 5; ++i)
+		batch.push_back(createData(i));
+
+	distributor.exportBatch(batch);
+
+	CPPUNIT_ASSERT(exporter->waitShipped(5));
+	distributor.stop();
+
+	CPPUNIT_ASSERT_EQUAL(1U, exporter->batches());
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 5, distributor.stats()[0].shipped);
+}
+
+/*
+ * Data refused by the exporter are counted as failed.
+ */
+void QueuedDistributorTest::testRefused()
+{
+	QueuedDistributor distributor;
+	SharedPtr<RecordingExporter> exporter(new RecordingExporter(false, true));
+	distributor.registerExporter(exporter);
+
+	distributor.exportData(createData(1));
+	distributor.exportData(createData(2));
+
+	CPPUNIT_ASSERT(exporter->waitShipped(2));
+	distributor.stop();
+
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 0, distributor.stats()[0].shipped);
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 2, distributor.stats()[0].failed);
+}
+
+}
@@ -0,0 +1,429 @@
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Exception.h>
+#include <Poco/Mutex.h>
+#include <Poco/Runnable.h>
+#include <Poco/Thread.h>
+
+#include "cppunit/BetterAssert.h"
+
+#include "exporters/NamedPipeExporter.h"
+#include "model/SensorData.h"
+#include "util/CSVSensorDataFormatter.h"
+#include "util/ColumnarSensorDataFormatter.h"
+
+using namespace Poco;
+using namespace std;
+
+namespace BeeeOn {
+
+class NamedPipeExporterTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(NamedPipeExporterTest);
+	CPPUNIT_TEST(testPersistentShip);
+	CPPUNIT_TEST(testNoReader);
+	CPPUNIT_TEST(testReaderGone);
+	CPPUNIT_TEST(testSlowReaderDoesNotBlock);
+	CPPUNIT_TEST(testPendingFlushedByTimer);
+	CPPUNIT_TEST(testHeldFlushedByTimer);
+	CPPUNIT_TEST(testHeldFlushedOnShutdown);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp();
+	void tearDown();
+
+	void testPersistentShip();
+	void testNoReader();
+	void testReaderGone();
+	void testSlowReaderDoesNotBlock();
+	void testPendingFlushedByTimer();
+	void testHeldFlushedByTimer();
+	void testHeldFlushedOnShutdown();
+
+private:
+	string m_path;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(NamedPipeExporterTest);
+
+/*
+ * Reader of the named pipe running in a separate thread. The pipe
+ * is opened for reading and writing, so the reader never sees EOF
+ * when the exporter closes its end.
+ */
+class PipeReader : public Runnable {
+public:
+	PipeReader(const string &path):
+		m_path(path),
+		m_fd(-1),
+		m_stop(false),
+		m_bytes(0)
+	{
+	}
+
+	~PipeReader()
+	{
+		stop();
+	}
+
+	void open()
+	{
+		m_fd = ::open(m_path.c_str(), O_RDWR | O_NONBLOCK);
+		if (m_fd < 0)
+			throw IOException("failed to open " + m_path);
+	}
+
+	void start()
+	{
+		if (m_fd < 0)
+			open();
+
+		m_thread.start(*this);
+	}
+
+	void stop()
+	{
+		m_stop = true;
+
+		if (m_thread.isRunning())
+			m_thread.join();
+
+		if (m_fd >= 0)
+			::close(m_fd);
+
+		m_fd = -1;
+	}
+
+	void run() override
+	{
+		char buffer[64 * 1024];
+		struct pollfd pfd = {m_fd, POLLIN, 0};
+
+		while (!m_stop) {
+			if (poll(&pfd, 1, 50) <= 0)
+				continue;
+
+			const ssize_t ret = ::read(m_fd, buffer, sizeof(buffer));
+			if (ret <= 0)
+				continue;
+
+			FastMutex::ScopedLock guard(m_lock);
+			m_bytes += ret;
+			m_data.append(buffer, ret);
+		}
+	}
+
+	bool waitBytes(size_t bytes)
+	{
+		for (int i = 0; i < 500; ++i) {
+			if (this->bytes() >= bytes)
+				return true;
+
+			Thread::sleep(10);
+		}
+
+		return false;
+	}
+
+	size_t bytes()
+	{
+		FastMutex::ScopedLock guard(m_lock);
+		return m_bytes;
+	}
+
+	string data()
+	{
+		FastMutex::ScopedLock guard(m_lock);
+		return m_data;
+	}
+
+private:
+	string m_path;
+	int m_fd;
+	std::atomic<bool> m_stop;
+	Thread m_thread;
+	FastMutex m_lock;
+	size_t m_bytes;
+	string m_data;
+};
+
+static SensorData createData(uint64_t id)
+{
+	SensorData data;
+	data.setDeviceID(DeviceID(id));
+	data.insertValue(SensorValue(ModuleID(0), id));
+	return data;
+}
+
+/*
+ * Count of records of a single complete block produced
+ * by ColumnarSensorDataFormatter.
+ */
+static unsigned int blockRecords(const string &data)
+{
+	const unsigned char *raw =
+		reinterpret_cast<const unsigned char *>(data.data());
+
+	CPPUNIT_ASSERT(data.size() >= 6);
+	CPPUNIT_ASSERT_EQUAL(data.size() - 4,
+		(size_t) (raw[0] | raw[1] << 8 | raw[2] << 16 | raw[3] << 24));
+
+	return raw[4] | raw[5] << 8;
+}
+
+void NamedPipeExporterTest::setUp()
+{
+	m_path = "/tmp/beeeon-test-pipe-" + to_string(getpid());
+	remove(m_path.c_str());
+
+	if (mkfifo(m_path.c_str(), S_IRUSR | S_IWUSR) < 0)
+		throw IOException("failed to create fifo " + m_path);
+}
+
+void NamedPipeExporterTest::tearDown()
+{
+	remove(m_path.c_str());
+}
+
+/*
+ * All records shipped via ship() and shipBatch() are delivered
+ * in the original order.
+ */
+void NamedPipeExporterTest::testPersistentShip()
+{
+	CSVSensorDataFormatter formatter;
+	PipeReader reader(m_path);
+	reader.start();
+
+	NamedPipeExporter exporter;
+	exporter.setFilePath(m_path);
+	exporter.setFormatter(&formatter);
+	exporter.setPersistent(1);
+
+	string expected;
+	vector<SensorData> batch;
+
+	for (uint64_t i = 1; i <= 100; ++i) {
+		const SensorData data = createData(i);
+		expected += formatter.format(data);
+		CPPUNIT_ASSERT(exporter.ship(data));
+	}
+
+	for (uint64_t i = 101; i <= 200; ++i) {
+		batch.push_back(createData(i));
+		expected += formatter.format(batch.back());
+	}
+
+	CPPUNIT_ASSERT(exporter.shipBatch(batch));
+
+	CPPUNIT_ASSERT(reader.waitBytes(expected.size()));
+	CPPUNIT_ASSERT_EQUAL(expected, reader.data());
+}
+
+/*
+ * Without a reader, the data are dropped. When a reader appears,
+ * the pipe is opened and the data are delivered.
+ */
+void NamedPipeExporterTest::testNoReader()
+{
+	CSVSensorDataFormatter formatter;
+
+	NamedPipeExporter exporter;
+	exporter.setFilePath(m_path);
+	exporter.setFormatter(&formatter);
+	exporter.setPersistent(1);
+
+	CPPUNIT_ASSERT(exporter.ship(createData(1)));
+
+	PipeReader reader(m_path);
+	reader.start();
+
+	const SensorData data = createData(2);
+	CPPUNIT_ASSERT(exporter.ship(data));
+
+	CPPUNIT_ASSERT(reader.waitBytes(formatter.format(data).size()));
+	CPPUNIT_ASSERT_EQUAL(formatter.format(data), reader.data());
+}
+
+/*
+ * When the reader disappears, the exporter reopens the pipe
+ * on the next ship() and continues with the new reader.
+ */
+void NamedPipeExporterTest::testReaderGone()
+{
+	CSVSensorDataFormatter formatter;
+
+	NamedPipeExporter exporter;
+	exporter.setFilePath(m_path);
+	exporter.setFormatter(&formatter);
+	exporter.setPersistent(1);
+
+	const SensorData first = createData(1);
+	PipeReader firstReader(m_path);
+	firstReader.start();
+
+	CPPUNIT_ASSERT(exporter.ship(first));
+	CPPUNIT_ASSERT(firstReader.waitBytes(formatter.format(first).size()));
+	firstReader.stop();
+
+	// EPIPE, data are dropped
+	CPPUNIT_ASSERT(exporter.ship(createData(2)));
+
+	const SensorData third = createData(3);
+	PipeReader secondReader(m_path);
+	secondReader.start();
+
+	CPPUNIT_ASSERT(exporter.ship(third));
+	CPPUNIT_ASSERT(secondReader.waitBytes(formatter.format(third).size()));
+	CPPUNIT_ASSERT_EQUAL(formatter.format(third), secondReader.data());
+}
+
+/*
+ * A reader that does not read makes the exporter to buffer the data
+ * until the buffer is full. Then, ship() reports failure immediately
+ * instead of blocking. After the reader continues, everything buffered
+ * is delivered.
+ */
+void NamedPipeExporterTest::testSlowReaderDoesNotBlock()
+{
+	CSVSensorDataFormatter formatter;
+	PipeReader reader(m_path);
+	reader.open();
+
+	NamedPipeExporter exporter;
+	exporter.setFilePath(m_path);
+	exporter.setFormatter(&formatter);
+	exporter.setPersistent(1);
+	exporter.setBufferSize(4096);
+
+	size_t accepted = 0;
+	bool full = false;
+
+	for (uint64_t i = 1; i <= 100000; ++i) {
+		const SensorData data = createData(i);
+
+		if (!exporter.ship(data)) {
+			full = true;
+			break;
+		}
+
+		accepted += formatter.format(data).size();
+	}
+
+	CPPUNIT_ASSERT(full);
+
+	reader.start();
+
+	const SensorData last = createData(0);
+	while (!exporter.ship(last))
+		Thread::sleep(1);
+
+	accepted += formatter.format(last).size();
+
+	// empty batch only flushes the pending data
+	for (int i = 0; i < 500 && reader.bytes() < accepted; ++i) {
+		CPPUNIT_ASSERT(exporter.shipBatch({}));
+		Thread::sleep(10);
+	}
+
+	CPPUNIT_ASSERT_EQUAL(accepted, reader.bytes());
+}
+
+/*
+ * The data pending because of a slow reader are delivered
+ * without any further ship() call.
+ */
+void NamedPipeExporterTest::testPendingFlushedByTimer()
+{
+	CSVSensorDataFormatter formatter;
+	PipeReader reader(m_path);
+	reader.open();
+
+	NamedPipeExporter exporter;
+	exporter.setFilePath(m_path);
+	exporter.setFormatter(&formatter);
+	exporter.setPersistent(1);
+	exporter.setBufferSize(4096);
+	exporter.setFlushInterval(10);
+
+	size_t accepted = 0;
+
+	for (uint64_t i = 1; i <= 100000; ++i) {
+		const SensorData data = createData(i);
+
+		if (!exporter.ship(data))
+			break;
+
+		accepted += formatter.format(data).size();
+	}
+
+	reader.start();
+
+	CPPUNIT_ASSERT(reader.waitBytes(accepted));
+	CPPUNIT_ASSERT_EQUAL(accepted, reader.bytes());
+}
+
+/*
+ * A block held by the formatter is written after its delay
+ * without any further ship() call in both modes.
+ */
+void NamedPipeExporterTest::testHeldFlushedByTimer()
+{
+	for (int persistent = 0; persistent <= 1; ++persistent) {
+		// the previous exporter has removed the pipe
+		if (persistent)
+			setUp();
+
+		ColumnarSensorDataFormatter formatter;
+		formatter.setBlockDelay(20);
+
+		PipeReader reader(m_path);
+		reader.start();
+
+		NamedPipeExporter exporter;
+		exporter.setFilePath(m_path);
+		exporter.setFormatter(&formatter);
+		exporter.setPersistent(persistent);
+		exporter.setFlushInterval(10);
+
+		CPPUNIT_ASSERT(exporter.ship(createData(1)));
+		CPPUNIT_ASSERT(reader.waitBytes(1));
+		CPPUNIT_ASSERT_EQUAL(1U, blockRecords(reader.data()));
+	}
+}
+
+/*
+ * The records held by the formatter are written when the exporter
+ * is destroyed.
+ */
+void NamedPipeExporterTest::testHeldFlushedOnShutdown()
+{
+	ColumnarSensorDataFormatter formatter;
+	formatter.setBlockDelay(60000);
+
+	PipeReader reader(m_path);
+	reader.start();
+
+	{
+		NamedPipeExporter exporter;
+		exporter.setFilePath(m_path);
+		exporter.setFormatter(&formatter);
+
+		CPPUNIT_ASSERT(exporter.ship(createData(1)));
+		CPPUNIT_ASSERT(exporter.ship(createData(2)));
+	}
+
+	CPPUNIT_ASSERT(reader.waitBytes(1));
+	CPPUNIT_ASSERT_EQUAL(2U, blockRecords(reader.data()));
+}
+
+}
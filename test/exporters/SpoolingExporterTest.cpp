@@ -0,0 +1,286 @@
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Exception.h>
+#include <Poco/File.h>
+#include <Poco/Mutex.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/Thread.h>
+#include <Poco/Timestamp.h>
+
+#include "cppunit/BetterAssert.h"
+
+#include "exporters/SpoolingExporter.h"
+#include "model/SensorData.h"
+
+using namespace Poco;
+using namespace std;
+
+namespace BeeeOn {
+
+class SpoolingExporterTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SpoolingExporterTest);
+	CPPUNIT_TEST(testEncodeDecode);
+	CPPUNIT_TEST(testPassThrough);
+	CPPUNIT_TEST(testSpoolAndReplay);
+	CPPUNIT_TEST(testReplayAfterRestart);
+	CPPUNIT_TEST(testExporterThrows);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp();
+	void tearDown();
+
+	void testEncodeDecode();
+	void testPassThrough();
+	void testSpoolAndReplay();
+	void testReplayAfterRestart();
+	void testExporterThrows();
+
+private:
+	SharedPtr<SpoolingExporter> createExporter(SharedPtr<Exporter> exporter);
+
+	string m_directory;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SpoolingExporterTest);
+
+/*
+ * Exporter that can be switched to fail or throw. It records
+ * the data shipped successfully.
+ */
+class FlakyExporter : public Exporter {
+public:
+	FlakyExporter():
+		m_available(true),
+		m_throw(false)
+	{
+	}
+
+	bool ship(const SensorData &data) override
+	{
+		FastMutex::ScopedLock guard(m_lock);
+
+		if (m_throw)
+			throw IOException("exporter is broken");
+		if (!m_available)
+			return false;
+
+		m_shipped.push_back(data);
+		return true;
+	}
+
+	void setAvailable(bool available)
+	{
+		FastMutex::ScopedLock guard(m_lock);
+		m_available = available;
+	}
+
+	void setThrow(bool fail)
+	{
+		FastMutex::ScopedLock guard(m_lock);
+		m_throw = fail;
+	}
+
+	bool waitShipped(size_t count)
+	{
+		for (int i = 0; i < 500; ++i) {
+			if (shipped().size() >= count)
+				return true;
+
+			Thread::sleep(10);
+		}
+
+		return false;
+	}
+
+	vector<SensorData> shipped()
+	{
+		FastMutex::ScopedLock guard(m_lock);
+		return m_shipped;
+	}
+
+private:
+	FastMutex m_lock;
+	bool m_available;
+	bool m_throw;
+	vector<SensorData> m_shipped;
+};
+
+static SensorData createData(uint64_t id)
+{
+	SensorData data;
+	data.setDeviceID(DeviceID(0xa300000000000000 | id));
+	data.setTimestamp(Timestamp(1488879656000000 + id));
+	data.insertValue(SensorValue(ModuleID(0), id));
+	data.insertValue(SensorValue(ModuleID(1), -0.5 * id));
+	return data;
+}
+
+static void assertOrdered(const vector<SensorData> &shipped, size_t count)
+{
+	CPPUNIT_ASSERT_EQUAL(count, shipped.size());
+
+	for (size_t i = 0; i < count; ++i)
+		CPPUNIT_ASSERT(createData(i) == shipped[i]);
+}
+
+void SpoolingExporterTest::setUp()
+{
+	m_directory = "/tmp/beeeon-test-spooling-" + to_string(getpid());
+
+	File directory(m_directory);
+	if (directory.exists())
+		directory.remove(true);
+}
+
+void SpoolingExporterTest::tearDown()
+{
+	File directory(m_directory);
+	if (directory.exists())
+		directory.remove(true);
+}
+
+SharedPtr<SpoolingExporter> SpoolingExporterTest::createExporter(
+		SharedPtr<Exporter> exporter)
+{
+	SharedPtr<SpoolingExporter> spooling(new SpoolingExporter);
+	spooling->setExporter(exporter);
+	spooling->setDirectory(m_directory);
+	spooling->setSegmentSize(4096);
+	spooling->setRetryInterval(10);
+	spooling->setSyncInterval(10);
+	spooling->setReplayBatch(8);
+
+	return spooling;
+}
+
+/*
+ * All parts of SensorData including invalid values survive
+ * the spool encoding.
+ */
+void SpoolingExporterTest::testEncodeDecode()
+{
+	SensorData data = createData(42);
+
+	SensorValue invalid(ModuleID(7));
+	data.insertValue(invalid);
+
+	string buffer;
+	SpoolingExporter::encode(data, buffer);
+
+	const SensorData result = SpoolingExporter::decode(
+		buffer.data(), buffer.size());
+
+	CPPUNIT_ASSERT(data == result);
+	CPPUNIT_ASSERT_EQUAL(
+		data.timestamp().value().epochMicroseconds(),
+		result.timestamp().value().epochMicroseconds());
+
+	CPPUNIT_ASSERT_THROW(
+		SpoolingExporter::decode(buffer.data(), buffer.size() - 1),
+		DataFormatException);
+}
+
+/*
+ * When the downstream exporter works, nothing is spooled.
+ */
+void SpoolingExporterTest::testPassThrough()
+{
+	SharedPtr<FlakyExporter> flaky(new FlakyExporter);
+	SharedPtr<SpoolingExporter> spooling = createExporter(flaky);
+
+	for (uint64_t i = 0; i < 10; ++i)
+		CPPUNIT_ASSERT(spooling->ship(createData(i)));
+
+	assertOrdered(flaky->shipped(), 10);
+	CPPUNIT_ASSERT_EQUAL(0UL, spooling->spooled());
+	CPPUNIT_ASSERT(spooling->empty());
+}
+
+/*
+ * Data are spooled while the downstream exporter fails. When it
+ * recovers, all data are delivered in the original order including
+ * the data shipped while replaying.
+ */
+void SpoolingExporterTest::testSpoolAndReplay()
+{
+	SharedPtr<FlakyExporter> flaky(new FlakyExporter);
+	SharedPtr<SpoolingExporter> spooling = createExporter(flaky);
+
+	flaky->setAvailable(false);
+
+	for (uint64_t i = 0; i < 200; ++i)
+		CPPUNIT_ASSERT(spooling->ship(createData(i)));
+
+	CPPUNIT_ASSERT_EQUAL(200UL, spooling->spooled());
+	CPPUNIT_ASSERT(flaky->shipped().empty());
+
+	flaky->setAvailable(true);
+
+	vector<SensorData> batch;
+	for (uint64_t i = 200; i < 300; ++i)
+		batch.push_back(createData(i));
+
+	CPPUNIT_ASSERT(spooling->shipBatch(batch));
+
+	CPPUNIT_ASSERT(flaky->waitShipped(300));
+	assertOrdered(flaky->shipped(), 300);
+	CPPUNIT_ASSERT(spooling->empty());
+}
+
+/*
+ * Data spooled but not replayed are replayed by a new instance
+ * using the same directory.
+ */
+void SpoolingExporterTest::testReplayAfterRestart()
+{
+	SharedPtr<FlakyExporter> flaky(new FlakyExporter);
+	flaky->setAvailable(false);
+
+	{
+		SharedPtr<SpoolingExporter> spooling = createExporter(flaky);
+
+		for (uint64_t i = 0; i < 100; ++i)
+			CPPUNIT_ASSERT(spooling->ship(createData(i)));
+
+		spooling->stop();
+	}
+
+	flaky->setAvailable(true);
+
+	SharedPtr<SpoolingExporter> spooling = createExporter(flaky);
+	CPPUNIT_ASSERT(spooling->ship(createData(100)));
+
+	CPPUNIT_ASSERT(flaky->waitShipped(101));
+	assertOrdered(flaky->shipped(), 101);
+	CPPUNIT_ASSERT_EQUAL(101UL, spooling->replayed());
+}
+
+/*
+ * An exception thrown by the downstream exporter is treated
+ * as a failure to ship.
+ */
+void SpoolingExporterTest::testExporterThrows()
+{
+	SharedPtr<FlakyExporter> flaky(new FlakyExporter);
+	SharedPtr<SpoolingExporter> spooling = createExporter(flaky);
+
+	flaky->setThrow(true);
+
+	for (uint64_t i = 0; i < 5; ++i)
+		CPPUNIT_ASSERT(spooling->ship(createData(i)));
+
+	CPPUNIT_ASSERT_EQUAL(5UL, spooling->spooled());
+
+	flaky->setThrow(false);
+
+	CPPUNIT_ASSERT(flaky->waitShipped(5));
+	assertOrdered(flaky->shipped(), 5);
+}
+
+}
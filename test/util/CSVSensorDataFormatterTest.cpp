@@ -0,0 +1,186 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Logger.h>
+#include <Poco/NumberFormatter.h>
+#include <Poco/Timestamp.h>
+
+#include "model/SensorData.h"
+#include "util/CSVSensorDataFormatter.h"
+
+using namespace std;
+using namespace Poco;
+
+namespace BeeeOn {
+
+class CSVSensorDataFormatterTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(CSVSensorDataFormatterTest);
+	CPPUNIT_TEST(testFormat);
+	CPPUNIT_TEST(testAppend);
+	CPPUNIT_TEST(testValues);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void testFormat();
+	void testAppend();
+	void testValues();
+
+protected:
+	SensorData createSensorData(uint64_t id, size_t count) const;
+	string expected(const SensorData &data, const string &separator) const;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CSVSensorDataFormatterTest);
+
+class CSVSensorDataFormatterBenchmark : public CSVSensorDataFormatterTest {
+	CPPUNIT_TEST_SUITE(CSVSensorDataFormatterBenchmark);
+	CPPUNIT_TEST(benchmarkFormat);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void benchmarkFormat();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(CSVSensorDataFormatterBenchmark, "benchmark");
+
+SensorData CSVSensorDataFormatterTest::createSensorData(
+		uint64_t id, size_t count) const
+{
+	SensorData data;
+	data.setDeviceID(DeviceID(id));
+	data.setTimestamp(Timestamp::fromEpochTime(1488879656));
+
+	for (size_t i = 0; i < count; ++i)
+		data.insertValue(SensorValue(ModuleID(i * 7), -59.4 + i * 1.37));
+
+	return data;
+}
+
+/*
+ * Output as originally produced by the formatter.
+ */
+string CSVSensorDataFormatterTest::expected(
+		const SensorData &data, const string &separator) const
+{
+	string output = "";
+	string device = data.deviceID().toString();
+	string timestamp = to_string(data.timestamp().value().epochTime());
+
+	for (auto item : data) {
+		output += "sensor" + separator + timestamp + separator + device + separator;
+		output += item.moduleID().toString() + separator;
+		output += NumberFormatter::format(item.value(), 2) + separator;
+		output += "\n";
+	}
+
+	return output;
+}
+
+void CSVSensorDataFormatterTest::testFormat()
+{
+	CSVSensorDataFormatter formatter;
+	SensorData data = createSensorData(0x499602d2, 0);
+
+	data.insertValue(SensorValue(ModuleID(5), 4.2));
+	data.insertValue(SensorValue(ModuleID(0x1f), -0.5));
+
+	const string device = DeviceID(0x499602d2).toString();
+
+	CPPUNIT_ASSERT_EQUAL(
+		"sensor;1488879656;" + device + ";5;4.20;\n"
+		"sensor;1488879656;" + device + ";1F;-0.50;\n",
+		formatter.format(data));
+
+	formatter.setSeparator(", ");
+	CPPUNIT_ASSERT_EQUAL(expected(data, ", "), formatter.format(data));
+}
+
+/*
+ * Appending keeps the buffer content and the cached device
+ * text is updated when the device changes.
+ */
+void CSVSensorDataFormatterTest::testAppend()
+{
+	CSVSensorDataFormatter formatter;
+	const SensorData first = createSensorData(0xa300000001020304, 3);
+	const SensorData second = createSensorData(0xa300000001020305, 2);
+
+	string buffer = "head\n";
+	formatter.format(first, buffer);
+	formatter.format(second, buffer);
+	formatter.format(first, buffer);
+
+	CPPUNIT_ASSERT_EQUAL(
+		"head\n" + expected(first, ";")
+			+ expected(second, ";") + expected(first, ";"),
+		buffer);
+}
+
+/*
+ * Values are formatted exactly as by Poco::NumberFormatter including
+ * rounding ties, negative zero and values out of the fast path.
+ */
+void CSVSensorDataFormatterTest::testValues()
+{
+	const double values[] = {
+		0.0, -0.0, -0.001, 0.004, 0.005, 0.015, 0.125, 1.005,
+		-59.4, 4.2, 99.995, -99.995, 1234567.891, 9999999.999,
+		1e7, -1e7, 12345678901.23, 1e20, -1e20,
+	};
+
+	CSVSensorDataFormatter formatter;
+	SensorData data = createSensorData(1, 0);
+
+	for (auto value : values)
+		data.insertValue(SensorValue(ModuleID(0xabcd), value));
+
+	for (int i = -100000; i <= 100000; i += 7)
+		data.insertValue(SensorValue(ModuleID(i & 0xffff), i / 1000.0));
+
+	CPPUNIT_ASSERT_EQUAL(expected(data, ";"), formatter.format(data));
+}
+
+/*
+ * Compare formatting into a new string per call with appending
+ * into a reused buffer.
+ */
+void CSVSensorDataFormatterBenchmark::benchmarkFormat()
+{
+	const unsigned int iterations = 200000;
+	Logger &logger = Logger::get("CSVSensorDataFormatterTest");
+	CSVSensorDataFormatter formatter;
+	const SensorData data = createSensorData(0xa300000001020304, 4);
+
+	size_t bytes = 0;
+	Timestamp start;
+
+	for (unsigned int i = 0; i < iterations; ++i)
+		bytes += expected(data, ";").size();
+
+	const Timestamp::TimeDiff original = start.elapsed();
+
+	start.update();
+
+	for (unsigned int i = 0; i < iterations; ++i)
+		bytes -= formatter.format(data).size();
+
+	const Timestamp::TimeDiff wrapper = start.elapsed();
+
+	string buffer;
+	start.update();
+
+	for (unsigned int i = 0; i < iterations; ++i) {
+		buffer.clear();
+		formatter.format(data, buffer);
+	}
+
+	const Timestamp::TimeDiff append = start.elapsed();
+
+	logger.information(
+		to_string(iterations) + " records: original "
+		+ to_string(original / 1000) + " ms, format() "
+		+ to_string(wrapper / 1000) + " ms, append "
+		+ to_string(append / 1000) + " ms");
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 0, bytes);
+	CPPUNIT_ASSERT_EQUAL(expected(data, ";"), buffer);
+}
+
+}
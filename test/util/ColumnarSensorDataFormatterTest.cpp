@@ -0,0 +1,457 @@
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/ByteOrder.h>
+#include <Poco/Exception.h>
+#include <Poco/Logger.h>
+#include <Poco/Thread.h>
+#include <Poco/Timestamp.h>
+
+#include "model/SensorData.h"
+#include "util/BinarySensorDataFormatter.h"
+#include "util/CSVSensorDataFormatter.h"
+#include "util/ColumnarSensorDataFormatter.h"
+
+using namespace std;
+using namespace Poco;
+
+namespace BeeeOn {
+
+class ColumnarSensorDataFormatterTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ColumnarSensorDataFormatterTest);
+	CPPUNIT_TEST(testBinaryRecord);
+	CPPUNIT_TEST(testBlockSize);
+	CPPUNIT_TEST(testFlush);
+	CPPUNIT_TEST(testFlushExpired);
+	CPPUNIT_TEST(testValues);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void testBinaryRecord();
+	void testBlockSize();
+	void testFlush();
+	void testFlushExpired();
+	void testValues();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ColumnarSensorDataFormatterTest);
+
+class ColumnarSensorDataFormatterBenchmark : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ColumnarSensorDataFormatterBenchmark);
+	CPPUNIT_TEST(benchmarkBandwidth);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void benchmarkBandwidth();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(ColumnarSensorDataFormatterBenchmark, "benchmark");
+
+/*
+ * Reader of the formats documented in BinarySensorDataFormatter
+ * and ColumnarSensorDataFormatter.
+ */
+class FormatReader {
+public:
+	FormatReader(const string &data):
+		m_data(data),
+		m_offset(0),
+		m_bit(0)
+	{
+	}
+
+	bool atEnd() const
+	{
+		return m_offset >= m_data.size();
+	}
+
+	size_t offset() const
+	{
+		return m_offset;
+	}
+
+	uint64_t readUInt(size_t size)
+	{
+		if (m_offset + size > m_data.size())
+			throw RangeException("read out of data");
+
+		uint64_t value = 0;
+		for (size_t i = 0; i < size; ++i) {
+			value |= static_cast<uint64_t>(
+				static_cast<uint8_t>(m_data[m_offset + i])) << (8 * i);
+		}
+
+		m_offset += size;
+		return value;
+	}
+
+	double readDouble()
+	{
+		const uint64_t raw = readUInt(8);
+		double value;
+
+		memcpy(&value, &raw, sizeof(value));
+		return value;
+	}
+
+	uint64_t readVarint()
+	{
+		uint64_t value = 0;
+		unsigned int shift = 0;
+		uint8_t byte;
+
+		do {
+			byte = readUInt(1);
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			shift += 7;
+		} while (byte & 0x80);
+
+		return value;
+	}
+
+	int64_t readSignedVarint()
+	{
+		const uint64_t value = readVarint();
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+
+	uint64_t readBits(unsigned int count)
+	{
+		uint64_t value = 0;
+
+		for (unsigned int i = 0; i < count; ++i) {
+			if (m_offset >= m_data.size())
+				throw RangeException("read out of data");
+
+			const uint8_t byte = m_data[m_offset];
+			value = (value << 1) | ((byte >> (7 - m_bit)) & 1);
+
+			if (++m_bit == 8) {
+				m_bit = 0;
+				m_offset++;
+			}
+		}
+
+		return value;
+	}
+
+	void alignBits()
+	{
+		if (m_bit > 0) {
+			m_bit = 0;
+			m_offset++;
+		}
+	}
+
+	static double toDouble(uint64_t raw)
+	{
+		double value;
+		memcpy(&value, &raw, sizeof(value));
+		return value;
+	}
+
+private:
+	const string &m_data;
+	size_t m_offset;
+	unsigned int m_bit;
+};
+
+static SensorValue decodedValue(const ModuleID &module, double value)
+{
+	if (std::isnan(value))
+		return SensorValue(module);
+
+	return SensorValue(module, value);
+}
+
+static vector<SensorData> readBlock(FormatReader &reader)
+{
+	const size_t length = reader.readUInt(4);
+	const size_t end = reader.offset() + length;
+	const size_t count = reader.readUInt(2);
+
+	vector<SensorData> result(count);
+
+	for (auto &data : result)
+		data.setDeviceID(DeviceID(reader.readUInt(8)));
+
+	int64_t timestamp = 0;
+	for (auto &data : result) {
+		timestamp += reader.readSignedVarint();
+		data.setTimestamp(Timestamp(timestamp));
+	}
+
+	vector<size_t> counts;
+	for (size_t i = 0; i < count; ++i)
+		counts.push_back(reader.readVarint());
+
+	vector<ModuleID> modules;
+	for (auto n : counts) {
+		for (size_t i = 0; i < n; ++i)
+			modules.push_back(ModuleID(reader.readVarint()));
+	}
+
+	uint64_t last = 0;
+	unsigned int leading = 0;
+	unsigned int meaningful = 0;
+	size_t module = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		for (size_t j = 0; j < counts[i]; ++j, ++module) {
+			if (module == 0) {
+				last = reader.readBits(64);
+			}
+			else if (reader.readBits(1) == 1) {
+				if (reader.readBits(1) == 1) {
+					leading = reader.readBits(6);
+					meaningful = reader.readBits(6) + 1;
+				}
+
+				const unsigned int trailing = 64 - leading - meaningful;
+				last ^= reader.readBits(meaningful) << trailing;
+			}
+
+			result[i].insertValue(decodedValue(
+				modules[module], FormatReader::toDouble(last)));
+		}
+	}
+
+	reader.alignBits();
+	CPPUNIT_ASSERT_EQUAL(end, reader.offset());
+
+	return result;
+}
+
+static SensorData createSensorData(uint64_t id, int64_t us, size_t count)
+{
+	SensorData data;
+	data.setDeviceID(DeviceID(id));
+	data.setTimestamp(Timestamp(us));
+
+	for (size_t i = 0; i < count; ++i)
+		data.insertValue(SensorValue(ModuleID(i), 20.5 + (us / 1000000 % 10) * 0.25));
+
+	return data;
+}
+
+/*
+ * The binary record matches its documented layout, invalid values
+ * are stored as NaN.
+ */
+void ColumnarSensorDataFormatterTest::testBinaryRecord()
+{
+	BinarySensorDataFormatter formatter;
+	SensorData data = createSensorData(0xa300000001020304, 1488879656000123, 2);
+	data.insertValue(SensorValue(ModuleID(7)));
+
+	string buffer = "x";
+	formatter.format(data, buffer);
+
+	CPPUNIT_ASSERT_EQUAL(
+		(size_t) 1 + BinarySensorDataFormatter::HEADER_SIZE
+			+ 3 * BinarySensorDataFormatter::VALUE_SIZE,
+		buffer.size());
+	CPPUNIT_ASSERT_EQUAL(buffer.substr(1), formatter.format(data));
+
+	FormatReader reader(buffer);
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 'x', reader.readUInt(1));
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 18 + 3 * 10, reader.readUInt(4));
+
+	SensorData decoded;
+	decoded.setDeviceID(DeviceID(reader.readUInt(8)));
+	decoded.setTimestamp(Timestamp(reader.readUInt(8)));
+
+	const size_t count = reader.readUInt(2);
+	for (size_t i = 0; i < count; ++i) {
+		const ModuleID module(reader.readUInt(2));
+		decoded.insertValue(decodedValue(module, reader.readDouble()));
+	}
+
+	CPPUNIT_ASSERT(reader.atEnd());
+	CPPUNIT_ASSERT(data == decoded);
+}
+
+/*
+ * A block is produced after blockSize records only and it
+ * contains all the records.
+ */
+void ColumnarSensorDataFormatterTest::testBlockSize()
+{
+	ColumnarSensorDataFormatter formatter;
+	formatter.setBlockSize(3);
+	formatter.setBlockDelay(60000);
+
+	vector<SensorData> input;
+	string buffer;
+
+	for (int i = 0; i < 3; ++i) {
+		input.push_back(createSensorData(0x100 + i, 1488879656000000 + i * 1000000, i + 1));
+
+		const size_t before = buffer.size();
+		formatter.format(input.back(), buffer);
+
+		if (i < 2)
+			CPPUNIT_ASSERT_EQUAL(before, buffer.size());
+	}
+
+	CPPUNIT_ASSERT(!buffer.empty());
+
+	string held;
+	formatter.flush(held);
+	CPPUNIT_ASSERT(held.empty());
+
+	FormatReader reader(buffer);
+	const vector<SensorData> output = readBlock(reader);
+
+	CPPUNIT_ASSERT(reader.atEnd());
+	CPPUNIT_ASSERT(input == output);
+}
+
+/*
+ * flush() produces a block of the held records.
+ */
+void ColumnarSensorDataFormatterTest::testFlush()
+{
+	ColumnarSensorDataFormatter formatter;
+	formatter.setBlockDelay(60000);
+
+	const SensorData data = createSensorData(0x42, 1488879656000000, 4);
+
+	CPPUNIT_ASSERT(formatter.format(data).empty());
+
+	string buffer;
+	formatter.flush(buffer);
+
+	FormatReader reader(buffer);
+	const vector<SensorData> output = readBlock(reader);
+
+	CPPUNIT_ASSERT(reader.atEnd());
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, output.size());
+	CPPUNIT_ASSERT(data == output.front());
+}
+
+/*
+ * flushExpired() produces a block only after the oldest held
+ * record has been held for blockDelay.
+ */
+void ColumnarSensorDataFormatterTest::testFlushExpired()
+{
+	ColumnarSensorDataFormatter formatter;
+	formatter.setBlockDelay(50);
+
+	const SensorData data = createSensorData(0x42, 1488879656000000, 1);
+	CPPUNIT_ASSERT(formatter.format(data).empty());
+
+	string buffer;
+	formatter.flushExpired(buffer);
+	CPPUNIT_ASSERT(buffer.empty());
+
+	Thread::sleep(60);
+	formatter.flushExpired(buffer);
+
+	FormatReader reader(buffer);
+	const vector<SensorData> output = readBlock(reader);
+
+	CPPUNIT_ASSERT(reader.atEnd());
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, output.size());
+	CPPUNIT_ASSERT(data == output.front());
+
+	buffer.clear();
+	formatter.flushExpired(buffer);
+	CPPUNIT_ASSERT(buffer.empty());
+}
+
+/*
+ * All kinds of values survive the XOR compression, including
+ * repeated values, invalid values, negative and tiny numbers
+ * and the timestamps going backwards.
+ */
+void ColumnarSensorDataFormatterTest::testValues()
+{
+	const double values[] = {
+		0.0, 0.0, -0.0, 1.0, 1.5, 1.5, -59.4, 4.2, 1e-300, -1e300,
+		21.25, 21.5, 21.25, 1024.0, 3.141592653589793, 0.1,
+	};
+
+	ColumnarSensorDataFormatter formatter;
+	vector<SensorData> input;
+
+	for (size_t i = 0; i < 20; ++i) {
+		SensorData data;
+		data.setDeviceID(DeviceID(0xa300000000000000 | i));
+		data.setTimestamp(Timestamp(1488879656000000 + (i % 3) * 1000 - i * 10));
+
+		for (size_t j = 0; j < i % 5; ++j) {
+			const double value = values[(i + j) % 16];
+
+			if ((i + j) % 7 == 0)
+				data.insertValue(SensorValue(ModuleID(j)));
+			else
+				data.insertValue(SensorValue(ModuleID(j * 300), value));
+		}
+
+		input.push_back(data);
+		formatter.format(data);
+	}
+
+	string buffer;
+	formatter.flush(buffer);
+
+	FormatReader reader(buffer);
+	const vector<SensorData> output = readBlock(reader);
+
+	CPPUNIT_ASSERT(reader.atEnd());
+	CPPUNIT_ASSERT_EQUAL(input.size(), output.size());
+
+	for (size_t i = 0; i < input.size(); ++i)
+		CPPUNIT_ASSERT(input[i] == output[i]);
+}
+
+/*
+ * Compare the bandwidth of the CSV, binary and columnar output
+ * for a typical stream of slowly changing temperatures.
+ */
+void ColumnarSensorDataFormatterBenchmark::benchmarkBandwidth()
+{
+	const unsigned int count = 100000;
+	Logger &logger = Logger::get("ColumnarSensorDataFormatterTest");
+
+	CSVSensorDataFormatter csv;
+	BinarySensorDataFormatter binary;
+	ColumnarSensorDataFormatter columnar;
+	columnar.setBlockDelay(60000);
+
+	SensorDataFormatter *formatters[] = {&csv, &binary, &columnar};
+	const char *names[] = {"csv", "binary", "columnar"};
+
+	for (int f = 0; f < 3; ++f) {
+		string buffer;
+		size_t bytes = 0;
+		Timestamp start;
+
+		for (unsigned int i = 0; i < count; ++i) {
+			SensorData data = createSensorData(
+				0xa300000001020300 + i % 4, 1488879656000000 + i * 1000000, 2);
+
+			buffer.clear();
+			formatters[f]->format(data, buffer);
+			bytes += buffer.size();
+		}
+
+		buffer.clear();
+		formatters[f]->flush(buffer);
+		bytes += buffer.size();
+
+		const Timestamp::TimeDiff elapsed = start.elapsed();
+
+		logger.information(
+			string(names[f]) + ": " + to_string(count) + " records, "
+			+ to_string(bytes) + " B, "
+			+ to_string(elapsed / 1000) + " ms");
+
+		CPPUNIT_ASSERT(bytes > 0);
+	}
+}
+
+}
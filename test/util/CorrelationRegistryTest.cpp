@@ -0,0 +1,308 @@
+#include <map>
+#include <string>
+#include <vector>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Logger.h>
+#include <Poco/Random.h>
+#include <Poco/Timespan.h>
+#include <Poco/Timestamp.h>
+
+#include "cppunit/BetterAssert.h"
+
+#include "model/GlobalID.h"
+#include "util/CorrelationRegistry.h"
+
+using namespace std;
+using namespace Poco;
+
+namespace BeeeOn {
+
+class CorrelationRegistryTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(CorrelationRegistryTest);
+	CPPUNIT_TEST(testInsertFind);
+	CPPUNIT_TEST(testTake);
+	CPPUNIT_TEST(testExpire);
+	CPPUNIT_TEST(testCapacity);
+	CPPUNIT_TEST(testCollisions);
+	CPPUNIT_TEST(testGlobalID);
+	CPPUNIT_TEST(testSoak);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void testInsertFind();
+	void testTake();
+	void testExpire();
+	void testCapacity();
+	void testCollisions();
+	void testGlobalID();
+	void testSoak();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CorrelationRegistryTest);
+
+static const Timestamp::TimeDiff START = 1488879656000000;
+
+static Timestamp at(Timestamp::TimeDiff ms)
+{
+	return Timestamp(START + ms * Timespan::MILLISECONDS);
+}
+
+/*
+ * All the keys share just a few hash values to exercise
+ * the probing and the backward shift deletion.
+ */
+struct CollidingHash {
+	size_t operator()(unsigned int key) const
+	{
+		return key % 7;
+	}
+};
+
+/*
+ * Inserted values are found, inserting of an existing key
+ * replaces its value.
+ */
+void CorrelationRegistryTest::testInsertFind()
+{
+	CorrelationRegistry<unsigned int, string> registry;
+
+	CPPUNIT_ASSERT(registry.find(1) == NULL);
+
+	for (unsigned int i = 0; i < 100; ++i)
+		CPPUNIT_ASSERT(registry.insert(i, to_string(i), at(0)));
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 100, registry.size());
+
+	for (unsigned int i = 0; i < 100; ++i) {
+		CPPUNIT_ASSERT(registry.find(i) != NULL);
+		CPPUNIT_ASSERT_EQUAL(to_string(i), *registry.find(i));
+	}
+
+	CPPUNIT_ASSERT(registry.find(100) == NULL);
+
+	registry.insert(5, "five", at(0));
+	CPPUNIT_ASSERT_EQUAL((size_t) 100, registry.size());
+	CPPUNIT_ASSERT_EQUAL(string("five"), *registry.find(5));
+}
+
+/*
+ * Taken and removed entries are not found anymore.
+ */
+void CorrelationRegistryTest::testTake()
+{
+	CorrelationRegistry<unsigned int, string> registry;
+	string value;
+
+	registry.insert(1, "one", at(0));
+	registry.insert(2, "two", at(0));
+
+	CPPUNIT_ASSERT(registry.take(1, value));
+	CPPUNIT_ASSERT_EQUAL(string("one"), value);
+	CPPUNIT_ASSERT(!registry.take(1, value));
+	CPPUNIT_ASSERT(registry.find(1) == NULL);
+
+	CPPUNIT_ASSERT(registry.remove(2));
+	CPPUNIT_ASSERT(!registry.remove(2));
+	CPPUNIT_ASSERT(registry.empty());
+}
+
+/*
+ * Entries older than TTL are evicted in order of their insertion,
+ * replacing an entry renews its age.
+ */
+void CorrelationRegistryTest::testExpire()
+{
+	CorrelationRegistry<unsigned int, unsigned int> registry(
+		100 * Timespan::MILLISECONDS);
+	vector<unsigned int> expired;
+
+	registry.insert(1, 1, at(0));
+	registry.insert(2, 2, at(10));
+	registry.insert(3, 3, at(20));
+	registry.insert(1, 4, at(30));
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 0, registry.expire(at(109), expired));
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, registry.expire(at(110), expired));
+	CPPUNIT_ASSERT_EQUAL(2u, expired[0]);
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, registry.expire(at(1000), expired));
+	CPPUNIT_ASSERT_EQUAL(3u, expired[1]);
+	CPPUNIT_ASSERT_EQUAL(4u, expired[2]);
+
+	CPPUNIT_ASSERT(registry.empty());
+}
+
+/*
+ * The full registry evicts the oldest entries.
+ */
+void CorrelationRegistryTest::testCapacity()
+{
+	CorrelationRegistry<unsigned int, unsigned int> registry(
+		60 * Timespan::SECONDS, 10);
+	vector<unsigned int> evicted;
+
+	for (unsigned int i = 0; i < 10; ++i)
+		registry.insert(i, i, evicted, at(i));
+
+	CPPUNIT_ASSERT(evicted.empty());
+
+	registry.insert(10, 10, evicted, at(10));
+	registry.insert(11, 11, evicted, at(11));
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 10, registry.size());
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, evicted.size());
+	CPPUNIT_ASSERT_EQUAL(0u, evicted[0]);
+	CPPUNIT_ASSERT_EQUAL(1u, evicted[1]);
+
+	CPPUNIT_ASSERT(registry.find(0) == NULL);
+	CPPUNIT_ASSERT(registry.find(2) != NULL);
+	CPPUNIT_ASSERT(registry.find(11) != NULL);
+
+	CPPUNIT_ASSERT(!registry.insert(12, 12, at(12)));
+}
+
+/*
+ * Random operations with colliding hashes give the same results
+ * as std::map.
+ */
+void CorrelationRegistryTest::testCollisions()
+{
+	CorrelationRegistry<unsigned int, unsigned int, CollidingHash> registry;
+	map<unsigned int, unsigned int> model;
+	Random random;
+	random.seed(42);
+
+	for (unsigned int i = 0; i < 20000; ++i) {
+		const unsigned int key = random.next(300);
+		unsigned int value;
+
+		switch (random.next(3)) {
+		case 0:
+			registry.insert(key, i, at(0));
+			model[key] = i;
+			break;
+
+		case 1:
+			CPPUNIT_ASSERT_EQUAL(model.erase(key) > 0,
+				registry.take(key, value));
+			break;
+
+		default:
+			if (model.find(key) == model.end()) {
+				CPPUNIT_ASSERT(registry.find(key) == NULL);
+			}
+			else {
+				CPPUNIT_ASSERT(registry.find(key) != NULL);
+				CPPUNIT_ASSERT_EQUAL(model[key], *registry.find(key));
+			}
+		}
+
+		CPPUNIT_ASSERT_EQUAL(model.size(), registry.size());
+	}
+
+	for (auto &item : model) {
+		CPPUNIT_ASSERT(registry.find(item.first) != NULL);
+		CPPUNIT_ASSERT_EQUAL(item.second, *registry.find(item.first));
+	}
+}
+
+/*
+ * GlobalIDs are matched by their value.
+ */
+void CorrelationRegistryTest::testGlobalID()
+{
+	CorrelationRegistry<GlobalID, unsigned int, GlobalIDHash> registry;
+	vector<GlobalID> ids;
+
+	for (unsigned int i = 0; i < 1000; ++i) {
+		ids.push_back(GlobalID::random());
+		registry.insert(ids.back(), i, at(0));
+	}
+
+	for (unsigned int i = 0; i < ids.size(); ++i) {
+		const GlobalID copy = GlobalID::parse(ids[i].toString());
+
+		CPPUNIT_ASSERT(registry.find(copy) != NULL);
+		CPPUNIT_ASSERT_EQUAL(i, *registry.find(copy));
+	}
+
+	CPPUNIT_ASSERT(registry.find(GlobalID::random()) == NULL);
+}
+
+/*
+ * Simulate one hour of a broker processing 100 requests per second
+ * where 5 % of responses never come and 1 % come too late. Memory
+ * of the registry is logged every 5 minutes. The allocated blocks
+ * are reused, so the memory must stay bounded after the first
+ * period (it may grow only slightly due to random peaks).
+ */
+void CorrelationRegistryTest::testSoak()
+{
+	const Timestamp::TimeDiff duration = 3600 * 1000;
+	const Timestamp::TimeDiff period = 300 * 1000;
+	const Timespan ttl = 30 * Timespan::SECONDS;
+
+	Logger &logger = Logger::get("CorrelationRegistryTest");
+	CorrelationRegistry<GlobalID, unsigned int, GlobalIDHash> registry(ttl);
+	multimap<Timestamp::TimeDiff, GlobalID> responses;
+	vector<unsigned int> expired;
+	Random random;
+	random.seed(42);
+
+	size_t baseline = 0;
+	unsigned int lost = 0;
+	unsigned int late = 0;
+	unsigned int matched = 0;
+	Timestamp start;
+
+	for (Timestamp::TimeDiff now = 0; now <= duration; now += 10) {
+		const GlobalID id = GlobalID::random();
+		const unsigned int chance = random.next(100);
+
+		registry.insert(id, now, at(now));
+
+		if (chance == 0)
+			responses.emplace(now + 40000, id);
+		else if (chance > 5)
+			responses.emplace(now + 1 + random.next(2000), id);
+
+		while (!responses.empty() && responses.begin()->first <= now) {
+			unsigned int value;
+
+			if (registry.take(responses.begin()->second, value))
+				matched++;
+			else
+				late++;
+
+			responses.erase(responses.begin());
+		}
+
+		lost += registry.expire(at(now), expired);
+		expired.clear();
+
+		if (now % period == 0 && now > 0) {
+			logger.information(
+				to_string(now / 60000) + " min: "
+				+ to_string(registry.size()) + " entries, "
+				+ to_string(registry.memoryUsage()) + " B");
+
+			if (now == period)
+				baseline = registry.memoryUsage();
+
+			CPPUNIT_ASSERT(registry.memoryUsage() <= 2 * baseline);
+		}
+	}
+
+	logger.information(
+		to_string(matched) + " matched, "
+		+ to_string(late) + " late, "
+		+ to_string(lost) + " expired in "
+		+ to_string(start.elapsed() / 1000) + " ms");
+
+	CPPUNIT_ASSERT(late > 0);
+	CPPUNIT_ASSERT(registry.size() < 2 * 100 * 30);
+}
+
+}
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Random.h>
+
+#include "cppunit/BetterAssert.h"
+
+#include "util/LatencyHistogram.h"
+
+using namespace std;
+using namespace Poco;
+
+namespace BeeeOn {
+
+class LatencyHistogramTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(LatencyHistogramTest);
+	CPPUNIT_TEST(testEmpty);
+	CPPUNIT_TEST(testSmallValues);
+	CPPUNIT_TEST(testRelativeError);
+	CPPUNIT_TEST(testHugeValues);
+	CPPUNIT_TEST(testMerge);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void testEmpty();
+	void testSmallValues();
+	void testRelativeError();
+	void testHugeValues();
+	void testMerge();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(LatencyHistogramTest);
+
+void LatencyHistogramTest::testEmpty()
+{
+	LatencyHistogram histogram;
+
+	CPPUNIT_ASSERT_EQUAL(0UL, (unsigned long) histogram.count());
+	CPPUNIT_ASSERT_EQUAL(0UL, (unsigned long) histogram.min());
+	CPPUNIT_ASSERT_EQUAL(0UL, (unsigned long) histogram.max());
+	CPPUNIT_ASSERT_EQUAL(0UL, (unsigned long) histogram.percentile(50));
+}
+
+/*
+ * Values less than 128 are recorded exactly.
+ */
+void LatencyHistogramTest::testSmallValues()
+{
+	LatencyHistogram histogram;
+
+	for (unsigned int i = 1; i <= 100; ++i)
+		histogram.record(i);
+
+	CPPUNIT_ASSERT_EQUAL(100UL, (unsigned long) histogram.count());
+	CPPUNIT_ASSERT_EQUAL(1UL, (unsigned long) histogram.min());
+	CPPUNIT_ASSERT_EQUAL(100UL, (unsigned long) histogram.max());
+	CPPUNIT_ASSERT_EQUAL(50.5, histogram.mean());
+
+	CPPUNIT_ASSERT_EQUAL(1UL, (unsigned long) histogram.percentile(0));
+	CPPUNIT_ASSERT_EQUAL(50UL, (unsigned long) histogram.percentile(50));
+	CPPUNIT_ASSERT_EQUAL(90UL, (unsigned long) histogram.percentile(90));
+	CPPUNIT_ASSERT_EQUAL(99UL, (unsigned long) histogram.percentile(99));
+	CPPUNIT_ASSERT_EQUAL(100UL, (unsigned long) histogram.percentile(100));
+}
+
+/*
+ * Percentiles of random values differ from the exact ones
+ * by less than 1/64 and they are never less than the exact ones.
+ */
+void LatencyHistogramTest::testRelativeError()
+{
+	const double percents[] = {1, 10, 50, 90, 99, 99.9, 100};
+
+	LatencyHistogram histogram;
+	vector<uint64_t> values;
+	Random random;
+	random.seed(42);
+
+	for (unsigned int i = 0; i < 100000; ++i) {
+		// spread the values over several orders of magnitude
+		const uint64_t value = random.next(1000) << random.next(20);
+
+		values.push_back(value);
+		histogram.record(value);
+	}
+
+	sort(values.begin(), values.end());
+
+	for (auto percent : percents) {
+		size_t rank = ceil(percent / 100 * values.size());
+		const uint64_t exact = values[rank < 1 ? 0 : rank - 1];
+		const uint64_t estimate = histogram.percentile(percent);
+
+		CPPUNIT_ASSERT(estimate >= exact);
+		CPPUNIT_ASSERT(estimate - exact <= exact / 64);
+	}
+
+	CPPUNIT_ASSERT_EQUAL(values.back(), histogram.max());
+	CPPUNIT_ASSERT_EQUAL(values.front(), histogram.min());
+}
+
+void LatencyHistogramTest::testHugeValues()
+{
+	LatencyHistogram histogram;
+
+	histogram.record(UINT64_MAX);
+	histogram.record(1ULL << 63);
+
+	CPPUNIT_ASSERT_EQUAL(2UL, (unsigned long) histogram.count());
+	CPPUNIT_ASSERT(histogram.percentile(50) >= 1ULL << 63);
+	CPPUNIT_ASSERT(histogram.percentile(100) == UINT64_MAX);
+}
+
+void LatencyHistogramTest::testMerge()
+{
+	LatencyHistogram first;
+	LatencyHistogram second;
+
+	for (unsigned int i = 1; i <= 50; ++i) {
+		first.record(i);
+		second.record(i + 50);
+	}
+
+	first.merge(second);
+
+	CPPUNIT_ASSERT_EQUAL(100UL, (unsigned long) first.count());
+	CPPUNIT_ASSERT_EQUAL(1UL, (unsigned long) first.min());
+	CPPUNIT_ASSERT_EQUAL(100UL, (unsigned long) first.max());
+	CPPUNIT_ASSERT_EQUAL(50UL, (unsigned long) first.percentile(50));
+
+	first.reset();
+	CPPUNIT_ASSERT_EQUAL(0UL, (unsigned long) first.count());
+	CPPUNIT_ASSERT_EQUAL(0UL, (unsigned long) first.percentile(50));
+}
+
+}
@@ -0,0 +1,195 @@
+#include <vector>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Exception.h>
+#include <Poco/Runnable.h>
+#include <Poco/Thread.h>
+
+#include "cppunit/BetterAssert.h"
+
+#include "util/MPSCRing.h"
+
+using namespace std;
+using namespace Poco;
+
+namespace BeeeOn {
+
+class MPSCRingTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(MPSCRingTest);
+	CPPUNIT_TEST(testPushPop);
+	CPPUNIT_TEST(testFull);
+	CPPUNIT_TEST(testFullMinimal);
+	CPPUNIT_TEST(testCapacity);
+	CPPUNIT_TEST(testProducers);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void testPushPop();
+	void testFull();
+	void testFullMinimal();
+	void testCapacity();
+	void testProducers();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MPSCRingTest);
+
+struct Item {
+	unsigned int producer;
+	unsigned int sequence;
+};
+
+/*
+ * Items are popped in order they were pushed.
+ */
+void MPSCRingTest::testPushPop()
+{
+	MPSCRing<int> ring(4);
+	int item = 0;
+
+	CPPUNIT_ASSERT(!ring.pop(item));
+
+	CPPUNIT_ASSERT(ring.push(1));
+	CPPUNIT_ASSERT(ring.push(2));
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, ring.size());
+
+	CPPUNIT_ASSERT(ring.pop(item));
+	CPPUNIT_ASSERT_EQUAL(1, item);
+
+	CPPUNIT_ASSERT(ring.push(3));
+
+	CPPUNIT_ASSERT(ring.pop(item));
+	CPPUNIT_ASSERT_EQUAL(2, item);
+	CPPUNIT_ASSERT(ring.pop(item));
+	CPPUNIT_ASSERT_EQUAL(3, item);
+
+	CPPUNIT_ASSERT(!ring.pop(item));
+	CPPUNIT_ASSERT_EQUAL((size_t) 0, ring.size());
+}
+
+/*
+ * Nothing is pushed into a full ring, the slots are reused
+ * after popping.
+ */
+void MPSCRingTest::testFull()
+{
+	MPSCRing<int> ring(4);
+	int item = 0;
+
+	for (int round = 0; round < 3; ++round) {
+		for (int i = 0; i < 4; ++i)
+			CPPUNIT_ASSERT(ring.push(round * 4 + i));
+
+		CPPUNIT_ASSERT(!ring.push(100));
+		CPPUNIT_ASSERT_EQUAL((size_t) 4, ring.size());
+
+		for (int i = 0; i < 4; ++i) {
+			CPPUNIT_ASSERT(ring.pop(item));
+			CPPUNIT_ASSERT_EQUAL(round * 4 + i, item);
+		}
+	}
+}
+
+/*
+ * A ring of the minimal capacity does not overwrite the queued items.
+ */
+void MPSCRingTest::testFullMinimal()
+{
+	MPSCRing<int> ring(1);
+	int item = 0;
+
+	for (int round = 0; round < 3; ++round) {
+		CPPUNIT_ASSERT(ring.push(round * 2));
+		CPPUNIT_ASSERT(ring.push(round * 2 + 1));
+		CPPUNIT_ASSERT(!ring.push(100));
+		CPPUNIT_ASSERT_EQUAL((size_t) 2, ring.size());
+
+		CPPUNIT_ASSERT(ring.pop(item));
+		CPPUNIT_ASSERT_EQUAL(round * 2, item);
+		CPPUNIT_ASSERT(ring.pop(item));
+		CPPUNIT_ASSERT_EQUAL(round * 2 + 1, item);
+		CPPUNIT_ASSERT(!ring.pop(item));
+	}
+}
+
+/*
+ * The capacity is rounded up to a power of 2, at least 2.
+ */
+void MPSCRingTest::testCapacity()
+{
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, MPSCRing<int>(1).capacity());
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, MPSCRing<int>(2).capacity());
+	CPPUNIT_ASSERT_EQUAL((size_t) 8, MPSCRing<int>(5).capacity());
+	CPPUNIT_ASSERT_EQUAL((size_t) 1024, MPSCRing<int>(1024).capacity());
+
+	CPPUNIT_ASSERT_THROW(MPSCRing<int>(0), InvalidArgumentException);
+}
+
+class Producer : public Runnable {
+public:
+	Producer(MPSCRing<Item> &ring, unsigned int id, unsigned int count):
+		m_ring(ring),
+		m_id(id),
+		m_count(count)
+	{
+	}
+
+	void run() override
+	{
+		for (unsigned int i = 0; i < m_count; ++i) {
+			while (!m_ring.push({m_id, i}))
+				Thread::yield();
+		}
+	}
+
+private:
+	MPSCRing<Item> &m_ring;
+	unsigned int m_id;
+	unsigned int m_count;
+};
+
+/*
+ * Items of concurrent producers are all consumed, items of every
+ * single producer in order they were pushed.
+ */
+void MPSCRingTest::testProducers()
+{
+	const unsigned int PRODUCERS = 4;
+	const unsigned int COUNT = 20000;
+
+	MPSCRing<Item> ring(64);
+	vector<Producer *> producers;
+	vector<Thread *> threads;
+
+	for (unsigned int i = 0; i < PRODUCERS; ++i) {
+		producers.push_back(new Producer(ring, i, COUNT));
+		threads.push_back(new Thread);
+		threads.back()->start(*producers.back());
+	}
+
+	vector<unsigned int> next(PRODUCERS, 0);
+	unsigned int consumed = 0;
+	Item item;
+
+	while (consumed < PRODUCERS * COUNT) {
+		if (!ring.pop(item)) {
+			Thread::yield();
+			continue;
+		}
+
+		CPPUNIT_ASSERT(item.producer < PRODUCERS);
+		CPPUNIT_ASSERT_EQUAL(next[item.producer], item.sequence);
+
+		next[item.producer] += 1;
+		consumed += 1;
+	}
+
+	for (unsigned int i = 0; i < PRODUCERS; ++i) {
+		threads[i]->join();
+		delete threads[i];
+		delete producers[i];
+	}
+
+	CPPUNIT_ASSERT(!ring.pop(item));
+}
+
+}
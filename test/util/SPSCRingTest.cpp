@@ -0,0 +1,162 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Exception.h>
+#include <Poco/Runnable.h>
+#include <Poco/Thread.h>
+
+#include "cppunit/BetterAssert.h"
+
+#include "util/SPSCRing.h"
+
+using namespace std;
+using namespace Poco;
+
+namespace BeeeOn {
+
+class SPSCRingTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SPSCRingTest);
+	CPPUNIT_TEST(testPushPop);
+	CPPUNIT_TEST(testReplaceOldest);
+	CPPUNIT_TEST(testReplaceOldestConcurrent);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void testPushPop();
+	void testReplaceOldest();
+	void testReplaceOldestConcurrent();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SPSCRingTest);
+
+/*
+ * Items are popped in order they were pushed, nothing is pushed
+ * into a full ring.
+ */
+void SPSCRingTest::testPushPop()
+{
+	SPSCRing<int> ring(2);
+
+	CPPUNIT_ASSERT(ring.pop() == NULL);
+
+	CPPUNIT_ASSERT(ring.push(new int(1)));
+	CPPUNIT_ASSERT(ring.push(new int(2)));
+
+	int *item = new int(3);
+	CPPUNIT_ASSERT(!ring.push(item));
+	delete item;
+
+	for (int i = 1; i <= 2; ++i) {
+		item = ring.pop();
+		CPPUNIT_ASSERT(item != NULL);
+		CPPUNIT_ASSERT_EQUAL(i, *item);
+		delete item;
+	}
+
+	CPPUNIT_ASSERT(ring.pop() == NULL);
+	CPPUNIT_ASSERT_THROW(SPSCRing<int>(0), InvalidArgumentException);
+}
+
+/*
+ * Replacing the oldest item of a full ring keeps the order
+ * of the remaining items.
+ */
+void SPSCRingTest::testReplaceOldest()
+{
+	SPSCRing<int> ring(3);
+
+	CPPUNIT_ASSERT(ring.pushReplacingOldest(new int(1)) == NULL);
+
+	for (int i = 2; i <= 3; ++i)
+		CPPUNIT_ASSERT(ring.push(new int(i)));
+
+	for (int i = 4; i <= 7; ++i) {
+		int *oldest = ring.pushReplacingOldest(new int(i));
+		CPPUNIT_ASSERT(oldest != NULL);
+		CPPUNIT_ASSERT_EQUAL(i - 3, *oldest);
+		delete oldest;
+	}
+
+	for (int i = 5; i <= 7; ++i) {
+		int *item = ring.pop();
+		CPPUNIT_ASSERT(item != NULL);
+		CPPUNIT_ASSERT_EQUAL(i, *item);
+		delete item;
+	}
+
+	CPPUNIT_ASSERT(ring.pop() == NULL);
+}
+
+class ReplacingProducer : public Runnable {
+public:
+	ReplacingProducer(SPSCRing<unsigned int> &ring, unsigned int count):
+		m_ring(ring),
+		m_count(count),
+		m_dropped(0)
+	{
+	}
+
+	void run() override
+	{
+		for (unsigned int i = 0; i < m_count; ++i) {
+			unsigned int *oldest = m_ring.pushReplacingOldest(new unsigned int(i));
+
+			if (oldest != NULL) {
+				m_dropped += 1;
+				delete oldest;
+			}
+		}
+	}
+
+	unsigned int dropped() const
+	{
+		return m_dropped;
+	}
+
+private:
+	SPSCRing<unsigned int> &m_ring;
+	unsigned int m_count;
+	unsigned int m_dropped;
+};
+
+/*
+ * While the producer keeps overflowing the ring, the consumer
+ * receives the items in increasing order and every item is either
+ * consumed or dropped.
+ */
+void SPSCRingTest::testReplaceOldestConcurrent()
+{
+	const unsigned int COUNT = 100000;
+
+	SPSCRing<unsigned int> ring(4);
+	ReplacingProducer producer(ring, COUNT);
+	Thread thread;
+
+	thread.start(producer);
+
+	unsigned int consumed = 0;
+	bool first = true;
+	unsigned int last = 0;
+
+	// the last item is never dropped
+	while (first || last != COUNT - 1) {
+		unsigned int *item = ring.pop();
+
+		if (item == NULL) {
+			Thread::yield();
+			continue;
+		}
+
+		CPPUNIT_ASSERT(first || *item > last);
+
+		first = false;
+		last = *item;
+		consumed += 1;
+		delete item;
+	}
+
+	thread.join();
+
+	CPPUNIT_ASSERT_EQUAL(COUNT, consumed + producer.dropped());
+	CPPUNIT_ASSERT(ring.pop() == NULL);
+}
+
+}
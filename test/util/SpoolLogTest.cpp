@@ -0,0 +1,306 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Exception.h>
+#include <Poco/File.h>
+
+#include "cppunit/BetterAssert.h"
+
+#include "util/SpoolLog.h"
+
+using namespace std;
+using namespace Poco;
+
+namespace BeeeOn {
+
+class SpoolLogTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SpoolLogTest);
+	CPPUNIT_TEST(testAppendNext);
+	CPPUNIT_TEST(testRewind);
+	CPPUNIT_TEST(testRotate);
+	CPPUNIT_TEST(testRecovery);
+	CPPUNIT_TEST(testTornRecord);
+	CPPUNIT_TEST(testMaxSegments);
+	CPPUNIT_TEST(testTooLarge);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void setUp();
+	void tearDown();
+
+	void testAppendNext();
+	void testRewind();
+	void testRotate();
+	void testRecovery();
+	void testTornRecord();
+	void testMaxSegments();
+	void testTooLarge();
+
+private:
+	string m_directory;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SpoolLogTest);
+
+static void append(SpoolLog &log, const string &record)
+{
+	log.append(record.data(), record.size());
+}
+
+static string next(SpoolLog &log)
+{
+	const char *data;
+	size_t length;
+
+	if (!log.next(data, length))
+		return "";
+
+	return string(data, length);
+}
+
+/*
+ * Read all records not consumed (crossing segments).
+ */
+static vector<string> drain(SpoolLog &log)
+{
+	vector<string> records;
+
+	while (true) {
+		string record = next(log);
+
+		if (record.empty()) {
+			log.commit();
+
+			record = next(log);
+			if (record.empty())
+				break;
+		}
+
+		records.push_back(record);
+	}
+
+	log.commit();
+	return records;
+}
+
+void SpoolLogTest::setUp()
+{
+	m_directory = "/tmp/beeeon-test-spool-" + to_string(getpid());
+
+	File directory(m_directory);
+	if (directory.exists())
+		directory.remove(true);
+}
+
+void SpoolLogTest::tearDown()
+{
+	File directory(m_directory);
+	if (directory.exists())
+		directory.remove(true);
+}
+
+/*
+ * Records are read in the order of appending, a record read
+ * by next() is not consumed until commit().
+ */
+void SpoolLogTest::testAppendNext()
+{
+	SpoolLog log;
+	log.open(m_directory, 4096);
+
+	CPPUNIT_ASSERT(log.empty());
+	CPPUNIT_ASSERT_EQUAL(string(""), next(log));
+
+	append(log, "first");
+	append(log, "second record");
+	append(log, "x");
+
+	CPPUNIT_ASSERT(!log.empty());
+	CPPUNIT_ASSERT_EQUAL(string("first"), next(log));
+	CPPUNIT_ASSERT_EQUAL(string("second record"), next(log));
+	CPPUNIT_ASSERT(!log.empty());
+
+	log.commit();
+	CPPUNIT_ASSERT(!log.empty());
+
+	CPPUNIT_ASSERT_EQUAL(string("x"), next(log));
+	CPPUNIT_ASSERT_EQUAL(string(""), next(log));
+
+	append(log, "late");
+	CPPUNIT_ASSERT_EQUAL(string("late"), next(log));
+
+	log.commit();
+	CPPUNIT_ASSERT(log.empty());
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, log.segments());
+}
+
+/*
+ * The records not committed are returned again after rewind().
+ */
+void SpoolLogTest::testRewind()
+{
+	SpoolLog log;
+	log.open(m_directory, 4096);
+
+	append(log, "a");
+	append(log, "b");
+
+	CPPUNIT_ASSERT_EQUAL(string("a"), next(log));
+	log.commit();
+
+	CPPUNIT_ASSERT_EQUAL(string("b"), next(log));
+	log.rewind();
+
+	CPPUNIT_ASSERT_EQUAL(string("b"), next(log));
+	log.commit();
+	CPPUNIT_ASSERT(log.empty());
+}
+
+/*
+ * Segments are rotated when full and deleted when consumed.
+ * A single read does not cross a segment boundary.
+ */
+void SpoolLogTest::testRotate()
+{
+	SpoolLog log;
+	log.open(m_directory, 4096);
+
+	const string payload(100, 'p');
+
+	for (int i = 0; i < 100; ++i)
+		append(log, payload + to_string(i));
+
+	// 36 records of 112 bytes fit into a segment
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, log.segments());
+
+	int count = 0;
+	while (!next(log).empty())
+		++count;
+
+	CPPUNIT_ASSERT_EQUAL(36, count);
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, log.segments());
+
+	log.rewind();
+
+	const vector<string> records = drain(log);
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 100, records.size());
+	for (int i = 0; i < 100; ++i)
+		CPPUNIT_ASSERT_EQUAL(payload + to_string(i), records[i]);
+
+	CPPUNIT_ASSERT(log.empty());
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, log.segments());
+}
+
+/*
+ * After reopening, only the records not consumed are read
+ * and new records are appended after them.
+ */
+void SpoolLogTest::testRecovery()
+{
+	const string payload(200, 'r');
+
+	{
+		SpoolLog log;
+		log.open(m_directory, 4096);
+
+		for (int i = 0; i < 50; ++i)
+			append(log, payload + to_string(i));
+
+		for (int i = 0; i < 10; ++i)
+			next(log);
+
+		log.commit();
+		log.close();
+	}
+
+	SpoolLog log;
+	log.open(m_directory, 4096);
+
+	CPPUNIT_ASSERT(!log.empty());
+	append(log, "new");
+
+	const vector<string> records = drain(log);
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 41, records.size());
+	CPPUNIT_ASSERT_EQUAL(payload + "10", records.front());
+	CPPUNIT_ASSERT_EQUAL(payload + "49", records[39]);
+	CPPUNIT_ASSERT_EQUAL(string("new"), records.back());
+	CPPUNIT_ASSERT(log.empty());
+}
+
+/*
+ * A record with an invalid CRC (e.g. written partially before
+ * a crash) terminates the data and it is overwritten.
+ */
+void SpoolLogTest::testTornRecord()
+{
+	{
+		SpoolLog log;
+		log.open(m_directory, 4096);
+
+		append(log, "valid");
+		append(log, "torn");
+		log.close();
+	}
+
+	const string path = m_directory + "/0000000000000000.spool";
+	const int fd = ::open(path.c_str(), O_WRONLY);
+	CPPUNIT_ASSERT(fd >= 0);
+
+	// damage the payload of the second record
+	CPPUNIT_ASSERT_EQUAL((ssize_t) 1, ::pwrite(fd, "T", 1,
+		SpoolLog::recordSize(5) + SpoolLog::RECORD_HEADER_SIZE));
+	::close(fd);
+
+	SpoolLog log;
+	log.open(m_directory, 4096);
+
+	CPPUNIT_ASSERT(log.corruptedRecords() > 0);
+
+	append(log, "next");
+
+	CPPUNIT_ASSERT_EQUAL(string("valid"), next(log));
+	CPPUNIT_ASSERT_EQUAL(string("next"), next(log));
+	CPPUNIT_ASSERT_EQUAL(string(""), next(log));
+}
+
+/*
+ * The oldest segments are dropped when there are too many.
+ */
+void SpoolLogTest::testMaxSegments()
+{
+	SpoolLog log;
+	log.open(m_directory, 4096, 3);
+
+	const string payload(100, 'm');
+
+	for (int i = 0; i < 200; ++i)
+		append(log, payload + to_string(i));
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, log.segments());
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 3, log.droppedSegments());
+
+	const vector<string> records = drain(log);
+
+	CPPUNIT_ASSERT(!records.empty());
+	CPPUNIT_ASSERT_EQUAL(payload + "199", records.back());
+	CPPUNIT_ASSERT_EQUAL(payload + to_string(200 - records.size()),
+		records.front());
+}
+
+void SpoolLogTest::testTooLarge()
+{
+	SpoolLog log;
+	log.open(m_directory, 4096);
+
+	CPPUNIT_ASSERT_THROW(append(log, string(4096, 'l')), RangeException);
+	CPPUNIT_ASSERT_THROW(append(log, ""), RangeException);
+	CPPUNIT_ASSERT(log.empty());
+}
+
+}
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Logger.h>
+#include <Poco/Random.h>
+#include <Poco/Timespan.h>
+#include <Poco/Timestamp.h>
+
+#include "cppunit/BetterAssert.h"
+
+#include "util/TimingWheel.h"
+
+using namespace std;
+using namespace Poco;
+
+namespace BeeeOn {
+
+class TimingWheelTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TimingWheelTest);
+	CPPUNIT_TEST(testExpire);
+	CPPUNIT_TEST(testCancel);
+	CPPUNIT_TEST(testCascade);
+	CPPUNIT_TEST(testPastDeadline);
+	CPPUNIT_TEST(testNextTimeout);
+	CPPUNIT_TEST(testStress);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void testExpire();
+	void testCancel();
+	void testCascade();
+	void testPastDeadline();
+	void testNextTimeout();
+	void testStress();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TimingWheelTest);
+
+static const Timestamp::TimeDiff START = 1488879656000000;
+
+static Timestamp at(Timestamp::TimeDiff ms)
+{
+	return Timestamp(START + ms * Timespan::MILLISECONDS);
+}
+
+/*
+ * Timers expire exactly in their millisecond, in order of their
+ * deadlines.
+ */
+void TimingWheelTest::testExpire()
+{
+	TimingWheel<int> wheel(at(0));
+	vector<int> expired;
+
+	wheel.schedule(at(20), 20);
+	wheel.schedule(at(5), 5);
+	wheel.schedule(at(10), 10);
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, wheel.size());
+
+	wheel.advance(at(4), expired);
+	CPPUNIT_ASSERT(expired.empty());
+
+	wheel.advance(at(5), expired);
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, expired.size());
+	CPPUNIT_ASSERT_EQUAL(5, expired[0]);
+
+	wheel.advance(at(30), expired);
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, expired.size());
+	CPPUNIT_ASSERT_EQUAL(10, expired[1]);
+	CPPUNIT_ASSERT_EQUAL(20, expired[2]);
+
+	CPPUNIT_ASSERT(wheel.empty());
+}
+
+/*
+ * Cancelled timers do not expire, cancelling of a timer that
+ * has expired or has been cancelled fails.
+ */
+void TimingWheelTest::testCancel()
+{
+	TimingWheel<int> wheel(at(0));
+	vector<int> expired;
+
+	const TimingWheel<int>::Handle first = wheel.schedule(at(10), 1);
+	const TimingWheel<int>::Handle second = wheel.schedule(at(10), 2);
+
+	CPPUNIT_ASSERT(wheel.cancel(first));
+	CPPUNIT_ASSERT(!wheel.cancel(first));
+	CPPUNIT_ASSERT(!wheel.cancel(TimingWheel<int>::INVALID));
+
+	// reuses the slot of the first timer
+	const TimingWheel<int>::Handle third = wheel.schedule(at(20), 3);
+	CPPUNIT_ASSERT(third != first);
+	CPPUNIT_ASSERT(!wheel.cancel(first));
+
+	wheel.advance(at(10), expired);
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, expired.size());
+	CPPUNIT_ASSERT_EQUAL(2, expired[0]);
+	CPPUNIT_ASSERT(!wheel.cancel(second));
+
+	CPPUNIT_ASSERT(wheel.cancel(third));
+	CPPUNIT_ASSERT(wheel.empty());
+}
+
+/*
+ * Timers in the higher levels are cascaded down and expire
+ * exactly in their millisecond.
+ */
+void TimingWheelTest::testCascade()
+{
+	const Timestamp::TimeDiff deadlines[] = {
+		255, 256, 257, 65535, 65536, 65537,
+		16777215, 16777216, 16777217, 5000000000LL,
+	};
+
+	TimingWheel<Timestamp::TimeDiff> wheel(at(0));
+	vector<Timestamp::TimeDiff> expired;
+
+	for (auto deadline : deadlines)
+		wheel.schedule(at(deadline), deadline);
+
+	for (auto deadline : deadlines) {
+		wheel.advance(at(deadline - 1), expired);
+		CPPUNIT_ASSERT(expired.empty());
+
+		wheel.advance(at(deadline), expired);
+		CPPUNIT_ASSERT_EQUAL((size_t) 1, expired.size());
+		CPPUNIT_ASSERT_EQUAL(deadline, expired[0]);
+
+		expired.clear();
+	}
+
+	CPPUNIT_ASSERT(wheel.empty());
+}
+
+/*
+ * Timers with deadline in the past expire on the next tick.
+ */
+void TimingWheelTest::testPastDeadline()
+{
+	TimingWheel<int> wheel(at(100));
+	vector<int> expired;
+
+	wheel.schedule(at(50), 1);
+	wheel.schedule(at(100), 2);
+
+	wheel.advance(at(100), expired);
+	CPPUNIT_ASSERT(expired.empty());
+
+	wheel.advance(at(101), expired);
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, expired.size());
+}
+
+/*
+ * The next timeout is exact for near timers and never later than
+ * the nearest deadline.
+ */
+void TimingWheelTest::testNextTimeout()
+{
+	TimingWheel<int> wheel(at(0));
+	vector<int> expired;
+
+	CPPUNIT_ASSERT(wheel.nextTimeout(at(0)) < 0);
+
+	wheel.schedule(at(100000), 1);
+	const Timespan far = wheel.nextTimeout(at(0));
+	CPPUNIT_ASSERT(far > 0);
+	CPPUNIT_ASSERT(far <= 100000 * Timespan::MILLISECONDS);
+
+	wheel.schedule(at(37), 2);
+	CPPUNIT_ASSERT_EQUAL(37 * Timespan::MILLISECONDS,
+		wheel.nextTimeout(at(0)).totalMicroseconds());
+
+	wheel.advance(at(37), expired);
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, expired.size());
+
+	// follow the timeouts as an event loop would do
+	Timestamp::TimeDiff now = 37;
+	while (!wheel.empty()) {
+		now += wheel.nextTimeout(at(now)).totalMilliseconds();
+		wheel.advance(at(now), expired);
+
+		CPPUNIT_ASSERT(now <= 100000);
+	}
+
+	CPPUNIT_ASSERT_EQUAL(100000L, (long) now);
+}
+
+/*
+ * Schedule 10k timers with various deadlines, cancel some of them
+ * and advance the wheel in random steps. Every timer must expire
+ * in the millisecond of its deadline unless cancelled.
+ */
+void TimingWheelTest::testStress()
+{
+	const unsigned int count = 10000;
+	Random random;
+	random.seed(42);
+
+	TimingWheel<unsigned int> wheel(at(0));
+	map<unsigned int, Timestamp::TimeDiff> deadlines;
+	vector<TimingWheel<unsigned int>::Handle> handles;
+	vector<unsigned int> expired;
+
+	Timestamp start;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		const Timestamp::TimeDiff deadline = 1 + (i % 3 == 0 ?
+			random.next(300) : random.next(600000));
+
+		deadlines[i] = deadline;
+		handles.push_back(wheel.schedule(at(deadline), i));
+	}
+
+	for (unsigned int i = 0; i < count; i += 4) {
+		CPPUNIT_ASSERT(wheel.cancel(handles[i]));
+		deadlines.erase(i);
+	}
+
+	CPPUNIT_ASSERT_EQUAL(deadlines.size(), wheel.size());
+
+	Timestamp::TimeDiff now = 0;
+	while (!wheel.empty()) {
+		now += 1 + random.next(2000);
+		expired.clear();
+		wheel.advance(at(now), expired);
+
+		for (auto id : expired) {
+			auto it = deadlines.find(id);
+
+			CPPUNIT_ASSERT(it != deadlines.end());
+			CPPUNIT_ASSERT(it->second <= now);
+			deadlines.erase(it);
+		}
+
+		for (auto &item : deadlines)
+			CPPUNIT_ASSERT(item.second > now);
+	}
+
+	CPPUNIT_ASSERT(deadlines.empty());
+
+	Logger::get("TimingWheelTest").information(
+		to_string(count) + " timers processed in "
+		+ to_string(start.elapsed() / 1000) + " ms");
+}
+
+}
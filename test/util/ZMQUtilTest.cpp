@@ -0,0 +1,207 @@
+#include <unistd.h>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Logger.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/Timestamp.h>
+
+#include "util/ZMQUtil.h"
+
+using namespace std;
+using namespace Poco;
+
+namespace BeeeOn {
+
+class ZMQUtilTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ZMQUtilTest);
+	CPPUNIT_TEST(testSendReceive);
+	CPPUNIT_TEST(testZeroCopySendReceive);
+	CPPUNIT_TEST(testSendMultipart);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void setUp();
+	void tearDown();
+
+	void testSendReceive();
+	void testZeroCopySendReceive();
+	void testSendMultipart();
+
+protected:
+	/*
+	 * Receive a frame, wait for at most 1 s.
+	 */
+	bool receiveFrame(zmq::message_t &frame);
+
+	SharedPtr<zmq::context_t> m_context;
+	SharedPtr<zmq::socket_t> m_sender;
+	SharedPtr<zmq::socket_t> m_receiver;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ZMQUtilTest);
+
+class ZMQUtilBenchmark : public ZMQUtilTest {
+	CPPUNIT_TEST_SUITE(ZMQUtilBenchmark);
+	CPPUNIT_TEST(benchmarkBytesCopied);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void benchmarkBytesCopied();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(ZMQUtilBenchmark, "benchmark");
+
+void ZMQUtilTest::setUp()
+{
+	m_context = new zmq::context_t(1);
+
+	m_receiver = new zmq::socket_t(*m_context, ZMQ_PAIR);
+	m_receiver->bind("inproc://zmq-util-test");
+
+	m_sender = new zmq::socket_t(*m_context, ZMQ_PAIR);
+	m_sender->connect("inproc://zmq-util-test");
+}
+
+void ZMQUtilTest::tearDown()
+{
+	m_sender->close();
+	m_receiver->close();
+	m_context->close();
+}
+
+bool ZMQUtilTest::receiveFrame(zmq::message_t &frame)
+{
+	for (int i = 0; i < 1000; ++i) {
+		if (ZMQUtil::receive(m_receiver, frame))
+			return true;
+
+		usleep(1000);
+	}
+
+	return false;
+}
+
+/*
+ * The copying API sends and receives the given string.
+ */
+void ZMQUtilTest::testSendReceive()
+{
+	string received;
+
+	CPPUNIT_ASSERT(ZMQUtil::send(m_sender, string("message")));
+
+	for (int i = 0; i < 1000 && received.empty(); ++i) {
+		if (!ZMQUtil::receive(m_receiver, received))
+			usleep(1000);
+	}
+
+	CPPUNIT_ASSERT_EQUAL(string("message"), received);
+}
+
+/*
+ * The moved buffer is handed over to ZMQ and it is received via
+ * ZMQFrameView. Over inproc transport, the receiver gets the very
+ * same buffer, so no data are copied on the way.
+ */
+void ZMQUtilTest::testZeroCopySendReceive()
+{
+	string message(4096, 'x');
+	const char *buffer = message.data();
+
+	CPPUNIT_ASSERT(ZMQUtil::send(m_sender, std::move(message)));
+
+	zmq::message_t frame;
+	CPPUNIT_ASSERT(receiveFrame(frame));
+
+	ZMQFrameView view(frame);
+	CPPUNIT_ASSERT_EQUAL(size_t(4096), view.size());
+	CPPUNIT_ASSERT(view.toString() == string(4096, 'x'));
+	CPPUNIT_ASSERT(buffer == view.data());
+}
+
+/*
+ * The routing frame and the payload are sent together as a single
+ * multipart message.
+ */
+void ZMQUtilTest::testSendMultipart()
+{
+	CPPUNIT_ASSERT(ZMQUtil::sendMultipart(
+		m_sender, "a800", string("{\"message_type\" : \"error\"}")));
+
+	zmq::message_t identity;
+	CPPUNIT_ASSERT(receiveFrame(identity));
+	CPPUNIT_ASSERT(identity.more());
+	CPPUNIT_ASSERT_EQUAL(string("a800"), ZMQFrameView(identity).toString());
+
+	zmq::message_t payload;
+	CPPUNIT_ASSERT(receiveFrame(payload));
+	CPPUNIT_ASSERT(!payload.more());
+	CPPUNIT_ASSERT_EQUAL(
+		string("{\"message_type\" : \"error\"}"),
+		ZMQFrameView(payload).toString());
+}
+
+/*
+ * Sends messages of typical sizes via the copying and via the
+ * zero-copy API and reports the number of bytes copied per message
+ * and the throughput. A byte is counted as copied when the receiver
+ * does not see the buffer of the sender.
+ */
+void ZMQUtilBenchmark::benchmarkBytesCopied()
+{
+	const size_t sizes[] = {256, 4096, 65536};
+	const unsigned int count = 1000;
+	Logger &logger = Logger::get("ZMQUtilTest");
+
+	for (auto size : sizes) {
+		size_t copied = 0;
+		Timestamp start;
+
+		for (unsigned int i = 0; i < count; ++i) {
+			const string message(size, 'x');
+			string received;
+
+			ZMQUtil::send(m_sender, message);
+			copied += message.size(); // memcpy into zmq::message_t
+
+			while (!ZMQUtil::receive(m_receiver, received))
+				;
+
+			copied += received.size(); // copy into std::string
+		}
+
+		const Timestamp::TimeDiff copyTime = start.elapsed();
+		const size_t copyBytes = copied / count;
+
+		copied = 0;
+		start.update();
+
+		for (unsigned int i = 0; i < count; ++i) {
+			string message(size, 'x');
+			const char *buffer = message.data();
+			zmq::message_t frame;
+
+			ZMQUtil::send(m_sender, std::move(message));
+
+			while (!ZMQUtil::receive(m_receiver, frame))
+				;
+
+			ZMQFrameView view(frame);
+			if (view.data() != buffer)
+				copied += view.size();
+		}
+
+		const Timestamp::TimeDiff zeroCopyTime = start.elapsed();
+		const size_t zeroCopyBytes = copied / count;
+
+		logger.information(to_string(size) + " B messages: copy "
+			+ to_string(copyBytes) + " B copied, "
+			+ to_string(copyTime) + " us; zero-copy "
+			+ to_string(zeroCopyBytes) + " B copied, "
+			+ to_string(zeroCopyTime) + " us");
+
+		CPPUNIT_ASSERT_EQUAL(2 * size, copyBytes);
+		CPPUNIT_ASSERT(zeroCopyBytes < copyBytes);
+	}
+}
+
+}
@@ -0,0 +1,596 @@
+#include <vector>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/AtomicCounter.h>
+#include <Poco/Event.h>
+#include <Poco/Exception.h>
+#include <Poco/Mutex.h>
+#include <Poco/Nullable.h>
+#include <Poco/Runnable.h>
+#include <Poco/SharedPtr.h>
+#include <Poco/Thread.h>
+
+#include "cppunit/BetterAssert.h"
+
+#include "z-wave/GenericZWaveMessageFactory.h"
+#include "z-wave/NotificationProcessor.h"
+
+using namespace std;
+using namespace Poco;
+
+namespace BeeeOn {
+
+class NotificationProcessorTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(NotificationProcessorTest);
+	CPPUNIT_TEST(testDropNewest);
+	CPPUNIT_TEST(testBlock);
+	CPPUNIT_TEST(testStopDrains);
+	CPPUNIT_TEST(testRefresh);
+	CPPUNIT_TEST(testConfiguration);
+	CPPUNIT_TEST(testIdentifyOnce);
+	CPPUNIT_TEST(testIdentifyLater);
+	CPPUNIT_TEST(testDeltaValues);
+	CPPUNIT_TEST(testAllValues);
+	CPPUNIT_TEST(testRefreshAllValues);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void setUp();
+	void tearDown();
+
+	void testDropNewest();
+	void testBlock();
+	void testStopDrains();
+	void testRefresh();
+	void testConfiguration();
+	void testIdentifyOnce();
+	void testIdentifyLater();
+	void testDeltaValues();
+	void testAllValues();
+	void testRefreshAllValues();
+
+private:
+	NotificationProcessor::PairedDevices m_devices;
+	AtomicCounter m_listen;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(NotificationProcessorTest);
+
+/*
+ * Processor recording the node IDs of the processed events instead
+ * of processing them via OpenZWave. When blocking, processing of every
+ * event waits until release() is called.
+ */
+class RecordingProcessor : public NotificationProcessor {
+public:
+	RecordingProcessor(const PairedDevices &devices,
+			AtomicCounter &listen, bool blocking = false):
+		NotificationProcessor(devices, listen),
+		m_blocking(blocking),
+		m_release(false)
+	{
+	}
+
+	~RecordingProcessor()
+	{
+		release();
+		stop();
+	}
+
+	bool push(uint8_t nodeId, bool droppable)
+	{
+		Event event;
+		event.type = OpenZWave::Notification::Type_ValueChanged;
+		event.nodeId = nodeId;
+
+		return enqueue(event, droppable);
+	}
+
+	void waitEntered()
+	{
+		m_entered.wait(1000);
+	}
+
+	void release()
+	{
+		m_release.set();
+	}
+
+	bool waitRefreshed(long ms)
+	{
+		return m_refreshed.tryWait(ms);
+	}
+
+	vector<uint8_t> processed()
+	{
+		FastMutex::ScopedLock guard(m_lock);
+		return m_processed;
+	}
+
+protected:
+	void process(const Event &event) override
+	{
+		m_entered.set();
+
+		if (m_blocking)
+			m_release.wait();
+
+		FastMutex::ScopedLock guard(m_lock);
+		m_processed.push_back(event.nodeId);
+	}
+
+	void refreshNodes() override
+	{
+		m_refreshed.set();
+	}
+
+private:
+	bool m_blocking;
+	Poco::Event m_entered;
+	Poco::Event m_release;
+	Poco::Event m_refreshed;
+	FastMutex m_lock;
+	vector<uint8_t> m_processed;
+};
+
+/*
+ * Message recording the indexes of the values to be extracted.
+ * No value is mapped to a module, thus nothing is sent.
+ */
+class RecordingMessage : public ZWaveMessage {
+public:
+	RecordingMessage(vector<vector<int>> &extracted):
+		m_extracted(extracted)
+	{
+	}
+
+	SensorData extractValues(const vector<ZWaveSensorValue> &values) override
+	{
+		vector<int> indexes;
+
+		for (auto &value : values)
+			indexes.push_back(value.index);
+
+		m_extracted.push_back(indexes);
+		return SensorData();
+	}
+
+	void setValue(const SensorData &, const uint8_t &) override
+	{
+	}
+
+	int getDeviceID() override
+	{
+		return 0;
+	}
+
+	void setAfterStart() override
+	{
+	}
+
+private:
+	vector<vector<int>> &m_extracted;
+};
+
+class RecordingMessageFactory : public ZWaveMessageFactory {
+public:
+	RecordingMessageFactory():
+		m_created(0)
+	{
+	}
+
+	ZWaveMessage *create(const uint32_t, const uint32_t) override
+	{
+		m_created++;
+		return new RecordingMessage(m_extracted);
+	}
+
+	unsigned int m_created;
+	vector<vector<int>> m_extracted;
+};
+
+#define TEST_MANUFACTURER 0x010f
+#define TEST_PRODUCT      0x1000
+
+/*
+ * Processor processing the events synchronously without OpenZWave.
+ * The node is identified as TEST_MANUFACTURER and TEST_PRODUCT
+ * unless setIdentified(false) is called.
+ */
+class OfflineProcessor : public NotificationProcessor {
+public:
+	OfflineProcessor(const PairedDevices &devices, AtomicCounter &listen):
+		NotificationProcessor(devices, listen),
+		m_identified(true),
+		m_queries(0),
+		m_products(new RecordingMessageFactory)
+	{
+		m_factory.registerManufacturer(TEST_MANUFACTURER, m_products);
+		setGenericMessageFactory(&m_factory);
+	}
+
+	void deliver(OpenZWave::Notification::NotificationType type,
+		uint8_t nodeId, uint8_t index = 0)
+	{
+		Event event;
+		event.type = type;
+		event.nodeId = nodeId;
+		event.valueID = OpenZWave::ValueID(0, nodeId,
+			OpenZWave::ValueID::ValueGenre_User,
+			COMMAND_CLASS_SENSOR_MULTILEVEL, 1, index,
+			OpenZWave::ValueID::ValueType_Decimal);
+
+		process(event);
+	}
+
+	void refreshNow()
+	{
+		refreshNodes();
+	}
+
+	void setIdentified(bool identified)
+	{
+		m_identified = identified;
+	}
+
+	unsigned int queries() const
+	{
+		return m_queries;
+	}
+
+	unsigned int created() const
+	{
+		return m_products->m_created;
+	}
+
+	const vector<vector<int>> &extracted() const
+	{
+		return m_products->m_extracted;
+	}
+
+protected:
+	string nodeManufacturer(const uint8_t) override
+	{
+		m_queries++;
+		return m_identified ? "0x010f" : "";
+	}
+
+	string nodeProduct(const uint8_t) override
+	{
+		return m_identified ? "0x1000" : "";
+	}
+
+	ZWaveSensorValue readValue(const OpenZWave::ValueID &valueID) override
+	{
+		return {valueID.GetCommandClassId(), valueID.GetIndex(), valueID, "1", ""};
+	}
+
+	void cancelControllerCommand(const uint32_t) override
+	{
+	}
+
+	void writeConfig() override
+	{
+	}
+
+private:
+	bool m_identified;
+	unsigned int m_queries;
+	SharedPtr<RecordingMessageFactory> m_products;
+	GenericZWaveMessageFactory m_factory;
+};
+
+void NotificationProcessorTest::setUp()
+{
+	m_devices = make_shared<const set<DeviceID>>();
+	m_listen = 0;
+}
+
+/*
+ * The node table is shared by all processors, no node
+ * is left there for the other tests.
+ */
+void NotificationProcessorTest::tearDown()
+{
+	OfflineProcessor processor(m_devices, m_listen);
+
+	for (unsigned int i = 0; i < 256; ++i)
+		processor.deliver(OpenZWave::Notification::Type_NodeRemoved, i);
+}
+
+/*
+ * Value notifications are dropped while the queue is full,
+ * the queued ones are processed in order.
+ */
+void NotificationProcessorTest::testDropNewest()
+{
+	RecordingProcessor processor(m_devices, m_listen, true);
+	processor.setQueueSize(2);
+	processor.setOverflowPolicy("drop-newest");
+	processor.start();
+
+	CPPUNIT_ASSERT(processor.push(1, true));
+	processor.waitEntered();
+
+	CPPUNIT_ASSERT(processor.push(2, true));
+	CPPUNIT_ASSERT(processor.push(3, true));
+	CPPUNIT_ASSERT(!processor.push(4, true));
+	CPPUNIT_ASSERT(!processor.push(5, true));
+
+	NotificationProcessor::Stats stats = processor.stats();
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, stats.depth);
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, stats.maxDepth);
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, stats.capacity);
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 3, stats.queued);
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 2, stats.dropped);
+
+	processor.release();
+	processor.stop();
+
+	const vector<uint8_t> processed = processor.processed();
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, processed.size());
+	CPPUNIT_ASSERT_EQUAL(1, (int) processed[0]);
+	CPPUNIT_ASSERT_EQUAL(2, (int) processed[1]);
+	CPPUNIT_ASSERT_EQUAL(3, (int) processed[2]);
+
+	stats = processor.stats();
+	CPPUNIT_ASSERT_EQUAL((size_t) 0, stats.depth);
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 3, stats.processed);
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 2, stats.dropped);
+}
+
+class PushLater : public Runnable {
+public:
+	PushLater(RecordingProcessor &processor, uint8_t nodeId):
+		m_processor(processor),
+		m_nodeId(nodeId),
+		m_result(false)
+	{
+	}
+
+	void run() override
+	{
+		m_result = m_processor.push(m_nodeId, false);
+		m_done.set();
+	}
+
+	bool waitDone(long ms)
+	{
+		return m_done.tryWait(ms);
+	}
+
+	bool result() const
+	{
+		return m_result;
+	}
+
+private:
+	RecordingProcessor &m_processor;
+	uint8_t m_nodeId;
+	bool m_result;
+	Poco::Event m_done;
+};
+
+/*
+ * The driver thread is blocked while the queue is full
+ * and no notification is lost.
+ */
+void NotificationProcessorTest::testBlock()
+{
+	RecordingProcessor processor(m_devices, m_listen, true);
+	processor.setQueueSize(2);
+	processor.setOverflowPolicy("block");
+	processor.start();
+
+	CPPUNIT_ASSERT(processor.push(1, false));
+	processor.waitEntered();
+
+	CPPUNIT_ASSERT(processor.push(2, false));
+	CPPUNIT_ASSERT(processor.push(3, false));
+
+	PushLater later(processor, 4);
+	Poco::Thread thread;
+	thread.start(later);
+
+	CPPUNIT_ASSERT(!later.waitDone(200));
+
+	processor.release();
+
+	CPPUNIT_ASSERT(later.waitDone(1000));
+	CPPUNIT_ASSERT(later.result());
+	thread.join();
+
+	processor.stop();
+
+	const vector<uint8_t> processed = processor.processed();
+	CPPUNIT_ASSERT_EQUAL((size_t) 4, processed.size());
+	CPPUNIT_ASSERT_EQUAL(4, (int) processed[3]);
+
+	const NotificationProcessor::Stats stats = processor.stats();
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 4, stats.queued);
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 4, stats.processed);
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 0, stats.dropped);
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, stats.maxDepth);
+}
+
+/*
+ * The queued notifications are processed before stop() returns.
+ * After stop, a full queue does not block the driver thread.
+ */
+void NotificationProcessorTest::testStopDrains()
+{
+	RecordingProcessor processor(m_devices, m_listen, true);
+	processor.setQueueSize(2);
+	processor.setOverflowPolicy("block");
+	processor.start();
+
+	CPPUNIT_ASSERT(processor.push(1, false));
+	processor.waitEntered();
+
+	CPPUNIT_ASSERT(processor.push(2, false));
+	CPPUNIT_ASSERT(processor.push(3, false));
+
+	processor.release();
+	processor.stop();
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, processor.processed().size());
+	CPPUNIT_ASSERT_EQUAL((size_t) 0, processor.stats().depth);
+
+	CPPUNIT_ASSERT(processor.push(4, false));
+	CPPUNIT_ASSERT(processor.push(5, false));
+	CPPUNIT_ASSERT(!processor.push(6, false));
+
+	CPPUNIT_ASSERT_EQUAL((uint64_t) 1, processor.stats().dropped);
+}
+
+/*
+ * The refresh is done by the processing thread even when
+ * no notification arrives.
+ */
+void NotificationProcessorTest::testRefresh()
+{
+	RecordingProcessor processor(m_devices, m_listen);
+	processor.start();
+
+	CPPUNIT_ASSERT(!processor.waitRefreshed(200));
+
+	processor.refresh();
+
+	CPPUNIT_ASSERT(processor.waitRefreshed(1000));
+	CPPUNIT_ASSERT(processor.processed().empty());
+}
+
+void NotificationProcessorTest::testConfiguration()
+{
+	RecordingProcessor processor(m_devices, m_listen);
+
+	CPPUNIT_ASSERT_THROW(processor.setQueueSize(0), InvalidArgumentException);
+	CPPUNIT_ASSERT_THROW(processor.setOverflowPolicy("drop-oldest"),
+		InvalidArgumentException);
+
+	processor.setQueueSize(3);
+	processor.start();
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 4, processor.stats().capacity);
+	CPPUNIT_ASSERT_THROW(processor.setQueueSize(8), IllegalStateException);
+}
+
+/*
+ * A node is identified once, its changed values are processed
+ * without querying OpenZWave for the product again.
+ */
+void NotificationProcessorTest::testIdentifyOnce()
+{
+	OfflineProcessor processor(m_devices, m_listen);
+
+	processor.deliver(OpenZWave::Notification::Type_NodeAdded, 10);
+	processor.deliver(OpenZWave::Notification::Type_ValueAdded, 10, 1);
+	processor.deliver(OpenZWave::Notification::Type_ValueAdded, 10, 2);
+
+	for (int i = 0; i < 3; ++i)
+		processor.deliver(OpenZWave::Notification::Type_ValueChanged, 10, 1);
+
+	CPPUNIT_ASSERT_EQUAL(1, (int) processor.queries());
+	CPPUNIT_ASSERT_EQUAL(1, (int) processor.created());
+	CPPUNIT_ASSERT_EQUAL((size_t) 3, processor.extracted().size());
+
+	const Nullable<NodeInfo> node = NotificationProcessor::findNodeInfo(10);
+	CPPUNIT_ASSERT(!node.isNull());
+	CPPUNIT_ASSERT(node.value().m_identified);
+	CPPUNIT_ASSERT_EQUAL(TEST_MANUFACTURER, (int) node.value().m_manufacturer);
+	CPPUNIT_ASSERT_EQUAL(TEST_PRODUCT, (int) node.value().m_product);
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, node.value().m_values.size());
+
+	processor.deliver(OpenZWave::Notification::Type_NodeRemoved, 10);
+	CPPUNIT_ASSERT(NotificationProcessor::findNodeInfo(10).isNull());
+}
+
+/*
+ * A node with the product not known yet is identified later
+ * and its values are not processed until then.
+ */
+void NotificationProcessorTest::testIdentifyLater()
+{
+	OfflineProcessor processor(m_devices, m_listen);
+	processor.setIdentified(false);
+
+	processor.deliver(OpenZWave::Notification::Type_NodeAdded, 11);
+	processor.deliver(OpenZWave::Notification::Type_ValueAdded, 11, 1);
+	processor.deliver(OpenZWave::Notification::Type_ValueChanged, 11, 1);
+
+	CPPUNIT_ASSERT_EQUAL(2, (int) processor.queries());
+	CPPUNIT_ASSERT_EQUAL(0, (int) processor.created());
+	CPPUNIT_ASSERT(processor.extracted().empty());
+	CPPUNIT_ASSERT(!NotificationProcessor::findNodeInfo(11).value().m_identified);
+
+	processor.setIdentified(true);
+	processor.deliver(OpenZWave::Notification::Type_NodeQueriesComplete, 11);
+
+	CPPUNIT_ASSERT_EQUAL(1, (int) processor.created());
+	CPPUNIT_ASSERT(NotificationProcessor::findNodeInfo(11).value().m_identified);
+
+	processor.deliver(OpenZWave::Notification::Type_ValueChanged, 11, 1);
+
+	CPPUNIT_ASSERT_EQUAL(3, (int) processor.queries());
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, processor.extracted().size());
+}
+
+/*
+ * Only the changed value is extracted in the delta mode.
+ */
+void NotificationProcessorTest::testDeltaValues()
+{
+	OfflineProcessor processor(m_devices, m_listen);
+
+	processor.deliver(OpenZWave::Notification::Type_NodeAdded, 20);
+	processor.deliver(OpenZWave::Notification::Type_ValueAdded, 20, 1);
+	processor.deliver(OpenZWave::Notification::Type_ValueAdded, 20, 2);
+	processor.deliver(OpenZWave::Notification::Type_ValueChanged, 20, 2);
+
+	const vector<vector<int>> &extracted = processor.extracted();
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, extracted.size());
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, extracted[0].size());
+	CPPUNIT_ASSERT_EQUAL(2, extracted[0][0]);
+}
+
+/*
+ * All values of the node are extracted when the delta mode is off.
+ */
+void NotificationProcessorTest::testAllValues()
+{
+	OfflineProcessor processor(m_devices, m_listen);
+	processor.setDeltaValues(false);
+
+	processor.deliver(OpenZWave::Notification::Type_NodeAdded, 21);
+	processor.deliver(OpenZWave::Notification::Type_ValueAdded, 21, 1);
+	processor.deliver(OpenZWave::Notification::Type_ValueAdded, 21, 2);
+	processor.deliver(OpenZWave::Notification::Type_ValueChanged, 21, 2);
+
+	const vector<vector<int>> &extracted = processor.extracted();
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, extracted.size());
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, extracted[0].size());
+	CPPUNIT_ASSERT_EQUAL(1, extracted[0][0]);
+	CPPUNIT_ASSERT_EQUAL(2, extracted[0][1]);
+}
+
+/*
+ * The refresh extracts all values of the node even in the delta mode.
+ */
+void NotificationProcessorTest::testRefreshAllValues()
+{
+	OfflineProcessor processor(m_devices, m_listen);
+
+	processor.deliver(OpenZWave::Notification::Type_NodeAdded, 22);
+	processor.deliver(OpenZWave::Notification::Type_ValueAdded, 22, 1);
+	processor.deliver(OpenZWave::Notification::Type_ValueAdded, 22, 2);
+
+	processor.refreshNow();
+
+	const vector<vector<int>> &extracted = processor.extracted();
+	CPPUNIT_ASSERT_EQUAL((size_t) 1, extracted.size());
+	CPPUNIT_ASSERT_EQUAL((size_t) 2, extracted[0].size());
+	CPPUNIT_ASSERT_EQUAL(1, extracted[0][0]);
+	CPPUNIT_ASSERT_EQUAL(2, extracted[0][1]);
+}
+
+}
@@ -0,0 +1,256 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Exception.h>
+#include <Poco/Logger.h>
+#include <Poco/Timestamp.h>
+
+#include "model/SensorData.h"
+#include "zmq/ZMQBinaryMessage.h"
+#include "zmq/ZMQMessage.h"
+
+using namespace Poco;
+using namespace std;
+
+namespace BeeeOn {
+
+class ZMQBinaryMessageTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ZMQBinaryMessageTest);
+	CPPUNIT_TEST(testMeasuredValues);
+	CPPUNIT_TEST(testMeasuredValuesBatch);
+	CPPUNIT_TEST(testHeader);
+	CPPUNIT_TEST(testInvalidMessage);
+	CPPUNIT_TEST(testEncodingNegotiation);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testMeasuredValues();
+	void testMeasuredValuesBatch();
+	void testHeader();
+	void testInvalidMessage();
+	void testEncodingNegotiation();
+
+protected:
+	SensorData createSensorData(size_t count) const;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ZMQBinaryMessageTest);
+
+class ZMQBinaryMessageBenchmark : public ZMQBinaryMessageTest {
+	CPPUNIT_TEST_SUITE(ZMQBinaryMessageBenchmark);
+	CPPUNIT_TEST(benchmarkEncodings);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void benchmarkEncodings();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(ZMQBinaryMessageBenchmark, "benchmark");
+
+SensorData ZMQBinaryMessageTest::createSensorData(size_t count) const
+{
+	SensorData sensorData;
+	sensorData.setDeviceID(DeviceID(0xfe01020304050607));
+
+	for (size_t i = 0; i < count; ++i)
+		sensorData.insertValue(SensorValue(ModuleID(i), -59.4 + i));
+
+	return sensorData;
+}
+
+/*
+ * Encoded measured values are decoded into equal SensorData including
+ * invalid values. The message size matches the documented layout.
+ */
+void ZMQBinaryMessageTest::testMeasuredValues()
+{
+	Timestamp now;
+
+	SensorData testSensorData = createSensorData(2);
+	testSensorData.insertValue(SensorValue(ModuleID(7)));
+	testSensorData.setTimestamp(now);
+
+	const string message = ZMQBinaryMessage::fromSensorData(testSensorData);
+
+	CPPUNIT_ASSERT_EQUAL(
+		(size_t) ZMQBinaryMessage::HEADER_SIZE
+			+ ZMQBinaryMessage::SENSOR_DATA_SIZE
+			+ 3 * ZMQBinaryMessage::SENSOR_VALUE_SIZE,
+		message.size());
+
+	CPPUNIT_ASSERT(ZMQBinaryMessage::isBinary(message.data(), message.size()));
+	CPPUNIT_ASSERT(ZMQBinaryMessage::type(message.data(), message.size())
+		== ZMQMessageType::TYPE_MEASURED_VALUES);
+
+	SensorData sensorData = ZMQBinaryMessage::toSensorData(
+		message.data(), message.size());
+	sensorData.setTimestamp(now);
+
+	CPPUNIT_ASSERT(testSensorData == sensorData);
+}
+
+void ZMQBinaryMessageTest::testMeasuredValuesBatch()
+{
+	Timestamp now;
+	vector<SensorData> testBatch;
+
+	for (size_t i = 0; i < 3; ++i) {
+		testBatch.push_back(createSensorData(i + 1));
+		testBatch.back().setTimestamp(now);
+	}
+
+	const string message = ZMQBinaryMessage::fromSensorDataBatch(testBatch);
+
+	CPPUNIT_ASSERT_EQUAL(
+		(size_t) ZMQBinaryMessage::HEADER_SIZE
+			+ ZMQBinaryMessage::BATCH_SIZE
+			+ 3 * ZMQBinaryMessage::SENSOR_DATA_SIZE
+			+ 6 * ZMQBinaryMessage::SENSOR_VALUE_SIZE,
+		message.size());
+
+	CPPUNIT_ASSERT(ZMQBinaryMessage::type(message.data(), message.size())
+		== ZMQMessageType::TYPE_MEASURED_VALUES_BATCH);
+
+	vector<SensorData> batch = ZMQBinaryMessage::toSensorDataBatch(
+		message.data(), message.size());
+
+	CPPUNIT_ASSERT_EQUAL(testBatch.size(), batch.size());
+
+	for (size_t i = 0; i < batch.size(); ++i) {
+		batch[i].setTimestamp(now);
+		CPPUNIT_ASSERT(testBatch[i] == batch[i]);
+	}
+
+	CPPUNIT_ASSERT_THROW(
+		ZMQBinaryMessage::toSensorDataBatch(message.data(), message.size() - 4),
+		SyntaxException);
+	CPPUNIT_ASSERT_THROW(
+		ZMQBinaryMessage::toSensorData(message.data(), message.size()),
+		SyntaxException);
+}
+
+void ZMQBinaryMessageTest::testHeader()
+{
+	const SensorData sensorData = createSensorData(1);
+
+	string message = ZMQBinaryMessage::fromSensorData(sensorData);
+	CPPUNIT_ASSERT(ZMQBinaryMessage::id(message.data(), message.size()).isNull());
+
+	const GlobalID id = GlobalID::parse("3feca65f-fdfc-4189-ad9d-0be68e13ef5d");
+	message = ZMQBinaryMessage::fromSensorData(sensorData, id);
+
+	const Nullable<GlobalID> parsed =
+		ZMQBinaryMessage::id(message.data(), message.size());
+
+	CPPUNIT_ASSERT(!parsed.isNull());
+	CPPUNIT_ASSERT_EQUAL(id.toString(), parsed.value().toString());
+}
+
+void ZMQBinaryMessageTest::testInvalidMessage()
+{
+	const string json = ZMQMessage::fromSensorData(createSensorData(1)).toString();
+	CPPUNIT_ASSERT(!ZMQBinaryMessage::isBinary(json.data(), json.size()));
+	CPPUNIT_ASSERT(!ZMQBinaryMessage::isBinary("", 0));
+
+	string message = ZMQBinaryMessage::fromSensorData(createSensorData(2));
+
+	CPPUNIT_ASSERT_THROW(
+		ZMQBinaryMessage::type(message.data(), 4),
+		SyntaxException);
+
+	CPPUNIT_ASSERT_THROW(
+		ZMQBinaryMessage::toSensorData(message.data(), message.size() - 1),
+		SyntaxException);
+
+	message[1] = ZMQBinaryMessage::VERSION + 1;
+	CPPUNIT_ASSERT_THROW(
+		ZMQBinaryMessage::type(message.data(), message.size()),
+		SyntaxException);
+
+	message[1] = ZMQBinaryMessage::VERSION;
+	message[2] = (char) 0xff;
+	CPPUNIT_ASSERT_THROW(
+		ZMQBinaryMessage::type(message.data(), message.size()),
+		SyntaxException);
+}
+
+/*
+ * The encoding attribute is optional, JSON is used when missing
+ * or unknown.
+ */
+void ZMQBinaryMessageTest::testEncodingNegotiation()
+{
+	ZMQMessage request = ZMQMessage::fromHelloRequest(
+		DevicePrefix::fromRaw(DevicePrefix::PREFIX_FITPROTOCOL));
+
+	CPPUNIT_ASSERT(request.encoding() == ZMQMessageEncoding::ENCODING_JSON);
+
+	request.setEncoding(
+		ZMQMessageEncoding::fromRaw(ZMQMessageEncoding::ENCODING_BINARY));
+
+	ZMQMessage parsed = ZMQMessage::fromJSON(request.toString());
+	CPPUNIT_ASSERT(parsed.encoding() == ZMQMessageEncoding::ENCODING_BINARY);
+	CPPUNIT_ASSERT_EQUAL(
+		DevicePrefix::fromRaw(DevicePrefix::PREFIX_FITPROTOCOL),
+		parsed.toHelloRequest());
+
+	parsed = ZMQMessage::fromJSON(R"({
+		"message_type" : "hello_response",
+		"device_manager_id" : "0xa100",
+		"encoding" : "unknown"
+	})");
+	CPPUNIT_ASSERT(parsed.encoding() == ZMQMessageEncoding::ENCODING_JSON);
+}
+
+/*
+ * Compares messages per second and bytes per message of both
+ * encodings for a message of measured_values (encode + decode).
+ */
+void ZMQBinaryMessageBenchmark::benchmarkEncodings()
+{
+	const size_t counts[] = {1, 4, 16};
+	const unsigned int iterations = 10000;
+	Logger &logger = Logger::get("ZMQBinaryMessageTest");
+
+	for (auto count : counts) {
+		const SensorData sensorData = createSensorData(count);
+		size_t jsonBytes = 0;
+		size_t binaryBytes = 0;
+
+		Timestamp start;
+
+		for (unsigned int i = 0; i < iterations; ++i) {
+			const string message = ZMQMessage::fromSensorData(sensorData).toString();
+			jsonBytes = message.size();
+
+			const SensorData decoded = ZMQMessage::fromJSON(
+				message.data(), message.size()).toSensorData();
+			CPPUNIT_ASSERT(decoded.deviceID() == sensorData.deviceID());
+		}
+
+		const Timestamp::TimeDiff jsonTime = start.elapsed();
+		start.update();
+
+		for (unsigned int i = 0; i < iterations; ++i) {
+			const string message = ZMQBinaryMessage::fromSensorData(sensorData);
+			binaryBytes = message.size();
+
+			const SensorData decoded = ZMQBinaryMessage::toSensorData(
+				message.data(), message.size());
+			CPPUNIT_ASSERT(decoded.deviceID() == sensorData.deviceID());
+		}
+
+		const Timestamp::TimeDiff binaryTime = start.elapsed();
+
+		CPPUNIT_ASSERT(binaryBytes < jsonBytes);
+
+		logger.information(to_string(count) + " values: JSON "
+			+ to_string(jsonBytes) + " B/msg "
+			+ to_string(iterations * 1000000.0 / (jsonTime ? jsonTime : 1))
+			+ " msg/s, binary "
+			+ to_string(binaryBytes) + " B/msg "
+			+ to_string(iterations * 1000000.0 / (binaryTime ? binaryTime : 1))
+			+ " msg/s");
+	}
+}
+
+}
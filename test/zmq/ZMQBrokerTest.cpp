@@ -1,11 +1,16 @@
+#include <algorithm>
+#include <sys/resource.h>
 #include <unistd.h>
 
 #include <cppunit/extensions/HelperMacros.h>
 
 #include <Poco/Delegate.h>
+#include <Poco/Logger.h>
+#include <Poco/Mutex.h>
 #include <Poco/Random.h>
 
 #include "core/BasicDistributor.h"
+#include "core/Exporter.h"
 #include "loop/LoopRunner.h"
 #include "util/ZMQUtil.h"
 #include "zmq/ZMQBroker.h"
@@ -20,6 +25,12 @@ class ZMQBrokerTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(testListenCommandOneClient);
 	CPPUNIT_TEST(testListenCommandTwoClients);
 	CPPUNIT_TEST(testUnpairCommand);
+	CPPUNIT_TEST(testReactorListenCommand);
+	CPPUNIT_TEST(testBatchedMeasuredValues);
+	CPPUNIT_TEST(testSetValueTimeouts);
+	CPPUNIT_TEST(testShardedMeasuredValues);
+	CPPUNIT_TEST(testHeartbeatLiveness);
+	CPPUNIT_TEST(testCreditFlowControl);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -27,14 +38,34 @@ public:
 	void testListenCommandOneClient();
 	void testListenCommandTwoClients();
 	void testUnpairCommand();
+	void testReactorListenCommand();
+	void testBatchedMeasuredValues();
+	void testSetValueTimeouts();
+	void testShardedMeasuredValues();
+	void testHeartbeatLiveness();
+	void testCreditFlowControl();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(ZMQBrokerTest);
 
+class ZMQBrokerBenchmark : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ZMQBrokerBenchmark);
+	CPPUNIT_TEST(benchmarkLoopLatency);
+	CPPUNIT_TEST(benchmarkShardedThroughput);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void benchmarkLoopLatency();
+	void benchmarkShardedThroughput();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(ZMQBrokerBenchmark, "benchmark");
+
 class FakeClient : public ZMQClient {
 public:
 	FakeClient():
-		ZMQClient()
+		ZMQClient(),
+		m_ignoreSetValue(false)
 	{
 		onReceive += Poco::delegate(this, &FakeClient::handleMessage);
 	}
@@ -44,6 +75,10 @@ public:
 		m_zmqMessage = zmqMessage;
 		m_event.set();
 
+		if (m_ignoreSetValue
+				&& zmqMessage.type() == ZMQMessageType::TYPE_SET_VALUES_CMD)
+			return;
+
 		switch (zmqMessage.type().raw()){
 		case ZMQMessageType::TYPE_LISTEN_CMD:
 		case ZMQMessageType::TYPE_DEVICE_UNPAIR_CMD:
@@ -70,21 +105,55 @@ public:
 		msg = m_zmqMessage;
 		return wait;
 	}
+
+	/*
+	 * Do not answer to set value commands to make them time out.
+	 */
+	void setIgnoreSetValue(bool ignore)
+	{
+		m_ignoreSetValue = ignore;
+	}
+
 private:
 	Poco::Event m_event;
 	ZMQMessage m_zmqMessage;
+	bool m_ignoreSetValue;
 };
 
 class FakeBroker : public ZMQBroker {
 public:
 	FakeBroker():
 		ZMQBroker(),
-		m_clients(INT_MAX)
+		m_clients(INT_MAX),
+		m_brokerLoop(false)
 	{
 	}
 
+	/*
+	 * Use the main loop of the ZMQBroker instead of the testing one.
+	 */
+	void useBrokerLoop(bool reactor, int workers = 0)
+	{
+		m_brokerLoop = true;
+		setReactor(reactor);
+		setWorkers(workers);
+	}
+
 	virtual ~FakeBroker(){}
 
+	/*
+	 * Number of commands waiting for a result of a device manager.
+	 */
+	size_t pendingCommands() const
+	{
+		return m_cmdTable.size();
+	}
+
+	std::vector<DeviceManagerID> deviceManagers() const
+	{
+		return m_deviceManagersTable.getAll();
+	}
+
 	/*
 	 * Posle danu spravu vsetkym klientom po tom co sa dosiahne
 	 * zadany pocet klientov.
@@ -98,6 +167,11 @@ public:
 
 	void run() override
 	{
+		if (m_brokerLoop) {
+			ZMQBroker::run();
+			return;
+		}
+
 		configureDataSockets();
 		configureHelloSockets();
 
@@ -123,6 +197,61 @@ public:
 private:
 	ZMQMessage m_zmqMessage;
 	unsigned long m_clients;
+	bool m_brokerLoop;
+};
+
+/*
+ * Counts the exported SensorData and the batches they came in.
+ */
+class BatchCountingExporter : public Exporter {
+public:
+	BatchCountingExporter():
+		m_items(0),
+		m_calls(0),
+		m_maxBatch(0)
+	{
+	}
+
+	bool ship(const SensorData &) override
+	{
+		Poco::FastMutex::ScopedLock guard(m_lock);
+		m_items += 1;
+		m_calls += 1;
+		return true;
+	}
+
+	bool shipBatch(const std::vector<SensorData> &batch) override
+	{
+		Poco::FastMutex::ScopedLock guard(m_lock);
+		m_items += batch.size();
+		m_calls += 1;
+		m_maxBatch = std::max(m_maxBatch, batch.size());
+		return true;
+	}
+
+	size_t items()
+	{
+		Poco::FastMutex::ScopedLock guard(m_lock);
+		return m_items;
+	}
+
+	size_t calls()
+	{
+		Poco::FastMutex::ScopedLock guard(m_lock);
+		return m_calls;
+	}
+
+	size_t maxBatch()
+	{
+		Poco::FastMutex::ScopedLock guard(m_lock);
+		return m_maxBatch;
+	}
+
+private:
+	Poco::FastMutex m_lock;
+	size_t m_items;
+	size_t m_calls;
+	size_t m_maxBatch;
 };
 
 class InitComponents {
@@ -171,6 +300,11 @@ public:
 		return client;
 	}
 
+	void addExporter(Poco::SharedPtr<Exporter> exporter)
+	{
+		m_distributor.cast<BasicDistributor>()->registerExporter(exporter);
+	}
+
 	Poco::SharedPtr<CommandDispatcher> commandDispatcher()
 	{
 		return m_commandDispatcher;
@@ -186,6 +320,16 @@ public:
 		m_runner.stop();
 	}
 
+	int helloPort() const
+	{
+		return m_helloPort;
+	}
+
+	int dataPort() const
+	{
+		return m_dataPort;
+	}
+
 private:
 	LoopRunner m_runner;
 	Poco::SharedPtr<FakeBroker> m_broker;
@@ -387,4 +531,689 @@ void ZMQBrokerTest::testUnpairCommand()
 	sleep(1);
 }
 
+/*
+ * The reactor loop must deliver commands to device managers and
+ * results back to the CommandDispatcher same as the polling loop.
+ */
+void ZMQBrokerTest::testReactorListenCommand()
+{
+	AnswerQueue queue;
+	Answer::Ptr answer = new Answer(queue);
+	InitComponents init;
+	std::list<Answer::Ptr> dirtyList;
+
+	Poco::SharedPtr<FakeBroker> broker = init.addServer();
+	broker->useBrokerLoop(true);
+	Poco::SharedPtr<FakeClient> client1 = init.addClient(DevicePrefix::parse("Z-Wave"));
+	CommandDispatcher *commandDispatcher = init.commandDispatcher();
+
+	init.start();
+
+	// cakanie maximalne 2s pokial sa nastavia ID
+	for (int i = 0; i < 200; i++) {
+		if (broker->deviceManagersCount() == 1)
+			break;
+
+		usleep(10000);
+	}
+	usleep(100000);
+	CPPUNIT_ASSERT(1 == broker->deviceManagersCount());
+
+	GatewayListenCommand::Ptr cmd =
+		new GatewayListenCommand(60*Poco::Timespan::SECONDS);
+
+	commandDispatcher->dispatch(cmd, answer);
+
+	ZMQMessage receiveMessage;
+	CPPUNIT_ASSERT(client1->waitOnMessage(600000, receiveMessage));
+	CPPUNIT_ASSERT(receiveMessage.type() == ZMQMessageType::TYPE_LISTEN_CMD);
+
+	CPPUNIT_ASSERT(queue.wait(1000000, dirtyList));
+	CPPUNIT_ASSERT(1 == dirtyList.size());
+	CPPUNIT_ASSERT(answer->at(0)->status() == Result::SUCCESS);
+
+	init.stop();
+	sleep(1);
+}
+
+/*
+ * Measured values sent by a batching client arrive to the exporter
+ * in batches not larger than the configured size and none of them
+ * is lost.
+ */
+void ZMQBrokerTest::testBatchedMeasuredValues()
+{
+	const size_t count = 25;
+	InitComponents init;
+	Poco::SharedPtr<BatchCountingExporter> exporter(new BatchCountingExporter);
+
+	init.addExporter(exporter);
+	Poco::SharedPtr<FakeBroker> broker = init.addServer();
+	Poco::SharedPtr<FakeClient> client = init.addClient(DevicePrefix::parse("Z-Wave"));
+	client->setBatchSize(10);
+	client->setBatchDelay(100 * Poco::Timespan::MILLISECONDS);
+
+	init.start();
+
+	for (int i = 0; i < 200; i++) {
+		if (!client->deviceManagerID().isNull())
+			break;
+
+		usleep(10000);
+	}
+	usleep(100000);
+	CPPUNIT_ASSERT(!client->deviceManagerID().isNull());
+
+	for (size_t i = 0; i < count; ++i) {
+		SensorData sensorData;
+		sensorData.setDeviceID(DeviceID(0xa801020304050600 + i));
+		sensorData.insertValue(SensorValue(ModuleID(0), i));
+
+		CPPUNIT_ASSERT(client->send(sensorData));
+	}
+
+	for (int i = 0; i < 200; i++) {
+		if (exporter->items() == count)
+			break;
+
+		usleep(10000);
+	}
+
+	CPPUNIT_ASSERT_EQUAL(count, exporter->items());
+	CPPUNIT_ASSERT(exporter->maxBatch() <= 10);
+	CPPUNIT_ASSERT(exporter->calls() < count);
+
+	init.stop();
+	sleep(1);
+}
+
+/*
+ * Check extended status of the only result of the given Answer.
+ */
+static bool hasSetStatus(Answer::Ptr answer,
+		Result::Status status, DeviceSetValueResult::SetStatus setStatus)
+{
+	if (answer->resultsCount() != 1)
+		return false;
+
+	Result::Ptr result = answer->at(0);
+	if (!result->is<DeviceSetValueResult>())
+		return false;
+
+	return result->status() == status
+		&& result->cast<DeviceSetValueResult>().extendetSetStatus() == setStatus;
+}
+
+/*
+ * Dispatch 10k DeviceSetValueCommands at once, half of them to
+ * a device manager that answers, half of them to a device manager
+ * that does not. The answered ones must succeed and must not time
+ * out later, the others must time out shortly after their deadline.
+ * Finally, the broker must forget all the commands.
+ */
+void ZMQBrokerTest::testSetValueTimeouts()
+{
+	const unsigned int count = 10000;
+	const Poco::Timespan timeout = 300 * Poco::Timespan::MILLISECONDS;
+	AnswerQueue queue;
+	InitComponents init;
+	std::list<Answer::Ptr> dirtyList;
+
+	Poco::SharedPtr<FakeBroker> broker = init.addServer();
+	broker->useBrokerLoop(true);
+	broker->setRequestTTL(1000);
+	init.addClient(DevicePrefix::parse("Z-Wave"));
+	Poco::SharedPtr<FakeClient> silent = init.addClient(DevicePrefix::parse("Jablotron"));
+	silent->setIgnoreSetValue(true);
+	CommandDispatcher *commandDispatcher = init.commandDispatcher();
+
+	init.start();
+
+	for (int i = 0; i < 200; i++) {
+		if (broker->deviceManagersCount() == 2)
+			break;
+
+		usleep(10000);
+	}
+	usleep(100000);
+	CPPUNIT_ASSERT(2 == broker->deviceManagersCount());
+
+	std::vector<Answer::Ptr> answered;
+	std::vector<Answer::Ptr> ignored;
+	Poco::Timestamp start;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		const DevicePrefix prefix = DevicePrefix::fromRaw(i % 2 == 0 ?
+			DevicePrefix::PREFIX_ZWAVE : DevicePrefix::PREFIX_JABLOTRON);
+		Answer::Ptr answer = new Answer(queue);
+
+		commandDispatcher->dispatch(new DeviceSetValueCommand(
+			DeviceID(prefix, i), ModuleID(0), i, timeout), answer);
+
+		if (i % 2 == 0)
+			answered.push_back(answer);
+		else
+			ignored.push_back(answer);
+	}
+
+	const Poco::Timestamp deadline = Poco::Timestamp() + timeout.totalMicroseconds();
+	unsigned int pending = count;
+
+	for (int i = 0; i < 500 && pending > 0; ++i) {
+		queue.wait(10 * Poco::Timespan::MILLISECONDS, dirtyList);
+
+		pending = 0;
+		for (auto &answer : answered)
+			pending += answer->isPending() ? 1 : 0;
+		for (auto &answer : ignored)
+			pending += answer->isPending() ? 1 : 0;
+	}
+
+	const Poco::Timestamp finished;
+	CPPUNIT_ASSERT_EQUAL(0U, pending);
+
+	// the answered commands are not affected by their deadlines
+	while (Poco::Timestamp() - deadline < timeout.totalMicroseconds())
+		usleep(10000);
+
+	for (auto &answer : answered) {
+		CPPUNIT_ASSERT(hasSetStatus(answer,
+			Result::SUCCESS, DeviceSetValueResult::GW_DEVICE_SUCCESS));
+	}
+
+	for (auto &answer : ignored) {
+		CPPUNIT_ASSERT(hasSetStatus(answer,
+			Result::FAILED, DeviceSetValueResult::GW_DEVICE_TIMEOUT));
+	}
+
+	Poco::Logger::get("ZMQBrokerTest").information(
+		std::to_string(count) + " set value commands processed in "
+		+ std::to_string((finished - start) / 1000) + " ms, last timeout "
+		+ std::to_string((finished - deadline) / 1000)
+		+ " ms after the deadline");
+
+	// timeouts come after the deadlines of the first commands
+	CPPUNIT_ASSERT(finished - start >= timeout.totalMicroseconds());
+	// and not much later than the last deadline
+	CPPUNIT_ASSERT(finished - deadline < Poco::Timespan::SECONDS);
+
+	// the commands without result are forgotten after the request TTL
+	for (int i = 0; i < 300 && broker->pendingCommands() > 0; ++i)
+		usleep(10000);
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 0, broker->pendingCommands());
+
+	for (auto &answer : answered)
+		queue.remove(answer);
+	for (auto &answer : ignored)
+		queue.remove(answer);
+
+	init.stop();
+	sleep(1);
+}
+
+/*
+ * Wait until the given number of clients is registered.
+ */
+static void waitForClients(Poco::SharedPtr<FakeBroker> broker, unsigned long count)
+{
+	for (int i = 0; i < 200; i++) {
+		if (broker->deviceManagersCount() == count)
+			break;
+
+		usleep(10000);
+	}
+	usleep(100000);
+
+	CPPUNIT_ASSERT_EQUAL(count, broker->deviceManagersCount());
+}
+
+/*
+ * Measured values of several device managers are exported by
+ * the workers of the sharded broker, other messages (results of
+ * commands) are still processed by the broker thread.
+ */
+void ZMQBrokerTest::testShardedMeasuredValues()
+{
+	const size_t count = 100;
+	AnswerQueue queue;
+	Answer::Ptr answer = new Answer(queue);
+	InitComponents init;
+	std::list<Answer::Ptr> dirtyList;
+	Poco::SharedPtr<BatchCountingExporter> exporter(new BatchCountingExporter);
+
+	init.addExporter(exporter);
+	Poco::SharedPtr<FakeBroker> broker = init.addServer();
+	broker->useBrokerLoop(true, 2);
+
+	std::vector<Poco::SharedPtr<FakeClient>> clients = {
+		init.addClient(DevicePrefix::parse("Z-Wave")),
+		init.addClient(DevicePrefix::parse("Z-Wave")),
+		init.addClient(DevicePrefix::parse("Jablotron")),
+	};
+
+	init.start();
+	waitForClients(broker, clients.size());
+
+	for (size_t i = 0; i < count; ++i) {
+		for (auto &client : clients) {
+			SensorData sensorData;
+			sensorData.setDeviceID(DeviceID(0xa801020304050600 + i));
+			sensorData.insertValue(SensorValue(ModuleID(0), i));
+
+			client->send(sensorData);
+		}
+	}
+
+	init.commandDispatcher()->dispatch(
+		new GatewayListenCommand(60 * Poco::Timespan::SECONDS), answer);
+
+	for (int i = 0; i < 200; i++) {
+		if (exporter->items() == count * clients.size() && !answer->isPending())
+			break;
+
+		queue.wait(10000, dirtyList);
+	}
+
+	CPPUNIT_ASSERT_EQUAL(count * clients.size(), exporter->items());
+	CPPUNIT_ASSERT_EQUAL(clients.size(), answer->resultsCount());
+
+	for (unsigned long i = 0; i < answer->resultsCount(); ++i)
+		CPPUNIT_ASSERT(answer->at(i)->status() == Result::SUCCESS);
+
+	init.stop();
+	sleep(1);
+}
+
+/*
+ * Wait until the broker has the given number of device managers.
+ */
+static bool waitForCount(Poco::SharedPtr<FakeBroker> broker, unsigned long count)
+{
+	for (int i = 0; i < 300; i++) {
+		if (broker->deviceManagersCount() == count)
+			return true;
+
+		usleep(10000);
+	}
+
+	return false;
+}
+
+/*
+ * Register a device manager via the given REQ socket and return
+ * the hello_response.
+ */
+static ZMQMessage helloRequest(Poco::SharedPtr<zmq::socket_t> socket,
+		const ZMQMessage &request)
+{
+	std::string response;
+
+	ZMQUtil::send(socket, request.toString());
+
+	for (int i = 0; i < 300; i++) {
+		if (ZMQUtil::receive(socket, response))
+			break;
+
+		usleep(10000);
+	}
+
+	CPPUNIT_ASSERT(!response.empty());
+	return ZMQMessage::fromJSON(response);
+}
+
+/*
+ * A device manager that stops sending heartbeats is unregistered,
+ * while the one sending them stays registered. The unregistered
+ * device manager gets its previous ID again when it sends any message
+ * or when it asks for it during registration.
+ */
+void ZMQBrokerTest::testHeartbeatLiveness()
+{
+	InitComponents init;
+	Poco::SharedPtr<FakeBroker> broker = init.addServer();
+	broker->useBrokerLoop(true);
+	broker->setHeartbeatInterval(100);
+	broker->setHeartbeatLiveness(3);
+
+	Poco::SharedPtr<FakeClient> alive = init.addClient(DevicePrefix::parse("Z-Wave"));
+
+	init.start();
+	waitForClients(broker, 1);
+
+	const DeviceManagerID aliveID = alive->deviceManagerID().value();
+
+	const int linger = 0;
+	zmq::context_t context;
+	Poco::SharedPtr<zmq::socket_t> hello = new zmq::socket_t(context, ZMQ_REQ);
+	hello->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+	hello->connect("tcp://127.0.0.1:" + std::to_string(init.helloPort()));
+
+	// register a device manager that never sends anything
+	ZMQMessage response = helloRequest(hello,
+		ZMQMessage::fromHelloRequest(DevicePrefix::parse("Jablotron")));
+
+	CPPUNIT_ASSERT(response.type() == ZMQMessageType::TYPE_HELLO_RESPONSE);
+	CPPUNIT_ASSERT_EQUAL(100 * Poco::Timespan::MILLISECONDS,
+		response.heartbeatInterval().totalMicroseconds());
+
+	const DeviceManagerID deadID = response.toHelloResponse();
+	CPPUNIT_ASSERT(2 == broker->deviceManagersCount());
+
+	CPPUNIT_ASSERT(waitForCount(broker, 1));
+	CPPUNIT_ASSERT(broker->deviceManagers()[0] == aliveID);
+
+	// any message of the unregistered device manager brings it back
+	{
+		Poco::SharedPtr<zmq::socket_t> data = new zmq::socket_t(context, ZMQ_DEALER);
+		const std::string identity = deadID.toString();
+
+		data->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+		data->setsockopt(ZMQ_IDENTITY, identity.c_str(), identity.size());
+		data->connect("tcp://127.0.0.1:" + std::to_string(init.dataPort()));
+
+		ZMQUtil::send(data, ZMQMessage::fromHeartbeat().toString());
+
+		CPPUNIT_ASSERT(waitForCount(broker, 2));
+	}
+
+	CPPUNIT_ASSERT(waitForCount(broker, 1));
+
+	// the previous ID is assigned again on request
+	ZMQMessage resume = ZMQMessage::fromHelloRequest(DevicePrefix::parse("Jablotron"));
+	resume.setResumeID(deadID);
+
+	response = helloRequest(hello, resume);
+	CPPUNIT_ASSERT(response.toHelloResponse() == deadID);
+	CPPUNIT_ASSERT(2 == broker->deviceManagersCount());
+
+	init.stop();
+	sleep(1);
+}
+
+static bool waitForItems(Poco::SharedPtr<BatchCountingExporter> exporter,
+		size_t count)
+{
+	for (int i = 0; i < 300; i++) {
+		if (exporter->items() >= count)
+			return true;
+
+		usleep(10000);
+	}
+
+	return false;
+}
+
+/*
+ * The client waits for credits and buffers the measured values
+ * meanwhile, nothing is lost. A device manager that ignores
+ * the credits has its excessive messages dropped by the broker.
+ */
+void ZMQBrokerTest::testCreditFlowControl()
+{
+	const size_t count = 200;
+	const unsigned int window = 4;
+	InitComponents init;
+	Poco::SharedPtr<BatchCountingExporter> exporter(new BatchCountingExporter);
+
+	init.addExporter(exporter);
+	Poco::SharedPtr<FakeBroker> broker = init.addServer();
+	broker->useBrokerLoop(true);
+	broker->setCreditWindow(window);
+
+	Poco::SharedPtr<FakeClient> client = init.addClient(DevicePrefix::parse("Z-Wave"));
+
+	init.start();
+	waitForClients(broker, 1);
+	CPPUNIT_ASSERT_EQUAL((int) window, client->credits());
+
+	for (size_t i = 0; i < count; ++i) {
+		SensorData sensorData;
+		sensorData.setDeviceID(DeviceID(0xa801020304050600 + i));
+		sensorData.insertValue(SensorValue(ModuleID(0), i));
+
+		client->send(sensorData);
+	}
+
+	CPPUNIT_ASSERT(waitForItems(exporter, count));
+	CPPUNIT_ASSERT_EQUAL(count, exporter->items());
+	CPPUNIT_ASSERT(client->throttled() > 0);
+	CPPUNIT_ASSERT_EQUAL(0UL, client->dropped());
+	CPPUNIT_ASSERT_EQUAL(0UL, broker->framesDropped());
+	CPPUNIT_ASSERT(broker->creditsGranted() >= count - window);
+
+	// a device manager flooding the broker regardless of the credits
+	const int linger = 0;
+	zmq::context_t context;
+	Poco::SharedPtr<zmq::socket_t> hello = new zmq::socket_t(context, ZMQ_REQ);
+	hello->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+	hello->connect("tcp://127.0.0.1:" + std::to_string(init.helloPort()));
+
+	ZMQMessage response = helloRequest(hello,
+		ZMQMessage::fromHelloRequest(DevicePrefix::parse("Jablotron")));
+	CPPUNIT_ASSERT_EQUAL(window, response.creditWindow());
+
+	const std::string identity = response.toHelloResponse().toString();
+	Poco::SharedPtr<zmq::socket_t> data = new zmq::socket_t(context, ZMQ_DEALER);
+	data->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+	data->setsockopt(ZMQ_IDENTITY, identity.c_str(), identity.size());
+	data->connect("tcp://127.0.0.1:" + std::to_string(init.dataPort()));
+
+	SensorData flood;
+	flood.setDeviceID(DeviceID(0xa801020304050700));
+	flood.insertValue(SensorValue(ModuleID(0), 1.0));
+	const std::string message = ZMQMessage::fromSensorData(flood).toString();
+
+	for (size_t i = 0; i < 10 * count; ++i)
+		ZMQUtil::send(data, message);
+
+	for (int i = 0; i < 300; i++) {
+		if (exporter->items() - count + broker->framesDropped() == 10 * count)
+			break;
+
+		usleep(10000);
+	}
+
+	CPPUNIT_ASSERT(broker->framesDropped() > 0);
+	CPPUNIT_ASSERT_EQUAL(10 * count, exporter->items() - count + broker->framesDropped());
+
+	// the well-behaved client is not affected
+	for (size_t i = 0; i < count; ++i) {
+		SensorData sensorData;
+		sensorData.setDeviceID(DeviceID(0xa801020304050600 + i));
+		sensorData.insertValue(SensorValue(ModuleID(0), i));
+
+		client->send(sensorData);
+	}
+
+	const size_t exported = 11 * count - broker->framesDropped();
+	CPPUNIT_ASSERT(waitForItems(exporter, exported + count));
+	CPPUNIT_ASSERT_EQUAL(0UL, client->dropped());
+
+	init.stop();
+	sleep(1);
+}
+
+struct LoopStats {
+	unsigned int roundTrips;
+	Poco::Timestamp::TimeDiff latency;
+	Poco::Timestamp::TimeDiff idleCpu;
+};
+
+static Poco::Timestamp::TimeDiff cpuTime()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000L
+		+ usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/*
+ * Sends the given number of GatewayListenCommands one by one via
+ * the broker and measures the average time until the result is
+ * delivered. Then it measures CPU time consumed while idle.
+ */
+static LoopStats measureLoop(bool reactor, unsigned int count)
+{
+	LoopStats stats = {0, 0, 0};
+	AnswerQueue queue;
+	InitComponents init;
+	std::list<Answer::Ptr> dirtyList;
+
+	Poco::SharedPtr<FakeBroker> broker = init.addServer();
+	broker->useBrokerLoop(reactor);
+	init.addClient(DevicePrefix::parse("Z-Wave"));
+	CommandDispatcher *commandDispatcher = init.commandDispatcher();
+
+	init.start();
+
+	for (int i = 0; i < 200; i++) {
+		if (broker->deviceManagersCount() == 1)
+			break;
+
+		usleep(10000);
+	}
+	usleep(100000);
+
+	Poco::Timestamp::TimeDiff total = 0;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		Answer::Ptr answer = new Answer(queue);
+		Poco::Timestamp start;
+
+		commandDispatcher->dispatch(
+			new GatewayListenCommand(Poco::Timespan::SECONDS), answer);
+
+		for (int attempt = 0; attempt < 10 && answer->isPending(); ++attempt)
+			queue.wait(100000, dirtyList);
+
+		if (answer->isPending())
+			break;
+
+		total += start.elapsed();
+		stats.roundTrips++;
+		queue.remove(answer);
+	}
+
+	if (stats.roundTrips > 0)
+		stats.latency = total / stats.roundTrips;
+
+	Poco::Timestamp::TimeDiff cpu = cpuTime();
+	usleep(500000);
+	stats.idleCpu = cpuTime() - cpu;
+
+	init.stop();
+	sleep(1);
+
+	return stats;
+}
+
+/*
+ * Compares the polling and the reactor loop of the ZMQBroker. The
+ * average command round-trip latency and the CPU time consumed by
+ * the idle gateway (broker and one client) within 500 ms is reported.
+ */
+void ZMQBrokerBenchmark::benchmarkLoopLatency()
+{
+	const unsigned int count = 100;
+
+	LoopStats polling = measureLoop(false, count);
+	LoopStats reactor = measureLoop(true, count);
+
+	Poco::Logger &logger = Poco::Logger::get("ZMQBrokerTest");
+	logger.information("polling loop: latency "
+		+ std::to_string(polling.latency) + " us, idle CPU "
+		+ std::to_string(polling.idleCpu) + " us");
+	logger.information("reactor loop: latency "
+		+ std::to_string(reactor.latency) + " us, idle CPU "
+		+ std::to_string(reactor.idleCpu) + " us");
+
+	CPPUNIT_ASSERT_EQUAL(count, polling.roundTrips);
+	CPPUNIT_ASSERT_EQUAL(count, reactor.roundTrips);
+}
+
+/*
+ * Device managers flooding the broker with measured values as fast
+ * as possible. Returns the number of exported values per second.
+ */
+static unsigned long measureThroughput(unsigned int workers,
+		unsigned int clientCount, unsigned int count)
+{
+	InitComponents init;
+	Poco::SharedPtr<BatchCountingExporter> exporter(new BatchCountingExporter);
+
+	init.addExporter(exporter);
+	Poco::SharedPtr<FakeBroker> broker = init.addServer();
+	broker->useBrokerLoop(true, workers);
+
+	std::vector<Poco::SharedPtr<FakeClient>> clients;
+	for (unsigned int i = 0; i < clientCount; ++i) {
+		clients.push_back(init.addClient(DevicePrefix::parse("Z-Wave")));
+		// the outbox is bounded, all messages are queued at once
+		clients.back()->setCreditBuffer(count);
+	}
+
+	init.start();
+	waitForClients(broker, clientCount);
+
+	// prepare the messages to measure the broker only
+	std::vector<std::string> messages;
+	for (unsigned int i = 0; i < clientCount; ++i) {
+		SensorData sensorData;
+		sensorData.setDeviceID(DeviceID(0xa801020304050600 + i));
+
+		for (unsigned int module = 0; module < 8; ++module)
+			sensorData.insertValue(SensorValue(ModuleID(module), 20.5 + module));
+
+		messages.push_back(ZMQMessage::fromSensorData(sensorData).toString());
+	}
+
+	Poco::Timestamp start;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		for (unsigned int c = 0; c < clientCount; ++c)
+			clients[c]->send(messages[c]);
+	}
+
+	const size_t total = count * clientCount;
+
+	for (int i = 0; i < 3000 && exporter->items() < total; ++i)
+		usleep(10000);
+
+	const Poco::Timestamp::TimeDiff elapsed = start.elapsed();
+	const size_t exported = exporter->items();
+
+	init.stop();
+	sleep(1);
+
+	CPPUNIT_ASSERT_EQUAL(total, exported);
+
+	return elapsed > 0 ? exported * 1000000ULL / elapsed : 0;
+}
+
+/*
+ * Throughput of measured values sent by 8 device managers to
+ * the broker without workers and with 1, 2 and 4 workers.
+ */
+void ZMQBrokerBenchmark::benchmarkShardedThroughput()
+{
+	const unsigned int clients = 8;
+	const unsigned int count = 5000;
+	const unsigned int workers[] = {0, 1, 2, 4};
+
+	Poco::Logger &logger = Poco::Logger::get("ZMQBrokerTest");
+
+	for (auto n : workers) {
+		const unsigned long throughput = measureThroughput(n, clients, count);
+
+		logger.information(std::to_string(n) + " workers: "
+			+ std::to_string(clients * count) + " values from "
+			+ std::to_string(clients) + " device managers, "
+			+ std::to_string(throughput) + " values/s");
+
+		CPPUNIT_ASSERT(throughput > 0);
+	}
+}
+
 }
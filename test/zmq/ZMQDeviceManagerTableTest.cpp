@@ -1,5 +1,11 @@
+#include <vector>
+
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <Poco/AtomicCounter.h>
+#include <Poco/Exception.h>
+#include <Poco/Thread.h>
+
 #include "zmq/ZMQDeviceManagerTable.h"
 
 using namespace std;
@@ -9,10 +15,20 @@ namespace BeeeOn {
 class ZMQDeviceManagerTableTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(ZMQDeviceManagerTableTest);
 	CPPUNIT_TEST(testRegisterDaemonID);
+	CPPUNIT_TEST(testIdentAllocation);
+	CPPUNIT_TEST(testResumeID);
+	CPPUNIT_TEST(testPrefixRange);
+	CPPUNIT_TEST(testSnapshotIsolation);
+	CPPUNIT_TEST(testConcurrentReaders);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void testRegisterDaemonID();
+	void testIdentAllocation();
+	void testResumeID();
+	void testPrefixRange();
+	void testSnapshotIsolation();
+	void testConcurrentReaders();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(ZMQDeviceManagerTableTest);
@@ -45,4 +61,207 @@ void ZMQDeviceManagerTableTest::testRegisterDaemonID()
 	CPPUNIT_ASSERT(deviceManagerTable.count() == 1);
 }
 
+/*
+ * All 256 idents can be allocated, the released idents are reused
+ * starting from the lowest one.
+ */
+void ZMQDeviceManagerTableTest::testIdentAllocation()
+{
+	ZMQDeviceManagerTable table;
+	const DevicePrefix zwave = DevicePrefix::fromRaw(DevicePrefix::PREFIX_ZWAVE);
+	vector<DeviceManagerID> ids;
+
+	for (unsigned int i = 0; i < 256; ++i) {
+		ids.push_back(table.registerDaemonPrefix(zwave));
+		CPPUNIT_ASSERT(ids.back().ident() == i);
+	}
+
+	CPPUNIT_ASSERT_THROW(table.registerDaemonPrefix(zwave),
+		Poco::RangeException);
+	CPPUNIT_ASSERT(table.count() == 256);
+
+	table.unregisterDaemon(ids[200]);
+	table.unregisterDaemon(ids[70]);
+	CPPUNIT_ASSERT_THROW(table.unregisterDaemon(ids[70]),
+		Poco::InvalidArgumentException);
+
+	CPPUNIT_ASSERT(table.registerDaemonPrefix(zwave).ident() == 70);
+	CPPUNIT_ASSERT(table.registerDaemonPrefix(zwave).ident() == 200);
+	CPPUNIT_ASSERT_THROW(table.registerDaemonPrefix(zwave),
+		Poco::RangeException);
+}
+
+/*
+ * A previous ID can be registered again unless its ident is used
+ * by another device manager.
+ */
+void ZMQDeviceManagerTableTest::testResumeID()
+{
+	ZMQDeviceManagerTable table;
+	const DevicePrefix zwave = DevicePrefix::fromRaw(DevicePrefix::PREFIX_ZWAVE);
+	const DevicePrefix jablotron = DevicePrefix::fromRaw(DevicePrefix::PREFIX_JABLOTRON);
+
+	const DeviceManagerID first = table.registerDaemonPrefix(zwave);
+	const DeviceManagerID second = table.registerDaemonPrefix(zwave);
+
+	CPPUNIT_ASSERT(table.registerDaemonID(first));
+	CPPUNIT_ASSERT(table.count() == 2);
+
+	table.unregisterDaemon(first);
+	CPPUNIT_ASSERT(table.registerDaemonID(first));
+	CPPUNIT_ASSERT(table.count() == 2);
+
+	// ident of the second one is used by the Jablotron now
+	table.unregisterDaemon(second);
+	CPPUNIT_ASSERT(table.registerDaemonPrefix(jablotron).ident() == second.ident());
+	CPPUNIT_ASSERT(!table.registerDaemonID(second));
+
+	const DeviceManagerID resumed(zwave, 100);
+	CPPUNIT_ASSERT(table.registerDaemonID(resumed));
+	CPPUNIT_ASSERT(table.registerDaemonPrefix(zwave).ident() == 2);
+	CPPUNIT_ASSERT(table.count() == 4);
+}
+
+/*
+ * Device managers are grouped by their prefixes.
+ */
+void ZMQDeviceManagerTableTest::testPrefixRange()
+{
+	ZMQDeviceManagerTable table;
+	const DevicePrefix zwave = DevicePrefix::fromRaw(DevicePrefix::PREFIX_ZWAVE);
+	const DevicePrefix jablotron = DevicePrefix::fromRaw(DevicePrefix::PREFIX_JABLOTRON);
+	const DevicePrefix fitp = DevicePrefix::fromRaw(DevicePrefix::PREFIX_FITPROTOCOL);
+
+	table.registerDaemonPrefix(zwave);
+	table.registerDaemonPrefix(jablotron);
+	table.registerDaemonPrefix(zwave);
+	table.registerDaemonPrefix(jablotron);
+	table.registerDaemonPrefix(zwave);
+
+	CPPUNIT_ASSERT(table.isDeviceManagerRegistered(zwave));
+	CPPUNIT_ASSERT(table.isDeviceManagerRegistered(jablotron));
+	CPPUNIT_ASSERT(!table.isDeviceManagerRegistered(fitp));
+
+	ZMQDeviceManagerTable::Snapshot::Ptr snapshot = table.snapshot();
+	CPPUNIT_ASSERT(snapshot->all().size() == 5);
+	CPPUNIT_ASSERT(snapshot->byPrefix(zwave).size() == 3);
+	CPPUNIT_ASSERT(snapshot->byPrefix(jablotron).size() == 2);
+	CPPUNIT_ASSERT(snapshot->byPrefix(fitp).empty());
+
+	for (auto &id : snapshot->byPrefix(zwave))
+		CPPUNIT_ASSERT(id.prefix() == DevicePrefix::PREFIX_ZWAVE);
+
+	for (auto &id : snapshot->byPrefix(jablotron))
+		CPPUNIT_ASSERT(id.prefix() == DevicePrefix::PREFIX_JABLOTRON);
+
+	const vector<DeviceManagerID> zwaves = table.getAll(zwave);
+	CPPUNIT_ASSERT(zwaves.size() == 3);
+	CPPUNIT_ASSERT(zwaves[0].ident() == 0);
+	CPPUNIT_ASSERT(zwaves[1].ident() == 2);
+	CPPUNIT_ASSERT(zwaves[2].ident() == 4);
+}
+
+/*
+ * A snapshot is not affected by the following changes of the table.
+ */
+void ZMQDeviceManagerTableTest::testSnapshotIsolation()
+{
+	ZMQDeviceManagerTable table;
+	const DevicePrefix zwave = DevicePrefix::fromRaw(DevicePrefix::PREFIX_ZWAVE);
+
+	const DeviceManagerID first = table.registerDaemonPrefix(zwave);
+	ZMQDeviceManagerTable::Snapshot::Ptr snapshot = table.snapshot();
+
+	table.registerDaemonPrefix(zwave);
+	table.unregisterDaemon(first);
+
+	CPPUNIT_ASSERT(snapshot->all().size() == 1);
+	CPPUNIT_ASSERT(snapshot->all()[0] == first);
+
+	CPPUNIT_ASSERT(table.count() == 1);
+	CPPUNIT_ASSERT(table.getAll()[0] != first);
+}
+
+/*
+ * Readers iterate over snapshots while the table is modified.
+ * Every snapshot must be consistent (sorted, single prefix per range).
+ */
+void ZMQDeviceManagerTableTest::testConcurrentReaders()
+{
+	class Reader : public Poco::Runnable {
+	public:
+		Reader(ZMQDeviceManagerTable &table, Poco::AtomicCounter &stop):
+			m_table(table),
+			m_stop(stop),
+			m_failed(false)
+		{
+		}
+
+		void run() override
+		{
+			const DevicePrefix zwave =
+				DevicePrefix::fromRaw(DevicePrefix::PREFIX_ZWAVE);
+
+			while (!m_stop) {
+				ZMQDeviceManagerTable::Snapshot::Ptr snapshot = m_table.snapshot();
+				const vector<DeviceManagerID> &all = snapshot->all();
+
+				for (size_t i = 1; i < all.size(); ++i) {
+					if (!(all[i - 1] < all[i]))
+						m_failed = true;
+				}
+
+				for (auto &id : snapshot->byPrefix(zwave)) {
+					if (id.prefix() != DevicePrefix::PREFIX_ZWAVE)
+						m_failed = true;
+				}
+			}
+		}
+
+		bool failed() const
+		{
+			return m_failed;
+		}
+
+	private:
+		ZMQDeviceManagerTable &m_table;
+		Poco::AtomicCounter &m_stop;
+		bool m_failed;
+	};
+
+	ZMQDeviceManagerTable table;
+	Poco::AtomicCounter stop(false);
+	Reader first(table, stop);
+	Reader second(table, stop);
+	Poco::Thread firstThread;
+	Poco::Thread secondThread;
+
+	firstThread.start(first);
+	secondThread.start(second);
+
+	const DevicePrefix prefixes[] = {
+		DevicePrefix::fromRaw(DevicePrefix::PREFIX_ZWAVE),
+		DevicePrefix::fromRaw(DevicePrefix::PREFIX_JABLOTRON),
+	};
+	vector<DeviceManagerID> ids;
+
+	for (unsigned int i = 0; i < 5000; ++i) {
+		if (ids.size() < 100)
+			ids.push_back(table.registerDaemonPrefix(prefixes[i % 2]));
+
+		if (i % 3 == 0) {
+			table.unregisterDaemon(ids[i % ids.size()]);
+			ids.erase(ids.begin() + i % ids.size());
+		}
+	}
+
+	stop = true;
+	firstThread.join();
+	secondThread.join();
+
+	CPPUNIT_ASSERT(!first.failed());
+	CPPUNIT_ASSERT(!second.failed());
+	CPPUNIT_ASSERT(table.count() == ids.size());
+}
+
 }
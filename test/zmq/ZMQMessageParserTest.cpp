@@ -0,0 +1,317 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <Poco/Exception.h>
+#include <Poco/Logger.h>
+#include <Poco/Timestamp.h>
+
+#include "model/SensorData.h"
+#include "zmq/ZMQMessage.h"
+#include "zmq/ZMQMessageParser.h"
+
+using namespace Poco;
+using namespace std;
+
+namespace BeeeOn {
+
+class ZMQMessageParserTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ZMQMessageParserTest);
+	CPPUNIT_TEST(testType);
+	CPPUNIT_TEST(testMeasuredValues);
+	CPPUNIT_TEST(testMeasuredValuesBatch);
+	CPPUNIT_TEST(testParse);
+	CPPUNIT_TEST(testUnknownValueType);
+	CPPUNIT_TEST(testMissingAttribute);
+	CPPUNIT_TEST(testInvalidJSON);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testType();
+	void testMeasuredValues();
+	void testMeasuredValuesBatch();
+	void testParse();
+	void testUnknownValueType();
+	void testMissingAttribute();
+	void testInvalidJSON();
+
+protected:
+	static ZMQMessageType type(const string &json);
+	static SensorData toSensorData(const string &json);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ZMQMessageParserTest);
+
+class ZMQMessageParserBenchmark : public ZMQMessageParserTest {
+	CPPUNIT_TEST_SUITE(ZMQMessageParserBenchmark);
+	CPPUNIT_TEST(benchmarkParseThroughput);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void benchmarkParseThroughput();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(ZMQMessageParserBenchmark, "benchmark");
+
+static const string MEASURED_VALUES = R"(
+	{
+		"device_id" : "0xfe01020304050607",
+		"message_type" : "measured_values",
+		"values" : [
+			{
+				"module_id" : "0",
+				"raw" : "123.500000",
+				"type" : "double"
+			},
+			{
+				"module_id" : "1",
+				"raw" : "-59.400000",
+				"type" : "double"
+			}
+		]
+	}
+)";
+
+ZMQMessageType ZMQMessageParserTest::type(const string &json)
+{
+	return ZMQMessageParser::type(json.data(), json.size());
+}
+
+SensorData ZMQMessageParserTest::toSensorData(const string &json)
+{
+	return ZMQMessageParser::toSensorData(json.data(), json.size());
+}
+
+/*
+ * The message_type is found regardless of its position and regardless
+ * of nested values preceding it.
+ */
+void ZMQMessageParserTest::testType()
+{
+	CPPUNIT_ASSERT(type(MEASURED_VALUES) == ZMQMessageType::TYPE_MEASURED_VALUES);
+
+	CPPUNIT_ASSERT(type(R"({"message_type" : "error"})")
+		== ZMQMessageType::TYPE_ERROR);
+
+	CPPUNIT_ASSERT(type(R"({"a" : {"b" : [1, {"c" : null}]}, "d" : true,
+		"message_type" : "hello_request"})")
+		== ZMQMessageType::TYPE_HELLO_REQUEST);
+
+	CPPUNIT_ASSERT_THROW(type("{}"), InvalidAccessException);
+	CPPUNIT_ASSERT_THROW(type(R"({"message_type" : "unknown"})"),
+		InvalidArgumentException);
+}
+
+/*
+ * The streaming parser gives the same result as the DOM based
+ * ZMQMessage::toSensorData().
+ */
+void ZMQMessageParserTest::testMeasuredValues()
+{
+	Timestamp now;
+
+	SensorData testSensorData;
+	testSensorData.setDeviceID(DeviceID(0xfe01020304050607));
+	testSensorData.insertValue(SensorValue(ModuleID(0), 123.5));
+	testSensorData.insertValue(SensorValue(ModuleID(1), -59.4));
+	testSensorData.setTimestamp(now);
+
+	SensorData sensorData = toSensorData(MEASURED_VALUES);
+	sensorData.setTimestamp(now);
+
+	CPPUNIT_ASSERT(testSensorData == sensorData);
+
+	SensorData domSensorData = ZMQMessage::fromJSON(MEASURED_VALUES).toSensorData();
+	domSensorData.setTimestamp(now);
+
+	CPPUNIT_ASSERT(domSensorData == sensorData);
+}
+
+/*
+ * The streaming parser reads every record of the batch same as
+ * ZMQMessage::toSensorDataBatch().
+ */
+void ZMQMessageParserTest::testMeasuredValuesBatch()
+{
+	vector<SensorData> testBatch(3);
+	for (size_t i = 0; i < testBatch.size(); ++i) {
+		testBatch[i].setDeviceID(DeviceID(0xfe01020304050600 + i));
+		testBatch[i].insertValue(SensorValue(ModuleID(i), 10.5 * i));
+	}
+
+	const string json = ZMQMessage::fromSensorDataBatch(testBatch).toString();
+
+	CPPUNIT_ASSERT(type(json) == ZMQMessageType::TYPE_MEASURED_VALUES_BATCH);
+
+	const vector<SensorData> batch =
+		ZMQMessageParser::toSensorDataBatch(json.data(), json.size());
+	const vector<SensorData> domBatch =
+		ZMQMessage::fromJSON(json).toSensorDataBatch();
+
+	CPPUNIT_ASSERT_EQUAL(testBatch.size(), batch.size());
+	CPPUNIT_ASSERT_EQUAL(domBatch.size(), batch.size());
+
+	for (size_t i = 0; i < batch.size(); ++i)
+		CPPUNIT_ASSERT(domBatch[i] == batch[i]);
+
+	const string empty = R"({"message_type" : "measured_values_batch"})";
+	CPPUNIT_ASSERT_THROW(
+		ZMQMessageParser::toSensorDataBatch(empty.data(), empty.size()),
+		InvalidAccessException);
+}
+
+/*
+ * A single pass recognizes the type of message and reads
+ * the measured values regardless of the order of attributes.
+ * Other messages are only recognized.
+ */
+void ZMQMessageParserTest::testParse()
+{
+	Timestamp now;
+	vector<SensorData> data;
+
+	CPPUNIT_ASSERT(ZMQMessageParser::parse(
+			MEASURED_VALUES.data(), MEASURED_VALUES.size(), data)
+		== ZMQMessageType::TYPE_MEASURED_VALUES);
+	CPPUNIT_ASSERT_EQUAL(1, (int) data.size());
+
+	SensorData sensorData = toSensorData(MEASURED_VALUES);
+	sensorData.setTimestamp(now);
+	data[0].setTimestamp(now);
+
+	CPPUNIT_ASSERT(sensorData == data[0]);
+
+	vector<SensorData> testBatch(2);
+	for (size_t i = 0; i < testBatch.size(); ++i) {
+		testBatch[i].setDeviceID(DeviceID(0xfe01020304050600 + i));
+		testBatch[i].insertValue(SensorValue(ModuleID(i), 10.5 * i));
+	}
+
+	const string batch = ZMQMessage::fromSensorDataBatch(testBatch).toString();
+
+	CPPUNIT_ASSERT(ZMQMessageParser::parse(batch.data(), batch.size(), data)
+		== ZMQMessageType::TYPE_MEASURED_VALUES_BATCH);
+	CPPUNIT_ASSERT_EQUAL(testBatch.size(), data.size());
+	CPPUNIT_ASSERT(testBatch[1].deviceID() == data[1].deviceID());
+
+	const string error = R"({"message_type" : "error", "values" : 1})";
+
+	CPPUNIT_ASSERT(ZMQMessageParser::parse(error.data(), error.size(), data)
+		== ZMQMessageType::TYPE_ERROR);
+	CPPUNIT_ASSERT_EQUAL(testBatch.size(), data.size());
+
+	const string missing = R"({"values" : [], "message_type" : "measured_values"})";
+
+	CPPUNIT_ASSERT_THROW(
+		ZMQMessageParser::parse(missing.data(), missing.size(), data),
+		InvalidAccessException);
+}
+
+/*
+ * A value of unsupported type is reported as an invalid SensorValue
+ * the same way as ZMQMessage does it.
+ */
+void ZMQMessageParserTest::testUnknownValueType()
+{
+	const string json = R"(
+		{
+			"device_id" : "0xfe01020304050607",
+			"message_type" : "measured_values",
+			"values" : [
+				{
+					"module_id" : "0",
+					"type" : "unknown"
+				}
+			]
+		}
+	)";
+
+	Timestamp now;
+
+	SensorData sensorData = toSensorData(json);
+	sensorData.setTimestamp(now);
+
+	SensorData domSensorData = ZMQMessage::fromJSON(json).toSensorData();
+	domSensorData.setTimestamp(now);
+
+	CPPUNIT_ASSERT(domSensorData == sensorData);
+}
+
+void ZMQMessageParserTest::testMissingAttribute()
+{
+	CPPUNIT_ASSERT_THROW(toSensorData(R"({"values" : []})"),
+		InvalidAccessException);
+
+	CPPUNIT_ASSERT_THROW(toSensorData(R"({"device_id" : "0xfe01020304050607"})"),
+		InvalidAccessException);
+
+	CPPUNIT_ASSERT_THROW(toSensorData(R"({
+			"device_id" : "0xfe01020304050607",
+			"values" : [{"raw" : "1.0", "type" : "double"}]
+		})"),
+		InvalidAccessException);
+}
+
+void ZMQMessageParserTest::testInvalidJSON()
+{
+	CPPUNIT_ASSERT_THROW(type("invalidJSON"), SyntaxException);
+	CPPUNIT_ASSERT_THROW(type(R"({"message_type" "error"})"), SyntaxException);
+	CPPUNIT_ASSERT_THROW(type(R"({"a" : 1 "message_type" : "error"})"),
+		SyntaxException);
+
+	CPPUNIT_ASSERT_THROW(toSensorData(""), SyntaxException);
+	CPPUNIT_ASSERT_THROW(toSensorData(R"({"device_id" : "0x1", "values" : [)"),
+		SyntaxException);
+	CPPUNIT_ASSERT_THROW(toSensorData(R"({"values" : [1, 2]})"),
+		SyntaxException);
+	CPPUNIT_ASSERT_THROW(toSensorData(R"({"device_id" : "0x1",})"),
+		SyntaxException);
+	CPPUNIT_ASSERT_THROW(toSensorData(R"({"device_id" : })"),
+		SyntaxException);
+}
+
+/*
+ * Compares throughput of the DOM based parsing (as done by the broker
+ * originally) with the streaming parser on a typical measured_values
+ * message.
+ */
+void ZMQMessageParserBenchmark::benchmarkParseThroughput()
+{
+	const unsigned int count = 20000;
+	Logger &logger = Logger::get("ZMQMessageParserTest");
+	size_t values = 0;
+
+	Timestamp start;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		ZMQMessage message = ZMQMessage::fromJSON(
+			MEASURED_VALUES.data(), MEASURED_VALUES.size());
+
+		if (message.type() == ZMQMessageType::TYPE_MEASURED_VALUES) {
+			const SensorData data = message.toSensorData();
+			values += data.end() - data.begin();
+		}
+	}
+
+	const Timestamp::TimeDiff domTime = start.elapsed();
+	start.update();
+
+	vector<SensorData> data;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		if (ZMQMessageParser::parse(MEASURED_VALUES.data(),
+				MEASURED_VALUES.size(), data)
+				== ZMQMessageType::TYPE_MEASURED_VALUES) {
+			values -= data.front().end() - data.front().begin();
+		}
+	}
+
+	const Timestamp::TimeDiff streamTime = start.elapsed();
+
+	CPPUNIT_ASSERT_EQUAL((size_t) 0, values);
+
+	logger.information(to_string(count) + " measured_values messages: DOM "
+		+ to_string(count * 1000000.0 / (domTime ? domTime : 1)) + " msg/s, "
+		+ "streaming "
+		+ to_string(count * 1000000.0 / (streamTime ? streamTime : 1)) + " msg/s");
+}
+
+}
@@ -25,6 +25,7 @@ class ZMQMessageTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(testHelloRequest);
 	CPPUNIT_TEST(testHelloResponse);
 	CPPUNIT_TEST(testMeasuredValues);
+	CPPUNIT_TEST(testMeasuredValuesBatch);
 	CPPUNIT_TEST(testGatewayListenCommand);
 	CPPUNIT_TEST(testDefaultResult);
 	CPPUNIT_TEST(testDeviceSetValueCommand);
@@ -42,6 +43,7 @@ public:
 	void testHelloRequest();
 	void testHelloResponse();
 	void testMeasuredValues();
+	void testMeasuredValuesBatch();
 	void testGatewayListenCommand();
 	void testDefaultResult();
 	void testDeviceSetValueCommand();
@@ -197,6 +199,59 @@ void ZMQMessageTest::testMeasuredValues()
 	CPPUNIT_ASSERT(testSensorData == sensorData);
 }
 
+void ZMQMessageTest::testMeasuredValuesBatch()
+{
+	string jsonMessage = R"(
+		{
+			"message_type" : "measured_values_batch",
+			"data" : [
+				{
+					"device_id" : "0xfe01020304050607",
+					"values" : [
+						{
+							"module_id" : "0",
+							"raw" : "123.500000",
+							"type" : "double"
+						}
+					]
+				},
+				{
+					"device_id" : "0xfe01020304050608",
+					"values" : [
+						{
+							"module_id" : "1",
+							"raw" : "-59.400000",
+							"type" : "double"
+						}
+					]
+				}
+			]
+		}
+	)";
+	Timestamp now;
+	vector<SensorData> testBatch(2);
+
+	testBatch[0].setDeviceID(DeviceID(0xfe01020304050607));
+	testBatch[0].insertValue(SensorValue(ModuleID(0), 123.5));
+	testBatch[0].setTimestamp(now);
+	testBatch[1].setDeviceID(DeviceID(0xfe01020304050608));
+	testBatch[1].insertValue(SensorValue(ModuleID(1), -59.4));
+	testBatch[1].setTimestamp(now);
+
+	ZMQMessage message = ZMQMessage::fromSensorDataBatch(testBatch);
+
+	CPPUNIT_ASSERT(toPocoJSON(jsonMessage) == message.toString());
+	CPPUNIT_ASSERT(message.type() == ZMQMessageType::TYPE_MEASURED_VALUES_BATCH);
+
+	vector<SensorData> batch = message.toSensorDataBatch();
+	CPPUNIT_ASSERT_EQUAL(testBatch.size(), batch.size());
+
+	for (size_t i = 0; i < batch.size(); ++i) {
+		batch[i].setTimestamp(now);
+		CPPUNIT_ASSERT(testBatch[i] == batch[i]);
+	}
+}
+
 void ZMQMessageTest::testGatewayListenCommand()
 {
 	Timespan duration(60*Timespan::SECONDS);